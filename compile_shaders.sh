@@ -4,3 +4,20 @@
 /usr/local/bin/glslc shaders/phong_shader.frag -o shaders/phong_shader.frag.spv
 /usr/local/bin/glslc shaders/light_shader.vert -o shaders/light_shader.vert.spv
 /usr/local/bin/glslc shaders/light_shader.frag -o shaders/light_shader.frag.spv
+/usr/local/bin/glslc shaders/instance_culling.comp -o shaders/instance_culling.comp.spv
+/usr/local/bin/glslc shaders/meshlet_culling.comp -o shaders/meshlet_culling.comp.spv
+/usr/local/bin/glslc shaders/depth_prepass.vert -o shaders/depth_prepass.vert.spv
+/usr/local/bin/glslc shaders/skin_lut.comp -o shaders/skin_lut.comp.spv
+/usr/local/bin/glslc shaders/prefilter_specular.comp -o shaders/prefilter_specular.comp.spv
+/usr/local/bin/glslc shaders/irradiance.comp -o shaders/irradiance.comp.spv
+/usr/local/bin/glslc shaders/brdf_lut.comp -o shaders/brdf_lut.comp.spv
+/usr/local/bin/glslc shaders/light_clustering.comp -o shaders/light_clustering.comp.spv
+/usr/local/bin/glslc shaders/shadow_map.vert -o shaders/shadow_map.vert.spv
+/usr/local/bin/glslc shaders/sss_downsample.comp -o shaders/sss_downsample.comp.spv
+/usr/local/bin/glslc shaders/sss_blur.comp -o shaders/sss_blur.comp.spv
+/usr/local/bin/glslc shaders/fullscreen.vert -o shaders/fullscreen.vert.spv
+/usr/local/bin/glslc shaders/sss_composite.frag -o shaders/sss_composite.frag.spv
+/usr/local/bin/glslc shaders/sss_resolve.frag -o shaders/sss_resolve.frag.spv
+/usr/local/bin/glslc shaders/upscale.frag -o shaders/upscale.frag.spv
+/usr/local/bin/glslc shaders/tonemap.frag -o shaders/tonemap.frag.spv
+/usr/local/bin/glslc shaders/tonemap_pass.frag -o shaders/tonemap_pass.frag.spv
\ No newline at end of file
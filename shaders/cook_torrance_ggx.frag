@@ -3,19 +3,74 @@
 #define PI 3.14159265
 
  
-const float roughness = 0.5;
-const float IOR = 1.5;
+// Specialization constants, provided per shader variant by ModelPipeline
+layout(constant_id = 0) const bool SSS_ENABLED = true;
+layout(constant_id = 1) const bool NORMAL_MAPPING_ENABLED = true;
+layout(constant_id = 2) const int THICKNESS_SAMPLES = 7;
+layout(constant_id = 5) const bool BAKED_THICKNESS = true;
+layout(constant_id = 6) const bool PREINTEGRATED_SKIN = false;
+layout(constant_id = 7) const float CURVATURE_SCALE = 0.005;
+layout(constant_id = 8) const bool IBL_ENABLED = false;
+layout(constant_id = 9) const float IBL_INTENSITY = 1.0;
+layout(constant_id = 10) const bool SCREEN_SPACE_SSS = false;
+layout(constant_id = 11) const uint TEXTURE_SLOTS = 8;
 
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
     vec3 position;
     vec3 lightPosition;
+    vec4 clusterScale;
+    uvec4 clusterGrid;
+    mat4 shadowFaces[6];
+    vec4 shadowParams;
 } ubo;
-layout(binding = 1) uniform sampler2D texSampler;
-layout(binding = 2) uniform sampler2D normalMapSampler; 
+layout(binding = 5) uniform sampler2D skinLutSampler;
+layout(binding = 6) uniform samplerCube specularMapSampler;
+layout(binding = 7) uniform samplerCube irradianceMapSampler;
+layout(binding = 8) uniform sampler2D brdfLutSampler;
+layout(binding = 12) uniform sampler2DShadow shadowMapSampler;
+
+// Point lights binned into view frustum clusters by light_clustering.comp
+struct PointLight {
+    vec4 positionRadius;
+    vec4 colorIntensity;
+};
+layout(std430, binding = 9) readonly buffer LightBuffer {
+    PointLight lights[];
+};
+layout(std430, binding = 10) readonly buffer LightGridBuffer {
+    uvec2 lightGrid[];
+};
+layout(std430, binding = 11) readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+};
+
+// Bindless heap shared by every material, see BindlessHeap
+struct Material {
+    uint albedoTexture;
+    uint normalMapTexture;
+    uint thicknessTexture;
+    uint flags;
+    vec4 tint;          // multiplies the albedo
+    float roughness;
+    float ior;
+    float ambient;
+    float padding;
+};
+layout(set = 1, binding = 0) uniform sampler2D textures[TEXTURE_SLOTS];
+layout(std430, set = 1, binding = 1) readonly buffer MaterialBuffer {
+    Material materials[];
+};
+// after the shadow pass's view-projection, the same for every fragment of a draw
+layout(push_constant) uniform DrawConstants {
+    layout(offset = 64) uint materialIndex;
+} draw;
+
+// parameters of the draw's material, set at the start of main
+float roughness;
+float IOR;
 
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec3 vertexNormal;
@@ -24,6 +79,7 @@ layout(location = 3) in mat3 TBNMatrix;
 
 
 layout(location = 0) out vec4 fragmentColor;
+layout(location = 1) out vec4 irradianceColor;  // key light diffuse and view depth, blurred by the screen-space scattering
 
 float chi(float v)
 {
@@ -33,14 +89,13 @@ float chi(float v)
 
 //Simplified reverse Screen-space Ambient Occlusion
 float thickness(float maximumDistance, float falloff) {
-    const int sampleCount = 7;
     float ao = 0.0;
 
-    for (int i=0; i<sampleCount; i++) {
+    for (int i=0; i<THICKNESS_SAMPLES; i++) {
         ao += fract(sin(i/10))*maximumDistance;
     }
 
-    return 1.0 - ao/float(sampleCount);
+    return 1.0 - ao/float(THICKNESS_SAMPLES);
 }
 
 
@@ -52,18 +107,109 @@ vec3 sss2(vec3 diffuse, vec3 N, vec3 V, vec3 L) {
     float powDot = pow(clamp(dot(V, lightVec), 0.0, 1.0), power);
     float lightAttenuation = 1 / pow(length(ubo.lightPosition-vertexPosition) / 2, 3.0); 
     float ambient = 1.0;
-    float translucency = lightAttenuation * (powDot + ambient) * thickness(6.0, 0.6);
+    //baked offline by tools/thickness_baker, white = thin
+    float localThickness = BAKED_THICKNESS ? texture(textures[materials[draw.materialIndex].thicknessTexture], vertexTexCoord).r : thickness(6.0, 0.6);
+    float translucency = lightAttenuation * (powDot + ambient) * localThickness;
     float lightDiffuse = 0.0005;
     return diffuse * lightDiffuse * translucency;
 }
 
+// Penner pre-integrated skin: diffuse scattering looked up by N.L and curvature (generated by skin_lut.comp)
+vec3 preintegratedDiffuse(vec3 N, vec3 L) {
+    vec3 geometricNormal = TBNMatrix[2];
+    float curvature = length(fwidth(geometricNormal)) / max(length(fwidth(vertexPosition)), 1e-6);
+    return texture(skinLutSampler, vec2(dot(N, L) * 0.5 + 0.5, clamp(curvature * CURVATURE_SCALE, 0.0, 1.0))).rgb;
+}
+
+// Split-sum image-based lighting, maps prefiltered by EnvironmentLighting (one roughness per specular mip level)
+vec3 environmentLighting(vec3 diffuse, vec3 N, vec3 V, float F0) {
+    float NdotV = max(dot(N, V), 1e-4);
+    vec3 irradiance = texture(irradianceMapSampler, N).rgb;
+    float lod = roughness * float(textureQueryLevels(specularMapSampler) - 1);
+    vec3 prefiltered = textureLod(specularMapSampler, reflect(-V, N), lod).rgb;
+    vec2 scaleBias = texture(brdfLutSampler, vec2(NdotV, roughness)).rg;
+    return IBL_INTENSITY * (irradiance * diffuse * (1.0 - F0) + prefiltered * (F0 * scaleBias.x + scaleBias.y));
+}
+
+// Visibility of the movable light, looked up in the shadow atlas rendered by ShadowMap: one 90 degree face per
+// major axis (+x, -x, +y, -y, +z, -z), laid out in 3 columns and 2 rows
+float keyLightShadow() {
+    if (ubo.shadowParams.x == 0.0) {
+        return 1.0;
+    }
+    vec3 fromLight = vertexPosition - ubo.lightPosition;
+    vec3 axis = abs(fromLight);
+    int face;
+    if (axis.x >= axis.y && axis.x >= axis.z) {
+        face = fromLight.x > 0.0 ? 0 : 1;
+    } else if (axis.y >= axis.z) {
+        face = fromLight.y > 0.0 ? 2 : 3;
+    } else {
+        face = fromLight.z > 0.0 ? 4 : 5;
+    }
+    vec4 clip = ubo.shadowFaces[face] * vec4(vertexPosition, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    //kept half a texel inside the face, so filtering never reads the neighbouring one
+    float inset = 0.5 * ubo.shadowParams.y;
+    vec2 faceUv = clamp(ndc.xy * 0.5 + 0.5, inset, 1.0 - inset);
+    vec2 atlasUv = (vec2(face % 3, face / 3) + faceUv) / vec2(3.0, 2.0);
+    return texture(shadowMapSampler, vec3(atlasUv, ndc.z));
+}
+
+// Light cluster of the fragment: screen tile and exponential depth slice, as laid out by light_clustering.comp
+uint clusterIndex() {
+    float viewDepth = -(ubo.view * vec4(vertexPosition, 1.0)).z;
+    uint x = min(uint(gl_FragCoord.x * ubo.clusterScale.x), ubo.clusterGrid.x - 1u);
+    uint y = min(uint(gl_FragCoord.y * ubo.clusterScale.y), ubo.clusterGrid.y - 1u);
+    uint z = uint(clamp(log(viewDepth) * ubo.clusterScale.z + ubo.clusterScale.w, 0.0, float(ubo.clusterGrid.z - 1u)));
+    return x + ubo.clusterGrid.x * (y + ubo.clusterGrid.y * z);
+}
+
+// Smooth window reaching zero at the light radius, so lights outside their clusters contribute nothing
+float lightFalloff(float distanceSquared, float radius) {
+    float window = clamp(1.0 - distanceSquared * distanceSquared / pow(radius, 4.0), 0.0, 1.0);
+    return window * window;
+}
+
+// Lambert diffuse and GGX specular of the point lights listed for the fragment's cluster
+vec3 clusteredLights(vec3 diffuse, vec3 N, vec3 V, float F0) {
+    uvec2 range = lightGrid[clusterIndex()];
+    float alpha = roughness * roughness;
+    float k = alpha / 2.0;
+    float NdotV = max(dot(N, V), 1e-4);
+    vec3 result = vec3(0.0);
+    for (uint i = 0; i < range.y; i++) {
+        PointLight light = lights[lightIndices[range.x + i]];
+        vec3 toLight = light.positionRadius.xyz - vertexPosition;
+        float distanceSquared = dot(toLight, toLight);
+        vec3 L = toLight * inversesqrt(distanceSquared);
+        float NdotL = dot(N, L);
+        if (NdotL <= 0.0) {
+            continue;
+        }
+        vec3 H = normalize(V + L);
+        float NdotH = max(dot(N, H), 0.0);
+        float dDenominator = NdotH * NdotH * (alpha * alpha - 1.0) + 1.0;
+        float D = alpha * alpha / (PI * dDenominator * dDenominator);
+        float F = F0 + (1.0 - F0) * pow(1.0 - max(dot(H, V), 0.0), 5);
+        float G = NdotL / (NdotL * (1.0 - k) + k) * NdotV / (NdotV * (1.0 - k) + k);
+        float specular = D * F * G / (4.0 * NdotL * NdotV);
+        vec3 radiance = light.colorIntensity.rgb * light.colorIntensity.a * lightFalloff(distanceSquared, light.positionRadius.w);
+        result += (diffuse * (1.0 - F) + specular) * NdotL * radiance;
+    }
+    return result;
+}
+
 // Cook-Torrance Specular
 vec4 rs() {
-    vec4 diffuseTex = texture(texSampler, vertexTexCoord);
-    vec4 normalTex = texture(normalMapSampler, vertexTexCoord);
-
-    vec3 N = normalize(normalTex.rgb);
-    N = normalize(TBNMatrix * N);
+    vec4 diffuseTex = texture(textures[materials[draw.materialIndex].albedoTexture], vertexTexCoord) * materials[draw.materialIndex].tint;
+    vec3 N;
+    if (NORMAL_MAPPING_ENABLED) {
+        vec4 normalTex = texture(textures[materials[draw.materialIndex].normalMapTexture], vertexTexCoord);
+        N = normalize(TBNMatrix * normalize(normalTex.rgb));
+    } else {
+        N = normalize(TBNMatrix[2]);
+    }
     vec3 V = normalize(ubo.position - vertexPosition);
     vec3 L = normalize(ubo.lightPosition - vertexPosition);
     vec3 H = normalize(V + L); //Half-vector, between viewer and the light
@@ -96,9 +242,25 @@ vec4 rs() {
 
     float sinT = sqrt( 1 - NdotL * NdotL);
 
-    vec4 ka = vec4(0.05, 0.05, 0.05, 1.0);
+    vec4 ka = vec4(vec3(materials[draw.materialIndex].ambient), 1.0);
 
-    vec4 fin = (ks * brdf * sinT + NdotL + ka) * diffuseTex;   // color-corrected specular
+    //the LUT already contains the light scattered under the surface, so it replaces both N.L and the sss2 term
+    vec4 diffuseLight = PREINTEGRATED_SKIN ? vec4(preintegratedDiffuse(N, L), NdotL) : vec4(NdotL);
+    vec4 ambient = IBL_ENABLED ? vec4(environmentLighting(diffuseTex.rgb, N, V, F0), ka.a * diffuseTex.a) : ka * diffuseTex;
+    float shadow = keyLightShadow();
+    //with screen-space scattering the key light diffuse is blurred after the pass instead of being added here
+    bool scatter = SCREEN_SPACE_SSS && SSS_ENABLED && !PREINTEGRATED_SKIN;
+    vec4 keyDiffuse = diffuseLight * diffuseTex;
+    vec4 keyLight = ks * brdf * sinT * diffuseTex + (scatter ? vec4(0.0, 0.0, 0.0, keyDiffuse.a) : keyDiffuse);   // color-corrected specular
+    vec4 fin = vec4(keyLight.rgb * shadow, keyLight.a) + ambient;
+    if (SCREEN_SPACE_SSS) {
+        float viewDepth = -(ubo.view * vec4(vertexPosition, 1.0)).z;
+        irradianceColor = scatter ? vec4(keyDiffuse.rgb * shadow, viewDepth) : vec4(0.0);
+    }
+    fin.rgb += clusteredLights(diffuseTex.rgb, N, V, F0);
+    if (!SSS_ENABLED || PREINTEGRATED_SKIN) {
+        return vec4(0.0, 0.0, 0.0, 1.0) + fin;
+    }
     vec3 sssCol = sss2(diffuseTex.rgb, N, V, L);
     sssCol = clamp(sssCol, 0.0, 1.0);
     return vec4(sssCol, 1.0) + fin ;
@@ -106,6 +268,8 @@ vec4 rs() {
 
 
 void main() {
+    roughness = materials[draw.materialIndex].roughness;
+    IOR = materials[draw.materialIndex].ior;
     vec4 total = rs();
     
     fragmentColor = total;
@@ -0,0 +1,26 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    vec3 position;
+    vec3 lightPosition;
+} ubo;
+
+struct InstanceData {
+    mat4 model;
+};
+
+layout(std430, binding = 3) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+// position-only stream, the pre-pass has no fragment shader and writes nothing but depth
+layout(location = 0) in vec3 inputPosition;
+
+invariant gl_Position;
+
+void main() {
+    mat4 model = instances[gl_InstanceIndex].model;
+    gl_Position = ubo.proj * ubo.view * model * vec4(inputPosition, 1.0);
+}
@@ -9,29 +9,107 @@ const int shininess = 8;
 
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
     vec3 position;
     vec3 lightPosition;
+    vec4 clusterScale;
+    uvec4 clusterGrid;
+    mat4 shadowFaces[6];
+    vec4 shadowParams;
 } ubo;
+layout(binding = 12) uniform sampler2DShadow shadowMapSampler;
+
+// Point lights binned into view frustum clusters by light_clustering.comp
+struct PointLight {
+    vec4 positionRadius;
+    vec4 colorIntensity;
+};
+layout(std430, binding = 9) readonly buffer LightBuffer {
+    PointLight lights[];
+};
+layout(std430, binding = 10) readonly buffer LightGridBuffer {
+    uvec2 lightGrid[];
+};
+layout(std430, binding = 11) readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+};
 
 
 layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec3 vertexNormal;
 
 layout(location = 0) out vec4 fragmentColor;
+layout(location = 1) out vec4 irradianceColor;  // nothing scatters, zero alpha keeps the screen-space scattering off
+
+// Visibility of the movable light, looked up in the shadow atlas rendered by ShadowMap: one 90 degree face per
+// major axis (+x, -x, +y, -y, +z, -z), laid out in 3 columns and 2 rows
+float keyLightShadow() {
+    if (ubo.shadowParams.x == 0.0) {
+        return 1.0;
+    }
+    vec3 fromLight = vertexPosition - ubo.lightPosition;
+    vec3 axis = abs(fromLight);
+    int face;
+    if (axis.x >= axis.y && axis.x >= axis.z) {
+        face = fromLight.x > 0.0 ? 0 : 1;
+    } else if (axis.y >= axis.z) {
+        face = fromLight.y > 0.0 ? 2 : 3;
+    } else {
+        face = fromLight.z > 0.0 ? 4 : 5;
+    }
+    vec4 clip = ubo.shadowFaces[face] * vec4(vertexPosition, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    //kept half a texel inside the face, so filtering never reads the neighbouring one
+    float inset = 0.5 * ubo.shadowParams.y;
+    vec2 faceUv = clamp(ndc.xy * 0.5 + 0.5, inset, 1.0 - inset);
+    vec2 atlasUv = (vec2(face % 3, face / 3) + faceUv) / vec2(3.0, 2.0);
+    return texture(shadowMapSampler, vec3(atlasUv, ndc.z));
+}
+
+// Light cluster of the fragment: screen tile and exponential depth slice, as laid out by light_clustering.comp
+uint clusterIndex() {
+    float viewDepth = -(ubo.view * vec4(vertexPosition, 1.0)).z;
+    uint x = min(uint(gl_FragCoord.x * ubo.clusterScale.x), ubo.clusterGrid.x - 1u);
+    uint y = min(uint(gl_FragCoord.y * ubo.clusterScale.y), ubo.clusterGrid.y - 1u);
+    uint z = uint(clamp(log(viewDepth) * ubo.clusterScale.z + ubo.clusterScale.w, 0.0, float(ubo.clusterGrid.z - 1u)));
+    return x + ubo.clusterGrid.x * (y + ubo.clusterGrid.y * z);
+}
+
+// Smooth window reaching zero at the light radius, so lights outside their clusters contribute nothing
+float lightFalloff(float distanceSquared, float radius) {
+    float window = clamp(1.0 - distanceSquared * distanceSquared / pow(radius, 4.0), 0.0, 1.0);
+    return window * window;
+}
+
+// Phong terms of the point lights listed for the fragment's cluster
+vec3 clusteredLights(vec3 N, vec3 V) {
+    uvec2 range = lightGrid[clusterIndex()];
+    vec3 result = vec3(0.0);
+    for (uint i = 0; i < range.y; i++) {
+        PointLight light = lights[lightIndices[range.x + i]];
+        vec3 toLight = light.positionRadius.xyz - vertexPosition;
+        float distanceSquared = dot(toLight, toLight);
+        vec3 L = toLight * inversesqrt(distanceSquared);
+        vec3 radiance = light.colorIntensity.rgb * light.colorIntensity.a * lightFalloff(distanceSquared, light.positionRadius.w);
+        result += radiance * max(dot(L, N), 0) * diffuseReflectionConstant;
+        result += radiance * specularReflectionConstant * pow(max(dot(V, reflect(-L, N)), 0), shininess);
+    }
+    return result;
+}
 
 void main()
 {
-    vec3 fragmentColor3 = ambientReflectionConstant * lightColor;
-
-    fragmentColor3 += lightColor * max(dot(normalize(ubo.lightPosition-vertexPosition), vertexNormal), 0) * diffuseReflectionConstant;
+    vec3 keyLight = lightColor * max(dot(normalize(ubo.lightPosition-vertexPosition), vertexNormal), 0) * diffuseReflectionConstant;
 
 
     vec3 observerOrientedVector = normalize(ubo.position - vertexPosition);
     vec3 specularVector = reflect(-normalize(ubo.lightPosition-vertexPosition), normalize(vertexNormal));
-    fragmentColor3 += specularReflectionConstant * pow(max(dot(observerOrientedVector, specularVector),0), shininess) * lightColor;
+    keyLight += specularReflectionConstant * pow(max(dot(observerOrientedVector, specularVector),0), shininess) * lightColor;
+
+    vec3 fragmentColor3 = ambientReflectionConstant * lightColor + keyLight * keyLightShadow();
+    fragmentColor3 += clusteredLights(normalize(vertexNormal), observerOrientedVector);
 
     fragmentColor = vec4(fragmentColor3 * vec3(0.5, 0.5, 0.5), 1.0);
+    irradianceColor = vec4(0.0);
 }
\ No newline at end of file
@@ -1,21 +1,32 @@
 #version 450
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
     vec3 position;
     vec3 lightPosition;
 } ubo;
 
+struct InstanceData {
+    mat4 model;
+};
+
+layout(std430, binding = 3) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
 layout(location = 0) in vec3 inputPosition;
 layout(location = 1) in vec3 inputNormal;
 
 layout(location = 0) out vec3 vertexPosition;
 layout(location = 1) out vec3 vertexNormal;
 
+// depth has to match the pre-pass bit for bit, shading is tested with VK_COMPARE_OP_EQUAL
+invariant gl_Position;
+
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inputPosition, 1.0);
-    vertexPosition = (ubo.model * vec4(inputPosition, 1.0)).xyz;
-    vertexNormal = (ubo.model * vec4(normalize(inputNormal), 1.0)).xyz;
+    mat4 model = instances[gl_InstanceIndex].model;
+    gl_Position = ubo.proj * ubo.view * model * vec4(inputPosition, 1.0);
+    vertexPosition = (model * vec4(inputPosition, 1.0)).xyz;
+    vertexNormal = (model * vec4(normalize(inputNormal), 1.0)).xyz;
 }
\ No newline at end of file
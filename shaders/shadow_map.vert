@@ -0,0 +1,21 @@
+#version 450
+
+struct InstanceData {
+    mat4 model;
+};
+
+layout(std430, binding = 3) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+// view-projection of the shadow atlas face being drawn
+layout(push_constant) uniform ShadowFace {
+    mat4 viewProjection;
+} face;
+
+// only the position of the full vertex is fetched, the shadow pass writes nothing but depth
+layout(location = 0) in vec3 inputPosition;
+
+void main() {
+    gl_Position = face.viewProjection * instances[gl_InstanceIndex].model * vec4(inputPosition, 1.0);
+}
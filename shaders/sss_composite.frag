@@ -0,0 +1,35 @@
+#version 450
+
+// Adds the blurred irradiance back onto the shaded image (additive blending). The half resolution result is
+// upsampled bilaterally: the four nearest texels are weighted by how close their depth is to the full resolution one.
+layout(binding = 0) uniform sampler2D scatteredSampler;
+layout(binding = 1) uniform sampler2D irradianceSampler;
+
+layout(push_constant) uniform PushConstants {
+    ivec2 halfSize;     // part of the half resolution target written by the blur
+} pc;
+
+layout(location = 0) out vec4 fragmentColor;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 irradiance = texelFetch(irradianceSampler, texel, 0);
+    if (irradiance.a <= 0.0) {
+        discard;
+    }
+    vec2 halfPosition = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(halfPosition));
+    vec2 f = fract(halfPosition);
+    vec3 sum = vec3(0.0);
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec4 scattered = texelFetch(scatteredSampler, clamp(base + offset, ivec2(0), pc.halfSize - 1), 0);
+        float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        float depthWeight = scattered.a > 0.0 ? 1.0 / (0.001 + abs(scattered.a - irradiance.a) / irradiance.a) : 0.0;
+        sum += scattered.rgb * bilinear * depthWeight;
+        weightSum += bilinear * depthWeight;
+    }
+    //thin features missing from the half resolution target keep their unblurred irradiance
+    fragmentColor = vec4(weightSum > 0.0 ? sum / weightSum : irradiance.rgb, 0.0);
+}
@@ -0,0 +1,25 @@
+#version 450
+
+// Resolves the multisampled irradiance at the end of the shading pass. The irradiance is averaged over all samples
+// like the HDR target, while the view depth comes from the nearest sample with scattering: averaging it would blend
+// the skin depth with the zero marking samples without scattering along the silhouette.
+layout(input_attachment_index = 0, binding = 0) uniform subpassInputMS irradianceSamples;
+
+layout(push_constant) uniform PushConstants {
+    int sampleCount;
+} pc;
+
+layout(location = 0) out vec4 resolvedIrradiance;
+
+void main() {
+    vec3 irradiance = vec3(0.0);
+    float depth = 0.0;
+    for (int i = 0; i < pc.sampleCount; i++) {
+        vec4 irradianceSample = subpassLoad(irradianceSamples, i);
+        irradiance += irradianceSample.rgb;
+        if (irradianceSample.a > 0.0) {
+            depth = depth > 0.0 ? min(depth, irradianceSample.a) : irradianceSample.a;
+        }
+    }
+    resolvedIrradiance = vec4(irradiance / float(pc.sampleCount), depth);
+}
@@ -0,0 +1,21 @@
+#version 450
+
+// Tonemaps the HDR target into the scene color target. Runs as a subpass after the one writing the HDR values and
+// reads them as an input attachment, so on tile-based GPUs they never leave tile memory.
+layout(input_attachment_index = 0, binding = 0) uniform subpassInput hdrColor;
+
+layout(push_constant) uniform PushConstants {
+    float exposure;
+} pc;
+
+layout(location = 0) out vec4 fragmentColor;
+
+// fitted ACES filmic curve
+vec3 aces(vec3 x) {
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main() {
+    //the sRGB target applies the transfer function on write
+    fragmentColor = vec4(aces(subpassLoad(hdrColor).rgb * pc.exposure), 1.0);
+}
@@ -0,0 +1,20 @@
+#version 450
+
+// Same tonemapping as tonemap.frag, as a separate pass sampling the stored HDR target. Kept for comparison with the
+// subpass, which spares writing the HDR values out and reading them back.
+layout(binding = 0) uniform sampler2D hdrSampler;
+
+layout(push_constant) uniform PushConstants {
+    float exposure;
+} pc;
+
+layout(location = 0) out vec4 fragmentColor;
+
+// fitted ACES filmic curve
+vec3 aces(vec3 x) {
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main() {
+    fragmentColor = vec4(aces(texelFetch(hdrSampler, ivec2(gl_FragCoord.xy), 0).rgb * pc.exposure), 1.0);
+}
@@ -0,0 +1,33 @@
+#version 450
+
+// Stretches the rendered part of the scene color target over the swap chain image and sharpens it. The sharpening
+// adds the difference to the four neighbours, clamped to their range so that edges do not ring.
+layout(binding = 0) uniform sampler2D sceneColorSampler;
+
+layout(push_constant) uniform PushConstants {
+    vec2 sourceScale;   // rendered part of the scene color target, in texture coordinates
+    vec2 texelSize;     // of the scene color target
+    vec2 outputSize;
+    float sharpness;
+} pc;
+
+layout(location = 0) out vec4 fragmentColor;
+
+vec3 fetch(vec2 uv) {
+    //keeps bilinear filtering from reaching past the rendered area
+    return texture(sceneColorSampler, clamp(uv, 0.5 * pc.texelSize, pc.sourceScale - 0.5 * pc.texelSize)).rgb;
+}
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / pc.outputSize * pc.sourceScale;
+    vec3 center = fetch(uv);
+    vec3 left = fetch(uv - vec2(pc.texelSize.x, 0.0));
+    vec3 right = fetch(uv + vec2(pc.texelSize.x, 0.0));
+    vec3 up = fetch(uv - vec2(0.0, pc.texelSize.y));
+    vec3 down = fetch(uv + vec2(0.0, pc.texelSize.y));
+
+    vec3 minimum = min(center, min(min(left, right), min(up, down)));
+    vec3 maximum = max(center, max(max(left, right), max(up, down)));
+    vec3 sharpened = center + (4.0 * center - left - right - up - down) * pc.sharpness;
+    fragmentColor = vec4(clamp(sharpened, minimum, maximum), 1.0);
+}
@@ -1,6 +1,9 @@
 #include "app.h"
 #include "app_config.h"
 
+#include <algorithm>
+#include <numeric>
+
 
 #ifdef NDEBUG
     const bool enableValidationLayers = false;
@@ -14,26 +17,70 @@ namespace vmr{
 App::App(AppConfig* config) : _appConfig(config) { }
 
 void App::run() {
+    _runStart = std::chrono::high_resolution_clock::now();
     _window = new Window("Vulkan Material Renderer", _appConfig);
+    _simulation = new Simulation(_appConfig);
+    _window->setSimulation(_simulation);
     initVulkan();
-    mainLoop();
+    if (_appConfig->benchmarkEnabled()) {
+        benchmarkLoop();
+    } else {
+        mainLoop();
+    }
     cleanup();
 }
 
 void App::initVulkan() {
-    _device = new Device(_window->window());
+    _device = new Device(_window->window(), _appConfig);
+    _threadPool = new ThreadPool(std::thread::hardware_concurrency());
+    _scene = new Scene(_appConfig);
     _swapChain = new SwapChain(_device, _window->window(), _appConfig);
     createRenderPass();
-    _modelPipeline = new ModelPipeline(_device, _swapChain, _appConfig, _appConfig->modelVertexShaderPath(), _appConfig->modelFragmentShaderPath(), _appConfig->displayModelPath());
-    _lightPipeline = new LightPipeline(_device, _swapChain, _appConfig, _appConfig->lightVertexShaderPath(), _appConfig->lightFragmentShaderPath(), _appConfig->sphereModelPath());
+    _clusteredLighting = new ClusteredLighting(_device, _appConfig, _scene);
+    _shadowMap = new ShadowMap(_device, _appConfig, _scene);
+    _bindlessHeap = new BindlessHeap(_device, _appConfig, MAX_FRAMES_IN_FLIGHT);
+    _geometryArena = new GeometryArena(_device, _appConfig);
+    _modelPipeline = new ModelPipeline(_device, _swapChain, _appConfig, _threadPool, _scene, _clusteredLighting, _shadowMap, _bindlessHeap, _geometryArena, _appConfig->modelVertexShaderPath(), _appConfig->modelFragmentShaderPath(), _appConfig->displayModelPath());
+    _lightPipeline = new LightPipeline(_device, _swapChain, _appConfig, _geometryArena, _appConfig->lightVertexShaderPath(), _appConfig->lightFragmentShaderPath(), _appConfig->sphereModelPath());
     createCommandPool();
     _swapChain->createDepthResources();
+    _swapChain->createMultisampleResources();
+    _swapChain->createHdrResources();
+    createRenderGraph();
+    compileRenderGraph();
+    _renderGraph->printSchedule();
     _swapChain->createFramebuffers();
+    if (_appConfig->screenSpaceSss()) {
+        _screenSpaceSss = new ScreenSpaceSss(_device, _appConfig, _swapChain, _renderGraph, _sssFirstTarget, _sssSecondTarget, MAX_FRAMES_IN_FLIGHT);
+    }
+    //the tonemapping subpass ends the render pass writing the HDR target last
+    if (_screenSpaceSss) {
+        _tonemapping = new Tonemapping(_device, _appConfig, _swapChain, _screenSpaceSss->compositeRenderPass(), 1);
+    } else {
+        _tonemapping = new Tonemapping(_device, _appConfig, _swapChain, _swapChain->renderPass(), _appConfig->shadingSubpass() + 1);
+    }
+    if (_appConfig->dynamicResolution()) {
+        _dynamicResolution = new DynamicResolution(_device, _appConfig, _swapChain);
+    }
     _swapChain->createTextureImages();
     _swapChain->createTextureImageViews();
     _swapChain->createTextureSampler();
     _modelPipeline->prepareModel();
     _lightPipeline->prepareModel();
+    if (_appConfig->cullingEnabled()) {
+        _cullingPass = new CullingPass(_device, _appConfig, _scene, _modelPipeline);
+    }
+    //GPU culling writes its own indirect draws in scene order, which leaves no draws to sort; it is only used with a single material
+    if (!_cullingPass || !_cullingPass->gpuCulling()) {
+        _renderQueue = new RenderQueue(_appConfig->renderQueueSort());
+    }
+    _gpuProfiler = new GpuProfiler(_device, MAX_FRAMES_IN_FLIGHT);
+    if (_appConfig->hotReload()) {
+        _hotReload = new HotReload(_device, _appConfig, _threadPool, _swapChain, _modelPipeline, _shadowMap, _cullingPass);
+    }
+    if (_appConfig->captureEnabled()) {
+        _frameCapture = new FrameCapture(_device, _appConfig, _swapChain, _threadPool, MAX_FRAMES_IN_FLIGHT);
+    }
     createCommandBuffers();
     createSyncObjects();
 }
@@ -43,11 +90,20 @@ void App::mainLoop() {
     uint64_t framesCount = 0;
     std::cout.setf(std::ios::fixed,std::ios::floatfield);
     std::cout.precision(3);
-    while (!_window->shouldClose()) {
+    auto frameStart = start;
+    while (!_window->shouldClose() && !(_frameCapture && _frameCapture->finished())
+           && !(_appConfig->metricsFrames() > 0 && framesCount >= _appConfig->metricsFrames())) {
         _window->pollEvents();
         _window->handleKeystrokes();
         drawFrame();
         framesCount++;
+        auto frameEnd = std::chrono::high_resolution_clock::now();
+        if (framesCount == 1) {
+            _startupMs = std::chrono::duration<double, std::milli>(frameEnd - _runStart).count();
+        } else if (!_appConfig->metricsPath().empty()) {
+            _frameTimesMs.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        }
+        frameStart = frameEnd;
     }
     auto end = std::chrono::high_resolution_clock::now();
     auto executionTime = std::chrono::duration_cast
@@ -55,14 +111,149 @@ void App::mainLoop() {
     std::cout<<"\nAvg fps: "
              <<framesCount / (double) executionTime.count()
              <<std::endl;
+    _swapChain->printRecreateStats();
+    _swapChain->printAttachmentMemory();
+    if (_cullingPass) {
+        _cullingPass->printStats();
+    }
+    _clusteredLighting->printStats();
+    _shadowMap->printStats();
+    _bindlessHeap->printStats();
+    _geometryArena->printStats();
+    if (_renderQueue) {
+        _renderQueue->printStats();
+    }
+    _tonemapping->printStats();
+    if (_dynamicResolution) {
+        _dynamicResolution->printStats();
+    }
+    if (_hotReload) {
+        _hotReload->printStats();
+    }
+    if (_inputLatencyCount > 0) {
+        std::cout<<"Avg input-to-GPU-completion latency: "<<_inputLatencyTotalMs / _inputLatencyCount<<" ms, max "<<_inputLatencyMaxMs
+                 <<" ms over "<<_inputLatencyCount<<" frame(s) showing new input, simulated at "<<_appConfig->simulationTickRate()<<" Hz";
+        if (_simulation->lateTicks() > 0) {
+            std::cout<<" ("<<_simulation->lateTicks()<<" late tick(s))";
+        }
+        std::cout<<std::endl;
+    }
+    if (_gpuProfiler->timestampsSupported()) {
+        std::cout<<"Avg GPU time of the light clustering: "<<_gpuProfiler->averageTimestampMs("light clustering")<<" ms, of the model shading: "
+                 <<_gpuProfiler->averageTimestampMs("model shading")<<" ms, of a shadow map render: "
+                 <<_gpuProfiler->averageTimestampMs("shadow map")<<" ms"<<std::endl;
+        if (_screenSpaceSss && _screenSpaceSss->asyncCompute() && !_device->capabilities().computeTimestamps) {
+            std::cout<<"Avg GPU time of the screen-space scattering composite: "<<_gpuProfiler->averageTimestampMs("sss composite")
+                     <<" ms, the compute queue has no timestamps for the downsample and blur"<<std::endl;
+        } else if (_screenSpaceSss) {
+            std::cout<<"Avg GPU time of the screen-space scattering"<<(_screenSpaceSss->asyncCompute() ? " (async compute)" : "")<<": downsample "
+                     <<_gpuProfiler->averageTimestampMs("sss downsample")<<" ms, blur "
+                     <<_gpuProfiler->averageTimestampMs("sss blur")<<" ms, composite "
+                     <<_gpuProfiler->averageTimestampMs("sss composite")<<" ms"<<std::endl;
+        }
+        std::cout<<"Avg GPU frame time at "<<_swapChain->sampleCount()<<"x MSAA: "<<_gpuProfiler->averageTimestampMs("frame")<<" ms";
+        if (!_tonemapping->subpass()) {
+            std::cout<<", of the tonemap pass: "<<_gpuProfiler->averageTimestampMs("tonemap")<<" ms";
+        }
+        if (_dynamicResolution) {
+            std::cout<<", of the upscale: "<<_gpuProfiler->averageTimestampMs("upscale")<<" ms";
+        }
+        std::cout<<std::endl;
+    }
+    if (_gpuProfiler->statisticsSupported()) {
+        std::cout<<"Avg fragment shader invocations of the model shading per frame: "
+                 <<_gpuProfiler->averageFragmentInvocations()
+                 <<(_appConfig->depthPrePass() ? " (with depth pre-pass)" : " (without depth pre-pass)")<<std::endl;
+    }
+    printVariantCosts();
 
     vkDeviceWaitIdle(_device->logical());
+    //the frames still in flight are only counted once they are collected and encoded
+    if (_frameCapture) {
+        _frameCapture->finish();
+        _frameCapture->printStats();
+    }
+    if (!_appConfig->metricsPath().empty()) {
+        writeMetrics();
+    }
+}
+
+void App::writeMetrics() {
+    //the median is robust against the odd frame stalled by the OS, which matters when comparing runs
+    std::vector<double> sorted = _frameTimesMs;
+    std::sort(sorted.begin(), sorted.end());
+    nlohmann::json metrics;
+    metrics["startupMs"] = _startupMs;
+    metrics["frames"] = _frameTimesMs.size() + 1;
+    metrics["medianFrameMs"] = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+    metrics["avgFrameMs"] = sorted.empty() ? 0.0 : std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+    if (_gpuProfiler->timestampsSupported()) {
+        metrics["gpuFrameMs"] = _gpuProfiler->averageTimestampMs("frame");
+    }
+    std::ofstream file(_appConfig->metricsPath());
+    if (!file) {
+        throw std::runtime_error("failed to write metrics to " + _appConfig->metricsPath() + "!");
+    }
+    file<<metrics.dump(4)<<std::endl;
+}
+
+void App::benchmarkLoop() {
+    const uint32_t warmupFrames = 30;
+    std::cout.setf(std::ios::fixed,std::ios::floatfield);
+    std::cout.precision(3);
+    std::cout<<"\n"<<_swapChain->sampleCount()<<"x MSAA\ninstances | avg frame time [ms] | fps | instances/s\n";
+    for (uint32_t instanceCount : _appConfig->benchmarkInstanceCounts()) {
+        _scene->populateCrowd(instanceCount);
+        for (uint32_t i = 0; i < warmupFrames && !_window->shouldClose(); i++) {
+            _window->pollEvents();
+            drawFrame();
+        }
+        vkDeviceWaitIdle(_device->logical());
+
+        auto start = std::chrono::high_resolution_clock::now();
+        uint32_t frames = 0;
+        for (; frames < _appConfig->benchmarkFramesPerStep() && !_window->shouldClose(); frames++) {
+            _window->pollEvents();
+            drawFrame();
+        }
+        vkDeviceWaitIdle(_device->logical());
+        auto end = std::chrono::high_resolution_clock::now();
+        //closing the window cuts the step short, only the frames actually rendered count
+        if (frames == 0) {
+            break;
+        }
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double fps = frames / seconds;
+        std::cout<<instanceCount<<" | "
+                 <<1000.0 / fps<<" | "
+                 <<fps<<" | "
+                 <<fps * instanceCount<<std::endl;
+    }
 }
 
 void App::cleanup() {
+    _window->setSimulation(nullptr);
+    delete _simulation;
+    delete _hotReload;
+    delete _frameCapture;
+    _device->deletionQueue().flush();
+    delete _dynamicResolution;
+    delete _tonemapping;
+    delete _screenSpaceSss;
+    delete _renderGraph;
     delete _swapChain;
+    delete _renderQueue;
+    delete _cullingPass;
+    delete _gpuProfiler;
     delete _modelPipeline;
+    delete _bindlessHeap;
+    delete _shadowMap;
+    delete _clusteredLighting;
     delete _lightPipeline;
+    delete _geometryArena;
+    delete _threadPool;
+    delete _scene;
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(_device->logical(), _renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(_device->logical(), _imageAvailableSemaphores[i], nullptr);
@@ -73,19 +264,33 @@ void App::cleanup() {
 }
 
 void App::createRenderPass() {
+    //the shading is written in HDR, only the tonemapped result ends up in the scene color target
     VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = _swapChain->imageFormat();
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.format = _swapChain->hdrFormat();
+    colorAttachment.samples = _swapChain->sampleCount();
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //Clear the values to a constant at the start
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    //tonemapped by the last subpass it does not outlive the render pass
+    colorAttachment.storeOp = _appConfig->tonemapInMainPass() ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    //with screen-space scattering the composite pass adds the blurred irradiance afterwards, otherwise it is read by the tonemapping
+    colorAttachment.finalLayout = _appConfig->screenSpaceSss() ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    //written by the tonemapping subpass, with dynamic resolution the upscale samples it
+    VkAttachmentDescription sceneColorAttachment{};
+    sceneColorAttachment.format = _swapChain->sceneColorFormat();
+    sceneColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    sceneColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    sceneColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    sceneColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    sceneColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    sceneColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    sceneColorAttachment.finalLayout = _appConfig->dynamicResolution() ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = _device->findDepthFormat();
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.samples = _swapChain->sampleCount();
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -93,40 +298,224 @@ void App::createRenderPass() {
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkAttachmentDescription irradianceAttachment{};
+    irradianceAttachment.format = IRRADIANCE_FORMAT;
+    irradianceAttachment.samples = _swapChain->sampleCount();
+    irradianceAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; //zero alpha marks pixels without scattering
+    irradianceAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    irradianceAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    irradianceAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    irradianceAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    irradianceAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    //with multisampling the samples are resolved within the render pass and never written to memory
+    VkAttachmentDescription colorResolveAttachment = colorAttachment;
+    VkAttachmentDescription irradianceResolveAttachment = irradianceAttachment;
+    std::array<VkAttachmentReference, 2> resolveAttachmentRefs{};
+    if (_swapChain->multisampled()) {
+        colorResolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        irradianceResolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        irradianceResolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        irradianceAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        irradianceAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        //resolve targets follow the multisampled attachments
+        uint32_t firstResolve = _appConfig->screenSpaceSss() ? 3 : 2;
+        resolveAttachmentRefs[0].attachment = firstResolve;
+        resolveAttachmentRefs[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        //the irradiance carries the view depth in alpha, which must not be averaged, the resolve subpass writes it instead
+        resolveAttachmentRefs[1].attachment = VK_ATTACHMENT_UNUSED;
+        resolveAttachmentRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    std::array<VkAttachmentReference, 2> colorAttachmentRefs{};
+    colorAttachmentRefs[0].attachment = 0;
+    colorAttachmentRefs[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachmentRefs[1].attachment = 2;
+    colorAttachmentRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference depthAttachmentRef{};
     depthAttachmentRef.attachment = 1;
     depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     //render pass may have multiple subpasses (like postprocesses that ought to be grouped together)
+    VkSubpassDescription depthSubpass{};
+    depthSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    depthSubpass.colorAttachmentCount = 0;
+    depthSubpass.pDepthStencilAttachment = &depthAttachmentRef;
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.colorAttachmentCount = _appConfig->colorAttachmentCount();
+    subpass.pColorAttachments = colorAttachmentRefs.data();
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
+    if (_swapChain->multisampled()) {
+        subpass.pResolveAttachments = resolveAttachmentRefs.data();
+    }
+
+    //the multisampled irradiance is read sample by sample and written into its single sampled target
+    bool irradianceResolveSubpass = _appConfig->screenSpaceSss() && _swapChain->multisampled();
+    VkAttachmentReference irradianceSamplesRef{};
+    irradianceSamplesRef.attachment = 2;
+    irradianceSamplesRef.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference resolvedIrradianceRef{};
+    resolvedIrradianceRef.attachment = 4;
+    resolvedIrradianceRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription resolveSubpass{};
+    resolveSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    resolveSubpass.inputAttachmentCount = 1;
+    resolveSubpass.pInputAttachments = &irradianceSamplesRef;
+    resolveSubpass.colorAttachmentCount = 1;
+    resolveSubpass.pColorAttachments = &resolvedIrradianceRef;
+
+    //the HDR values (resolved, with multisampling) are tonemapped where they are, as an input attachment
+    VkAttachmentReference hdrInputRef{};
+    hdrInputRef.attachment = _swapChain->multisampled() ? 2 : 0;
+    hdrInputRef.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference sceneColorRef{};
+    sceneColorRef.attachment = _swapChain->multisampled() ? 3 : 2;
+    sceneColorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription tonemapSubpass{};
+    tonemapSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    tonemapSubpass.inputAttachmentCount = 1;
+    tonemapSubpass.pInputAttachments = &hdrInputRef;
+    tonemapSubpass.colorAttachmentCount = 1;
+    tonemapSubpass.pColorAttachments = &sceneColorRef;
+
+    //the HDR target is shared by all frames, the tonemapping of the previous one has to finish reading it
+    VkPipelineStageFlags previousReadStages = _appConfig->tonemapInMainPass() ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : 0;
 
     VkSubpassDependency dependency{};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL; // VK_SUBPASS_EXTERNAL refers to the implicit subpass before or after the render pass depending on whether it is specified in srcSubpass or dstSubpass
     dependency.dstSubpass = 0;
 
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | previousReadStages;
     dependency.srcAccessMask = 0;
 
     dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-    std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+    std::vector<VkSubpassDescription> subpasses;
+    std::vector<VkSubpassDependency> dependencies;
+    if (_appConfig->depthPrePass()) {
+        //depth-only subpass first, the shading subpass tests against its result
+        VkSubpassDependency depthDependency{};
+        depthDependency.srcSubpass = 0;
+        depthDependency.dstSubpass = 1;
+        depthDependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        depthDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        depthDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        depthDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        //color attachment is first used by the shading subpass, so its transition is ordered against that one
+        VkSubpassDependency colorDependency{};
+        colorDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        colorDependency.dstSubpass = 1;
+        colorDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | previousReadStages;
+        colorDependency.srcAccessMask = 0;
+        colorDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        colorDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        subpasses = {depthSubpass, subpass};
+        dependencies = {dependency, depthDependency, colorDependency};
+    } else {
+        subpasses = {subpass};
+        dependencies = {dependency};
+    }
+    if (_appConfig->tonemapInMainPass()) {
+        VkSubpassDependency tonemapDependency{};
+        tonemapDependency.srcSubpass = _appConfig->shadingSubpass();
+        tonemapDependency.dstSubpass = _appConfig->shadingSubpass() + 1;
+        tonemapDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        tonemapDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        tonemapDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        tonemapDependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        tonemapDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        //the scene color target is first written here, after the swap chain image was acquired
+        VkSubpassDependency sceneColorDependency{};
+        sceneColorDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        sceneColorDependency.dstSubpass = _appConfig->shadingSubpass() + 1;
+        sceneColorDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        sceneColorDependency.srcAccessMask = 0;
+        sceneColorDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        sceneColorDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        subpasses.push_back(tonemapSubpass);
+        dependencies.push_back(tonemapDependency);
+        dependencies.push_back(sceneColorDependency);
+    }
+    if (irradianceResolveSubpass) {
+        VkSubpassDependency samplesDependency{};
+        samplesDependency.srcSubpass = _appConfig->shadingSubpass();
+        samplesDependency.dstSubpass = _appConfig->shadingSubpass() + 1;
+        samplesDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        samplesDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        samplesDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        samplesDependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        samplesDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        //the irradiance target is first written here
+        VkSubpassDependency resolvedDependency{};
+        resolvedDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        resolvedDependency.dstSubpass = _appConfig->shadingSubpass() + 1;
+        resolvedDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        resolvedDependency.srcAccessMask = 0;
+        resolvedDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        resolvedDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        subpasses.push_back(resolveSubpass);
+        dependencies.push_back(samplesDependency);
+        dependencies.push_back(resolvedDependency);
+    }
+    if (_appConfig->screenSpaceSss() || _appConfig->dynamicResolution() || !_appConfig->tonemapSubpass()) {
+        //the irradiance is read by the scattering compute passes, the HDR target by the composite or the tonemap pass,
+        //the scene color target by the upscale pass
+        VkSubpassDependency outputDependency{};
+        outputDependency.srcSubpass = static_cast<uint32_t>(subpasses.size()) - 1;
+        outputDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        outputDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        outputDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        outputDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        outputDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies.push_back(outputDependency);
+        //the HDR target is still resolved by the shading subpass
+        if (irradianceResolveSubpass) {
+            outputDependency.srcSubpass = _appConfig->shadingSubpass();
+            dependencies.push_back(outputDependency);
+        }
+    }
+
+    std::vector<VkAttachmentDescription> attachments = {colorAttachment, depthAttachment};
+    if (_appConfig->screenSpaceSss()) {
+        attachments.push_back(irradianceAttachment);
+    }
+    if (_swapChain->multisampled()) {
+        attachments.push_back(colorResolveAttachment);
+        if (_appConfig->screenSpaceSss()) {
+            attachments.push_back(irradianceResolveAttachment);
+        }
+    }
+    if (_appConfig->tonemapInMainPass()) {
+        attachments.push_back(sceneColorAttachment);
+    }
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
     renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
 
     if (vkCreateRenderPass(_device->logical(), &renderPassInfo, nullptr, &_swapChain->renderPass()) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
@@ -160,6 +549,12 @@ void App::createCommandBuffers() {
     if (vkAllocateCommandBuffers(_device->logical(), &allocInfo, _commandBuffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate command buffers!");
     }
+    if (_screenSpaceSss && _screenSpaceSss->asyncCompute()) {
+        _compositeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateCommandBuffers(_device->logical(), &allocInfo, _compositeCommandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+    }
 }
 
 void App::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
@@ -171,40 +566,236 @@ void App::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
+    //reloaded resources are swapped in before anything of this frame binds them
+    if (_hotReload) {
+        _hotReload->update(commandBuffer);
+    }
+    _bindlessHeap->update(commandBuffer, _currentFrame);
+    //every draw of the frame reads the arena's buffers, bound once after this frame's compaction moved ranges
+    _geometryArena->defragment(commandBuffer);
+    _geometryArena->bind(commandBuffer);
+    _gpuProfiler->beginFrame(commandBuffer, _currentFrame);
+    _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "frame");
+    //on the async path the scattering and everything after it are recorded into their own command buffers
+    if (_screenSpaceSss && _screenSpaceSss->asyncCompute()) {
+        _renderGraph->execute(commandBuffer, imageIndex, 0, _renderGraph->passIndex("sss downsample"));
+    } else {
+        _renderGraph->execute(commandBuffer, imageIndex);
+        recordFrameEnd(commandBuffer, imageIndex);
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+}
+
+void App::createRenderGraph() {
+    _renderGraph = new RenderGraph(_device);
+    //the passes are declared before the culling pass and the scattering exist, so their state is derived from the config
+    bool gpuCulling = _appConfig->cullingEnabled() && _appConfig->gpuCulling() && _device->drawIndirectCountSupported();
+    bool sss = _appConfig->screenSpaceSss();
+    bool asyncScattering = sss && _appConfig->sssAsyncCompute() && _device->asyncComputeSupported();
+    PassQueue scatteringQueue = asyncScattering ? PassQueue::AsyncCompute : PassQueue::Graphics;
+
+    uint32_t drawCommands = _renderGraph->importBuffer("draw commands");
+    uint32_t lightClusters = _renderGraph->importBuffer("light clusters");
+    uint32_t shadowAtlas = _renderGraph->importImage("shadow atlas", [this](uint32_t) { return _shadowMap->image(); },
+                                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
+    uint32_t hdr = _renderGraph->importImage("hdr", [this](uint32_t imageIndex) { return _swapChain->hdrImage(imageIndex); },
+                                             VK_IMAGE_LAYOUT_UNDEFINED);
+    uint32_t swapChainImage = _renderGraph->importImage("swap chain image", [this](uint32_t imageIndex) { return _swapChain->image(imageIndex); },
+                                                        VK_IMAGE_LAYOUT_UNDEFINED);
+    _renderGraph->markOutput(swapChainImage);
+    //an EXR capture reads the HDR target once the frame is done
+    if (_appConfig->captureEnabled() && _appConfig->captureFormat() == "exr") {
+        _renderGraph->markOutput(hdr);
+    }
+    if (sss) {
+        _irradianceTarget = _renderGraph->createImage("irradiance", {IRRADIANCE_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                                     1, asyncScattering});
+        //half resolution targets the blur ping-pongs between
+        _sssFirstTarget = _renderGraph->createImage("sss first", {IRRADIANCE_FORMAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 2, asyncScattering});
+        _sssSecondTarget = _renderGraph->createImage("sss second", {IRRADIANCE_FORMAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 2, asyncScattering});
+    }
+    //without dynamic resolution the scene is rendered straight into the swap chain image
+    _sceneColorTarget = swapChainImage;
+    if (_appConfig->dynamicResolution()) {
+        _sceneColorTarget = _renderGraph->createImage("scene color", {_swapChain->sceneColorFormat(),
+                                                                      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT});
+    }
+    VkImageLayout sceneColorLayout = _appConfig->dynamicResolution() ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    //CPU culling and the render queue only write instance data from the host, before the shadow pass draws with it
+    std::vector<ResourceUse> cullingUses;
+    if (gpuCulling) {
+        cullingUses.push_back({drawCommands, GraphAccess::ComputeWrite});
+    }
+    _renderGraph->addPass("culling", PassQueue::Graphics, cullingUses, [this](VkCommandBuffer commandBuffer, uint32_t) {
+        if (_cullingPass) {
+            _cullingPass->record(commandBuffer, _currentFrame);
+        }
+        if (_renderQueue) {
+            buildRenderQueue();
+        }
+    }, !gpuCulling);
+    _renderGraph->addPass("light clustering", PassQueue::Graphics, {{lightClusters, GraphAccess::ComputeWrite}},
+                          [this](VkCommandBuffer commandBuffer, uint32_t) {
+        _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "light clustering");
+        _clusteredLighting->record(commandBuffer, _currentFrame, _modelPipeline->view(), _modelPipeline->projection(),
+                                   CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+        _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "light clustering");
+    });
+    _renderGraph->addPass("shadow map", PassQueue::Graphics, {{shadowAtlas, GraphAccess::DepthAttachment, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}},
+                          [this](VkCommandBuffer commandBuffer, uint32_t) {
+        //the atlas is reused until the light or the scene moves
+        if (_shadowMap->needsRender()) {
+            recordShadowMap(commandBuffer);
+        }
+    });
+
+    std::vector<ResourceUse> mainUses = {{lightClusters, GraphAccess::FragmentRead}, {shadowAtlas, GraphAccess::FragmentSampled},
+                                         {hdr, GraphAccess::ColorAttachment, sss ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}};
+    if (gpuCulling) {
+        mainUses.push_back({drawCommands, GraphAccess::IndirectRead});
+    }
+    if (sss) {
+        mainUses.push_back({_irradianceTarget, GraphAccess::ColorAttachment, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+    }
+    if (_appConfig->tonemapInMainPass()) {
+        mainUses.push_back({_sceneColorTarget, GraphAccess::ColorAttachment, sceneColorLayout});
+    }
+    _renderGraph->addPass("main", PassQueue::Graphics, mainUses, [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        recordMainPass(commandBuffer, imageIndex);
+    });
+
+    if (sss) {
+        //timestamps written on a compute family without valid timestamp bits are undefined, those passes stay untimed
+        bool timedScattering = scatteringQueue == PassQueue::Graphics || _device->capabilities().computeTimestamps;
+        _renderGraph->addPass("sss downsample", scatteringQueue, {{_irradianceTarget, GraphAccess::ComputeSampled},
+                                                                  {_sssFirstTarget, GraphAccess::ComputeStorageWrite}},
+                              [this, timedScattering](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            if (timedScattering) {
+                _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "sss downsample");
+            }
+            _screenSpaceSss->recordDownsample(commandBuffer, imageIndex);
+            if (timedScattering) {
+                _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "sss downsample");
+            }
+        });
+        _renderGraph->addPass("sss blur", scatteringQueue, {{_sssFirstTarget, GraphAccess::ComputeStorageReadWrite},
+                                                            {_sssSecondTarget, GraphAccess::ComputeStorageWrite}},
+                              [this, timedScattering](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            if (timedScattering) {
+                _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "sss blur");
+            }
+            _screenSpaceSss->recordBlur(commandBuffer, imageIndex, _modelPipeline->projection());
+            if (timedScattering) {
+                _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "sss blur");
+            }
+        });
+        //the blurred target stays in the general layout it is written in
+        std::vector<ResourceUse> compositeUses = {{_sssFirstTarget, GraphAccess::FragmentSampled, VK_IMAGE_LAYOUT_GENERAL},
+                                                  {_irradianceTarget, GraphAccess::FragmentSampled},
+                                                  {hdr, GraphAccess::ColorAttachment, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}};
+        if (_appConfig->tonemapSubpass()) {
+            compositeUses.push_back({_sceneColorTarget, GraphAccess::ColorAttachment, sceneColorLayout});
+        }
+        _renderGraph->addPass("sss composite", PassQueue::Graphics, compositeUses, [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "sss composite");
+            _screenSpaceSss->recordComposite(commandBuffer, imageIndex, _tonemapping);
+            _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "sss composite");
+        });
+    }
+    if (!_appConfig->tonemapSubpass()) {
+        _renderGraph->addPass("tonemap", PassQueue::Graphics, {{hdr, GraphAccess::FragmentSampled},
+                                                               {_sceneColorTarget, GraphAccess::ColorAttachment, sceneColorLayout}},
+                              [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "tonemap");
+            _tonemapping->recordPass(commandBuffer, imageIndex);
+            _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "tonemap");
+        });
+    }
+    if (_appConfig->dynamicResolution()) {
+        _renderGraph->addPass("upscale", PassQueue::Graphics, {{_sceneColorTarget, GraphAccess::FragmentSampled},
+                                                               {swapChainImage, GraphAccess::ColorAttachment, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR}},
+                              [this](VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "upscale");
+            _dynamicResolution->recordUpscale(commandBuffer, imageIndex);
+            _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "upscale");
+        });
+    }
+}
+
+void App::compileRenderGraph() {
+    _renderGraph->compile(_swapChain->extent(), static_cast<uint32_t>(_swapChain->imageViews().size()));
+    std::vector<VkImageView> irradianceImageViews;
+    std::vector<VkImageView> sceneColorImageViews;
+    if (_irradianceTarget != UINT32_MAX) {
+        irradianceImageViews = _renderGraph->imageViews(_irradianceTarget);
+    }
+    if (_appConfig->dynamicResolution()) {
+        sceneColorImageViews = _renderGraph->imageViews(_sceneColorTarget);
+    }
+    _swapChain->setTransientTargets(irradianceImageViews, sceneColorImageViews);
+}
+
+void App::recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = _swapChain->renderPass();
     renderPassInfo.framebuffer = _swapChain->framebuffers()[imageIndex];
     renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = _swapChain->extent();
+    //with dynamic resolution only the scaled top-left part of the targets is rendered
+    renderPassInfo.renderArea.extent = _swapChain->renderExtent();
 
     //color of pixels within render are with undefined values
-    std::array<VkClearValue, 2> clearValues{};
+    std::array<VkClearValue, 3> clearValues{};
     clearValues[0].color = {{0.2f, 0.2f, 0.2f, 1.0f}};
     clearValues[1].depthStencil = {1.0f, 0};
+    clearValues[2].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
 
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.clearValueCount = _appConfig->screenSpaceSss() ? 3 : 2;
     renderPassInfo.pClearValues = clearValues.data();
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _modelPipeline->pipeline());
-
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = static_cast<float>(_swapChain->extent().width);
-    viewport.height = static_cast<float>(_swapChain->extent().height);
+    viewport.width = static_cast<float>(_swapChain->renderExtent().width);
+    viewport.height = static_cast<float>(_swapChain->renderExtent().height);
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     VkRect2D scissor{};
     scissor.offset = {0, 0};
-    scissor.extent = _swapChain->extent();
+    scissor.extent = _swapChain->renderExtent();
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    _modelPipeline->bind(commandBuffer, _currentFrame);
+    if (_appConfig->depthPrePass()) {
+        _modelPipeline->bindDepthResources(commandBuffer, _currentFrame);
+        drawModel(commandBuffer, true);
+        vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+        //the pre-pass bound the positions of the model's range in place of the whole vertices
+        _geometryArena->bind(commandBuffer);
+    }
+
+    //frames drawn with the fallback are not attributed to any variant
+    _inFlightVariants[_currentFrame] = _modelPipeline->isVariantReady(_appConfig->shaderVariant()) ? _appConfig->shaderVariant().name() : "";
+
+    _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "model shading");
+    _gpuProfiler->beginStatistics(commandBuffer, _currentFrame);
+    //the render queue binds the pipeline and resources of every batch itself
+    if (!_renderQueue) {
+        //falls back to the startup variant until the requested one finishes compiling in the background
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _modelPipeline->requestVariant(_appConfig->shaderVariant()));
+        _modelPipeline->bindResources(commandBuffer, _currentFrame);
+        _modelPipeline->bindMaterials(commandBuffer, _currentFrame);
+    }
+    drawModel(commandBuffer, false);
+    _gpuProfiler->endStatistics(commandBuffer, _currentFrame);
+    _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "model shading");
 
     //-----light-------
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _lightPipeline->pipeline());
@@ -212,29 +803,211 @@ void App::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-    
+
     _lightPipeline->bind(commandBuffer, _currentFrame);
-  
+
+    if (_appConfig->tonemapInMainPass()) {
+        vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+        _tonemapping->recordSubpass(commandBuffer, imageIndex);
+    }
+    if (_screenSpaceSss && _swapChain->multisampled()) {
+        vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+        _screenSpaceSss->recordResolve(commandBuffer);
+    }
+
     vkCmdEndRenderPass(commandBuffer);
+}
 
-    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+void App::buildRenderQueue() {
+    //every instance gets an item so the instance data stays complete for the shadow pass, culled ones are never drawn
+    const auto& instances = _scene->instances();
+    const auto& materials = _scene->instanceMaterials();
+    std::vector<bool> visible(instances.size(), _cullingPass == nullptr);
+    if (_cullingPass) {
+        for (uint32_t i = 0; i < _cullingPass->visibleCount(); i++) {
+            visible[_cullingPass->visibleInstances()[i]] = true;
+        }
+    }
+    glm::vec3 cameraPos = _appConfig->observerPosition();
+    glm::vec3 cameraFront = glm::normalize(_appConfig->cameraFront());
+    _renderQueue->clear();
+    for (uint32_t i = 0; i < instances.size(); i++) {
+        uint32_t pipeline = visible[i] ? _modelPipeline->materialPipeline(materials[i]) : HIDDEN_PIPELINE;
+        float depth = glm::dot(glm::vec3(instances[i].model[3]) - cameraPos, cameraFront);
+        _renderQueue->add(RenderQueue::sortKey(pipeline, materials[i], 0, depth), i);
+    }
+    _renderQueue->finish();
+    _modelPipeline->writeInstances(_currentFrame, _renderQueue->order());
+}
+
+void App::drawModel(VkCommandBuffer commandBuffer, bool depthOnly) {
+    //the pre-pass and the shading pass issue identical draws, so the depth values match exactly
+    if (_renderQueue) {
+        StateChanges changes{};
+        uint64_t skippedBinds = _modelPipeline->drawBatches(commandBuffer, _currentFrame, *_renderQueue, depthOnly, changes);
+        if (!depthOnly) {
+            _renderQueue->addFrameChanges(changes, skippedBinds);
+        }
+    } else if (_cullingPass) {
+        _cullingPass->draw(commandBuffer, _currentFrame);
+    } else {
+        vkCmdDrawIndexed(commandBuffer, _modelPipeline->indexCount(), _scene->instanceCount(), _modelPipeline->firstIndex(), _modelPipeline->vertexOffset(), 0);
+    }
+}
+
+void App::recordShadowMap(VkCommandBuffer commandBuffer) {
+    _gpuProfiler->beginTimestamp(commandBuffer, _currentFrame, "shadow map");
+    _shadowMap->beginRenderPass(commandBuffer);
+    if (_shadowMap->enabled()) {
+        //casters outside of the camera frustum still shadow visible ones, so every instance is drawn into every face
+        _modelPipeline->bindShadowResources(commandBuffer, _currentFrame);
+        for (uint32_t face = 0; face < SHADOW_MAP_FACES; face++) {
+            _shadowMap->setFace(commandBuffer, face);
+            _modelPipeline->pushShadowFace(commandBuffer, _shadowMap->faceViewProjection(face));
+            vkCmdDrawIndexed(commandBuffer, _modelPipeline->indexCount(), _scene->instanceCount(), _modelPipeline->firstIndex(), _modelPipeline->vertexOffset(), 0);
+        }
+    }
+    _shadowMap->endRenderPass(commandBuffer);
+    _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "shadow map");
+}
+
+void App::recordFrameEnd(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    _gpuProfiler->endTimestamp(commandBuffer, _currentFrame, "frame");
+    //after the frame timestamp, the readback copy does not count against the dynamic resolution budget
+    if (_frameCapture) {
+        _frameCapture->record(commandBuffer, imageIndex, _currentFrame);
+    }
+}
+
+void App::submitAsyncScattering(uint32_t imageIndex) {
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    VkCommandBuffer computeCommandBuffer = _screenSpaceSss->computeCommandBuffer(_currentFrame);
+    vkResetCommandBuffer(computeCommandBuffer, 0);
+    if (vkBeginCommandBuffer(computeCommandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    uint32_t composite = _renderGraph->passIndex("sss composite");
+    _renderGraph->execute(computeCommandBuffer, imageIndex, _renderGraph->passIndex("sss downsample"), composite);
+    if (vkEndCommandBuffer(computeCommandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
+
+    VkCommandBuffer compositeCommandBuffer = _compositeCommandBuffers[_currentFrame];
+    vkResetCommandBuffer(compositeCommandBuffer, 0);
+    if (vkBeginCommandBuffer(compositeCommandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    _renderGraph->execute(compositeCommandBuffer, imageIndex, composite);
+    recordFrameEnd(compositeCommandBuffer, imageIndex);
+    if (vkEndCommandBuffer(compositeCommandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+
+    //the blur waits for the shading pass on the compute queue, meanwhile the graphics queue can move on
+    VkSemaphore irradianceReady = _screenSpaceSss->irradianceReadySemaphore(_currentFrame);
+    VkSemaphore scatteringDone = _screenSpaceSss->scatteringDoneSemaphore(_currentFrame);
+    VkPipelineStageFlags computeWaitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubmitInfo computeSubmitInfo{};
+    computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    computeSubmitInfo.waitSemaphoreCount = 1;
+    computeSubmitInfo.pWaitSemaphores = &irradianceReady;
+    computeSubmitInfo.pWaitDstStageMask = &computeWaitStage;
+    computeSubmitInfo.commandBufferCount = 1;
+    computeSubmitInfo.pCommandBuffers = &computeCommandBuffer;
+    computeSubmitInfo.signalSemaphoreCount = 1;
+    computeSubmitInfo.pSignalSemaphores = &scatteringDone;
+
+    if (vkQueueSubmit(_device->computeQueue(), 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit compute command buffer!");
+    }
+
+    //the composite finishes the frame, so it signals presentation and the frame fence
+    VkPipelineStageFlags compositeWaitStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    VkSubmitInfo compositeSubmitInfo{};
+    compositeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    compositeSubmitInfo.waitSemaphoreCount = 1;
+    compositeSubmitInfo.pWaitSemaphores = &scatteringDone;
+    compositeSubmitInfo.pWaitDstStageMask = &compositeWaitStage;
+    compositeSubmitInfo.commandBufferCount = 1;
+    compositeSubmitInfo.pCommandBuffers = &compositeCommandBuffer;
+    compositeSubmitInfo.signalSemaphoreCount = 1;
+    compositeSubmitInfo.pSignalSemaphores = &_renderFinishedSemaphores[_currentFrame];
+
+    if (vkQueueSubmit(_device->graphicsQueue(), 1, &compositeSubmitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+}
+
+void App::recreateSwapChain() {
+    _swapChain->recreateSwapChain();
+    compileRenderGraph();
+    _swapChain->createFramebuffers();
+    if (_screenSpaceSss) {
+        _screenSpaceSss->recreate();
+    }
+    _tonemapping->recreate();
+    if (_dynamicResolution) {
+        _dynamicResolution->recreate();
+    }
 }
 
 void App::drawFrame() {
     vkWaitForFences(_device->logical(), 1, &_inFlightFences[_currentFrame], VK_TRUE, UINT64_MAX);
+    //frames retire in submission order, so everything up to the one that used this fence has completed
+    _device->deletionQueue().collect(_inFlightFrameNumbers[_currentFrame]);
+    //the frame that first showed an input has finished on the GPU, an upper bound as the fence is only checked now
+    if (_inFlightInputs[_currentFrame] != std::chrono::high_resolution_clock::time_point{}) {
+        double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _inFlightInputs[_currentFrame]).count();
+        _inputLatencyCount++;
+        _inputLatencyTotalMs += latencyMs;
+        _inputLatencyMaxMs = std::max(_inputLatencyMaxMs, latencyMs);
+        _inFlightInputs[_currentFrame] = {};
+    }
+    if (_cullingPass) {
+        _cullingPass->collectStats(_currentFrame);
+    }
+    _clusteredLighting->collectStats(_currentFrame);
+    if (_frameCapture) {
+        _frameCapture->collect(_currentFrame);
+    }
+    bool collected = _gpuProfiler->collect(_currentFrame);
+    if (collected && !_inFlightVariants[_currentFrame].empty()) {
+        VariantCost& cost = _variantCosts[_inFlightVariants[_currentFrame]];
+        cost.frames++;
+        cost.shadingMs += _gpuProfiler->timestampMs("model shading");
+        cost.fragmentInvocations += _gpuProfiler->fragmentInvocations();
+    }
+    //the scale of the frame about to be recorded follows the GPU time of the last completed one
+    if (collected && _dynamicResolution && _gpuProfiler->timestampsSupported()) {
+        _dynamicResolution->update(_gpuProfiler->timestampMs("frame"));
+    }
 
     uint32_t imageIndex;
     VkResult result = vkAcquireNextImageKHR(_device->logical(), _swapChain->swapChain(), UINT64_MAX, _imageAvailableSemaphores[_currentFrame], VK_NULL_HANDLE, &imageIndex);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        _swapChain->recreateSwapChain();
+        recreateSwapChain();
         return;
     } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         throw std::runtime_error("failed to acquire swap chain image!");
     }
+    _swapChain->imageAcquired(imageIndex);
 
+    //the newest simulation tick, taken as late as possible before the frame is recorded
+    const SimulationState& state = _simulation->latest();
+    _appConfig->observerPosition() = state.observerPosition;
+    _appConfig->cameraFront() = state.cameraFront;
+    _appConfig->lightPosition() = state.lightPosition;
+    _appConfig->movementMode(state.movementMode);
+    _appConfig->shaderVariant() = state.shaderVariant;
+    if (state.lastInput != _lastShownInput) {
+        _inFlightInputs[_currentFrame] = state.lastInput;
+        _lastShownInput = state.lastInput;
+    }
+
+    _shadowMap->update(_appConfig->lightPosition());
     _modelPipeline->updateUniformBuffer(_currentFrame);
     _lightPipeline->updateUniformBuffer(_currentFrame);
 
@@ -258,11 +1031,22 @@ void App::drawFrame() {
 
     VkSemaphore signalSemaphores[] = {_renderFinishedSemaphores[_currentFrame]};
     submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(_device->graphicsQueue(), 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+    if (_screenSpaceSss && _screenSpaceSss->asyncCompute()) {
+        //the shading pass hands the irradiance to the compute queue, the composite submission ends the frame
+        VkSemaphore irradianceReady = _screenSpaceSss->irradianceReadySemaphore(_currentFrame);
+        submitInfo.pSignalSemaphores = &irradianceReady;
+        if (vkQueueSubmit(_device->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+        submitAsyncScattering(imageIndex);
+    } else {
+        submitInfo.pSignalSemaphores = signalSemaphores;
+        if (vkQueueSubmit(_device->graphicsQueue(), 1, &submitInfo, _inFlightFences[_currentFrame]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
     }
+    _inFlightFrameNumbers[_currentFrame] = ++_frameNumber;
+    _device->deletionQueue().frameSubmitted(_frameNumber);
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -278,15 +1062,21 @@ void App::drawFrame() {
     presentInfo.pResults = nullptr; // Optional
 
     result = vkQueuePresentKHR(_device->presentQueue(), &presentInfo);
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+        _swapChain->imagePresented(imageIndex);
+    }
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || _window->framebufferResized()) {
         _window->framebufferResized() = false;
-        _swapChain->recreateSwapChain();
+        recreateSwapChain();
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to present swap chain image!");
     }
 
     _currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    if (_appConfig->benchmarkEnabled()) {
+        return;
+    }
     std::cout<<"\rCurrent mode: "
                 <<(_appConfig->movementMode() == MOVEMENT_CAMERA ? "Camera" : "Light source")<<" | "
                 <<"Camera location: ("<<_appConfig->observerPosition().x<<";"
@@ -294,13 +1084,68 @@ void App::drawFrame() {
                 <<_appConfig->observerPosition().z<<") "
                 <<"Light source location: ("<<_appConfig->lightPosition().x<<";"
                 <<_appConfig->lightPosition().y<<";"
-                <<_appConfig->lightPosition().z<<")       ";
+                <<_appConfig->lightPosition().z<<") "
+                <<"Shader variant: "<<_appConfig->shaderVariant().name()
+                <<(_modelPipeline->isVariantReady(_appConfig->shaderVariant()) ? "" : " (compiling)");
+    if (_cullingPass && _cullingPass->meshletFrame()) {
+        std::cout<<" | Visible meshlets: "<<_cullingPass->visibleCount()<<", culled: "<<_cullingPass->frustumCulledCount()
+                 <<" (frustum) "<<_cullingPass->backfaceCulledCount()<<" (backface)";
+    } else if (_cullingPass) {
+        std::cout<<" | Visible: "<<_cullingPass->visibleCount()<<", culled: "<<_cullingPass->culledCount()
+                 <<(_cullingPass->gpuCulling() ? " (GPU)" : " (CPU)");
+    }
+    if (_renderQueue) {
+        const StateChanges& changes = _renderQueue->frameChanges();
+        std::cout<<" | Draws: "<<changes.draws<<", state changes: "<<changes.pipelineBinds<<" pipeline, "
+                 <<changes.descriptorSetBinds<<" descriptor set, "
+                 <<changes.materialPushes<<" material";
+    }
+    std::cout<<" | Lights per cluster: avg "<<_clusteredLighting->averageLightsPerCluster()<<", max "<<_clusteredLighting->maxLightsPerCluster();
+    std::cout<<" | Shadow map renders: "<<_shadowMap->renderCount()<<", reuses: "<<_shadowMap->reuseCount();
+    if (_gpuProfiler->statisticsSupported()) {
+        std::cout<<" | Fragments shaded: "<<_gpuProfiler->fragmentInvocations();
+    }
+    if (_gpuProfiler->timestampsSupported()) {
+        std::cout<<" | Model shading: "<<_gpuProfiler->timestampMs("model shading")<<" ms"
+                 <<" | Light clustering: "<<_gpuProfiler->timestampMs("light clustering")<<" ms"
+                 <<" | Shadow map: "<<_gpuProfiler->timestampMs("shadow map")<<" ms";
+        if (_dynamicResolution) {
+            std::cout<<" | Frame: "<<_gpuProfiler->timestampMs("frame")<<" ms at scale "<<_dynamicResolution->scale()
+                     <<" ("<<_swapChain->renderExtent().width<<"x"<<_swapChain->renderExtent().height<<")";
+        }
+        if (_screenSpaceSss) {
+            std::cout<<" | SSS: "<<_gpuProfiler->timestampMs("sss downsample")<<" + "
+                     <<_gpuProfiler->timestampMs("sss blur")<<" + "
+                     <<_gpuProfiler->timestampMs("sss composite")<<" ms";
+        }
+    }
+    std::cout<<"       ";
+}
+
+void App::printVariantCosts() {
+    if (_variantCosts.empty() || (!_gpuProfiler->timestampsSupported() && !_gpuProfiler->statisticsSupported())) {
+        return;
+    }
+    std::cout<<"Model shading cost per shader variant:\n";
+    for (const auto& [name, cost] : _variantCosts) {
+        std::cout<<"  "<<name<<": "<<cost.frames<<" frame(s)";
+        if (_gpuProfiler->timestampsSupported()) {
+            std::cout<<", avg "<<cost.shadingMs / cost.frames<<" ms";
+        }
+        if (_gpuProfiler->statisticsSupported()) {
+            std::cout<<", avg "<<cost.fragmentInvocations / cost.frames<<" fragment invocations";
+        }
+        std::cout<<"\n";
+    }
 }
 
 void App::createSyncObjects() {
     _imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     _renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     _inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    _inFlightFrameNumbers.resize(MAX_FRAMES_IN_FLIGHT, 0);
+    _inFlightVariants.resize(MAX_FRAMES_IN_FLIGHT);
+    _inFlightInputs.resize(MAX_FRAMES_IN_FLIGHT);
 
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
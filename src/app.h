@@ -10,37 +10,107 @@
 #include <cstdint>
 #include <fstream>
 #include <limits>
+#include <map>
 
 #include "device.h"
 #include "swap_chain.h"
+#include "bindless_heap.h"
+#include "geometry_arena.h"
 #include "model_pipeline.h"
 #include "light_pipeline.h"
 #include "window.h"
+#include "thread_pool.h"
+#include "scene.h"
+#include "culling_pass.h"
+#include "render_queue.h"
+#include "render_graph.h"
+#include "clustered_lighting.h"
+#include "shadow_map.h"
+#include "screen_space_sss.h"
+#include "dynamic_resolution.h"
+#include "tonemapping.h"
+#include "hot_reload.h"
+#include "simulation.h"
+#include "frame_capture.h"
+#include "gpu_profiler.h"
 
 
 namespace vmr {
 class App{
 private:
+    struct VariantCost {
+        uint64_t frames = 0;
+        double shadingMs = 0.0;
+        double fragmentInvocations = 0.0;
+    };
+
+
     AppConfig* _appConfig;
     Window* _window;
+    Simulation* _simulation;
     Device* _device;
+    ThreadPool* _threadPool;
+    Scene* _scene;
     SwapChain* _swapChain;
+    BindlessHeap* _bindlessHeap;
+    GeometryArena* _geometryArena;
     ModelPipeline* _modelPipeline;
     LightPipeline* _lightPipeline;
+    CullingPass* _cullingPass = nullptr;
+    RenderQueue* _renderQueue = nullptr;          // orders model draws unless the GPU culling pass emits them
+    ClusteredLighting* _clusteredLighting;
+    ShadowMap* _shadowMap;
+    ScreenSpaceSss* _screenSpaceSss = nullptr;
+    DynamicResolution* _dynamicResolution = nullptr;
+    Tonemapping* _tonemapping;
+    HotReload* _hotReload = nullptr;
+    FrameCapture* _frameCapture = nullptr;
+    GpuProfiler* _gpuProfiler;
+    RenderGraph* _renderGraph;
+    uint32_t _irradianceTarget = UINT32_MAX;    // render graph resources
+    uint32_t _sssFirstTarget = UINT32_MAX;
+    uint32_t _sssSecondTarget = UINT32_MAX;
+    uint32_t _sceneColorTarget;                 // the swap chain image without dynamic resolution
     std::vector<VkCommandBuffer> _commandBuffers;
+    std::vector<VkCommandBuffer> _compositeCommandBuffers;   // second graphics submission of a frame when the scattering runs on async compute
     std::vector<VkSemaphore> _imageAvailableSemaphores;
     std::vector<VkSemaphore> _renderFinishedSemaphores;
     std::vector<VkFence> _inFlightFences;
     uint32_t _currentFrame = 0;
+    uint64_t _frameNumber = 0;
+    std::vector<uint64_t> _inFlightFrameNumbers;
+    std::vector<std::string> _inFlightVariants;        // shader variant each frame slot was last recorded with
+    std::map<std::string, VariantCost> _variantCosts;
+    std::vector<std::chrono::high_resolution_clock::time_point> _inFlightInputs;   // input first shown by each frame slot, epoch if none
+    std::chrono::high_resolution_clock::time_point _lastShownInput{};
+    uint64_t _inputLatencyCount = 0;
+    double _inputLatencyTotalMs = 0.0;
+    double _inputLatencyMaxMs = 0.0;
+    std::chrono::high_resolution_clock::time_point _runStart;
+    double _startupMs = 0.0;                   // from the start of run() until the first frame is submitted
+    std::vector<double> _frameTimesMs;         // of every frame after the first, only kept when metrics are written
 
     void initVulkan();
     void mainLoop();
+    void benchmarkLoop();
     void cleanup();
     void createRenderPass();
     void createCommandPool();
     void createCommandBuffers();
+    void createRenderGraph();
+    // (re)creates the transient images for the current swap chain, before its framebuffers
+    void compileRenderGraph();
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void buildRenderQueue();
+    void drawModel(VkCommandBuffer commandBuffer, bool depthOnly);
+    void recordShadowMap(VkCommandBuffer commandBuffer);
+    void recordFrameEnd(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void submitAsyncScattering(uint32_t imageIndex);
+    void recreateSwapChain();
     void drawFrame();
+    void printVariantCosts();
+    void writeMetrics();
     void createSyncObjects();
     
 public:
@@ -1,9 +1,72 @@
+#include <algorithm>
+
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "app_config.h"
 
 namespace vmr {
 
-AppConfig::AppConfig(std::string configPath) {
+glm::mat4 InstanceTransform::matrix() const {
+    auto transform = glm::translate(glm::mat4(1.0f), position);
+    transform = glm::rotate(transform, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::scale(transform, glm::vec3(scale, scale, scale));
+}
+
+static InstanceTransform parseInstanceTransform(const nlohmann::json& jsonInstance, const std::vector<MaterialDefinition>& materials) {
+    InstanceTransform transform{};
+    transform.position = glm::vec3(
+        jsonInstance["position"]["x"],
+        jsonInstance["position"]["y"],
+        jsonInstance["position"]["z"]
+    );
+    transform.rotation = glm::vec3(
+        jsonInstance["rotation"]["x"],
+        jsonInstance["rotation"]["y"],
+        jsonInstance["rotation"]["z"]
+    );
+    transform.scale = jsonInstance["scale"];
+    if (jsonInstance.contains("material")) {
+        std::string name = jsonInstance["material"];
+        auto found = std::find_if(materials.begin(), materials.end(), [&name](const MaterialDefinition& material) { return material.name == name; });
+        if (found == materials.end()) {
+            throw std::runtime_error("unknown material " + name + "!");
+        }
+        transform.material = static_cast<uint32_t>(found - materials.begin());
+    }
+    return transform;
+}
+
+static MaterialDefinition parseMaterial(const nlohmann::json& jsonMaterial) {
+    MaterialDefinition material{};
+    material.name = jsonMaterial.value("name", material.name);
+    if (jsonMaterial.contains("tint")) {
+        material.tint = glm::vec3(
+            jsonMaterial["tint"]["r"],
+            jsonMaterial["tint"]["g"],
+            jsonMaterial["tint"]["b"]
+        );
+    }
+    material.roughness = jsonMaterial.value("roughness", material.roughness);
+    material.ior = jsonMaterial.value("IOR", material.ior);
+    material.ambient = jsonMaterial.value("ambient", material.ambient);
+    material.shaderVariant = jsonMaterial.value("shaderVariant", material.shaderVariant);
+    return material;
+}
+
+static ShaderVariant parseShaderVariant(const nlohmann::json& jsonVariant) {
+    ShaderVariant variant{};
+    variant.sss = jsonVariant.value("sss", variant.sss);
+    variant.normalMapping = jsonVariant.value("normalMapping", variant.normalMapping);
+    variant.bakedThickness = jsonVariant.value("bakedThickness", variant.bakedThickness);
+    variant.preintegratedSkin = jsonVariant.value("preintegratedSkin", variant.preintegratedSkin);
+    variant.ibl = jsonVariant.value("ibl", variant.ibl);
+    variant.thicknessSamples = jsonVariant.value("thicknessSamples", variant.thicknessSamples);
+    return variant;
+}
+
+AppConfig::AppConfig(std::string configPath) : _configPath(configPath) {
     std::ifstream i(configPath);
     if (i.fail()){
         throw std::runtime_error("Could not open file: " + configPath);
@@ -14,12 +77,35 @@ AppConfig::AppConfig(std::string configPath) {
     _displayModelPath = jsonConfig["path"]["displayModel"];
     _modelTexturePath = jsonConfig["path"]["modelTexture"];
     _modelNormalMapPath = jsonConfig["path"]["modelNormalMap"];
+    _thicknessMapPath = jsonConfig["path"]["thicknessMap"];
     _modelVertexShaderPath = jsonConfig["path"]["modelVertexShader"];
     _modelFragmentShaderPath = jsonConfig["path"]["modelFragmentShader"];
     _lightVertexShaderPath = jsonConfig["path"]["lightVertexShader"];
     _lightFragmentShaderPath = jsonConfig["path"]["lightFragmentShader"];
+    _cullingComputeShaderPath = jsonConfig["path"]["cullingComputeShader"];
+    _meshletCullingComputeShaderPath = jsonConfig["path"]["meshletCullingComputeShader"];
+    _depthPrePassVertexShaderPath = jsonConfig["path"]["depthPrePassVertexShader"];
+    _skinLutComputeShaderPath = jsonConfig["path"]["skinLutComputeShader"];
+    _cacheDirectory = jsonConfig["path"].value("cacheDirectory", _cacheDirectory);
+    _environmentMapPath = jsonConfig["path"]["environmentMap"];
+    _prefilterSpecularComputeShaderPath = jsonConfig["path"]["prefilterSpecularComputeShader"];
+    _irradianceComputeShaderPath = jsonConfig["path"]["irradianceComputeShader"];
+    _brdfLutComputeShaderPath = jsonConfig["path"]["brdfLutComputeShader"];
+    _lightClusteringComputeShaderPath = jsonConfig["path"]["lightClusteringComputeShader"];
+    _shadowMapVertexShaderPath = jsonConfig["path"]["shadowMapVertexShader"];
+    _sssDownsampleComputeShaderPath = jsonConfig["path"]["sssDownsampleComputeShader"];
+    _sssBlurComputeShaderPath = jsonConfig["path"]["sssBlurComputeShader"];
+    _sssCompositeFragmentShaderPath = jsonConfig["path"]["sssCompositeFragmentShader"];
+    _sssResolveFragmentShaderPath = jsonConfig["path"]["sssResolveFragmentShader"];
+    _fullscreenVertexShaderPath = jsonConfig["path"]["fullscreenVertexShader"];
+    _upscaleFragmentShaderPath = jsonConfig["path"]["upscaleFragmentShader"];
+    _tonemapFragmentShaderPath = jsonConfig["path"]["tonemapFragmentShader"];
+    _tonemapPassFragmentShaderPath = jsonConfig["path"]["tonemapPassFragmentShader"];
     _windowWidth = jsonConfig["windowSize"]["width"];
     _windowHeight = jsonConfig["windowSize"]["height"];
+    if (jsonConfig.contains("resize")) {
+        _resizeWaitIdle = jsonConfig["resize"].value("waitIdle", false);
+    }
     _cameraSpeed = jsonConfig["camera"]["speed"];
     _lightSpeed = jsonConfig["lightSpeed"];
     _cameraFront = glm::vec3(
@@ -42,6 +128,143 @@ AppConfig::AppConfig(std::string configPath) {
         jsonConfig["observerPosition"]["y"],
         jsonConfig["observerPosition"]["z"]
     );
+    if (jsonConfig.contains("shaderVariants")) {
+        for (const auto& jsonVariant : jsonConfig["shaderVariants"]) {
+            _shaderVariants.push_back(parseShaderVariant(jsonVariant));
+        }
+    }
+    if (_shaderVariants.empty()) {
+        _shaderVariants.push_back(ShaderVariant{});
+    }
+    size_t activeVariant = jsonConfig.value("activeShaderVariant", 0);
+    if (activeVariant >= _shaderVariants.size()) {
+        throw std::runtime_error("activeShaderVariant is out of range!");
+    }
+    _shaderVariant = _shaderVariants[activeVariant];
+    if (jsonConfig.contains("materials")) {
+        for (const auto& jsonMaterial : jsonConfig["materials"]) {
+            _materials.push_back(parseMaterial(jsonMaterial));
+            if (_materials.back().shaderVariant >= static_cast<int>(_shaderVariants.size())) {
+                throw std::runtime_error("shaderVariant of material " + _materials.back().name + " is out of range!");
+            }
+        }
+    }
+    if (_materials.empty()) {
+        _materials.push_back(MaterialDefinition{});
+    }
+    for (const auto& jsonInstance : jsonConfig["scene"]["instances"]) {
+        _sceneInstances.push_back(parseInstanceTransform(jsonInstance, _materials));
+    }
+    if (jsonConfig["scene"].contains("crowd")) {
+        _crowdSize = jsonConfig["scene"]["crowd"].value("count", _crowdSize);
+        _crowdSpacing = jsonConfig["scene"]["crowd"].value("spacing", _crowdSpacing);
+    }
+    if (jsonConfig["scene"].contains("pointLights")) {
+        _pointLightCount = jsonConfig["scene"]["pointLights"].value("count", _pointLightCount);
+        _pointLightSpread = jsonConfig["scene"]["pointLights"].value("spread", _pointLightSpread);
+        _pointLightRadius = jsonConfig["scene"]["pointLights"].value("radius", _pointLightRadius);
+        _pointLightIntensity = jsonConfig["scene"]["pointLights"].value("intensity", _pointLightIntensity);
+        _pointLightSeed = jsonConfig["scene"]["pointLights"].value("seed", _pointLightSeed);
+    }
+    if (jsonConfig.contains("clusters")) {
+        _clusterGrid.x = jsonConfig["clusters"].value("x", _clusterGrid.x);
+        _clusterGrid.y = jsonConfig["clusters"].value("y", _clusterGrid.y);
+        _clusterGrid.z = jsonConfig["clusters"].value("z", _clusterGrid.z);
+        _maxLightsPerCluster = jsonConfig["clusters"].value("maxLightsPerCluster", _maxLightsPerCluster);
+    }
+    if (jsonConfig.contains("benchmark")) {
+        _benchmarkEnabled = jsonConfig["benchmark"].value("enabled", false);
+        _benchmarkFramesPerStep = jsonConfig["benchmark"].value("framesPerStep", _benchmarkFramesPerStep);
+        for (const auto& count : jsonConfig["benchmark"]["instanceCounts"]) {
+            _benchmarkInstanceCounts.push_back(count.get<uint32_t>());
+        }
+    }
+    if (jsonConfig.contains("culling")) {
+        _cullingEnabled = jsonConfig["culling"].value("enabled", _cullingEnabled);
+        _gpuCulling = jsonConfig["culling"].value("gpu", _gpuCulling);
+        _meshletCulling = jsonConfig["culling"].value("meshlets", _meshletCulling);
+        _meshletInstanceLimit = jsonConfig["culling"].value("meshletInstanceLimit", _meshletInstanceLimit);
+    }
+    if (jsonConfig.contains("depthPrePass")) {
+        _depthPrePass = jsonConfig["depthPrePass"].value("enabled", _depthPrePass);
+    }
+    if (jsonConfig.contains("skinLut")) {
+        _skinLutResolution = jsonConfig["skinLut"].value("resolution", _skinLutResolution);
+        _skinLutSamples = jsonConfig["skinLut"].value("samples", _skinLutSamples);
+        _skinLutMaxCurvature = jsonConfig["skinLut"].value("maxCurvature", _skinLutMaxCurvature);
+        _unitsPerMillimeter = jsonConfig["skinLut"].value("unitsPerMillimeter", _unitsPerMillimeter);
+    }
+    if (jsonConfig.contains("ibl")) {
+        _iblSpecularResolution = jsonConfig["ibl"].value("specularResolution", _iblSpecularResolution);
+        _iblIrradianceResolution = jsonConfig["ibl"].value("irradianceResolution", _iblIrradianceResolution);
+        _iblBrdfLutResolution = jsonConfig["ibl"].value("brdfLutResolution", _iblBrdfLutResolution);
+        _iblSpecularSamples = jsonConfig["ibl"].value("specularSamples", _iblSpecularSamples);
+        _iblIrradianceSamples = jsonConfig["ibl"].value("irradianceSamples", _iblIrradianceSamples);
+        _iblBrdfLutSamples = jsonConfig["ibl"].value("brdfLutSamples", _iblBrdfLutSamples);
+        _iblIntensity = jsonConfig["ibl"].value("intensity", _iblIntensity);
+    }
+    if (jsonConfig.contains("shadows")) {
+        _shadowsEnabled = jsonConfig["shadows"].value("enabled", _shadowsEnabled);
+        _shadowMapResolution = jsonConfig["shadows"].value("resolution", _shadowMapResolution);
+        _shadowFarPlane = jsonConfig["shadows"].value("farPlane", _shadowFarPlane);
+        _shadowDepthBias = jsonConfig["shadows"].value("depthBias", _shadowDepthBias);
+        _shadowSlopeBias = jsonConfig["shadows"].value("slopeBias", _shadowSlopeBias);
+    }
+    if (jsonConfig.contains("screenSpaceSss")) {
+        _screenSpaceSss = jsonConfig["screenSpaceSss"].value("enabled", _screenSpaceSss);
+        _sssAsyncCompute = jsonConfig["screenSpaceSss"].value("asyncCompute", _sssAsyncCompute);
+        _sssWidth = jsonConfig["screenSpaceSss"].value("width", _sssWidth);
+        _sssDepthThreshold = jsonConfig["screenSpaceSss"].value("depthThreshold", _sssDepthThreshold);
+    }
+    if (jsonConfig.contains("dynamicResolution")) {
+        _dynamicResolution = jsonConfig["dynamicResolution"].value("enabled", _dynamicResolution);
+        _targetFrameMs = jsonConfig["dynamicResolution"].value("targetFrameMs", _targetFrameMs);
+        _minRenderScale = jsonConfig["dynamicResolution"].value("minScale", _minRenderScale);
+        _maxRenderScale = jsonConfig["dynamicResolution"].value("maxScale", _maxRenderScale);
+        _upscaleSharpness = jsonConfig["dynamicResolution"].value("sharpness", _upscaleSharpness);
+    }
+    if (jsonConfig.contains("msaa")) {
+        _msaaSamples = jsonConfig["msaa"].value("samples", _msaaSamples);
+    }
+    if (jsonConfig.contains("hdr")) {
+        _hdrFormat = jsonConfig["hdr"].value("format", _hdrFormat);
+        _tonemapSubpass = jsonConfig["hdr"].value("tonemapSubpass", _tonemapSubpass);
+        _exposure = jsonConfig["hdr"].value("exposure", _exposure);
+    }
+    if (jsonConfig.contains("simulation")) {
+        _simulationTickRate = jsonConfig["simulation"].value("tickRate", _simulationTickRate);
+    }
+    if (jsonConfig.contains("device")) {
+        _deviceIndex = jsonConfig["device"].value("index", _deviceIndex);
+        _deviceName = jsonConfig["device"].value("name", _deviceName);
+    }
+    if (jsonConfig.contains("renderQueue")) {
+        _renderQueueSort = jsonConfig["renderQueue"].value("sort", _renderQueueSort);
+    }
+    if (jsonConfig.contains("bindless")) {
+        _bindlessMaxTextures = jsonConfig["bindless"].value("maxTextures", _bindlessMaxTextures);
+        _bindlessMaxMaterials = jsonConfig["bindless"].value("maxMaterials", _bindlessMaxMaterials);
+    }
+    if (jsonConfig.contains("geometryArena")) {
+        _geometryArenaVertexMegabytes = jsonConfig["geometryArena"].value("vertexMegabytes", _geometryArenaVertexMegabytes);
+        _geometryArenaIndexMegabytes = jsonConfig["geometryArena"].value("indexMegabytes", _geometryArenaIndexMegabytes);
+        _geometryArenaDefragmentKilobytes = jsonConfig["geometryArena"].value("defragmentKilobytesPerFrame", _geometryArenaDefragmentKilobytes);
+    }
+    if (jsonConfig.contains("capture")) {
+        _captureEnabled = jsonConfig["capture"].value("enabled", _captureEnabled);
+        _captureFormat = jsonConfig["capture"].value("format", _captureFormat);
+        _captureDirectory = jsonConfig["capture"].value("directory", _captureDirectory);
+        _captureRingSize = jsonConfig["capture"].value("ringSize", _captureRingSize);
+        _captureFrames = jsonConfig["capture"].value("frames", _captureFrames);
+        _captureHidden = jsonConfig["capture"].value("hidden", _captureHidden);
+    }
+    if (jsonConfig.contains("metrics")) {
+        _metricsPath = jsonConfig["metrics"].value("path", _metricsPath);
+        _metricsFrames = jsonConfig["metrics"].value("frames", _metricsFrames);
+    }
+    if (jsonConfig.contains("hotReload")) {
+        _hotReload = jsonConfig["hotReload"].value("enabled", _hotReload);
+    }
     _lastX = _windowWidth / 2;
     _lastY = _windowHeight / 2;
 }
@@ -1,29 +1,77 @@
 #pragma once
 
 #include <fstream>
+#include <string>
+#include <vector>
 #include <json.hpp>
 #include <glm/glm.hpp>
 
+#include "shader_variant.h"
+
 #define MOVEMENT_CAMERA 0
 #define MOVEMENT_LIGHT 1
 
 namespace vmr {
+struct InstanceTransform {
+    glm::vec3 position;
+    glm::vec3 rotation; // degrees, applied in X, Y, Z order
+    float scale;
+    uint32_t material = 0;  // index into the materials of the config
+
+    glm::mat4 matrix() const;
+};
+
+// Surface parameters of a material, uploaded to the material buffer of the bindless heap
+struct MaterialDefinition {
+    std::string name;
+    glm::vec3 tint = glm::vec3(1.0f);
+    float roughness = 0.5f;
+    float ior = 1.5f;
+    float ambient = 0.05f;
+    int shaderVariant = -1; // index into the shader variants, -1 follows the active one
+};
+
 class AppConfig {
 public:
     AppConfig(std::string configPath);
 
+    std::string configPath()                const { return _configPath; }
     std::string sphereModelPath()           const { return _sphereModelPath; }
     std::string displayModelPath()          const { return _displayModelPath; }
     std::string modelTexturePath()          const { return _modelTexturePath; }
     std::string modelNormalMapPath()        const { return _modelNormalMapPath; }
+    std::string thicknessMapPath()          const { return _thicknessMapPath; }
     std::string modelVertexShaderPath()     const { return _modelVertexShaderPath; }
     std::string modelFragmentShaderPath()   const { return _modelFragmentShaderPath; }
     std::string lightVertexShaderPath()     const { return _lightVertexShaderPath; }
     std::string lightFragmentShaderPath()   const { return _lightFragmentShaderPath; }
+    std::string cullingComputeShaderPath()  const { return _cullingComputeShaderPath; }
+    std::string meshletCullingComputeShaderPath() const { return _meshletCullingComputeShaderPath; }
+    std::string depthPrePassVertexShaderPath() const { return _depthPrePassVertexShaderPath; }
+    std::string skinLutComputeShaderPath()  const { return _skinLutComputeShaderPath; }
+    std::string cacheDirectory()            const { return _cacheDirectory; }
+    std::string environmentMapPath()        const { return _environmentMapPath; }
+    std::string prefilterSpecularComputeShaderPath() const { return _prefilterSpecularComputeShaderPath; }
+    std::string irradianceComputeShaderPath() const { return _irradianceComputeShaderPath; }
+    std::string brdfLutComputeShaderPath()  const { return _brdfLutComputeShaderPath; }
+    std::string lightClusteringComputeShaderPath() const { return _lightClusteringComputeShaderPath; }
+    std::string shadowMapVertexShaderPath() const { return _shadowMapVertexShaderPath; }
+    std::string sssDownsampleComputeShaderPath() const { return _sssDownsampleComputeShaderPath; }
+    std::string sssBlurComputeShaderPath()  const { return _sssBlurComputeShaderPath; }
+    std::string sssCompositeFragmentShaderPath() const { return _sssCompositeFragmentShaderPath; }
+    std::string sssResolveFragmentShaderPath() const { return _sssResolveFragmentShaderPath; }
+    std::string fullscreenVertexShaderPath() const { return _fullscreenVertexShaderPath; }
+    std::string upscaleFragmentShaderPath() const { return _upscaleFragmentShaderPath; }
+    std::string tonemapFragmentShaderPath() const { return _tonemapFragmentShaderPath; }
+    std::string tonemapPassFragmentShaderPath() const { return _tonemapPassFragmentShaderPath; }
     int windowWidth()                       const { return _windowWidth; }
     int windowHeight()                      const { return _windowHeight; }
+    bool resizeWaitIdle()                   const { return _resizeWaitIdle; }
+    // units per second
     float cameraSpeed()                     const { return _cameraSpeed; }
     float lightSpeed()                      const { return _lightSpeed; }
+    // ticks per second of the camera and light simulation
+    float simulationTickRate()              const { return _simulationTickRate; }
     glm::vec3 cameraFront()                 const { return _cameraFront; }
     glm::vec3 cameraUp()                    const { return _cameraUp; }
     glm::vec3 lightPosition()               const { return _lightPosition; } 
@@ -34,10 +82,95 @@ public:
     double lastY()                          const { return _lastY; }
     float pitch()                           const { return _pitch; }
     float yaw()                             const { return _yaw; }
+    const std::vector<ShaderVariant>& shaderVariants() const { return _shaderVariants; }
+    const ShaderVariant& shaderVariant()    const { return _shaderVariant; }
+    const std::vector<InstanceTransform>& sceneInstances() const { return _sceneInstances; }
+    const std::vector<MaterialDefinition>& materials() const { return _materials; }
+    // model draws are ordered by pipeline, material, mesh and depth, instead of the scene order
+    bool renderQueueSort()                  const { return _renderQueueSort; }
+    uint32_t crowdSize()                    const { return _crowdSize; }
+    float crowdSpacing()                    const { return _crowdSpacing; }
+    uint32_t pointLightCount()              const { return _pointLightCount; }
+    float pointLightSpread()                const { return _pointLightSpread; }
+    float pointLightRadius()                const { return _pointLightRadius; }
+    float pointLightIntensity()             const { return _pointLightIntensity; }
+    uint32_t pointLightSeed()               const { return _pointLightSeed; }
+    glm::uvec3 clusterGrid()                const { return _clusterGrid; }
+    uint32_t maxLightsPerCluster()          const { return _maxLightsPerCluster; }
+    bool benchmarkEnabled()                 const { return _benchmarkEnabled; }
+    const std::vector<uint32_t>& benchmarkInstanceCounts() const { return _benchmarkInstanceCounts; }
+    uint32_t benchmarkFramesPerStep()       const { return _benchmarkFramesPerStep; }
+    bool cullingEnabled()                   const { return _cullingEnabled; }
+    bool gpuCulling()                       const { return _gpuCulling; }
+    bool meshletCulling()                   const { return _meshletCulling; }
+    uint32_t meshletInstanceLimit()         const { return _meshletInstanceLimit; }
+    bool depthPrePass()                     const { return _depthPrePass; }
+    // the depth pre-pass occupies the first subpass of the render pass when enabled
+    uint32_t shadingSubpass()               const { return _depthPrePass ? 1 : 0; }
+    uint32_t skinLutResolution()            const { return _skinLutResolution; }
+    uint32_t skinLutSamples()               const { return _skinLutSamples; }
+    float skinLutMaxCurvature()             const { return _skinLutMaxCurvature; }
+    float unitsPerMillimeter()              const { return _unitsPerMillimeter; }
+    uint32_t iblSpecularResolution()        const { return _iblSpecularResolution; }
+    uint32_t iblIrradianceResolution()      const { return _iblIrradianceResolution; }
+    uint32_t iblBrdfLutResolution()         const { return _iblBrdfLutResolution; }
+    uint32_t iblSpecularSamples()           const { return _iblSpecularSamples; }
+    uint32_t iblIrradianceSamples()         const { return _iblIrradianceSamples; }
+    uint32_t iblBrdfLutSamples()            const { return _iblBrdfLutSamples; }
+    float iblIntensity()                    const { return _iblIntensity; }
+    bool shadowsEnabled()                   const { return _shadowsEnabled; }
+    uint32_t shadowMapResolution()          const { return _shadowMapResolution; }
+    float shadowFarPlane()                  const { return _shadowFarPlane; }
+    float shadowDepthBias()                 const { return _shadowDepthBias; }
+    float shadowSlopeBias()                 const { return _shadowSlopeBias; }
+    bool screenSpaceSss()                   const { return _screenSpaceSss; }
+    bool sssAsyncCompute()                  const { return _sssAsyncCompute; }
+    float sssWidth()                        const { return _sssWidth; }
+    float sssDepthThreshold()               const { return _sssDepthThreshold; }
+    bool dynamicResolution()                const { return _dynamicResolution; }
+    float targetFrameMs()                   const { return _targetFrameMs; }
+    float minRenderScale()                  const { return _minRenderScale; }
+    float maxRenderScale()                  const { return _maxRenderScale; }
+    float upscaleSharpness()                const { return _upscaleSharpness; }
+    // requested samples per pixel of the main pass, 1 disables multisampling
+    uint32_t msaaSamples()                  const { return _msaaSamples; }
+    std::string hdrFormat()                 const { return _hdrFormat; }
+    bool tonemapSubpass()                   const { return _tonemapSubpass; }
+    float exposure()                        const { return _exposure; }
+    // watches config.json and the model assets and shaders, rebuilding what changed while running
+    bool hotReload()                        const { return _hotReload; }
+    // physical device to use instead of the highest scoring one, by enumeration index or by part of its name
+    int deviceIndex()                       const { return _deviceIndex; }
+    std::string deviceName()                const { return _deviceName; }
+    // slots of the bindless texture array and material buffer, the texture count is clamped to the device limit
+    uint32_t bindlessMaxTextures()          const { return _bindlessMaxTextures; }
+    uint32_t bindlessMaxMaterials()         const { return _bindlessMaxMaterials; }
+    // size of the shared vertex and index buffers, and how much of them may be moved per frame to compact them (0 disables it)
+    uint32_t geometryArenaVertexMegabytes() const { return _geometryArenaVertexMegabytes; }
+    uint32_t geometryArenaIndexMegabytes()  const { return _geometryArenaIndexMegabytes; }
+    uint32_t geometryArenaDefragmentKilobytes() const { return _geometryArenaDefragmentKilobytes; }
+    bool captureEnabled()                   const { return _captureEnabled; }
+    // png of the presented image, or exr of the HDR target where it is stored
+    std::string captureFormat()             const { return _captureFormat; }
+    std::string captureDirectory()          const { return _captureDirectory; }
+    uint32_t captureRingSize()              const { return _captureRingSize; }
+    // frames to capture before exiting, 0 captures until the window is closed
+    uint32_t captureFrames()                const { return _captureFrames; }
+    // renders into a window that is never shown, it still needs a display since frames are presented to its surface
+    bool captureHidden()                    const { return _captureHidden; }
+    // json file the startup and frame times are written to on exit, none if empty
+    std::string metricsPath()               const { return _metricsPath; }
+    // frames to render before exiting, 0 renders until the window is closed
+    uint32_t metricsFrames()                const { return _metricsFrames; }
+    // the scattering is added to the HDR target after the main pass, which then leaves the tonemapping to the composite pass
+    bool tonemapInMainPass()                const { return _tonemapSubpass && !_screenSpaceSss; }
+    // the shading subpass writes the diffuse irradiance to a second attachment for the screen-space scattering
+    uint32_t colorAttachmentCount()         const { return _screenSpaceSss ? 2 : 1; }
 
     glm::vec3 & lightPosition()             { return _lightPosition; }
     glm::vec3 & observerPosition()          { return _observerPosition; }
     glm::vec3 & cameraFront()               { return _cameraFront; }
+    ShaderVariant & shaderVariant()         { return _shaderVariant; }
 
     void movementMode(int newMovementMode)          { _movementMode = std::move(newMovementMode); }
     void firstMouse(bool newFirstMouse)             { _firstMouse = std::move(newFirstMouse); }
@@ -47,16 +180,38 @@ public:
     void yaw(float newYaw)                          { _yaw = std::move(newYaw); }
 
 private:
+    std::string _configPath;
     std::string _sphereModelPath;
     std::string _displayModelPath;
     std::string _modelTexturePath;
     std::string _modelNormalMapPath;
+    std::string _thicknessMapPath;
     std::string _modelVertexShaderPath;
     std::string _modelFragmentShaderPath;
     std::string _lightVertexShaderPath;
     std::string _lightFragmentShaderPath;
+    std::string _cullingComputeShaderPath;
+    std::string _meshletCullingComputeShaderPath;
+    std::string _depthPrePassVertexShaderPath;
+    std::string _skinLutComputeShaderPath;
+    std::string _cacheDirectory = "./cache";
+    std::string _environmentMapPath;
+    std::string _prefilterSpecularComputeShaderPath;
+    std::string _irradianceComputeShaderPath;
+    std::string _brdfLutComputeShaderPath;
+    std::string _lightClusteringComputeShaderPath;
+    std::string _shadowMapVertexShaderPath;
+    std::string _sssDownsampleComputeShaderPath;
+    std::string _sssBlurComputeShaderPath;
+    std::string _sssCompositeFragmentShaderPath;
+    std::string _sssResolveFragmentShaderPath;
+    std::string _fullscreenVertexShaderPath;
+    std::string _upscaleFragmentShaderPath;
+    std::string _tonemapFragmentShaderPath;
+    std::string _tonemapPassFragmentShaderPath;
     int _windowWidth;
     int _windowHeight;
+    bool _resizeWaitIdle = false;
     float _cameraSpeed;
     float _lightSpeed;
     glm::vec3 _cameraFront;
@@ -69,5 +224,73 @@ private:
     double _lastY;
     float _pitch=0.0f;
     float _yaw=0.0f;
+    std::vector<ShaderVariant> _shaderVariants;
+    ShaderVariant _shaderVariant;
+    std::vector<InstanceTransform> _sceneInstances;
+    std::vector<MaterialDefinition> _materials;
+    bool _renderQueueSort = true;
+    uint32_t _crowdSize = 0;
+    float _crowdSpacing = 0.6f;
+    uint32_t _pointLightCount = 0;
+    float _pointLightSpread = 1.0f;
+    float _pointLightRadius = 0.3f;
+    float _pointLightIntensity = 0.5f;
+    uint32_t _pointLightSeed = 1;
+    glm::uvec3 _clusterGrid = glm::uvec3(16, 9, 24);
+    uint32_t _maxLightsPerCluster = 64;
+    bool _benchmarkEnabled = false;
+    std::vector<uint32_t> _benchmarkInstanceCounts;
+    uint32_t _benchmarkFramesPerStep = 300;
+    bool _cullingEnabled = true;
+    bool _gpuCulling = true;
+    bool _meshletCulling = false;
+    uint32_t _meshletInstanceLimit = 16;
+    bool _depthPrePass = false;
+    uint32_t _skinLutResolution = 256;
+    uint32_t _skinLutSamples = 512;
+    float _skinLutMaxCurvature = 1.0f;
+    float _unitsPerMillimeter = 0.005f;
+    uint32_t _iblSpecularResolution = 256;
+    uint32_t _iblIrradianceResolution = 32;
+    uint32_t _iblBrdfLutResolution = 256;
+    uint32_t _iblSpecularSamples = 1024;
+    uint32_t _iblIrradianceSamples = 2048;
+    uint32_t _iblBrdfLutSamples = 1024;
+    float _iblIntensity = 1.0f;
+    bool _shadowsEnabled = false;
+    uint32_t _shadowMapResolution = 1024;
+    float _shadowFarPlane = 10.0f;
+    float _shadowDepthBias = 1.25f;
+    float _shadowSlopeBias = 1.75f;
+    bool _screenSpaceSss = false;
+    bool _sssAsyncCompute = true;
+    float _sssWidth = 1.5f;
+    float _sssDepthThreshold = 0.05f;
+    bool _dynamicResolution = false;
+    float _targetFrameMs = 8.0f;
+    float _minRenderScale = 0.5f;
+    float _maxRenderScale = 1.0f;
+    float _upscaleSharpness = 0.25f;
+    uint32_t _msaaSamples = 1;
+    std::string _hdrFormat = "R16G16B16A16_SFLOAT";
+    bool _tonemapSubpass = true;
+    float _exposure = 1.0f;
+    bool _hotReload = false;
+    float _simulationTickRate = 120.0f;
+    int _deviceIndex = -1;
+    std::string _deviceName;
+    uint32_t _bindlessMaxTextures = 1024;
+    uint32_t _bindlessMaxMaterials = 256;
+    uint32_t _geometryArenaVertexMegabytes = 64;
+    uint32_t _geometryArenaIndexMegabytes = 32;
+    uint32_t _geometryArenaDefragmentKilobytes = 256;
+    bool _captureEnabled = false;
+    std::string _captureFormat = "png";
+    std::string _captureDirectory = "./capture";
+    uint32_t _captureRingSize = 4;
+    uint32_t _captureFrames = 0;
+    bool _captureHidden = false;
+    std::string _metricsPath;
+    uint32_t _metricsFrames = 0;
 };
 }
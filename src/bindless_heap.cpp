@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <array>
+
+#include "bindless_heap.h"
+
+namespace vmr {
+
+BindlessHeap::BindlessHeap(Device* device, AppConfig* appConfig, size_t framesInFlight) : _device(device), _appConfig(appConfig) {
+    _updateAfterBind = _device->capabilities().descriptorIndexing;
+    if (_updateAfterBind) {
+        _textureCapacity = std::min(_appConfig->bindlessMaxTextures(), _device->capabilities().maxBindlessImages);
+    } else {
+        _textureCapacity = std::min(_appConfig->bindlessMaxTextures(), FALLBACK_TEXTURE_SLOTS);
+        std::cout<<"Descriptor indexing is not supported, textures are bound through a fixed array of "<<_textureCapacity<<" slots"<<std::endl;
+    }
+    _textureCapacity = std::max(_textureCapacity, 1u);
+    _materialCapacity = std::max(_appConfig->bindlessMaxMaterials(), 1u);
+    _textures.resize(_textureCapacity, VkDescriptorImageInfo{VK_NULL_HANDLE, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+    //lowest slots are handed out first
+    for (uint32_t slot = _textureCapacity; slot > 0; slot--) {
+        _freeTextures.push_back(slot - 1);
+    }
+    _materials.reserve(_materialCapacity);
+
+    createLayout();
+    createPool(framesInFlight);
+    createMaterialBuffer();
+    createSets(framesInFlight);
+}
+
+BindlessHeap::~BindlessHeap() {
+    vkDestroyBuffer(_device->logical(), _materialBuffer, nullptr);
+    vkFreeMemory(_device->logical(), _materialBufferMemory, nullptr);
+    vkDestroyDescriptorPool(_device->logical(), _pool, nullptr);
+    vkDestroyDescriptorSetLayout(_device->logical(), _layout, nullptr);
+}
+
+void BindlessHeap::createLayout() {
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorCount = _textureCapacity;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].pImmutableSamplers = nullptr;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    bindings[1].binding = 1;
+    bindings[1].descriptorCount = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].pImmutableSamplers = nullptr;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    //free slots are never written, and slots no pending frame samples may be written while the set is bound
+    std::array<VkDescriptorBindingFlagsEXT, 2> bindingFlags = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT,
+        0
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+    if (_updateAfterBind) {
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        layoutInfo.pNext = &bindingFlagsInfo;
+    }
+
+    if (vkCreateDescriptorSetLayout(_device->logical(), &layoutInfo, nullptr, &_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless descriptor set layout!");
+    }
+}
+
+void BindlessHeap::createPool(size_t framesInFlight) {
+    uint32_t setCount = _updateAfterBind ? 1 : static_cast<uint32_t>(framesInFlight);
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = _textureCapacity * setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+    if (_updateAfterBind) {
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    }
+
+    if (vkCreateDescriptorPool(_device->logical(), &poolInfo, nullptr, &_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless descriptor pool!");
+    }
+}
+
+void BindlessHeap::createMaterialBuffer() {
+    //device local and updated from the command buffer, every frame reads the materials uploaded before its draws
+    VkDeviceSize bufferSize = sizeof(Material) * _materialCapacity;
+    _device->createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _materialBuffer, _materialBufferMemory);
+}
+
+void BindlessHeap::createSets(size_t framesInFlight) {
+    uint32_t setCount = _updateAfterBind ? 1 : static_cast<uint32_t>(framesInFlight);
+    std::vector<VkDescriptorSetLayout> layouts(setCount, _layout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _pool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    _sets.resize(setCount);
+    _staleSets.assign(setCount, true);
+    if (vkAllocateDescriptorSets(_device->logical(), &allocInfo, _sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate bindless descriptor sets!");
+    }
+
+    VkDescriptorBufferInfo materialBufferInfo{_materialBuffer, 0, VK_WHOLE_SIZE};
+    for (VkDescriptorSet set : _sets) {
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = set;
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &materialBufferInfo;
+        vkUpdateDescriptorSets(_device->logical(), 1, &descriptorWrite, 0, nullptr);
+    }
+}
+
+void BindlessHeap::writeTexture(VkDescriptorSet set, uint32_t slot, const VkDescriptorImageInfo& imageInfo) {
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(_device->logical(), 1, &descriptorWrite, 0, nullptr);
+    _textureWrites++;
+}
+
+void BindlessHeap::writeAllTextures(VkDescriptorSet set) {
+    //without partial binding every element has to be valid, free slots repeat the first texture in use
+    auto firstUsed = std::find_if(_textures.begin(), _textures.end(), [](const VkDescriptorImageInfo& info) { return info.imageView != VK_NULL_HANDLE; });
+    if (firstUsed == _textures.end()) {
+        return;
+    }
+    std::vector<VkDescriptorImageInfo> imageInfos(_textures);
+    for (auto& info : imageInfos) {
+        if (info.imageView == VK_NULL_HANDLE) {
+            info = *firstUsed;
+        }
+    }
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+    descriptorWrite.pImageInfo = imageInfos.data();
+    vkUpdateDescriptorSets(_device->logical(), 1, &descriptorWrite, 0, nullptr);
+    _textureWrites += imageInfos.size();
+}
+
+uint32_t BindlessHeap::addTexture(VkImageView imageView, VkSampler sampler) {
+    if (_freeTextures.empty()) {
+        throw std::runtime_error("failed to add texture, all " + std::to_string(_textureCapacity) + " bindless slots are in use!");
+    }
+    uint32_t slot = _freeTextures.back();
+    _freeTextures.pop_back();
+    _textures[slot] = {sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    _usedTextures++;
+
+    if (_updateAfterBind) {
+        //no frame samples a free slot, so it is written right away even while the set is in use
+        writeTexture(_sets[0], slot, _textures[slot]);
+    } else {
+        _staleSets.assign(_sets.size(), true);
+    }
+    return slot;
+}
+
+void BindlessHeap::removeTexture(uint32_t slot) {
+    //the descriptor is left as it is, partially bound slots may refer to destroyed views while nothing samples them
+    _textures[slot].imageView = VK_NULL_HANDLE;
+    _usedTextures--;
+    _device->deletionQueue().pushAfterRecording([this, slot]() {
+        _freeTextures.push_back(slot);
+    });
+    if (!_updateAfterBind) {
+        _staleSets.assign(_sets.size(), true);
+    }
+}
+
+uint32_t BindlessHeap::addMaterial(const Material& material) {
+    if (_materials.size() == _materialCapacity) {
+        throw std::runtime_error("failed to add material, all " + std::to_string(_materialCapacity) + " bindless slots are in use!");
+    }
+    uint32_t index = static_cast<uint32_t>(_materials.size());
+    _materials.push_back(material);
+    updateMaterial(index, material);
+    return index;
+}
+
+void BindlessHeap::updateMaterial(uint32_t index, const Material& material) {
+    _materials[index] = material;
+    if (_dirtyBegin == _dirtyEnd) {
+        _dirtyBegin = index;
+        _dirtyEnd = index + 1;
+    } else {
+        _dirtyBegin = std::min(_dirtyBegin, index);
+        _dirtyEnd = std::max(_dirtyEnd, index + 1);
+    }
+}
+
+void BindlessHeap::update(VkCommandBuffer commandBuffer, int currentFrame) {
+    if (!_updateAfterBind && _staleSets[currentFrame]) {
+        writeAllTextures(_sets[currentFrame]);
+        _staleSets[currentFrame] = false;
+    }
+    if (_dirtyBegin == _dirtyEnd) {
+        return;
+    }
+
+    //earlier frames may still read the buffer, later ones only after the upload
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = _materialBuffer;
+    barrier.offset = sizeof(Material) * _dirtyBegin;
+    barrier.size = sizeof(Material) * (_dirtyEnd - _dirtyBegin);
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    //vkCmdUpdateBuffer is limited to 64 KiB per call
+    const uint32_t materialsPerUpdate = 65536 / sizeof(Material);
+    for (uint32_t begin = _dirtyBegin; begin < _dirtyEnd; begin += materialsPerUpdate) {
+        uint32_t count = std::min(materialsPerUpdate, _dirtyEnd - begin);
+        vkCmdUpdateBuffer(commandBuffer, _materialBuffer, sizeof(Material) * begin, sizeof(Material) * count, &_materials[begin]);
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    _dirtyBegin = _dirtyEnd = 0;
+    _materialUploads++;
+}
+
+void BindlessHeap::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, int currentFrame) {
+    VkDescriptorSet descriptorSet = _updateAfterBind ? _sets[0] : _sets[currentFrame];
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &descriptorSet, 0, nullptr);
+}
+
+void BindlessHeap::printStats() {
+    std::cout<<"Bindless heap: "<<_usedTextures<<" of "<<_textureCapacity<<" texture slots and "<<_materials.size()<<" of "<<_materialCapacity
+             <<" materials in use, "<<_textureWrites<<" descriptor writes, "<<_materialUploads<<" material uploads"
+             <<(_updateAfterBind ? "" : " (fixed array)")<<std::endl;
+}
+}
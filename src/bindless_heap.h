@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+#include "device.h"
+
+namespace vmr {
+// texture slots of the fixed array used where descriptor indexing is missing, the sampler limit guaranteed by every
+// device is 16 per stage and the model pipeline's own set already takes seven of them
+const uint32_t FALLBACK_TEXTURE_SLOTS = 8;
+
+// mirrors struct Material of the model fragment shader, textures are slots of the bindless array
+struct Material {
+    uint32_t albedoTexture;
+    uint32_t normalMapTexture;
+    uint32_t thicknessTexture;
+    uint32_t flags;
+    alignas(16) glm::vec4 tint;
+    float roughness;
+    float ior;
+    float ambient;
+    float padding;
+};
+
+// One descriptor set holding every texture and material of the scene: binding 0 is an array of sampled images,
+// binding 1 a storage buffer of materials referring to them by slot. Draws only push their material index, so any
+// number of materials is drawn without binding another set. With descriptor indexing the array is large, partially
+// bound and written while frames using other slots are in flight; otherwise it is a small fixed array with a set
+// per frame in flight, rewritten before a frame next uses it.
+class BindlessHeap {
+private:
+    Device* _device;
+    AppConfig* _appConfig;
+    bool _updateAfterBind;
+    uint32_t _textureCapacity;
+    uint32_t _materialCapacity;
+    VkDescriptorSetLayout _layout;
+    VkDescriptorPool _pool;
+    std::vector<VkDescriptorSet> _sets;             // a single one with descriptor indexing, one per frame otherwise
+    std::vector<VkDescriptorImageInfo> _textures;   // by slot, a null view where free
+    std::vector<uint32_t> _freeTextures;
+    uint32_t _usedTextures = 0;
+    std::vector<bool> _staleSets;
+    VkBuffer _materialBuffer;
+    VkDeviceMemory _materialBufferMemory;
+    std::vector<Material> _materials;
+    uint32_t _dirtyBegin = 0;                       // range of materials changed since the last upload
+    uint32_t _dirtyEnd = 0;
+    uint64_t _textureWrites = 0;
+    uint64_t _materialUploads = 0;
+
+    void createLayout();
+    void createPool(size_t framesInFlight);
+    void createSets(size_t framesInFlight);
+    void createMaterialBuffer();
+    void writeTexture(VkDescriptorSet set, uint32_t slot, const VkDescriptorImageInfo& imageInfo);
+    void writeAllTextures(VkDescriptorSet set);
+
+public:
+    BindlessHeap(Device* device, AppConfig* appConfig, size_t framesInFlight);
+    ~BindlessHeap();
+    VkDescriptorSetLayout layout()      { return _layout; }
+    // size of the texture array, the TEXTURE_SLOTS constant of the shaders sampling it
+    uint32_t textureCapacity() const    { return _textureCapacity; }
+    bool updateAfterBind() const        { return _updateAfterBind; }
+
+    // the slot of the texture in the array, usable by materials uploaded from the next frame on
+    uint32_t addTexture(VkImageView imageView, VkSampler sampler);
+    // the slot is reused once the frames in flight and the one being recorded no longer sample it
+    void removeTexture(uint32_t slot);
+    uint32_t addMaterial(const Material& material);
+    void updateMaterial(uint32_t index, const Material& material);
+
+    // before the frame's first draw, once its fence has been waited on: uploads the changed materials and, without
+    // descriptor indexing, rewrites the frame's set if textures changed since it was last used
+    void update(VkCommandBuffer commandBuffer, int currentFrame);
+    void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, int currentFrame);
+    void printStats();
+};
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <array>
+
+#include "clustered_lighting.h"
+#include "pipeline.h"
+
+namespace vmr {
+
+ClusteredLighting::ClusteredLighting(Device* device, AppConfig* appConfig, Scene* scene)
+            : _device(device), _appConfig(appConfig), _scene(scene) {
+    _grid = glm::max(_appConfig->clusterGrid(), glm::uvec3(1));
+    _clusterCount = _grid.x * _grid.y * _grid.z;
+
+    uint32_t maxLightsPerCluster = std::max(1u, _appConfig->maxLightsPerCluster());
+    VkSpecializationMapEntry specializationEntry{0, 0, sizeof(uint32_t)};
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &specializationEntry;
+    specializationInfo.dataSize = sizeof(uint32_t);
+    specializationInfo.pData = &maxLightsPerCluster;
+
+    _clusteringPipeline = new ComputePipeline(_device, _appConfig->lightClusteringComputeShaderPath(),
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+        sizeof(ClusteringConstants), MAX_FRAMES_IN_FLIGHT, &specializationInfo);
+    _recorded.resize(MAX_FRAMES_IN_FLIGHT, false);
+    createBuffers();
+    createDescriptorSets();
+    std::cout<<"Clustered lighting: "<<_scene->lightCount()<<" point light(s) in "<<_grid.x<<"x"<<_grid.y<<"x"<<_grid.z<<" clusters\n";
+}
+
+ClusteredLighting::~ClusteredLighting() {
+    for (size_t i = 0; i < _lightBuffers.size(); i++) {
+        vkDestroyBuffer(_device->logical(), _lightBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _lightBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device->logical(), _lightGridBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _lightGridBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device->logical(), _lightIndexBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _lightIndexBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device->logical(), _counterBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _counterBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device->logical(), _readbackBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _readbackBuffersMemory[i], nullptr);
+    }
+    delete _clusteringPipeline;
+}
+
+void ClusteredLighting::createBuffers() {
+    //every cluster may list up to maxLightsPerCluster lights, so the shared index list can never overflow
+    VkDeviceSize lightsSize = sizeof(PointLight) * std::max(1u, _scene->lightCount());
+    VkDeviceSize gridSize = sizeof(uint32_t) * 2 * _clusterCount;
+    VkDeviceSize indicesSize = sizeof(uint32_t) * _clusterCount * std::max(1u, _appConfig->maxLightsPerCluster());
+
+    _lightBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _lightBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _lightBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    _lightGridBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _lightGridBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _lightIndexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _lightIndexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _counterBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _counterBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _readbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _readbackBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _readbackBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        _device->createBuffer(lightsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _lightBuffers[i], _lightBuffersMemory[i]);
+        _device->createBuffer(gridSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _lightGridBuffers[i], _lightGridBuffersMemory[i]);
+        _device->createBuffer(indicesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _lightIndexBuffers[i], _lightIndexBuffersMemory[i]);
+        _device->createBuffer(sizeof(ClusterCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _counterBuffers[i], _counterBuffersMemory[i]);
+        _device->createBuffer(sizeof(ClusterCounters), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _readbackBuffers[i], _readbackBuffersMemory[i]);
+
+        vkMapMemory(_device->logical(), _lightBuffersMemory[i], 0, lightsSize, 0, &_lightBuffersMapped[i]);
+        memset(_lightBuffersMapped[i], 0, static_cast<size_t>(lightsSize));
+        vkMapMemory(_device->logical(), _readbackBuffersMemory[i], 0, sizeof(ClusterCounters), 0, &_readbackBuffersMapped[i]);
+        memset(_readbackBuffersMapped[i], 0, sizeof(ClusterCounters));
+    }
+}
+
+void ClusteredLighting::createDescriptorSets() {
+    _descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        _descriptorSets[i] = _clusteringPipeline->allocateDescriptorSet();
+
+        std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+        bufferInfos[0] = {_lightBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[1] = {_lightGridBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[2] = {_lightIndexBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[3] = {_counterBuffers[i], 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = _descriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+        vkUpdateDescriptorSets(_device->logical(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void ClusteredLighting::collectStats(uint32_t currentFrame) {
+    if (!_recorded[currentFrame]) {
+        return;
+    }
+    //the fence of this frame has already been waited on, so its counters can be read without stalling
+    memcpy(&_counters, _readbackBuffersMapped[currentFrame], sizeof(ClusterCounters));
+    _statsFrames++;
+    _assignmentsTotal += _counters.indexCount;
+    _occupiedClustersTotal += _counters.occupiedClusters;
+    _maxLightsTotal = std::max(_maxLightsTotal, _counters.maxLights);
+    _droppedLightsTotal += _counters.droppedLights;
+}
+
+void ClusteredLighting::printStats() {
+    if (_statsFrames == 0) {
+        return;
+    }
+    std::cout<<"Clustered lighting: avg "<<(_occupiedClustersTotal == 0 ? 0.0 : _assignmentsTotal / (double) _occupiedClustersTotal)
+             <<" lights per lit cluster, "<<_occupiedClustersTotal / (double) _statsFrames<<" of "<<_clusterCount<<" clusters lit on average, max "
+             <<_maxLightsTotal<<" lights in one cluster";
+    if (_droppedLightsTotal > 0) {
+        std::cout<<", "<<_droppedLightsTotal<<" light assignment(s) dropped over the limit of "<<_appConfig->maxLightsPerCluster();
+    }
+    std::cout<<std::endl;
+}
+
+void ClusteredLighting::record(VkCommandBuffer commandBuffer, uint32_t currentFrame, const glm::mat4& view, const glm::mat4& projection,
+                               float nearPlane, float farPlane) {
+    //lights are few and small, this frame's copy is simply rewritten
+    if (_scene->lightCount() > 0) {
+        memcpy(_lightBuffersMapped[currentFrame], _scene->lights().data(), sizeof(PointLight) * _scene->lightCount());
+    }
+    vkCmdFillBuffer(commandBuffer, _counterBuffers[currentFrame], 0, sizeof(ClusterCounters), 0);
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    //the planes are passed as they are, recovering them from the matrix depends on its depth range convention
+    ClusteringConstants constants{};
+    constants.view = view;
+    constants.projection = glm::vec4(projection[0][0], projection[1][1], nearPlane, farPlane);
+    constants.grid = glm::uvec4(_grid, _scene->lightCount());
+
+    _clusteringPipeline->bind(commandBuffer, _descriptorSets[currentFrame]);
+    _clusteringPipeline->pushConstants(commandBuffer, &constants, sizeof(constants));
+    vkCmdDispatch(commandBuffer, (_clusterCount + 63) / 64, 1, 1);
+
+    //only for the readback, the render graph orders the shading pass after the clustering
+    VkMemoryBarrier clusteringBarrier{};
+    clusteringBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clusteringBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    clusteringBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &clusteringBarrier, 0, nullptr, 0, nullptr);
+
+    //counters are copied out and read back once this frame's fence signals
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(ClusterCounters);
+    vkCmdCopyBuffer(commandBuffer, _counterBuffers[currentFrame], _readbackBuffers[currentFrame], 1, &copyRegion);
+
+    VkMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+    _recorded[currentFrame] = true;
+}
+
+}
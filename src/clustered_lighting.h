@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+#include "compute_pipeline.h"
+#include "scene.h"
+
+namespace vmr {
+// Clustered forward light culling. A compute pre-pass splits the view frustum into screen tiles and exponential
+// depth slices and writes, for every cluster, the list of point lights reaching it. Model shaders find their cluster
+// from the fragment position and only evaluate the lights listed there.
+class ClusteredLighting {
+private:
+    struct ClusteringConstants {
+        alignas(16) glm::mat4 view;
+        alignas(16) glm::vec4 projection;   // proj[0][0], proj[1][1], near plane, far plane
+        alignas(16) glm::uvec4 grid;        // clusters along x, y and z, light count
+    };
+    // Layout of the ClusterCounters buffer, indexCount is the allocator of the light index list
+    struct ClusterCounters {
+        uint32_t indexCount;
+        uint32_t maxLights;
+        uint32_t occupiedClusters;
+        uint32_t droppedLights;
+    };
+
+    Device* _device;
+    AppConfig* _appConfig;
+    Scene* _scene;
+    glm::uvec3 _grid;
+    uint32_t _clusterCount;
+    ComputePipeline* _clusteringPipeline;
+    std::vector<VkDescriptorSet> _descriptorSets;
+    std::vector<VkBuffer> _lightBuffers;
+    std::vector<VkDeviceMemory> _lightBuffersMemory;
+    std::vector<void *> _lightBuffersMapped;
+    std::vector<VkBuffer> _lightGridBuffers;
+    std::vector<VkDeviceMemory> _lightGridBuffersMemory;
+    std::vector<VkBuffer> _lightIndexBuffers;
+    std::vector<VkDeviceMemory> _lightIndexBuffersMemory;
+    std::vector<VkBuffer> _counterBuffers;
+    std::vector<VkDeviceMemory> _counterBuffersMemory;
+    std::vector<VkBuffer> _readbackBuffers;
+    std::vector<VkDeviceMemory> _readbackBuffersMemory;
+    std::vector<void *> _readbackBuffersMapped;
+    std::vector<bool> _recorded;
+    ClusterCounters _counters{};
+    uint64_t _statsFrames = 0;
+    uint64_t _assignmentsTotal = 0;
+    uint64_t _occupiedClustersTotal = 0;
+    uint32_t _maxLightsTotal = 0;
+    uint64_t _droppedLightsTotal = 0;
+
+    void createBuffers();
+    void createDescriptorSets();
+
+public:
+    ClusteredLighting(Device* device, AppConfig* appConfig, Scene* scene);
+    ~ClusteredLighting();
+    VkBuffer lightBuffer(size_t frame)      { return _lightBuffers[frame]; }
+    VkBuffer lightGridBuffer(size_t frame)  { return _lightGridBuffers[frame]; }
+    VkBuffer lightIndexBuffer(size_t frame) { return _lightIndexBuffers[frame]; }
+    glm::uvec3 grid()                       const { return _grid; }
+    uint32_t lightCount()                   const { return _scene->lightCount(); }
+    // statistics of the last collected frame
+    double averageLightsPerCluster()        const { return _counters.occupiedClusters == 0 ? 0.0 : _counters.indexCount / (double) _counters.occupiedClusters; }
+    uint32_t maxLightsPerCluster()          const { return _counters.maxLights; }
+    uint32_t occupiedClusters()             const { return _counters.occupiedClusters; }
+
+    void collectStats(uint32_t currentFrame);
+    void printStats();
+    // has to be recorded outside of the render pass, before the model is shaded; the planes are the ones the
+    // shading pass slices depth with
+    void record(VkCommandBuffer commandBuffer, uint32_t currentFrame, const glm::mat4& view, const glm::mat4& projection,
+                float nearPlane, float farPlane);
+};
+}
@@ -0,0 +1,121 @@
+#include <map>
+
+#include "compute_pipeline.h"
+
+namespace vmr {
+
+ComputePipeline::ComputePipeline(Device* device, const std::string& shaderPath, const std::vector<VkDescriptorType>& descriptorTypes,
+                                 uint32_t pushConstantSize, uint32_t maxSets, const VkSpecializationInfo* specializationInfo)
+            : _device(device) {
+    createDescriptorSetLayout(descriptorTypes);
+    createDescriptorPool(descriptorTypes, maxSets);
+    createPipeline(shaderPath, pushConstantSize, specializationInfo);
+}
+
+ComputePipeline::~ComputePipeline() {
+    vkDestroyPipeline(_device->logical(), _pipeline, nullptr);
+    vkDestroyPipelineLayout(_device->logical(), _pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(_device->logical(), _descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(_device->logical(), _descriptorSetLayout, nullptr);
+}
+
+void ComputePipeline::createDescriptorSetLayout(const std::vector<VkDescriptorType>& descriptorTypes) {
+    std::vector<VkDescriptorSetLayoutBinding> bindings(descriptorTypes.size());
+    for (size_t i = 0; i < descriptorTypes.size(); i++) {
+        bindings[i].binding = static_cast<uint32_t>(i);
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = descriptorTypes[i];
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(_device->logical(), &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute descriptor set layout!");
+    }
+}
+
+void ComputePipeline::createDescriptorPool(const std::vector<VkDescriptorType>& descriptorTypes, uint32_t maxSets) {
+    std::map<VkDescriptorType, uint32_t> typeCounts;
+    for (auto type : descriptorTypes) {
+        typeCounts[type] += maxSets;
+    }
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto& [type, count] : typeCounts) {
+        poolSizes.push_back({type, count});
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = maxSets;
+
+    if (vkCreateDescriptorPool(_device->logical(), &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute descriptor pool!");
+    }
+}
+
+void ComputePipeline::createPipeline(const std::string& shaderPath, uint32_t pushConstantSize, const VkSpecializationInfo* specializationInfo) {
+    VkShaderModule shaderModule = _device->loadShaderModule(shaderPath);
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantSize > 0 ? &pushConstantRange : nullptr;
+
+    if (vkCreatePipelineLayout(_device->logical(), &pipelineLayoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline layout!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = specializationInfo;
+    pipelineInfo.layout = _pipelineLayout;
+
+    if (vkCreateComputePipelines(_device->logical(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+
+    vkDestroyShaderModule(_device->logical(), shaderModule, nullptr);
+}
+
+VkDescriptorSet ComputePipeline::allocateDescriptorSet() {
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &_descriptorSetLayout;
+
+    VkDescriptorSet descriptorSet;
+    if (vkAllocateDescriptorSets(_device->logical(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate compute descriptor set!");
+    }
+    return descriptorSet;
+}
+
+void ComputePipeline::bind(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+}
+
+void ComputePipeline::pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size) {
+    vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, size, data);
+}
+
+}
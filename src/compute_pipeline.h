@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "device.h"
+
+namespace vmr {
+// Compute shader together with its descriptor set layout, pipeline layout and a descriptor pool for its sets.
+// Binding N of the layout is given by descriptorTypes[N].
+class ComputePipeline {
+private:
+    Device* _device;
+    VkDescriptorSetLayout _descriptorSetLayout;
+    VkPipelineLayout _pipelineLayout;
+    VkPipeline _pipeline;
+    VkDescriptorPool _descriptorPool;
+
+    void createDescriptorSetLayout(const std::vector<VkDescriptorType>& descriptorTypes);
+    void createDescriptorPool(const std::vector<VkDescriptorType>& descriptorTypes, uint32_t maxSets);
+    void createPipeline(const std::string& shaderPath, uint32_t pushConstantSize, const VkSpecializationInfo* specializationInfo);
+
+public:
+    ComputePipeline(Device* device, const std::string& shaderPath, const std::vector<VkDescriptorType>& descriptorTypes,
+                    uint32_t pushConstantSize, uint32_t maxSets, const VkSpecializationInfo* specializationInfo = nullptr);
+    ~ComputePipeline();
+    VkPipeline& pipeline() { return _pipeline; }
+    VkPipelineLayout& layout() { return _pipelineLayout; }
+    VkDescriptorSetLayout& descriptorSetLayout() { return _descriptorSetLayout; }
+
+    VkDescriptorSet allocateDescriptorSet();
+    void bind(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet);
+    void pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size);
+};
+}
@@ -0,0 +1,304 @@
+#include <algorithm>
+
+#include "culling_pass.h"
+
+namespace vmr {
+
+CullingPass::CullingPass(Device* device, AppConfig* appConfig, Scene* scene, ModelPipeline* modelPipeline)
+            : _device(device), _appConfig(appConfig), _scene(scene), _modelPipeline(modelPipeline) {
+    _gpuCulling = _appConfig->gpuCulling() && _device->drawIndirectCountSupported();
+    if (_appConfig->gpuCulling() && !_gpuCulling) {
+        std::cout<<"VK_KHR_draw_indirect_count is not available, falling back to CPU culling\n";
+    }
+    //the indirect draws carry no material, so they would draw every instance with the first one
+    if (_gpuCulling && _appConfig->materials().size() > 1) {
+        std::cout<<"GPU culling draws a single material, falling back to CPU culling and the render queue for "
+                 <<_appConfig->materials().size()<<" materials\n";
+        _gpuCulling = false;
+    }
+    _meshletCulling = _gpuCulling && _appConfig->meshletCulling();
+    if (_appConfig->meshletCulling() && !_meshletCulling) {
+        std::cout<<"Meshlet culling requires GPU culling and is disabled\n";
+    }
+    _meshletFrames.resize(MAX_FRAMES_IN_FLIGHT, false);
+    _staleMeshletSets.resize(MAX_FRAMES_IN_FLIGHT, false);
+    _testedCounts.resize(MAX_FRAMES_IN_FLIGHT, 0);
+    if (_gpuCulling) {
+        _cullingPipeline = new ComputePipeline(_device, _appConfig->cullingComputeShaderPath(),
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+            sizeof(CullingConstants), MAX_FRAMES_IN_FLIGHT);
+        if (_meshletCulling) {
+            _meshletCullingPipeline = new ComputePipeline(_device, _appConfig->meshletCullingComputeShaderPath(),
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+                sizeof(MeshletCullingConstants), MAX_FRAMES_IN_FLIGHT);
+        }
+        createBuffers();
+        createDescriptorSets();
+        if (_meshletCulling) {
+            createMeshletDescriptorSets();
+        }
+    } else {
+        _cullingKernel = bestCullingKernel();
+        std::cout<<"CPU culling uses the "<<cullingKernelName(_cullingKernel)<<" kernel\n";
+    }
+}
+
+CullingPass::~CullingPass() {
+    for (size_t i = 0; i < _drawCommandBuffers.size(); i++) {
+        vkDestroyBuffer(_device->logical(), _drawCommandBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _drawCommandBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device->logical(), _drawCountBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _drawCountBuffersMemory[i], nullptr);
+        vkDestroyBuffer(_device->logical(), _readbackBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _readbackBuffersMemory[i], nullptr);
+    }
+    delete _meshletCullingPipeline;
+    delete _cullingPipeline;
+}
+
+void CullingPass::createBuffers() {
+    //meshlet culling emits up to one command per meshlet of every instance, but only for scenes below the instance limit
+    _maxDrawCount = _scene->capacity();
+    if (_meshletCulling) {
+        _maxDrawCount = std::max<VkDeviceSize>(_maxDrawCount, static_cast<VkDeviceSize>(_modelPipeline->meshletCount()) * _appConfig->meshletInstanceLimit());
+    }
+    VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * _maxDrawCount;
+
+    _drawCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _drawCommandBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _drawCountBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _drawCountBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _readbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _readbackBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _readbackBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        _device->createBuffer(commandsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _drawCommandBuffers[i], _drawCommandBuffersMemory[i]);
+        _device->createBuffer(sizeof(CullingCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _drawCountBuffers[i], _drawCountBuffersMemory[i]);
+        _device->createBuffer(sizeof(CullingCounters), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _readbackBuffers[i], _readbackBuffersMemory[i]);
+
+        vkMapMemory(_device->logical(), _readbackBuffersMemory[i], 0, sizeof(CullingCounters), 0, &_readbackBuffersMapped[i]);
+        memset(_readbackBuffersMapped[i], 0, sizeof(CullingCounters));
+    }
+}
+
+void CullingPass::createDescriptorSets() {
+    _descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        _descriptorSets[i] = _cullingPipeline->allocateDescriptorSet();
+
+        std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+        bufferInfos[0] = {_modelPipeline->instanceBuffer(i), 0, VK_WHOLE_SIZE};
+        bufferInfos[1] = {_drawCommandBuffers[i], 0, VK_WHOLE_SIZE};
+        bufferInfos[2] = {_drawCountBuffers[i], 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = _descriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].dstArrayElement = 0;
+            descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+        vkUpdateDescriptorSets(_device->logical(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void CullingPass::createMeshletDescriptorSets() {
+    _meshletDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        _meshletDescriptorSets[i] = _meshletCullingPipeline->allocateDescriptorSet();
+        writeMeshletDescriptorSet(i);
+    }
+}
+
+void CullingPass::writeMeshletDescriptorSet(size_t frame) {
+    std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+    bufferInfos[0] = {_modelPipeline->instanceBuffer(frame), 0, VK_WHOLE_SIZE};
+    bufferInfos[1] = {_modelPipeline->meshletBuffer(), 0, VK_WHOLE_SIZE};
+    bufferInfos[2] = {_drawCommandBuffers[frame], 0, VK_WHOLE_SIZE};
+    bufferInfos[3] = {_drawCountBuffers[frame], 0, VK_WHOLE_SIZE};
+
+    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+    for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+        descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[binding].dstSet = _meshletDescriptorSets[frame];
+        descriptorWrites[binding].dstBinding = binding;
+        descriptorWrites[binding].dstArrayElement = 0;
+        descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[binding].descriptorCount = 1;
+        descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+    }
+    vkUpdateDescriptorSets(_device->logical(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+bool CullingPass::useMeshlets() const {
+    //a reloaded model may have more meshlets than the draw command buffers were sized for
+    return _meshletCulling && _scene->instanceCount() <= _appConfig->meshletInstanceLimit()
+        && static_cast<VkDeviceSize>(_modelPipeline->meshletCount()) * _scene->instanceCount() <= _maxDrawCount;
+}
+
+void CullingPass::modelReloaded() {
+    //never a scene version, the spheres are transformed again on the next CPU cull
+    _instanceBoundsVersion = UINT64_MAX;
+    if (_meshletCulling) {
+        //the other frame may still be in flight with the previous meshlet buffer, each set is rewritten when its frame is recorded
+        std::fill(_staleMeshletSets.begin(), _staleMeshletSets.end(), true);
+    }
+}
+
+void CullingPass::collectStats(uint32_t currentFrame) {
+    if (!_gpuCulling) {
+        return;
+    }
+    //the fence of this frame has already been waited on, so its counters can be read without stalling
+    CullingCounters counters;
+    memcpy(&counters, _readbackBuffersMapped[currentFrame], sizeof(CullingCounters));
+    _visibleCount = counters.drawCount;
+    _testedCount = _testedCounts[currentFrame];
+    _meshletFrame = _meshletFrames[currentFrame];
+    _frustumCulledCount = _meshletFrame ? counters.frustumCulled : 0;
+    _backfaceCulledCount = _meshletFrame ? counters.backfaceCulled : 0;
+    if (_meshletFrame && _testedCount > 0) {
+        _meshletFramesTotal++;
+        _meshletsTestedTotal += _testedCount;
+        _frustumCulledTotal += _frustumCulledCount;
+        _backfaceCulledTotal += _backfaceCulledCount;
+    }
+}
+
+void CullingPass::printStats() {
+    if (_meshletFramesTotal == 0) {
+        return;
+    }
+    std::cout<<"Meshlets culled: "<<100.0 * (_frustumCulledTotal + _backfaceCulledTotal) / _meshletsTestedTotal<<"% (frustum: "
+             <<100.0 * _frustumCulledTotal / _meshletsTestedTotal<<"%, backface: "
+             <<100.0 * _backfaceCulledTotal / _meshletsTestedTotal<<"%) over "<<_meshletFramesTotal<<" frames"<<std::endl;
+}
+
+void CullingPass::record(VkCommandBuffer commandBuffer, uint32_t currentFrame) {
+    if (!_gpuCulling) {
+        cullOnCpu();
+        return;
+    }
+    vkCmdFillBuffer(commandBuffer, _drawCountBuffers[currentFrame], 0, sizeof(CullingCounters), 0);
+
+    VkMemoryBarrier clearBarrier{};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    Frustum frustum = Frustum::fromViewProjection(_modelPipeline->viewProjection());
+    _meshletFrames[currentFrame] = useMeshlets();
+    if (_staleMeshletSets[currentFrame]) {
+        writeMeshletDescriptorSet(currentFrame);
+        _staleMeshletSets[currentFrame] = false;
+    }
+    if (_meshletFrames[currentFrame]) {
+        MeshletCullingConstants constants{};
+        for (size_t i = 0; i < frustum.planes.size(); i++) {
+            constants.frustumPlanes[i] = frustum.planes[i];
+        }
+        constants.cameraPosition = glm::vec4(_appConfig->observerPosition(), 1.0f);
+        constants.meshletCount = _modelPipeline->meshletCount();
+        constants.instanceCount = _scene->instanceCount();
+        constants.firstIndex = _modelPipeline->firstIndex();
+        constants.vertexOffset = _modelPipeline->vertexOffset();
+        _testedCounts[currentFrame] = constants.meshletCount * constants.instanceCount;
+
+        _meshletCullingPipeline->bind(commandBuffer, _meshletDescriptorSets[currentFrame]);
+        _meshletCullingPipeline->pushConstants(commandBuffer, &constants, sizeof(constants));
+        vkCmdDispatch(commandBuffer, (constants.meshletCount + 63) / 64, constants.instanceCount, 1);
+    } else {
+        CullingConstants constants{};
+        for (size_t i = 0; i < frustum.planes.size(); i++) {
+            constants.frustumPlanes[i] = frustum.planes[i];
+        }
+        constants.boundingSphere = glm::vec4(_modelPipeline->boundingSphere().center, _modelPipeline->boundingSphere().radius);
+        constants.instanceCount = _scene->instanceCount();
+        constants.indexCount = _modelPipeline->indexCount();
+        constants.firstIndex = _modelPipeline->firstIndex();
+        constants.vertexOffset = _modelPipeline->vertexOffset();
+        _testedCounts[currentFrame] = constants.instanceCount;
+
+        _cullingPipeline->bind(commandBuffer, _descriptorSets[currentFrame]);
+        _cullingPipeline->pushConstants(commandBuffer, &constants, sizeof(constants));
+        vkCmdDispatch(commandBuffer, (constants.instanceCount + 63) / 64, 1, 1);
+    }
+
+    //only for the readback, the render graph orders the indirect draws after the culling
+    VkMemoryBarrier cullingBarrier{};
+    cullingBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullingBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullingBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &cullingBarrier, 0, nullptr, 0, nullptr);
+
+    //counters are copied out and read back once this frame's fence signals
+    VkBufferCopy copyRegion{};
+    copyRegion.size = sizeof(CullingCounters);
+    vkCmdCopyBuffer(commandBuffer, _drawCountBuffers[currentFrame], _readbackBuffers[currentFrame], 1, &copyRegion);
+
+    VkMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+}
+
+void CullingPass::updateInstanceBounds() {
+    //world space spheres only change with the scene, not with the camera
+    if (_instanceBoundsVersion == _scene->version()) {
+        return;
+    }
+    const auto& instances = _scene->instances();
+    _instanceBounds.resize(instances.size());
+    for (size_t i = 0; i < instances.size(); i++) {
+        _instanceBounds.set(i, _modelPipeline->boundingSphere().transformed(instances[i].model));
+    }
+    _visibleInstances.resize(instances.size());
+    _instanceBoundsVersion = _scene->version();
+}
+
+void CullingPass::cullOnCpu() {
+    updateInstanceBounds();
+    Frustum frustum = Frustum::fromViewProjection(_modelPipeline->viewProjection());
+    _visibleCount = cullSpheres(frustum, _instanceBounds, _visibleInstances.data(), _cullingKernel);
+    _testedCount = _scene->instanceCount();
+
+    //consecutive visible instances are merged into a single instanced draw
+    _drawRuns.clear();
+    for (uint32_t i = 0; i < _visibleCount; i++) {
+        uint32_t instance = _visibleInstances[i];
+        if (!_drawRuns.empty() && _drawRuns.back().firstInstance + _drawRuns.back().instanceCount == instance) {
+            _drawRuns.back().instanceCount++;
+        } else {
+            _drawRuns.push_back({instance, 1});
+        }
+    }
+}
+
+void CullingPass::draw(VkCommandBuffer commandBuffer, uint32_t currentFrame) {
+    if (_gpuCulling) {
+        uint32_t maxDrawCount = _scene->instanceCount();
+        if (_meshletFrames[currentFrame]) {
+            maxDrawCount *= _modelPipeline->meshletCount();
+        }
+        _device->cmdDrawIndexedIndirectCount(commandBuffer, _drawCommandBuffers[currentFrame], 0, _drawCountBuffers[currentFrame], 0,
+            maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+        return;
+    }
+    for (const auto& run : _drawRuns) {
+        vkCmdDrawIndexed(commandBuffer, _modelPipeline->indexCount(), run.instanceCount, _modelPipeline->firstIndex(), _modelPipeline->vertexOffset(), run.firstInstance);
+    }
+}
+
+}
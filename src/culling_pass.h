@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+#include "compute_pipeline.h"
+#include "frustum.h"
+#include "meshlet.h"
+#include "model_pipeline.h"
+#include "scene.h"
+#include "sphere_culling.h"
+
+namespace vmr {
+// Frustum culling of scene instances. On devices with VK_KHR_draw_indirect_count a compute pre-pass
+// compacts one indirect draw per visible instance, otherwise instances are culled on the CPU
+// with SIMD plane tests over packed instance bounds and drawn as runs of consecutive visible instances.
+// With meshlet culling enabled, small scenes are instead culled per meshlet of every instance (frustum and normal cone),
+// emitting one indirect draw for each visible meshlet.
+class CullingPass {
+private:
+    struct CullingConstants {
+        alignas(16) glm::vec4 frustumPlanes[6];
+        alignas(16) glm::vec4 boundingSphere;
+        uint32_t instanceCount;
+        uint32_t indexCount;
+        uint32_t firstIndex;            // position of the model in the geometry arena
+        int32_t vertexOffset;
+    };
+    struct MeshletCullingConstants {
+        alignas(16) glm::vec4 frustumPlanes[6];
+        alignas(16) glm::vec4 cameraPosition;
+        uint32_t meshletCount;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+    };
+    // Layout of the DrawCountBuffer, drawCount doubles as the count of vkCmdDrawIndexedIndirectCount
+    struct CullingCounters {
+        uint32_t drawCount;
+        uint32_t frustumCulled;
+        uint32_t backfaceCulled;
+        uint32_t padding;
+    };
+    struct DrawRun {
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+
+    Device* _device;
+    AppConfig* _appConfig;
+    Scene* _scene;
+    ModelPipeline* _modelPipeline;
+    bool _gpuCulling;
+    bool _meshletCulling;
+    ComputePipeline* _cullingPipeline = nullptr;
+    ComputePipeline* _meshletCullingPipeline = nullptr;
+    std::vector<VkDescriptorSet> _descriptorSets;
+    std::vector<VkDescriptorSet> _meshletDescriptorSets;
+    std::vector<bool> _meshletFrames;
+    std::vector<bool> _staleMeshletSets;    // per frame, still pointing at the meshlet buffer of a reloaded model
+    VkDeviceSize _maxDrawCount = 0;         // commands each draw command buffer holds
+    std::vector<uint32_t> _testedCounts;
+    std::vector<VkBuffer> _drawCommandBuffers;
+    std::vector<VkDeviceMemory> _drawCommandBuffersMemory;
+    std::vector<VkBuffer> _drawCountBuffers;
+    std::vector<VkDeviceMemory> _drawCountBuffersMemory;
+    std::vector<VkBuffer> _readbackBuffers;
+    std::vector<VkDeviceMemory> _readbackBuffersMemory;
+    std::vector<void *> _readbackBuffersMapped;
+    CullingKernel _cullingKernel;
+    BoundingSphereArray _instanceBounds;
+    uint64_t _instanceBoundsVersion = 0;
+    std::vector<uint32_t> _visibleInstances;
+    std::vector<DrawRun> _drawRuns;
+    uint32_t _visibleCount = 0;
+    uint32_t _testedCount = 0;
+    uint32_t _frustumCulledCount = 0;
+    uint32_t _backfaceCulledCount = 0;
+    bool _meshletFrame = false;
+    uint64_t _meshletFramesTotal = 0;
+    uint64_t _meshletsTestedTotal = 0;
+    uint64_t _frustumCulledTotal = 0;
+    uint64_t _backfaceCulledTotal = 0;
+
+    void createBuffers();
+    void createDescriptorSets();
+    void createMeshletDescriptorSets();
+    void writeMeshletDescriptorSet(size_t frame);
+    bool useMeshlets() const;
+    void updateInstanceBounds();
+    void cullOnCpu();
+
+public:
+    CullingPass(Device* device, AppConfig* appConfig, Scene* scene, ModelPipeline* modelPipeline);
+    ~CullingPass();
+    bool gpuCulling()           const { return _gpuCulling; }
+    uint32_t visibleCount()     const { return _visibleCount; }
+    uint32_t culledCount()      const { return _testedCount - _visibleCount; }
+    // instances drawn by the CPU path in the last recorded frame, the first visibleCount() entries are valid
+    const std::vector<uint32_t>& visibleInstances() const { return _visibleInstances; }
+    // true if the last collected frame was culled per meshlet, the counts are then in meshlets instead of instances
+    bool meshletFrame()             const { return _meshletFrame; }
+    uint32_t frustumCulledCount()   const { return _frustumCulledCount; }
+    uint32_t backfaceCulledCount()  const { return _backfaceCulledCount; }
+
+    // after a hot reload swapped in a new mesh, with its own bounding sphere and meshlet buffer
+    void modelReloaded();
+    void collectStats(uint32_t currentFrame);
+    void printStats();
+    void record(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+    void draw(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+};
+}
@@ -0,0 +1,30 @@
+#include "deletion_queue.h"
+
+namespace vmr {
+
+void DeletionQueue::push(std::function<void()> destroy) {
+    //any frame submitted so far may still use the resource
+    _pending.push_back({_lastSubmittedFrame, std::move(destroy)});
+}
+
+void DeletionQueue::pushAfterRecording(std::function<void()> destroy) {
+    //may land in front of entries of the previous frame, which then only wait one frame longer
+    _pending.push_back({_lastSubmittedFrame + 1, std::move(destroy)});
+}
+
+void DeletionQueue::collect(uint64_t completedFrame) {
+    //entries are pushed in frame order, so the front is always the oldest one
+    while (!_pending.empty() && _pending.front().frame <= completedFrame) {
+        _pending.front().destroy();
+        _pending.pop_front();
+    }
+}
+
+void DeletionQueue::flush() {
+    for (auto& pending : _pending) {
+        pending.destroy();
+    }
+    _pending.clear();
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace vmr {
+// Defers destruction of GPU resources until every frame that may still reference them has finished.
+// Frames are identified by a monotonically increasing number, assigned when they are submitted.
+class DeletionQueue {
+private:
+    struct PendingDeletion {
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+    std::deque<PendingDeletion> _pending;
+    uint64_t _lastSubmittedFrame = 0;
+
+public:
+    size_t size() const { return _pending.size(); }
+
+    void frameSubmitted(uint64_t frameNumber) { _lastSubmittedFrame = frameNumber; }
+    void push(std::function<void()> destroy);
+    // for resources also used by the frame being recorded, which is submitted after the current last one
+    void pushAfterRecording(std::function<void()> destroy);
+    void collect(uint64_t completedFrame);
+    void flush();
+};
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <fstream>
+
 #include "device.h"
 
 #ifdef NDEBUG
@@ -35,15 +38,17 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
     }
 }
 
-Device::Device(GLFWwindow* window){
+Device::Device(GLFWwindow* window, AppConfig* appConfig) : _appConfig(appConfig) {
     createInstance();
     setupDebugMessenger();
     createSurface(window);
     pickPhysicalDevice();
     createLogicalDevice();
+    printCapabilities();
 }
 
 Device::~Device(){
+    _deletionQueue.flush();
     vkDestroyCommandPool(_logicalDevice, _commandPool, nullptr);
     vkDestroyDevice(_logicalDevice, nullptr);
 
@@ -129,16 +134,38 @@ void Device::pickPhysicalDevice() {
     }
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(_instance, &deviceCount, devices.data());
-    for (const auto& device : devices) {
-        if (isDeviceSuitable(device)) {
-            _physicalDevice = device;
-            break;
+
+    _physicalDevice = VK_NULL_HANDLE;
+    int overridden = -1;
+    uint32_t bestScore = 0;
+    std::cout<<"Vulkan devices:\n";
+    for (uint32_t i = 0; i < deviceCount; i++) {
+        DeviceCapabilities capabilities = probeCapabilities(devices[i]);
+        bool suitable = isDeviceSuitable(devices[i]);
+        uint32_t score = suitable ? scoreDevice(capabilities) : 0;
+        std::cout<<"  ["<<i<<"] "<<capabilities.name<<(suitable ? ", score " + std::to_string(score) : ", not suitable")<<"\n";
+        if (!suitable) {
+            continue;
+        }
+        bool requested = static_cast<int>(i) == _appConfig->deviceIndex()
+                         || (!_appConfig->deviceName().empty() && capabilities.name.find(_appConfig->deviceName()) != std::string::npos);
+        if (requested && overridden < 0) {
+            overridden = i;
+            _physicalDevice = devices[i];
+            _capabilities = capabilities;
+        } else if (overridden < 0 && (_physicalDevice == VK_NULL_HANDLE || score > bestScore)) {
+            _physicalDevice = devices[i];
+            _capabilities = capabilities;
+            bestScore = score;
         }
     }
 
     if (_physicalDevice == VK_NULL_HANDLE) {
         throw std::runtime_error("failed to find a suitable GPU!");
     }
+    if (overridden < 0 && (_appConfig->deviceIndex() >= 0 || !_appConfig->deviceName().empty())) {
+        std::cout<<"The device requested in config.json is not available or not suitable, using the highest scoring one\n";
+    }
 }
 
 bool Device::isDeviceSuitable(VkPhysicalDevice device) {
@@ -157,11 +184,160 @@ bool Device::isDeviceSuitable(VkPhysicalDevice device) {
     return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
 }
 
+DeviceCapabilities Device::probeCapabilities(VkPhysicalDevice device) {
+    DeviceCapabilities capabilities;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    capabilities.name = properties.deviceName;
+    capabilities.type = properties.deviceType;
+    capabilities.apiVersion = properties.apiVersion;
+    capabilities.timestamps = properties.limits.timestampComputeAndGraphics;
+    capabilities.timestampPeriod = properties.limits.timestampPeriod;
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            capabilities.deviceLocalMemory = std::max(capabilities.deviceLocalMemory, memoryProperties.memoryHeaps[i].size);
+        }
+    }
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(device, &features);
+    capabilities.multiDrawIndirect = features.multiDrawIndirect && features.drawIndirectFirstInstance;
+    capabilities.drawIndirectCount = capabilities.multiDrawIndirect && isDeviceExtensionSupported(device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    capabilities.pipelineStatistics = features.pipelineStatisticsQuery;
+    capabilities.dynamicImageIndexing = features.shaderSampledImageArrayDynamicIndexing;
+
+    QueueFamilyIndices indices = findQueueFamilies(device);
+    capabilities.asyncCompute = indices.computeFamily.has_value();
+    capabilities.dedicatedTransfer = indices.transferFamily.has_value();
+    if (capabilities.asyncCompute) {
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+        capabilities.computeTimestamps = capabilities.timestamps && queueFamilies[indices.computeFamily.value()].timestampValidBits > 0;
+    }
+
+    if (!_properties2Supported) {
+        return capabilities;
+    }
+    capabilities.memoryBudget = isDeviceExtensionSupported(device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(_instance, "vkGetPhysicalDeviceFeatures2KHR");
+    auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR) vkGetInstanceProcAddr(_instance, "vkGetPhysicalDeviceProperties2KHR");
+    bool timelineExtension = isDeviceExtensionSupported(device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    bool indexingExtension = isDeviceExtensionSupported(device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+                             && isDeviceExtensionSupported(device, VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexingFeatures.pNext = &timelineFeatures;
+    VkPhysicalDeviceFeatures2KHR features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    features2.pNext = &indexingFeatures;
+    getFeatures2(device, &features2);
+    capabilities.timelineSemaphores = timelineExtension && timelineFeatures.timelineSemaphore;
+    capabilities.descriptorIndexing = indexingExtension
+                                      && indexingFeatures.shaderSampledImageArrayNonUniformIndexing
+                                      && indexingFeatures.descriptorBindingPartiallyBound
+                                      && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+                                      && indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+    if (capabilities.descriptorIndexing) {
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2KHR properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+        properties2.pNext = &indexingProperties;
+        getProperties2(device, &properties2);
+        //the heap's array holds combined image samplers, which count against the sampler limits as well
+        capabilities.maxBindlessImages = std::min({indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                                                   indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                                   indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                                                   indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers});
+    }
+    return capabilities;
+}
+
+//discrete GPUs first, then whichever device offers more of the fast paths and more memory
+uint32_t Device::scoreDevice(const DeviceCapabilities& capabilities) {
+    uint32_t score = 1;
+    switch (capabilities.type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 10000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 5000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 2000; break;
+        default: break;
+    }
+    score += capabilities.drawIndirectCount ? 400 : 0;
+    score += capabilities.asyncCompute ? 300 : 0;
+    score += capabilities.descriptorIndexing ? 200 : 0;
+    score += capabilities.timelineSemaphores ? 100 : 0;
+    score += capabilities.dedicatedTransfer ? 100 : 0;
+    score += static_cast<uint32_t>(std::min<VkDeviceSize>(capabilities.deviceLocalMemory >> 28, 255));   // per 256 MB
+    return score;
+}
+
+void Device::printCapabilities() {
+    const char* types[] = {"other", "integrated GPU", "discrete GPU", "virtual GPU", "CPU"};
+    auto yesNo = [](bool supported) { return supported ? "yes" : "no"; };
+    const DeviceCapabilities& c = _capabilities;
+    std::cout<<"Using "<<c.name<<" ("<<types[std::min<uint32_t>(c.type, 4)]<<", Vulkan "<<VK_VERSION_MAJOR(c.apiVersion)<<"."
+             <<VK_VERSION_MINOR(c.apiVersion)<<"."<<VK_VERSION_PATCH(c.apiVersion)<<", "<<(c.deviceLocalMemory >> 20)<<" MB device local)\n"
+             <<"  draw indirect count: "<<yesNo(c.drawIndirectCount)<<", pipeline statistics: "<<yesNo(c.pipelineStatistics)
+             <<", timestamps: "<<yesNo(c.timestamps)<<"\n"
+             <<"  timeline semaphores: "<<yesNo(c.timelineSemaphores)<<", descriptor indexing: "<<yesNo(c.descriptorIndexing);
+    if (c.descriptorIndexing) {
+        std::cout<<" (up to "<<c.maxBindlessImages<<" images)";
+    }
+    std::cout<<"\n  async compute queue: "<<yesNo(c.asyncCompute);
+    if (c.asyncCompute) {
+        std::cout<<" (timestamps: "<<yesNo(c.computeTimestamps)<<")";
+    }
+    std::cout<<", dedicated transfer queue: "<<yesNo(c.dedicatedTransfer)
+             <<", memory budget: "<<yesNo(c.memoryBudget)<<"\n";
+
+    std::vector<VkDeviceSize> budgets, usages;
+    memoryBudget(budgets, usages);
+    for (size_t heap = 0; heap < budgets.size(); heap++) {
+        std::cout<<"  heap "<<heap<<": "<<(usages[heap] >> 20)<<" of "<<(budgets[heap] >> 20)<<" MB used\n";
+    }
+    std::cout<<std::flush;
+}
+
+void Device::memoryBudget(std::vector<VkDeviceSize>& budgets, std::vector<VkDeviceSize>& usages) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2KHR memoryProperties2{};
+    memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+    if (_capabilities.memoryBudget) {
+        memoryProperties2.pNext = &budgetProperties;
+        auto getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR) vkGetInstanceProcAddr(_instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+        getMemoryProperties2(_physicalDevice, &memoryProperties2);
+    } else {
+        vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &memoryProperties2.memoryProperties);
+    }
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = memoryProperties2.memoryProperties;
+    budgets.resize(memoryProperties.memoryHeapCount);
+    usages.resize(memoryProperties.memoryHeapCount);
+    for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+        budgets[heap] = _capabilities.memoryBudget ? budgetProperties.heapBudget[heap] : memoryProperties.memoryHeaps[heap].size;
+        usages[heap] = _capabilities.memoryBudget ? budgetProperties.heapUsage[heap] : 0;
+    }
+}
+
 void Device::createLogicalDevice() {
     QueueFamilyIndices indices = findQueueFamilies(_physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    if (indices.computeFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.computeFamily.value());
+    }
+    if (indices.transferFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
         VkDeviceQueueCreateInfo queueCreateInfo{};
@@ -173,16 +349,60 @@ void Device::createLogicalDevice() {
     }
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    //optional, needed by GPU-driven culling which issues one indirect draw per visible instance
+    deviceFeatures.multiDrawIndirect = _capabilities.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = _capabilities.multiDrawIndirect;
+    //optional, fragment shader invocation counts are only reported where available
+    deviceFeatures.pipelineStatisticsQuery = _capabilities.pipelineStatistics;
+    //the model textures are picked from an array by the material index
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = _capabilities.dynamicImageIndexing;
+
+    std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    if (_capabilities.drawIndirectCount) {
+        enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+    if (_capabilities.memoryBudget) {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    //the extension features are chained behind VkPhysicalDeviceFeatures2, which then replaces pEnabledFeatures
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2KHR features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+    features2.features = deviceFeatures;
+    void** next = &features2.pNext;
+    if (_capabilities.timelineSemaphores) {
+        enabledExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+        *next = &timelineFeatures;
+        next = &timelineFeatures.pNext;
+    }
+    if (_capabilities.descriptorIndexing) {
+        enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        *next = &indexingFeatures;
+        next = &indexingFeatures.pNext;
+    }
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
-    createInfo.pEnabledFeatures = &deviceFeatures;
+    if (_properties2Supported) {
+        createInfo.pNext = &features2;
+    } else {
+        createInfo.pEnabledFeatures = &deviceFeatures;
+    }
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (enableValidationLayers) { 
         //these 2 are ignored in newer implementations, because instance and device specific validation layers are no longer distinguished
@@ -196,6 +416,18 @@ void Device::createLogicalDevice() {
     }
     vkGetDeviceQueue(_logicalDevice, indices.graphicsFamily.value(), 0, &_graphicsQueue);
     vkGetDeviceQueue(_logicalDevice, indices.presentFamily.value(), 0, &_presentQueue);
+    if (indices.computeFamily.has_value()) {
+        vkGetDeviceQueue(_logicalDevice, indices.computeFamily.value(), 0, &_computeQueue);
+        _sharedQueueFamilies = {indices.graphicsFamily.value(), indices.computeFamily.value()};
+    }
+    if (indices.transferFamily.has_value()) {
+        vkGetDeviceQueue(_logicalDevice, indices.transferFamily.value(), 0, &_transferQueue);
+    }
+
+    if (_capabilities.drawIndirectCount) {
+        _cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(_logicalDevice, "vkCmdDrawIndexedIndirectCountKHR");
+        _capabilities.drawIndirectCount = _cmdDrawIndexedIndirectCount != nullptr;
+    }
 }
 
 
@@ -207,6 +439,20 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device) {
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+    //dedicated compute families are looked up separately, the loop below stops at the first complete pair
+    for (uint32_t family = 0; family < queueFamilyCount; family++) {
+        if ((queueFamilies[family].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilies[family].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            indices.computeFamily = family;
+            break;
+        }
+    }
+    for (uint32_t family = 0; family < queueFamilyCount; family++) {
+        if ((queueFamilies[family].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[family].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = family;
+            break;
+        }
+    }
+
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
         if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
@@ -242,6 +488,21 @@ bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 }
 
 
+bool Device::isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 SwapChainSupportDetails Device::querySwapChainSupport(VkPhysicalDevice device) {
     SwapChainSupportDetails details;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, _surface, &details.capabilities);
@@ -289,6 +550,21 @@ bool Device::checkValidationLayerSupport() {
 
 }
 
+bool Device::isInstanceExtensionSupported(const char* extensionName) {
+    uint32_t extensionCount;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& extension : availableExtensions) {
+        if (strcmp(extension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 std::vector<const char*> Device::getRequiredExtensions() {
     uint32_t glfwExtensionCount = 0;
     const char** glfwExtensions;
@@ -299,6 +575,11 @@ std::vector<const char*> Device::getRequiredExtensions() {
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
+    //the instance is Vulkan 1.0, features of the optional device extensions can only be probed through this one
+    _properties2Supported = isInstanceExtensionSupported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    if (_properties2Supported) {
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    }
     return extensions;
 }
 
@@ -325,6 +606,26 @@ VkFormat Device::findDepthFormat() {
     );
 }
 
+VkShaderModule Device::loadShaderModule(const std::string& path) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + path);
+    }
+    std::vector<char> code((size_t) file.tellg());
+    file.seekg(0);
+    file.read(code.data(), code.size());
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(_logicalDevice, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+    return shaderModule;
+}
+
 void Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -363,6 +664,17 @@ uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags prope
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
+bool Device::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
@@ -406,6 +718,10 @@ void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
     vkFreeCommandBuffers(_logicalDevice, _commandPool, 1, &commandBuffer);
 }
 
+void Device::cmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride) {
+    _cmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+}
+
 VKAPI_ATTR VkBool32 VKAPI_CALL Device::debugCallback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
     VkDebugUtilsMessageTypeFlagsEXT messageType,
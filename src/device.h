@@ -3,7 +3,6 @@
 #define GLFW_INCLUDE_VULKAN
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
 
 #include <glm/glm.hpp>
@@ -16,12 +15,19 @@
 #include <stdexcept>
 #include <optional>
 #include <set>
+#include <string>
+#include <vector>
+
+#include "app_config.h"
+#include "deletion_queue.h"
 
 
 namespace vmr {
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> computeFamily; // compute without graphics, work submitted there runs alongside the graphics queue
+    std::optional<uint32_t> transferFamily; // transfer only, usually backed by a copy engine
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -34,9 +40,32 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// What the picked device supports beyond the required core, probed once so every subsystem can choose its fastest
+// supported path. Features listed here are also enabled on the logical device.
+struct DeviceCapabilities {
+    std::string name;
+    VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+    uint32_t apiVersion = 0;
+    VkDeviceSize deviceLocalMemory = 0;     // largest device local heap
+    bool multiDrawIndirect = false;
+    bool drawIndirectCount = false;
+    bool pipelineStatistics = false;
+    bool dynamicImageIndexing = false;      // sampled image arrays indexed by dynamically uniform values
+    bool timestamps = false;                // on the graphics and compute queues
+    bool computeTimestamps = false;         // on the async compute queue, its family reports valid timestamp bits
+    float timestampPeriod = 0.0f;           // nanoseconds per tick
+    bool timelineSemaphores = false;
+    // sampled image arrays indexed non-uniformly, partially bound and updated after binding, also while in use
+    bool descriptorIndexing = false;
+    uint32_t maxBindlessImages = 0;         // combined image samplers in one update-after-bind array
+    bool memoryBudget = false;
+    bool asyncCompute = false;              // a compute family without graphics
+    bool dedicatedTransfer = false;         // a transfer family without graphics or compute
+};
 
 class Device {
 private:
+    AppConfig* _appConfig;
     VkInstance _instance;
     VkDebugUtilsMessengerEXT _debugMessenger;
     VkPhysicalDevice _physicalDevice;
@@ -44,7 +73,14 @@ private:
     VkSurfaceKHR _surface;
     VkQueue _graphicsQueue;
     VkQueue _presentQueue;
+    VkQueue _computeQueue = VK_NULL_HANDLE;
+    VkQueue _transferQueue = VK_NULL_HANDLE;
+    std::vector<uint32_t> _sharedQueueFamilies;
     VkCommandPool _commandPool;
+    DeletionQueue _deletionQueue;
+    DeviceCapabilities _capabilities;
+    bool _properties2Supported = false;     // VK_KHR_get_physical_device_properties2, needed to probe extension features
+    PFN_vkCmdDrawIndexedIndirectCountKHR _cmdDrawIndexedIndirectCount = nullptr;
 
 
     void createInstance();
@@ -54,9 +90,14 @@ private:
     void createSurface(GLFWwindow* window);
     void pickPhysicalDevice();
     bool isDeviceSuitable(VkPhysicalDevice device);
+    DeviceCapabilities probeCapabilities(VkPhysicalDevice device);
+    uint32_t scoreDevice(const DeviceCapabilities& capabilities);
+    void printCapabilities();
     void createLogicalDevice();
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
     bool checkValidationLayerSupport();
+    bool isInstanceExtensionSupported(const char* extensionName);
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -65,22 +106,38 @@ private:
         void* pUserData);
 
 public:
-    Device(GLFWwindow* window); 
+    Device(GLFWwindow* window, AppConfig* appConfig);
     ~Device();
     VkDevice&               logical()           {return _logicalDevice; }
     VkPhysicalDevice&       physical()          {return _physicalDevice; }
     VkSurfaceKHR&           surface()           {return _surface; }
     VkQueue&                graphicsQueue()     {return _graphicsQueue; }
     VkQueue&                presentQueue()      {return _presentQueue; }
+    VkQueue&                computeQueue()      {return _computeQueue; }
+    // only created where the device has a transfer-only family, VK_NULL_HANDLE otherwise
+    VkQueue&                transferQueue()     {return _transferQueue; }
+    bool                    asyncComputeSupported() const {return _capabilities.asyncCompute; }
+    // graphics and async compute family, for resources used concurrently by both queues
+    const std::vector<uint32_t>& sharedQueueFamilies() const {return _sharedQueueFamilies; }
     VkCommandPool&          commandPool()       {return _commandPool; }
+    DeletionQueue&          deletionQueue()     {return _deletionQueue; }
+    const DeviceCapabilities& capabilities()    const {return _capabilities; }
+    bool                    drawIndirectCountSupported() const {return _capabilities.drawIndirectCount; }
+    bool                    pipelineStatisticsSupported() const {return _capabilities.pipelineStatistics; }
 
     VkFormat findDepthFormat();
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+    // module of a SPIR-V file, destroyed by the caller once its pipelines are created
+    VkShaderModule loadShaderModule(const std::string& path);
+    // budget and usage of every memory heap in bytes, the heap sizes and no usage without VK_EXT_memory_budget
+    void memoryBudget(std::vector<VkDeviceSize>& budgets, std::vector<VkDeviceSize>& usages);
+    void cmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride);
 };
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "disk_cache.h"
+
+namespace vmr {
+
+const char CACHE_MAGIC[4] = {'V', 'M', 'R', 'C'};
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t padding;
+    uint64_t key;
+    uint64_t size;
+};
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+DiskCache::DiskCache(std::string directory) : _directory(std::move(directory)) {}
+
+std::string DiskCache::entryPath(const std::string& name, uint64_t key) const {
+    std::ostringstream path;
+    path<<_directory<<"/"<<name<<"_"<<std::hex<<std::setw(16)<<std::setfill('0')<<key<<".bin";
+    return path.str();
+}
+
+bool DiskCache::load(const std::string& name, uint64_t key, std::vector<char>& data) const {
+    std::ifstream file(entryPath(name, key), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    CacheHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    //the key is repeated in the file, so a truncated or foreign file is never mistaken for a valid entry
+    if (!file || memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.key != key) {
+        return false;
+    }
+    //a corrupted size is a miss rather than a huge allocation
+    std::streampos dataStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff remaining = file.tellg() - dataStart;
+    if (!file || header.size > static_cast<uint64_t>(remaining)) {
+        return false;
+    }
+    file.seekg(dataStart);
+    data.resize(header.size);
+    file.read(data.data(), header.size);
+    return static_cast<bool>(file);
+}
+
+void DiskCache::store(const std::string& name, uint64_t key, const void* data, size_t size) const {
+    std::error_code error;
+    std::filesystem::create_directories(_directory, error);
+    std::string path = entryPath(name, key);
+    std::ofstream file(path, std::ios::binary);
+    if (error || !file) {
+        std::cerr<<"failed to write cache entry "<<path<<"!"<<std::endl;
+        return;
+    }
+    CacheHeader header{};
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.key = key;
+    header.size = size;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(static_cast<const char*>(data), size);
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vmr {
+// Results of expensive startup work stored as files in one directory. Every entry is keyed by a hash
+// of everything that affects its content, so changing a parameter simply misses the cache.
+class DiskCache {
+private:
+    std::string _directory;
+
+    std::string entryPath(const std::string& name, uint64_t key) const;
+
+public:
+    DiskCache(std::string directory);
+
+    bool load(const std::string& name, uint64_t key, std::vector<char>& data) const;
+    // a failure to write is reported but not fatal, the result is then recomputed on the next start
+    void store(const std::string& name, uint64_t key, const void* data, size_t size) const;
+};
+
+// FNV-1a, chained through the seed to combine several values into one key
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+}
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "dynamic_resolution.h"
+#include "fullscreen_pipeline.h"
+
+namespace vmr {
+
+// frame times this close to the budget leave the scale alone, so measurement noise does not change the resolution
+const float FRAME_TIME_TOLERANCE = 0.05f;
+// fraction of the way to the estimated scale taken per frame, results arrive a few frames late
+const float SCALE_DAMPING = 0.25f;
+const float SCALE_GRANULARITY = 0.01f;
+
+// matches the push constant block of upscale.frag
+struct UpscalePushConstants {
+    glm::vec2 sourceScale;
+    glm::vec2 texelSize;
+    glm::vec2 outputSize;
+    float sharpness;
+};
+
+DynamicResolution::DynamicResolution(Device* device, AppConfig* appConfig, SwapChain* swapChain)
+            : _device(device), _appConfig(appConfig), _swapChain(swapChain) {
+    _scale = _appConfig->maxRenderScale();
+    _minUsedScale = _scale;
+    _maxUsedScale = _scale;
+    _swapChain->setRenderScale(_scale);
+    createSampler();
+    createRenderPass();
+    createDescriptorSetLayout();
+    createPipeline();
+    createFramebuffers();
+    createDescriptorSets();
+}
+
+DynamicResolution::~DynamicResolution() {
+    destroyTargets();
+    vkDestroyPipeline(_device->logical(), _pipeline, nullptr);
+    vkDestroyPipelineLayout(_device->logical(), _pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device->logical(), _descriptorSetLayout, nullptr);
+    vkDestroyRenderPass(_device->logical(), _renderPass, nullptr);
+    vkDestroySampler(_device->logical(), _sampler, nullptr);
+}
+
+void DynamicResolution::createSampler() {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(_device->logical(), &samplerInfo, nullptr, &_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale sampler!");
+    }
+}
+
+void DynamicResolution::createRenderPass() {
+    //every pixel of the swap chain image is written, its previous contents are not needed
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = _swapChain->imageFormat();
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    //waits for the scene color and for the swap chain image being acquired
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+
+    if (vkCreateRenderPass(_device->logical(), &renderPassInfo, nullptr, &_renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale render pass!");
+    }
+}
+
+void DynamicResolution::createDescriptorSetLayout() {
+    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+    samplerLayoutBinding.binding = 0;
+    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerLayoutBinding.pImmutableSamplers = nullptr;
+    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &samplerLayoutBinding;
+
+    if (vkCreateDescriptorSetLayout(_device->logical(), &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale descriptor set layout!");
+    }
+}
+
+void DynamicResolution::createPipeline() {
+    _pipelineLayout = createFullscreenPipelineLayout(_device, _descriptorSetLayout, sizeof(UpscalePushConstants));
+    _pipeline = createFullscreenPipeline(_device, _appConfig->fullscreenVertexShaderPath(), _appConfig->upscaleFragmentShaderPath(), _pipelineLayout, _renderPass, 0);
+}
+
+void DynamicResolution::createFramebuffers() {
+    _framebuffers.resize(_swapChain->imageViews().size());
+    for (size_t i = 0; i < _framebuffers.size(); i++) {
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = _renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &_swapChain->imageViews()[i];
+        framebufferInfo.width = _swapChain->extent().width;
+        framebufferInfo.height = _swapChain->extent().height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(_device->logical(), &framebufferInfo, nullptr, &_framebuffers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upscale framebuffer!");
+        }
+    }
+}
+
+void DynamicResolution::createDescriptorSets() {
+    uint32_t imageCount = static_cast<uint32_t>(_swapChain->imageViews().size());
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = imageCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = imageCount;
+
+    if (vkCreateDescriptorPool(_device->logical(), &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upscale descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, _descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    _descriptorSets.resize(imageCount);
+    if (vkAllocateDescriptorSets(_device->logical(), &allocInfo, _descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upscale descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        VkDescriptorImageInfo imageInfo{_sampler, _swapChain->sceneColorImageViews()[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = _descriptorSets[i];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(_device->logical(), 1, &descriptorWrite, 0, nullptr);
+    }
+}
+
+void DynamicResolution::destroyTargets() {
+    vkDestroyDescriptorPool(_device->logical(), _descriptorPool, nullptr);
+    for (auto framebuffer : _framebuffers) {
+        vkDestroyFramebuffer(_device->logical(), framebuffer, nullptr);
+    }
+}
+
+void DynamicResolution::recreate() {
+    //frames in flight keep using the old framebuffers, which are destroyed once their fences signal
+    _device->deletionQueue().push([device = _device->logical(), descriptorPool = _descriptorPool, framebuffers = _framebuffers]() {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        for (auto framebuffer : framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+    });
+    createFramebuffers();
+    createDescriptorSets();
+}
+
+void DynamicResolution::update(double gpuFrameMs) {
+    if (gpuFrameMs > 0.0 && std::abs(gpuFrameMs - _appConfig->targetFrameMs()) > FRAME_TIME_TOLERANCE * _appConfig->targetFrameMs()) {
+        //the GPU time grows roughly with the pixel count, i.e. with the square of the scale
+        float estimate = _scale * static_cast<float>(std::sqrt(_appConfig->targetFrameMs() / gpuFrameMs));
+        estimate = std::clamp(estimate, _appConfig->minRenderScale(), _appConfig->maxRenderScale());
+        float scale = std::round((_scale + (estimate - _scale) * SCALE_DAMPING) / SCALE_GRANULARITY) * SCALE_GRANULARITY;
+        scale = std::clamp(scale, _appConfig->minRenderScale(), _appConfig->maxRenderScale());
+        if (scale != _scale) {
+            _scale = scale;
+            _scaleChanges++;
+            _swapChain->setRenderScale(_scale);
+        }
+    }
+    _frames++;
+    _scaleTotal += _scale;
+    _minUsedScale = std::min(_minUsedScale, _scale);
+    _maxUsedScale = std::max(_maxUsedScale, _scale);
+}
+
+void DynamicResolution::recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    VkExtent2D extent = _swapChain->extent();
+    VkExtent2D renderExtent = _swapChain->renderExtent();
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _renderPass;
+    renderPassInfo.framebuffer = _framebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = extent;
+    renderPassInfo.clearValueCount = 0;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    UpscalePushConstants pushConstants{};
+    pushConstants.sourceScale = glm::vec2(renderExtent.width / (float) extent.width, renderExtent.height / (float) extent.height);
+    pushConstants.texelSize = glm::vec2(1.0f / extent.width, 1.0f / extent.height);
+    pushConstants.outputSize = glm::vec2(extent.width, extent.height);
+    //nothing to restore at full resolution
+    pushConstants.sharpness = _scale < 1.0f ? _appConfig->upscaleSharpness() : 0.0f;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSets[imageIndex], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void DynamicResolution::printStats() {
+    if (_frames == 0) {
+        return;
+    }
+    std::cout<<"Render scale for a "<<_appConfig->targetFrameMs()<<" ms GPU frame budget: avg "<<_scaleTotal / _frames
+             <<", min "<<_minUsedScale<<", max "<<_maxUsedScale<<", changed "<<_scaleChanges<<" time(s)"<<std::endl;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+#include "device.h"
+#include "swap_chain.h"
+
+namespace vmr {
+// Dynamic resolution. The scene is rendered into the top-left part of full size offscreen targets, scaled by a
+// controller that follows the measured GPU frame time toward a budget, and an upscale pass stretches and sharpens
+// that part onto the swap chain image.
+class DynamicResolution {
+private:
+    Device* _device;
+    AppConfig* _appConfig;
+    SwapChain* _swapChain;
+    VkSampler _sampler;
+    VkRenderPass _renderPass;
+    VkDescriptorSetLayout _descriptorSetLayout;
+    VkPipelineLayout _pipelineLayout;
+    VkPipeline _pipeline;
+    float _scale;
+    uint64_t _frames = 0;
+    double _scaleTotal = 0.0;
+    float _minUsedScale;
+    float _maxUsedScale;
+    uint64_t _scaleChanges = 0;
+
+    // recreated together with the swap chain
+    std::vector<VkFramebuffer> _framebuffers;
+    VkDescriptorPool _descriptorPool;
+    std::vector<VkDescriptorSet> _descriptorSets;
+
+    void createSampler();
+    void createRenderPass();
+    void createDescriptorSetLayout();
+    void createPipeline();
+    void createFramebuffers();
+    void createDescriptorSets();
+    void destroyTargets();
+
+public:
+    DynamicResolution(Device* device, AppConfig* appConfig, SwapChain* swapChain);
+    ~DynamicResolution();
+    float scale()                               const { return _scale; }
+
+    // moves the render scale toward the frame time budget, called with the GPU time of a completed frame
+    void update(double gpuFrameMs);
+    void recreate();
+    // render pass on the swap chain image, leaves it ready for presentation
+    void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void printStats();
+};
+}
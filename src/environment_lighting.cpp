@@ -0,0 +1,519 @@
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "compute_pipeline.h"
+#include "disk_cache.h"
+#include "environment_lighting.h"
+
+namespace vmr {
+
+// bumped whenever one of the prefilter shaders changes its output, so stale cache entries are not reused
+const uint32_t IBL_VERSION = 1;
+const VkFormat LIGHTING_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+const VkDeviceSize LIGHTING_TEXEL_SIZE = 8;
+// mip levels of the specular cube, roughness goes from 0 at the first to 1 at the last one
+const uint32_t MAX_SPECULAR_MIP_LEVELS = 6;
+const uint32_t CUBE_FACES = 6;
+
+struct EnvironmentKey {
+    uint32_t version;
+    uint32_t specularSize;
+    uint32_t specularMipLevels;
+    uint32_t specularSamples;
+    uint32_t irradianceSize;
+    uint32_t irradianceSamples;
+};
+
+//out of range values are clamped to the largest finite half, NaNs become 0, so a broken texel cannot spread through the prefilter
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t floatExponent = (bits >> 23) & 0xff;
+    if (floatExponent == 0xff) {
+        return (bits & 0x7fffff) != 0 ? 0 : static_cast<uint16_t>(sign | 0x7bff);
+    }
+    int32_t exponent = static_cast<int32_t>(floatExponent) - 127 + 15;
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7bff);
+    }
+    if (exponent <= 0) {
+        return sign;
+    }
+    return static_cast<uint16_t>(sign | (exponent << 10) | ((bits & 0x7fffff) >> 13));
+}
+
+static void transitionLayout(VkCommandBuffer commandBuffer, VkImage image, uint32_t mipLevels, uint32_t layers, VkImageLayout oldLayout, VkImageLayout newLayout,
+                             VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, layers};
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+EnvironmentLighting::EnvironmentLighting(Device* device, AppConfig* appConfig) : _device(device), _appConfig(appConfig) {
+    auto start = std::chrono::high_resolution_clock::now();
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    uint32_t specularSize = _appConfig->iblSpecularResolution();
+    uint32_t specularMipLevels = std::min(MAX_SPECULAR_MIP_LEVELS, static_cast<uint32_t>(std::floor(std::log2(specularSize))) + 1);
+    createLightingImage(_specular, specularSize, specularSize, specularMipLevels, CUBE_FACES, usage);
+    createLightingImage(_irradiance, _appConfig->iblIrradianceResolution(), _appConfig->iblIrradianceResolution(), 1, CUBE_FACES, usage);
+    createLightingImage(_brdfLut, _appConfig->iblBrdfLutResolution(), _appConfig->iblBrdfLutResolution(), 1, 1, usage);
+    _specular.view = createView(_specular, VK_IMAGE_VIEW_TYPE_CUBE, 0, _specular.mipLevels);
+    _irradiance.view = createView(_irradiance, VK_IMAGE_VIEW_TYPE_CUBE, 0, 1);
+    _brdfLut.view = createView(_brdfLut, VK_IMAGE_VIEW_TYPE_2D, 0, 1);
+    createSampler(_sampler, static_cast<float>(_specular.mipLevels), VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+
+    //the environment entries are keyed by the file content, so replacing the file under the same name is detected
+    std::vector<char> fileData;
+    std::ifstream file(_appConfig->environmentMapPath(), std::ios::ate | std::ios::binary);
+    if (file) {
+        fileData.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(fileData.data(), fileData.size());
+    }
+    EnvironmentKey environmentParameters{IBL_VERSION, specularSize, specularMipLevels, _appConfig->iblSpecularSamples(),
+                                         _irradiance.width, _appConfig->iblIrradianceSamples()};
+    uint64_t environmentKey = hashBytes(&environmentParameters, sizeof(environmentParameters), hashBytes(fileData.data(), fileData.size()));
+    BrdfLutConstants brdfParameters{_brdfLut.width, _appConfig->iblBrdfLutSamples()};
+    uint64_t brdfKey = hashBytes(&brdfParameters, sizeof(brdfParameters), hashBytes(&IBL_VERSION, sizeof(IBL_VERSION)));
+
+    DiskCache cache(_appConfig->cacheDirectory());
+    VkDeviceSize specularBytes, irradianceBytes, brdfBytes;
+    copyRegions(_specular, specularBytes);
+    copyRegions(_irradiance, irradianceBytes);
+    copyRegions(_brdfLut, brdfBytes);
+    std::vector<char> specularData, irradianceData, brdfData;
+    bool environmentCached = cache.load("ibl_specular", environmentKey, specularData) && specularData.size() == specularBytes
+                          && cache.load("ibl_irradiance", environmentKey, irradianceData) && irradianceData.size() == irradianceBytes;
+    bool brdfCached = cache.load("brdf_lut", brdfKey, brdfData) && brdfData.size() == brdfBytes;
+
+    if (environmentCached) {
+        upload(_specular, specularData);
+        upload(_irradiance, irradianceData);
+    } else {
+        loadEnvironment(fileData);
+    }
+    if (brdfCached) {
+        upload(_brdfLut, brdfData);
+    }
+    if (!environmentCached || !brdfCached) {
+        generate(!environmentCached, !brdfCached);
+    }
+    if (!environmentCached) {
+        specularData = readback(_specular);
+        irradianceData = readback(_irradiance);
+        cache.store("ibl_specular", environmentKey, specularData.data(), specularData.size());
+        cache.store("ibl_irradiance", environmentKey, irradianceData.data(), irradianceData.size());
+        destroyLightingImage(_environment);
+        vkDestroySampler(_device->logical(), _environmentSampler, nullptr);
+        _environmentSampler = VK_NULL_HANDLE;
+    }
+    if (!brdfCached) {
+        brdfData = readback(_brdfLut);
+        cache.store("brdf_lut", brdfKey, brdfData.data(), brdfData.size());
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout<<"Environment lighting: "<<(environmentCached ? "prefiltered maps loaded from cache" : "environment prefiltered")
+             <<", BRDF LUT "<<(brdfCached ? "loaded from cache" : "integrated")<<" in "
+             <<std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count()<<" ms\n";
+}
+
+EnvironmentLighting::~EnvironmentLighting() {
+    vkDestroySampler(_device->logical(), _sampler, nullptr);
+    destroyLightingImage(_specular);
+    destroyLightingImage(_irradiance);
+    destroyLightingImage(_brdfLut);
+}
+
+void EnvironmentLighting::createLightingImage(LightingImage& target, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layers, VkImageUsageFlags usage) {
+    target.width = width;
+    target.height = height;
+    target.mipLevels = mipLevels;
+    target.layers = layers;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.flags = layers == CUBE_FACES ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = layers;
+    imageInfo.format = LIGHTING_FORMAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(_device->logical(), &imageInfo, nullptr, &target.image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create environment lighting image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(_device->logical(), target.image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = _device->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(_device->logical(), &allocInfo, nullptr, &target.memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate environment lighting memory!");
+    }
+    vkBindImageMemory(_device->logical(), target.image, target.memory, 0);
+}
+
+VkImageView EnvironmentLighting::createView(const LightingImage& target, VkImageViewType viewType, uint32_t baseMipLevel, uint32_t levelCount) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = target.image;
+    viewInfo.viewType = viewType;
+    viewInfo.format = LIGHTING_FORMAT;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, levelCount, 0, target.layers};
+
+    VkImageView view;
+    if (vkCreateImageView(_device->logical(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create environment lighting image view!");
+    }
+    return view;
+}
+
+void EnvironmentLighting::destroyLightingImage(LightingImage& target) {
+    vkDestroyImageView(_device->logical(), target.view, nullptr);
+    vkDestroyImage(_device->logical(), target.image, nullptr);
+    vkFreeMemory(_device->logical(), target.memory, nullptr);
+    target = LightingImage{};
+}
+
+void EnvironmentLighting::createSampler(VkSampler& sampler, float maxLod, VkSamplerAddressMode addressModeU) {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = addressModeU;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = maxLod;
+
+    if (vkCreateSampler(_device->logical(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create environment lighting sampler!");
+    }
+}
+
+//all mip levels one after another, every level holding all of its layers
+std::vector<VkBufferImageCopy> EnvironmentLighting::copyRegions(const LightingImage& target, VkDeviceSize& totalSize) {
+    std::vector<VkBufferImageCopy> regions(target.mipLevels);
+    totalSize = 0;
+    for (uint32_t level = 0; level < target.mipLevels; level++) {
+        uint32_t width = std::max(1u, target.width >> level);
+        uint32_t height = std::max(1u, target.height >> level);
+        regions[level] = {};
+        regions[level].bufferOffset = totalSize;
+        regions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, target.layers};
+        regions[level].imageExtent = {width, height, 1};
+        totalSize += static_cast<VkDeviceSize>(width) * height * target.layers * LIGHTING_TEXEL_SIZE;
+    }
+    return regions;
+}
+
+void EnvironmentLighting::loadEnvironment(const std::vector<char>& fileData) {
+    int width = 0, height = 0, channels = 0;
+    float* pixels = fileData.empty() ? nullptr : stbi_loadf_from_memory(reinterpret_cast<const stbi_uc*>(fileData.data()),
+                                                                         static_cast<int>(fileData.size()), &width, &height, &channels, STBI_rgb_alpha);
+    std::vector<float> sky;
+    if (!pixels) {
+        //a plain sky over a darker ground, so lighting still works without an environment map
+        std::cout<<"Environment map "<<_appConfig->environmentMapPath()<<" could not be loaded, using a procedural sky\n";
+        width = 128;
+        height = 64;
+        sky.resize(static_cast<size_t>(width) * height * 4);
+        for (int y = 0; y < height; y++) {
+            float elevation = 1.0f - 2.0f * (y + 0.5f) / height;
+            for (int x = 0; x < width; x++) {
+                float* texel = &sky[(static_cast<size_t>(y) * width + x) * 4];
+                if (elevation > 0.0f) {
+                    texel[0] = 0.6f + 0.4f * (1.0f - elevation);
+                    texel[1] = 0.75f + 0.25f * (1.0f - elevation);
+                    texel[2] = 1.0f;
+                } else {
+                    texel[0] = 0.25f;
+                    texel[1] = 0.22f;
+                    texel[2] = 0.2f;
+                }
+                texel[3] = 1.0f;
+            }
+        }
+    }
+    const float* source = pixels ? pixels : sky.data();
+    std::vector<uint16_t> halfPixels(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < halfPixels.size(); i++) {
+        halfPixels[i] = floatToHalf(source[i]);
+    }
+    if (pixels) {
+        stbi_image_free(pixels);
+    }
+
+    //full mip chain, the prefilter reads coarser levels for wider lobes
+    uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    createLightingImage(_environment, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels, 1,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    _environment.view = createView(_environment, VK_IMAGE_VIEW_TYPE_2D, 0, mipLevels);
+    createSampler(_environmentSampler, static_cast<float>(mipLevels), VK_SAMPLER_ADDRESS_MODE_REPEAT);
+
+    VkDeviceSize imageSize = halfPixels.size() * sizeof(uint16_t);
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    _device->createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    void* data;
+    vkMapMemory(_device->logical(), stagingBufferMemory, 0, imageSize, 0, &data);
+    memcpy(data, halfPixels.data(), static_cast<size_t>(imageSize));
+    vkUnmapMemory(_device->logical(), stagingBufferMemory);
+
+    VkCommandBuffer commandBuffer = _device->beginSingleTimeCommands();
+    transitionLayout(commandBuffer, _environment.image, mipLevels, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {_environment.width, _environment.height, 1};
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, _environment.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = _environment.image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    int32_t mipWidth = width;
+    int32_t mipHeight = height;
+    for (uint32_t level = 1; level < mipLevels; level++) {
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkImageBlit blit{};
+        blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+        blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+        blit.dstOffsets[1] = {std::max(1, mipWidth / 2), std::max(1, mipHeight / 2), 1};
+        blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+        vkCmdBlitImage(commandBuffer, _environment.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, _environment.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        mipWidth = std::max(1, mipWidth / 2);
+        mipHeight = std::max(1, mipHeight / 2);
+    }
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    _device->endSingleTimeCommands(commandBuffer);
+
+    vkDestroyBuffer(_device->logical(), stagingBuffer, nullptr);
+    vkFreeMemory(_device->logical(), stagingBufferMemory, nullptr);
+}
+
+void EnvironmentLighting::generate(bool prefilterEnvironment, bool integrateBrdf) {
+    ComputePipeline* specularPipeline = nullptr;
+    ComputePipeline* irradiancePipeline = nullptr;
+    ComputePipeline* brdfPipeline = nullptr;
+    std::vector<VkImageView> storageViews;
+
+    auto writeDescriptors = [this](VkDescriptorSet descriptorSet, VkImageView storageView, bool withEnvironment) {
+        VkDescriptorImageInfo environmentInfo{};
+        environmentInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        environmentInfo.imageView = _environment.view;
+        environmentInfo.sampler = _environmentSampler;
+
+        VkDescriptorImageInfo storageInfo{};
+        storageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        storageInfo.imageView = storageView;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = descriptorSet;
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pImageInfo = &environmentInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = descriptorSet;
+        descriptorWrites[1].dstBinding = withEnvironment ? 1 : 0;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &storageInfo;
+
+        if (withEnvironment) {
+            vkUpdateDescriptorSets(_device->logical(), 2, descriptorWrites.data(), 0, nullptr);
+        } else {
+            vkUpdateDescriptorSets(_device->logical(), 1, &descriptorWrites[1], 0, nullptr);
+        }
+    };
+
+    VkCommandBuffer commandBuffer = _device->beginSingleTimeCommands();
+    if (prefilterEnvironment) {
+        specularPipeline = new ComputePipeline(_device, _appConfig->prefilterSpecularComputeShaderPath(),
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE}, sizeof(PrefilterConstants), _specular.mipLevels);
+        irradiancePipeline = new ComputePipeline(_device, _appConfig->irradianceComputeShaderPath(),
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE}, sizeof(PrefilterConstants), 1);
+        transitionLayout(commandBuffer, _specular.image, _specular.mipLevels, CUBE_FACES, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        transitionLayout(commandBuffer, _irradiance.image, 1, CUBE_FACES, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        float environmentTexels = static_cast<float>(_environment.width) * _environment.height;
+        for (uint32_t level = 0; level < _specular.mipLevels; level++) {
+            storageViews.push_back(createView(_specular, VK_IMAGE_VIEW_TYPE_2D_ARRAY, level, 1));
+            VkDescriptorSet descriptorSet = specularPipeline->allocateDescriptorSet();
+            writeDescriptors(descriptorSet, storageViews.back(), true);
+
+            PrefilterConstants constants{};
+            constants.faceSize = std::max(1u, _specular.width >> level);
+            constants.sampleCount = _appConfig->iblSpecularSamples();
+            constants.roughness = _specular.mipLevels > 1 ? static_cast<float>(level) / (_specular.mipLevels - 1) : 0.0f;
+            constants.environmentTexels = environmentTexels;
+            specularPipeline->bind(commandBuffer, descriptorSet);
+            specularPipeline->pushConstants(commandBuffer, &constants, sizeof(constants));
+            vkCmdDispatch(commandBuffer, (constants.faceSize + 7) / 8, (constants.faceSize + 7) / 8, CUBE_FACES);
+        }
+
+        storageViews.push_back(createView(_irradiance, VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, 1));
+        VkDescriptorSet descriptorSet = irradiancePipeline->allocateDescriptorSet();
+        writeDescriptors(descriptorSet, storageViews.back(), true);
+        PrefilterConstants constants{};
+        constants.faceSize = _irradiance.width;
+        constants.sampleCount = _appConfig->iblIrradianceSamples();
+        constants.environmentTexels = environmentTexels;
+        irradiancePipeline->bind(commandBuffer, descriptorSet);
+        irradiancePipeline->pushConstants(commandBuffer, &constants, sizeof(constants));
+        vkCmdDispatch(commandBuffer, (constants.faceSize + 7) / 8, (constants.faceSize + 7) / 8, CUBE_FACES);
+
+        transitionLayout(commandBuffer, _specular.image, _specular.mipLevels, CUBE_FACES, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        transitionLayout(commandBuffer, _irradiance.image, 1, CUBE_FACES, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    if (integrateBrdf) {
+        brdfPipeline = new ComputePipeline(_device, _appConfig->brdfLutComputeShaderPath(), {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE}, sizeof(BrdfLutConstants), 1);
+        transitionLayout(commandBuffer, _brdfLut.image, 1, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+            0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        VkDescriptorSet descriptorSet = brdfPipeline->allocateDescriptorSet();
+        writeDescriptors(descriptorSet, _brdfLut.view, false);
+
+        BrdfLutConstants constants{_brdfLut.width, _appConfig->iblBrdfLutSamples()};
+        brdfPipeline->bind(commandBuffer, descriptorSet);
+        brdfPipeline->pushConstants(commandBuffer, &constants, sizeof(constants));
+        vkCmdDispatch(commandBuffer, (constants.resolution + 7) / 8, (constants.resolution + 7) / 8, 1);
+        transitionLayout(commandBuffer, _brdfLut.image, 1, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    _device->endSingleTimeCommands(commandBuffer);
+
+    for (auto view : storageViews) {
+        vkDestroyImageView(_device->logical(), view, nullptr);
+    }
+    delete specularPipeline;
+    delete irradiancePipeline;
+    delete brdfPipeline;
+}
+
+void EnvironmentLighting::upload(LightingImage& target, const std::vector<char>& data) {
+    VkDeviceSize totalSize;
+    std::vector<VkBufferImageCopy> regions = copyRegions(target, totalSize);
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    _device->createBuffer(totalSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    void* mapped;
+    vkMapMemory(_device->logical(), stagingBufferMemory, 0, totalSize, 0, &mapped);
+    memcpy(mapped, data.data(), static_cast<size_t>(totalSize));
+    vkUnmapMemory(_device->logical(), stagingBufferMemory);
+
+    VkCommandBuffer commandBuffer = _device->beginSingleTimeCommands();
+    transitionLayout(commandBuffer, target.image, target.mipLevels, target.layers, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+    transitionLayout(commandBuffer, target.image, target.mipLevels, target.layers, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    _device->endSingleTimeCommands(commandBuffer);
+
+    vkDestroyBuffer(_device->logical(), stagingBuffer, nullptr);
+    vkFreeMemory(_device->logical(), stagingBufferMemory, nullptr);
+}
+
+std::vector<char> EnvironmentLighting::readback(LightingImage& target) {
+    VkDeviceSize totalSize;
+    std::vector<VkBufferImageCopy> regions = copyRegions(target, totalSize);
+
+    VkBuffer readbackBuffer;
+    VkDeviceMemory readbackBufferMemory;
+    _device->createBuffer(totalSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackBufferMemory);
+
+    VkCommandBuffer commandBuffer = _device->beginSingleTimeCommands();
+    transitionLayout(commandBuffer, target.image, target.mipLevels, target.layers, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdCopyImageToBuffer(commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+    transitionLayout(commandBuffer, target.image, target.mipLevels, target.layers, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = readbackBuffer;
+    hostBarrier.offset = 0;
+    hostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+    _device->endSingleTimeCommands(commandBuffer);
+
+    std::vector<char> data(static_cast<size_t>(totalSize));
+    void* mapped;
+    vkMapMemory(_device->logical(), readbackBufferMemory, 0, totalSize, 0, &mapped);
+    memcpy(data.data(), mapped, data.size());
+    vkUnmapMemory(_device->logical(), readbackBufferMemory);
+
+    vkDestroyBuffer(_device->logical(), readbackBuffer, nullptr);
+    vkFreeMemory(_device->logical(), readbackBufferMemory, nullptr);
+    return data;
+}
+
+}
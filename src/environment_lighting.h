@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+#include "device.h"
+
+namespace vmr {
+// Image-based lighting with the split-sum approximation. An HDR equirectangular environment is prefiltered by
+// compute shaders into a specular cube (one GGX roughness per mip level) and a diffuse irradiance cube, and the GGX BRDF
+// is integrated into a scale/bias LUT. All three are read back and kept in the disk cache, so later starts neither
+// decode the environment nor run the prefilter.
+class EnvironmentLighting {
+private:
+    struct PrefilterConstants {
+        uint32_t faceSize;
+        uint32_t sampleCount;
+        float roughness;
+        float environmentTexels;
+    };
+    struct BrdfLutConstants {
+        uint32_t resolution;
+        uint32_t sampleCount;
+    };
+    // a cube or 2D image together with the view sampled by the model shader
+    struct LightingImage {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 1;
+        uint32_t layers = 1;
+    };
+
+    Device* _device;
+    AppConfig* _appConfig;
+    LightingImage _specular;
+    LightingImage _irradiance;
+    LightingImage _brdfLut;
+    LightingImage _environment;
+    VkSampler _environmentSampler = VK_NULL_HANDLE;
+    VkSampler _sampler;
+
+    void createLightingImage(LightingImage& target, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t layers, VkImageUsageFlags usage);
+    VkImageView createView(const LightingImage& target, VkImageViewType viewType, uint32_t baseMipLevel, uint32_t levelCount);
+    void destroyLightingImage(LightingImage& target);
+    void createSampler(VkSampler& sampler, float maxLod, VkSamplerAddressMode addressModeU);
+    std::vector<VkBufferImageCopy> copyRegions(const LightingImage& target, VkDeviceSize& totalSize);
+
+    void loadEnvironment(const std::vector<char>& fileData);
+    void generate(bool prefilterEnvironment, bool integrateBrdf);
+    void upload(LightingImage& target, const std::vector<char>& data);
+    std::vector<char> readback(LightingImage& target);
+
+public:
+    EnvironmentLighting(Device* device, AppConfig* appConfig);
+    ~EnvironmentLighting();
+    VkImageView specularView()      { return _specular.view; }
+    VkImageView irradianceView()    { return _irradiance.view; }
+    VkImageView brdfLutView()       { return _brdfLut.view; }
+    VkSampler sampler()             { return _sampler; }
+};
+}
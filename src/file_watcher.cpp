@@ -0,0 +1,111 @@
+#include <filesystem>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "file_watcher.h"
+
+namespace vmr {
+
+//writes of a single save usually arrive within a few milliseconds of each other
+const auto DEBOUNCE_INTERVAL = std::chrono::milliseconds(30);
+const int POLL_TIMEOUT_MS = 10;
+
+FileWatcher::FileWatcher() {
+    _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotify < 0) {
+        throw std::runtime_error("failed to initialize inotify!");
+    }
+    _thread = std::thread(&FileWatcher::watchLoop, this);
+}
+
+FileWatcher::~FileWatcher() {
+    _stopping = true;
+    _thread.join();
+    close(_inotify);
+}
+
+std::string FileWatcher::normalize(const std::string& path) {
+    return std::filesystem::absolute(path).lexically_normal().string();
+}
+
+void FileWatcher::watch(const std::string& path) {
+    std::string file = normalize(path);
+    std::string directory = std::filesystem::path(file).parent_path().string();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _files[file] = path;
+    for (const auto& [descriptor, watched] : _directories) {
+        if (watched == directory) {
+            return;
+        }
+    }
+    int descriptor = inotify_add_watch(_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (descriptor < 0) {
+        throw std::runtime_error("failed to watch directory " + directory + "!");
+    }
+    _directories[descriptor] = directory;
+}
+
+void FileWatcher::unwatch(const std::string& path) {
+    //the directory stays watched, events of files no longer listed are dropped
+    std::lock_guard<std::mutex> lock(_mutex);
+    _files.erase(normalize(path));
+}
+
+std::vector<FileWatcher::Change> FileWatcher::takeChanges() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<Change> changes = std::move(_changes);
+    _changes.clear();
+    return changes;
+}
+
+void FileWatcher::watchLoop() {
+    alignas(inotify_event) char buffer[4096];
+    pollfd descriptor{_inotify, POLLIN, 0};
+    while (!_stopping) {
+        //the timeout bounds both the shutdown delay and the debounce resolution
+        poll(&descriptor, 1, POLL_TIMEOUT_MS);
+        auto now = std::chrono::high_resolution_clock::now();
+
+        ssize_t length;
+        while ((length = read(_inotify, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (char* next = buffer; next < buffer + length; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(next);
+                next += sizeof(inotify_event) + event->len;
+                auto directory = _directories.find(event->wd);
+                if (directory == _directories.end() || event->len == 0) {
+                    continue;
+                }
+                std::string file = directory->second + "/" + event->name;
+                if (_files.count(file) == 0) {
+                    continue;
+                }
+                auto pending = _pending.find(file);
+                if (pending == _pending.end()) {
+                    _pending[file] = {now, now};
+                } else {
+                    pending->second.lastEvent = now;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto pending = _pending.begin(); pending != _pending.end(); ) {
+            if (now - pending->second.lastEvent < DEBOUNCE_INTERVAL) {
+                ++pending;
+                continue;
+            }
+            auto watched = _files.find(pending->first);
+            if (watched != _files.end()) {
+                _changes.push_back({watched->second, pending->second.detected});
+            }
+            pending = _pending.erase(pending);
+        }
+    }
+}
+
+}
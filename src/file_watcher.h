@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vmr {
+// Watches individual files for changes with inotify. The parent directories are watched, so files replaced by a
+// rename (as most editors and glslc do) keep being reported. Bursts of events on one file are merged into a single
+// change once the file has been quiet for a short while.
+class FileWatcher {
+public:
+    struct Change {
+        std::string path;                                       // as passed to watch()
+        std::chrono::high_resolution_clock::time_point detected; // first event of the burst
+    };
+
+private:
+    struct PendingChange {
+        std::chrono::high_resolution_clock::time_point detected;
+        std::chrono::high_resolution_clock::time_point lastEvent;
+    };
+
+    int _inotify = -1;
+    std::thread _thread;
+    std::atomic<bool> _stopping{false};
+    std::mutex _mutex;
+    std::map<int, std::string> _directories;            // watch descriptor to the normalized directory
+    std::map<std::string, std::string> _files;          // normalized path to the watched path
+    std::map<std::string, PendingChange> _pending;      // only touched by the watcher thread
+    std::vector<Change> _changes;
+
+    static std::string normalize(const std::string& path);
+    void watchLoop();
+
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    void watch(const std::string& path);
+    void unwatch(const std::string& path);
+    // changes reported since the last call, oldest first
+    std::vector<Change> takeChanges();
+};
+}
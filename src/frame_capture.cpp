@@ -0,0 +1,324 @@
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "frame_capture.h"
+
+namespace vmr {
+
+FrameCapture::FrameCapture(Device* device, AppConfig* appConfig, SwapChain* swapChain, ThreadPool* threadPool, size_t framesInFlight)
+            : _device(device), _appConfig(appConfig), _swapChain(swapChain), _threadPool(threadPool),
+              _slots(std::max<uint32_t>(appConfig->captureRingSize(), 1)), _inFlightSlots(framesInFlight, -1) {
+    _hdr = _appConfig->captureFormat() == "exr";
+    if (_hdr && _appConfig->tonemapInMainPass()) {
+        //the HDR target never leaves tile memory when the main pass tonemaps it
+        std::cout<<"The HDR target is transient with hdr.tonemapSubpass in the main pass, capturing png instead of exr\n";
+        _hdr = false;
+    }
+    _enabled = _hdr || _swapChain->transferSource();
+    if (!_enabled) {
+        std::cout<<"The swap chain images can't be copied from on this device, frame capture is disabled\n";
+        return;
+    }
+    std::filesystem::create_directories(_appConfig->captureDirectory());
+    //speed over size, the encoders have to keep up with the frame rate
+    stbi_write_png_compression_level = 1;
+}
+
+FrameCapture::~FrameCapture() {
+    finish();
+    for (auto& slot : _slots) {
+        if (slot.buffer != VK_NULL_HANDLE) {
+            vkUnmapMemory(_device->logical(), slot.memory);
+            vkDestroyBuffer(_device->logical(), slot.buffer, nullptr);
+            vkFreeMemory(_device->logical(), slot.memory, nullptr);
+        }
+    }
+}
+
+void FrameCapture::finish() {
+    for (size_t frame = 0; frame < _inFlightSlots.size(); frame++) {
+        collect(static_cast<int>(frame));
+    }
+    for (auto& encode : _encodes) {
+        encode.wait();
+    }
+    _encodes.clear();
+}
+
+bool FrameCapture::finished() const {
+    return _appConfig->captureFrames() > 0 && _sequence >= _appConfig->captureFrames();
+}
+
+void FrameCapture::allocateSlot(ReadbackSlot& slot, VkDeviceSize size) {
+    //the slot is free, so no copy into its previous buffer is still running
+    if (slot.buffer != VK_NULL_HANDLE) {
+        vkUnmapMemory(_device->logical(), slot.memory);
+        vkDestroyBuffer(_device->logical(), slot.buffer, nullptr);
+        vkFreeMemory(_device->logical(), slot.memory, nullptr);
+    }
+    //cached memory makes the workers' reads fast, coherent memory saves invalidating the range
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    if (_device->hasMemoryType(~0u, properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+        properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    }
+    _device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.buffer, slot.memory);
+    vkMapMemory(_device->logical(), slot.memory, 0, size, 0, &slot.mapped);
+    slot.size = size;
+}
+
+void FrameCapture::record(VkCommandBuffer commandBuffer, uint32_t imageIndex, int currentFrame) {
+    if (!_enabled || finished()) {
+        return;
+    }
+    uint64_t sequence = _sequence++;
+    int found = -1;
+    for (size_t i = 0; i < _slots.size(); i++) {
+        size_t candidate = (_nextSlot + i) % _slots.size();
+        if (!_slots[candidate].pending && !_slots[candidate].encoding) {
+            found = static_cast<int>(candidate);
+            break;
+        }
+    }
+    if (found < 0) {
+        //every buffer waits for its frame or its encoder, the frame is skipped rather than stalling
+        _dropped++;
+        return;
+    }
+    _nextSlot = (found + 1) % _slots.size();
+    ReadbackSlot& slot = _slots[found];
+
+    VkImage image;
+    VkImageLayout layout;
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkAccessFlags access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    uint32_t bytesPerPixel = 4;
+    if (_hdr) {
+        //left readable for the tonemapping, which may still sample it
+        image = _swapChain->hdrImage(imageIndex);
+        layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        slot.extent = _swapChain->renderExtent();
+        slot.format = _swapChain->hdrFormat();
+        bytesPerPixel = slot.format == VK_FORMAT_R16G16B16A16_SFLOAT ? 8 : 4;
+    } else {
+        image = _swapChain->image(imageIndex);
+        layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        slot.extent = _swapChain->extent();
+        slot.format = _swapChain->imageFormat();
+    }
+    VkDeviceSize size = static_cast<VkDeviceSize>(slot.extent.width) * slot.extent.height * bytesPerPixel;
+    if (slot.size < size) {
+        allocateSlot(slot, size);
+    }
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = layout;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    barrier.srcAccessMask = access;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {slot.extent.width, slot.extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = layout;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = 0;
+    VkBufferMemoryBarrier bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = slot.buffer;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = size;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, nullptr, 1, &bufferBarrier, 1, &barrier);
+
+    slot.pending = true;
+    slot.sequence = sequence;
+    _inFlightSlots[currentFrame] = found;
+}
+
+void FrameCapture::collect(int currentFrame) {
+    for (size_t i = 0; i < _encodes.size(); ) {
+        if (_encodes[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            _encodes[i] = std::move(_encodes.back());
+            _encodes.pop_back();
+        } else {
+            i++;
+        }
+    }
+
+    int found = _inFlightSlots[currentFrame];
+    if (found < 0) {
+        return;
+    }
+    _inFlightSlots[currentFrame] = -1;
+    ReadbackSlot& slot = _slots[found];
+    slot.pending = false;
+    slot.encoding = true;
+    _encodes.push_back(_threadPool->submit([this, &slot]() { encode(slot); }));
+}
+
+void FrameCapture::encode(ReadbackSlot& slot) {
+    auto start = std::chrono::high_resolution_clock::now();
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06llu.%s", static_cast<unsigned long long>(slot.sequence), _hdr ? "exr" : "png");
+    std::string path = (std::filesystem::path(_appConfig->captureDirectory()) / name).string();
+    try {
+        if (_hdr) {
+            writeExr(slot, path);
+        } else {
+            writePng(slot, path);
+        }
+        _written++;
+    } catch (const std::exception& e) {
+        std::cerr<<"\nfailed to write "<<path<<": "<<e.what()<<std::endl;
+        _failed++;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    _encodeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    slot.encoding = false;
+}
+
+void FrameCapture::writePng(const ReadbackSlot& slot, const std::string& path) {
+    uint32_t pixelCount = slot.extent.width * slot.extent.height;
+    std::vector<uint8_t> pixels(static_cast<size_t>(pixelCount) * 4);
+    memcpy(pixels.data(), slot.mapped, pixels.size());
+    bool bgra = slot.format == VK_FORMAT_B8G8R8A8_SRGB || slot.format == VK_FORMAT_B8G8R8A8_UNORM;
+    for (uint32_t i = 0; i < pixelCount; i++) {
+        if (bgra) {
+            std::swap(pixels[4 * i], pixels[4 * i + 2]);
+        }
+        pixels[4 * i + 3] = 255;
+    }
+    if (!stbi_write_png(path.c_str(), slot.extent.width, slot.extent.height, 4, pixels.data(), slot.extent.width * 4)) {
+        throw std::runtime_error("failed to encode png!");
+    }
+}
+
+//uncompressed scanline OpenEXR with half RGBA channels, stored in the alphabetical channel order of the format
+void FrameCapture::writeExr(const ReadbackSlot& slot, const std::string& path) {
+    const uint32_t width = slot.extent.width;
+    const uint32_t height = slot.extent.height;
+    const uint16_t HALF_ONE = 0x3c00;
+
+    std::vector<char> file;
+    auto put = [&file](const void* data, size_t size) {
+        file.insert(file.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+    };
+    auto putInt = [&put](int32_t value) { put(&value, sizeof(value)); };
+    auto putFloat = [&put](float value) { put(&value, sizeof(value)); };
+    auto putAttribute = [&put, &putInt](const char* name, const char* type, int32_t size) {
+        put(name, strlen(name) + 1);
+        put(type, strlen(type) + 1);
+        putInt(size);
+    };
+
+    const uint8_t magic[] = {0x76, 0x2f, 0x31, 0x01};
+    put(magic, sizeof(magic));
+    putInt(2);
+
+    const char* channels[] = {"A", "B", "G", "R"};
+    putAttribute("channels", "chlist", 4 * (2 + 16) + 1);
+    for (const char* channel : channels) {
+        put(channel, 2);
+        putInt(1);                  // half
+        putInt(0);                  // pLinear and reserved
+        putInt(1);                  // x sampling
+        putInt(1);                  // y sampling
+    }
+    file.push_back(0);
+    putAttribute("compression", "compression", 1);
+    file.push_back(0);
+    for (const char* window : {"dataWindow", "displayWindow"}) {
+        putAttribute(window, "box2i", 16);
+        putInt(0);
+        putInt(0);
+        putInt(static_cast<int32_t>(width) - 1);
+        putInt(static_cast<int32_t>(height) - 1);
+    }
+    putAttribute("lineOrder", "lineOrder", 1);
+    file.push_back(0);
+    putAttribute("pixelAspectRatio", "float", 4);
+    putFloat(1.0f);
+    putAttribute("screenWindowCenter", "v2f", 8);
+    putFloat(0.0f);
+    putFloat(0.0f);
+    putAttribute("screenWindowWidth", "float", 4);
+    putFloat(1.0f);
+    file.push_back(0);
+
+    const int32_t lineSize = static_cast<int32_t>(width * 4 * sizeof(uint16_t));
+    uint64_t offset = file.size() + sizeof(uint64_t) * height;
+    for (uint32_t y = 0; y < height; y++) {
+        put(&offset, sizeof(offset));
+        offset += 2 * sizeof(int32_t) + lineSize;
+    }
+
+    std::vector<uint16_t> line(static_cast<size_t>(width) * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint16_t rgb[3];
+            if (slot.format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+                memcpy(rgb, static_cast<const uint16_t*>(slot.mapped) + (static_cast<size_t>(y) * width + x) * 4, sizeof(rgb));
+            } else {
+                //B10G11R11: the same 5 bit exponent as half floats, with shorter mantissas and no sign
+                uint32_t packed = static_cast<const uint32_t*>(slot.mapped)[static_cast<size_t>(y) * width + x];
+                uint32_t red = packed & 0x7ff;
+                uint32_t green = (packed >> 11) & 0x7ff;
+                uint32_t blue = packed >> 22;
+                rgb[0] = static_cast<uint16_t>(((red >> 6) << 10) | ((red & 0x3f) << 4));
+                rgb[1] = static_cast<uint16_t>(((green >> 6) << 10) | ((green & 0x3f) << 4));
+                rgb[2] = static_cast<uint16_t>(((blue >> 5) << 10) | ((blue & 0x1f) << 5));
+            }
+            line[x] = HALF_ONE;
+            line[width + x] = rgb[2];
+            line[2 * width + x] = rgb[1];
+            line[3 * width + x] = rgb[0];
+        }
+        putInt(static_cast<int32_t>(y));
+        putInt(lineSize);
+        put(line.data(), lineSize);
+    }
+
+    std::ofstream output(path, std::ios::binary);
+    output.write(file.data(), file.size());
+    if (!output) {
+        throw std::runtime_error("failed to write exr!");
+    }
+}
+
+void FrameCapture::printStats() {
+    if (!_enabled || _sequence == 0) {
+        return;
+    }
+    uint64_t encoded = _written + _failed;
+    std::cout<<"Captured "<<_written<<" of "<<_sequence<<" frame(s) as "<<(_hdr ? "exr" : "png")<<" into "<<_appConfig->captureDirectory()
+             <<", dropped "<<_dropped<<" ("<<100.0 * _dropped / _sequence<<"%), failed "<<_failed;
+    if (encoded > 0) {
+        std::cout<<", avg encode "<<_encodeMicroseconds / 1000.0 / encoded<<" ms on "<<_threadPool->workerCount()<<" worker(s)";
+    }
+    std::cout<<std::endl;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "app_config.h"
+#include "device.h"
+#include "swap_chain.h"
+#include "thread_pool.h"
+
+namespace vmr {
+// Saves every rendered frame as an image sequence without stalling the GPU. The end of each frame copies the image
+// into one of a ring of host-visible readback buffers; once the frame's fence has been waited on, the buffer is
+// handed to a worker thread that encodes it. Frames finding no free buffer are dropped and counted.
+class FrameCapture {
+private:
+    struct ReadbackSlot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkDeviceSize size = 0;
+        bool pending = false;                   // copy recorded, its frame not finished yet
+        std::atomic<bool> encoding{false};      // owned by a worker until it has written the file
+        uint64_t sequence = 0;
+        VkExtent2D extent;
+        VkFormat format;
+    };
+
+    Device* _device;
+    AppConfig* _appConfig;
+    SwapChain* _swapChain;
+    ThreadPool* _threadPool;
+    bool _hdr;                                  // exr of the HDR target, png of the presented image otherwise
+    bool _enabled;
+    std::vector<ReadbackSlot> _slots;
+    size_t _nextSlot = 0;
+    std::vector<int> _inFlightSlots;            // slot copied by each frame in flight, -1 if none
+    std::vector<std::future<void>> _encodes;
+    uint64_t _sequence = 0;
+    uint64_t _dropped = 0;
+    std::atomic<uint64_t> _written{0};
+    std::atomic<uint64_t> _failed{0};
+    std::atomic<uint64_t> _encodeMicroseconds{0};
+
+    void allocateSlot(ReadbackSlot& slot, VkDeviceSize size);
+    void encode(ReadbackSlot& slot);
+    void writePng(const ReadbackSlot& slot, const std::string& path);
+    void writeExr(const ReadbackSlot& slot, const std::string& path);
+
+public:
+    FrameCapture(Device* device, AppConfig* appConfig, SwapChain* swapChain, ThreadPool* threadPool, size_t framesInFlight);
+    // expects the device to be idle, calls finish()
+    ~FrameCapture();
+
+    // at the end of the frame's last render pass, the image is left in the layout it was found in
+    void record(VkCommandBuffer commandBuffer, uint32_t imageIndex, int currentFrame);
+    // after the frame's fence has been waited on
+    void collect(int currentFrame);
+    // every frame asked for by capture.frames has been captured or dropped
+    bool finished() const;
+    // expects the device to be idle, frames still in flight are encoded before returning
+    void finish();
+    // after finish(), so that the last frames are counted
+    void printStats();
+};
+}
@@ -0,0 +1,40 @@
+#include <algorithm>
+
+#include "frustum.h"
+
+namespace vmr {
+
+Frustum Frustum::fromViewProjection(const glm::mat4& viewProjection) {
+    //Gribb-Hartmann plane extraction, glm matrices are column-major so rows are gathered manually
+    auto row = [&](int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+    Frustum frustum{};
+    frustum.planes[0] = row(3) + row(0); // left
+    frustum.planes[1] = row(3) - row(0); // right
+    frustum.planes[2] = row(3) + row(1); // bottom
+    frustum.planes[3] = row(3) - row(1); // top
+    frustum.planes[4] = row(2);          // near, depth range is [0, 1] in Vulkan
+    frustum.planes[5] = row(3) - row(2); // far
+
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+BoundingSphere BoundingSphere::transformed(const glm::mat4& model) const {
+    float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+    return {glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale};
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+namespace vmr {
+// View frustum as six normalized planes (xyz = inward normal, w = distance), in the space of the matrix it was extracted from
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+
+    static Frustum fromViewProjection(const glm::mat4& viewProjection);
+    bool intersectsSphere(const glm::vec3& center, float radius) const;
+};
+
+// Bounding sphere of a mesh in its object space
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+
+    BoundingSphere transformed(const glm::mat4& model) const;
+};
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "device.h"
+
+namespace vmr {
+// Graphics pipelines of the post-processing passes: one triangle covering the viewport, generated from the vertex
+// index, single sampled, without depth, with the viewport and scissor set when recording.
+
+// one descriptor set and push constants read by the fragment stage
+VkPipelineLayout createFullscreenPipelineLayout(Device* device, VkDescriptorSetLayout descriptorSetLayout, uint32_t pushConstantSize);
+// writes every channel unblended without a blend attachment
+VkPipeline createFullscreenPipeline(Device* device, const std::string& vertPath, const std::string& fragPath, VkPipelineLayout layout,
+                                    VkRenderPass renderPass, uint32_t subpass, const VkPipelineColorBlendAttachmentState* blendAttachment = nullptr);
+}
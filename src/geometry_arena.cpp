@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "geometry_arena.h"
+
+namespace vmr {
+
+GeometryArena::GeometryArena(Device* device, AppConfig* appConfig) : _device(device), _appConfig(appConfig) {
+    const VkDeviceSize mb = 1024 * 1024;
+    //the source and destination of a move are both in the arena's own buffer
+    VkBufferUsageFlags transfers = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    createHeap(_vertexHeap, std::max(_appConfig->geometryArenaVertexMegabytes(), 1u) * mb, transfers | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    createHeap(_indexHeap, std::max(_appConfig->geometryArenaIndexMegabytes(), 1u) * mb, transfers | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+GeometryArena::~GeometryArena() {
+    for (Heap* heap : {&_vertexHeap, &_indexHeap}) {
+        vkDestroyBuffer(_device->logical(), heap->buffer, nullptr);
+        vkFreeMemory(_device->logical(), heap->memory, nullptr);
+    }
+}
+
+void GeometryArena::createHeap(Heap& heap, VkDeviceSize capacity, VkBufferUsageFlags usage) {
+    _device->createBuffer(capacity, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, heap.buffer, heap.memory);
+    heap.capacity = capacity;
+    heap.freeBlocks.push_back({0, capacity});
+}
+
+bool GeometryArena::findBlock(const Heap& heap, VkDeviceSize size, VkDeviceSize stride, VkDeviceSize limit, VkDeviceSize& offset) const {
+    for (const auto& block : heap.freeBlocks) {
+        VkDeviceSize start = (block.offset + stride - 1) / stride * stride;
+        VkDeviceSize end = start + size;
+        if (end > limit) {
+            return false;
+        }
+        if (end <= block.offset + block.size) {
+            offset = start;
+            return true;
+        }
+    }
+    return false;
+}
+
+void GeometryArena::take(Heap& heap, VkDeviceSize offset, VkDeviceSize size) {
+    auto it = std::find_if(heap.freeBlocks.begin(), heap.freeBlocks.end(), [offset](const Block& block) {
+        return block.offset <= offset && offset < block.offset + block.size;
+    });
+    Block block = *it;
+    it = heap.freeBlocks.erase(it);
+    //what the stride alignment skipped stays free before the range, the rest after it
+    if (offset + size < block.offset + block.size) {
+        it = heap.freeBlocks.insert(it, {offset + size, block.offset + block.size - offset - size});
+    }
+    if (offset > block.offset) {
+        heap.freeBlocks.insert(it, {block.offset, offset - block.offset});
+    }
+    heap.used += size;
+}
+
+void GeometryArena::release(Heap& heap, Block block) {
+    heap.used -= block.size;
+    auto it = std::lower_bound(heap.freeBlocks.begin(), heap.freeBlocks.end(), block.offset, [](const Block& free, VkDeviceSize offset) {
+        return free.offset < offset;
+    });
+    it = heap.freeBlocks.insert(it, block);
+    //merged with the following and the preceding free block where they touch
+    auto next = it + 1;
+    if (next != heap.freeBlocks.end() && it->offset + it->size == next->offset) {
+        it->size += next->size;
+        heap.freeBlocks.erase(next);
+    }
+    if (it != heap.freeBlocks.begin()) {
+        auto previous = it - 1;
+        if (previous->offset + previous->size == it->offset) {
+            previous->size += it->size;
+            heap.freeBlocks.erase(it);
+        }
+    }
+}
+
+uint32_t GeometryArena::add(Pool pool, const void* data, VkDeviceSize size, VkDeviceSize stride, VkCommandBuffer commandBuffer) {
+    Heap& target = heap(pool);
+    VkDeviceSize offset;
+    if (!findBlock(target, size, stride, target.capacity, offset)) {
+        throw std::runtime_error(std::string("failed to allocate ") + std::to_string(size) + " bytes in the geometry arena's "
+                                 + (pool == Pool::Vertex ? "vertex" : "index") + " buffer!");
+    }
+    take(target, offset, size);
+
+    uint32_t index;
+    if (_freeRanges.empty()) {
+        index = static_cast<uint32_t>(_ranges.size());
+        _ranges.emplace_back();
+    } else {
+        index = _freeRanges.back();
+        _freeRanges.pop_back();
+    }
+    _ranges[index] = {pool, {offset, size}, stride, true};
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    _device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* mapped;
+    vkMapMemory(_device->logical(), stagingBufferMemory, 0, size, 0, &mapped);
+        memcpy(mapped, data, (size_t) size);
+    vkUnmapMemory(_device->logical(), stagingBufferMemory);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.dstOffset = offset;
+    copyRegion.size = size;
+    if (commandBuffer == VK_NULL_HANDLE) {
+        VkCommandBuffer uploadCommandBuffer = _device->beginSingleTimeCommands();
+        vkCmdCopyBuffer(uploadCommandBuffer, stagingBuffer, target.buffer, 1, &copyRegion);
+        _device->endSingleTimeCommands(uploadCommandBuffer);
+        vkDestroyBuffer(_device->logical(), stagingBuffer, nullptr);
+        vkFreeMemory(_device->logical(), stagingBufferMemory, nullptr);
+    } else {
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, target.buffer, 1, &copyRegion);
+        VkDevice device = _device->logical();
+        _device->deletionQueue().pushAfterRecording([device, stagingBuffer, stagingBufferMemory]() {
+            vkDestroyBuffer(device, stagingBuffer, nullptr);
+            vkFreeMemory(device, stagingBufferMemory, nullptr);
+        });
+    }
+    _uploads++;
+    return index;
+}
+
+uint32_t GeometryArena::addVertices(const void* vertices, VkDeviceSize size, uint32_t stride, VkCommandBuffer commandBuffer) {
+    return add(Pool::Vertex, vertices, size, stride, commandBuffer);
+}
+
+uint32_t GeometryArena::addIndices(const std::vector<uint32_t>& indices, VkCommandBuffer commandBuffer) {
+    return add(Pool::Index, indices.data(), sizeof(indices[0]) * indices.size(), sizeof(indices[0]), commandBuffer);
+}
+
+void GeometryArena::remove(uint32_t range) {
+    _ranges[range].live = false;
+    _device->deletionQueue().pushAfterRecording([this, range]() {
+        release(heap(_ranges[range].pool), _ranges[range].block);
+        _freeRanges.push_back(range);
+    });
+}
+
+void GeometryArena::bind(VkCommandBuffer commandBuffer) {
+    VkBuffer vertexBuffers[] = {_vertexHeap.buffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, _indexHeap.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void GeometryArena::defragment(VkCommandBuffer commandBuffer) {
+    VkDeviceSize budget = static_cast<VkDeviceSize>(_appConfig->geometryArenaDefragmentKilobytes()) * 1024;
+    if (budget == 0) {
+        return;
+    }
+    //the ranges furthest back move first, each only into free space entirely before it
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < _ranges.size(); i++) {
+        if (_ranges[i].live) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return _ranges[a].block.offset > _ranges[b].block.offset; });
+
+    std::vector<VkBufferCopy> vertexCopies, indexCopies;
+    VkDeviceSize moved = 0;
+    for (uint32_t index : order) {
+        Range& range = _ranges[index];
+        //a range larger than the budget still moves on its own, or it would block the compaction for good
+        if (moved > 0 && moved + range.block.size > budget) {
+            break;
+        }
+        Heap& source = heap(range.pool);
+        VkDeviceSize offset;
+        if (!findBlock(source, range.block.size, range.stride, range.block.offset, offset)) {
+            continue;
+        }
+        take(source, offset, range.block.size);
+        (range.pool == Pool::Vertex ? vertexCopies : indexCopies).push_back({range.block.offset, offset, range.block.size});
+        //frames in flight and this frame's copy still read the old place
+        Block oldBlock = range.block;
+        Pool pool = range.pool;
+        _device->deletionQueue().pushAfterRecording([this, pool, oldBlock]() {
+            release(heap(pool), oldBlock);
+        });
+        range.block.offset = offset;
+        moved += range.block.size;
+        _moves++;
+    }
+    if (moved == 0) {
+        return;
+    }
+    _bytesMoved += moved;
+
+    //uploads and moves of earlier frames or of this one are complete before their data is copied again
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    //source and destination never overlap, so each buffer copies into itself
+    if (!vertexCopies.empty()) {
+        vkCmdCopyBuffer(commandBuffer, _vertexHeap.buffer, _vertexHeap.buffer, static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+    }
+    if (!indexCopies.empty()) {
+        vkCmdCopyBuffer(commandBuffer, _indexHeap.buffer, _indexHeap.buffer, static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GeometryArena::printStats() {
+    const double mb = 1024.0 * 1024.0;
+    for (Pool pool : {Pool::Vertex, Pool::Index}) {
+        const Heap& current = heap(pool);
+        VkDeviceSize largestFree = 0;
+        for (const auto& block : current.freeBlocks) {
+            largestFree = std::max(largestFree, block.size);
+        }
+        std::cout<<"Geometry arena "<<(pool == Pool::Vertex ? "vertices" : "indices")<<": "<<current.used / mb<<" of "<<current.capacity / mb
+                 <<" MB in use, "<<current.freeBlocks.size()<<" free block(s), largest "<<largestFree / mb<<" MB"<<std::endl;
+    }
+    std::cout<<"Geometry arena: "<<_uploads<<" upload(s), "<<_moves<<" range(s) moved by defragmentation ("<<_bytesMoved / (1024.0 * 1024.0)
+             <<" MB)"<<std::endl;
+}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+#include "device.h"
+
+namespace vmr {
+// One vertex and one index buffer suballocated by every mesh. Meshes are drawn through the firstIndex and vertexOffset
+// of their ranges, so any number of them share a single buffer bind. Vertex ranges start at a multiple of their stride,
+// which lets streams of different vertex formats live in the same buffer bound at offset 0. Freed ranges return to a
+// free list once the frames using them have finished, and every frame moves a bounded amount of the data at the end of
+// a buffer into free space before it, so the free space gathers at the end instead of fragmenting.
+class GeometryArena {
+private:
+    enum class Pool { Vertex, Index };
+    struct Block {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+    struct Heap {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        VkDeviceSize capacity;
+        VkDeviceSize used = 0;
+        std::vector<Block> freeBlocks;      // sorted by offset, neighbours merged
+    };
+    struct Range {
+        Pool pool;
+        Block block;
+        VkDeviceSize stride;
+        bool live;
+    };
+
+    Device* _device;
+    AppConfig* _appConfig;
+    Heap _vertexHeap;
+    Heap _indexHeap;
+    std::vector<Range> _ranges;
+    std::vector<uint32_t> _freeRanges;
+    uint64_t _uploads = 0;
+    uint64_t _moves = 0;
+    uint64_t _bytesMoved = 0;
+
+    Heap& heap(Pool pool)                           { return pool == Pool::Vertex ? _vertexHeap : _indexHeap; }
+    void createHeap(Heap& heap, VkDeviceSize capacity, VkBufferUsageFlags usage);
+    // lowest block fitting the size at a multiple of the stride, ending at or before the limit
+    bool findBlock(const Heap& heap, VkDeviceSize size, VkDeviceSize stride, VkDeviceSize limit, VkDeviceSize& offset) const;
+    void take(Heap& heap, VkDeviceSize offset, VkDeviceSize size);
+    void release(Heap& heap, Block block);
+    uint32_t add(Pool pool, const void* data, VkDeviceSize size, VkDeviceSize stride, VkCommandBuffer commandBuffer);
+
+public:
+    GeometryArena(Device* device, AppConfig* appConfig);
+    ~GeometryArena();
+
+    // without a command buffer the data is uploaded before returning, otherwise the copy is recorded into it and the
+    // caller makes it visible to the vertex input
+    uint32_t addVertices(const void* vertices, VkDeviceSize size, uint32_t stride, VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
+    uint32_t addIndices(const std::vector<uint32_t>& indices, VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
+    // the range is reused once the frames submitted so far and the one being recorded no longer draw it
+    void remove(uint32_t range);
+
+    // current position of a range, which moves when the arena is compacted
+    int32_t vertexOffset(uint32_t range) const      { return static_cast<int32_t>(_ranges[range].block.offset / _ranges[range].stride); }
+    uint32_t firstIndex(uint32_t range) const       { return static_cast<uint32_t>(_ranges[range].block.offset / sizeof(uint32_t)); }
+    VkDeviceSize byteOffset(uint32_t range) const   { return _ranges[range].block.offset; }
+    VkBuffer vertexBuffer()                         { return _vertexHeap.buffer; }
+
+    // binds both buffers, their bindings stay valid for every pass of the command buffer
+    void bind(VkCommandBuffer commandBuffer);
+    // before the frame's first draw: moves ranges into free space closer to the start of their buffer, up to the
+    // configured number of bytes per frame
+    void defragment(VkCommandBuffer commandBuffer);
+    void printStats();
+};
+}
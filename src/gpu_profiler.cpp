@@ -0,0 +1,164 @@
+#include "gpu_profiler.h"
+
+namespace vmr {
+
+GpuProfiler::GpuProfiler(Device* device, uint32_t framesInFlight) : _device(device), _framesInFlight(framesInFlight) {
+    if (_device->pipelineStatisticsSupported()) {
+        createStatisticsPools();
+    } else {
+        std::cout<<"Pipeline statistics queries are not supported, fragment invocations will not be reported\n";
+    }
+
+    if (_device->capabilities().timestamps) {
+        _timestampPeriod = _device->capabilities().timestampPeriod;
+        createTimestampPools();
+    } else {
+        std::cout<<"Timestamp queries are not supported, GPU times will not be reported\n";
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (auto pool : _statisticsPools) {
+        vkDestroyQueryPool(_device->logical(), pool, nullptr);
+    }
+    for (auto pool : _timestampPools) {
+        vkDestroyQueryPool(_device->logical(), pool, nullptr);
+    }
+}
+
+void GpuProfiler::createStatisticsPools() {
+    _statisticsPools.resize(_framesInFlight);
+    _statisticsRecorded.resize(_framesInFlight, false);
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = 1;
+        poolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+        if (vkCreateQueryPool(_device->logical(), &poolInfo, nullptr, &_statisticsPools[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline statistics query pool!");
+        }
+    }
+}
+
+void GpuProfiler::createTimestampPools() {
+    _timestampPools.resize(_framesInFlight);
+    _timestampsRecorded.resize(_framesInFlight, std::vector<bool>(MAX_TIMESTAMP_SCOPES, false));
+    for (uint32_t i = 0; i < _framesInFlight; i++) {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = 2 * MAX_TIMESTAMP_SCOPES;
+
+        if (vkCreateQueryPool(_device->logical(), &poolInfo, nullptr, &_timestampPools[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+    }
+}
+
+int GpuProfiler::findScope(const std::string& name) const {
+    for (size_t i = 0; i < _scopes.size(); i++) {
+        if (_scopes[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+uint32_t GpuProfiler::scopeIndex(const std::string& name) {
+    int found = findScope(name);
+    if (found >= 0) {
+        return static_cast<uint32_t>(found);
+    }
+    if (_scopes.size() == MAX_TIMESTAMP_SCOPES) {
+        throw std::runtime_error("failed to add timestamp scope " + name + ", increase MAX_TIMESTAMP_SCOPES!");
+    }
+    _scopes.push_back({name});
+    return static_cast<uint32_t>(_scopes.size() - 1);
+}
+
+double GpuProfiler::timestampMs(const std::string& scope) const {
+    int found = findScope(scope);
+    return found < 0 ? 0.0 : _scopes[found].lastMs;
+}
+
+double GpuProfiler::averageTimestampMs(const std::string& scope) const {
+    int found = findScope(scope);
+    return found < 0 || _scopes[found].samples == 0 ? 0.0 : _scopes[found].totalMs / _scopes[found].samples;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t currentFrame) {
+    if (statisticsSupported()) {
+        vkCmdResetQueryPool(commandBuffer, _statisticsPools[currentFrame], 0, 1);
+    }
+    if (timestampsSupported()) {
+        vkCmdResetQueryPool(commandBuffer, _timestampPools[currentFrame], 0, 2 * MAX_TIMESTAMP_SCOPES);
+    }
+}
+
+void GpuProfiler::beginStatistics(VkCommandBuffer commandBuffer, uint32_t currentFrame) {
+    if (statisticsSupported()) {
+        vkCmdBeginQuery(commandBuffer, _statisticsPools[currentFrame], 0, 0);
+    }
+}
+
+void GpuProfiler::endStatistics(VkCommandBuffer commandBuffer, uint32_t currentFrame) {
+    if (statisticsSupported()) {
+        vkCmdEndQuery(commandBuffer, _statisticsPools[currentFrame], 0);
+        _statisticsRecorded[currentFrame] = true;
+    }
+}
+
+void GpuProfiler::beginTimestamp(VkCommandBuffer commandBuffer, uint32_t currentFrame, const std::string& scope) {
+    if (timestampsSupported()) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestampPools[currentFrame], 2 * scopeIndex(scope));
+    }
+}
+
+void GpuProfiler::endTimestamp(VkCommandBuffer commandBuffer, uint32_t currentFrame, const std::string& scope) {
+    if (timestampsSupported()) {
+        uint32_t index = scopeIndex(scope);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestampPools[currentFrame], 2 * index + 1);
+        _timestampsRecorded[currentFrame][index] = true;
+    }
+}
+
+bool GpuProfiler::collect(uint32_t currentFrame) {
+    bool collected = false;
+    if (statisticsSupported() && _statisticsRecorded[currentFrame]) {
+        uint64_t fragmentInvocations = 0;
+        VkResult result = vkGetQueryPoolResults(_device->logical(), _statisticsPools[currentFrame], 0, 1,
+            sizeof(fragmentInvocations), &fragmentInvocations, sizeof(fragmentInvocations), VK_QUERY_RESULT_64_BIT);
+        _statisticsRecorded[currentFrame] = false;
+        if (result == VK_SUCCESS) {
+            _fragmentInvocations = fragmentInvocations;
+            _fragmentInvocationsTotal += fragmentInvocations;
+            _statisticsFrames++;
+            collected = true;
+        }
+    }
+    if (!timestampsSupported()) {
+        return collected;
+    }
+    for (uint32_t i = 0; i < _scopes.size(); i++) {
+        if (!_timestampsRecorded[currentFrame][i]) {
+            continue;
+        }
+        _timestampsRecorded[currentFrame][i] = false;
+        uint64_t timestamps[2] = {};
+        VkResult result = vkGetQueryPoolResults(_device->logical(), _timestampPools[currentFrame], 2 * i, 2,
+            sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS) {
+            continue;
+        }
+        //timestampPeriod is in nanoseconds per tick
+        _scopes[i].lastMs = (timestamps[1] - timestamps[0]) * _timestampPeriod / 1e6;
+        _scopes[i].totalMs += _scopes[i].lastMs;
+        _scopes[i].samples++;
+        collected = true;
+    }
+    return collected;
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "device.h"
+
+namespace vmr {
+const uint32_t MAX_TIMESTAMP_SCOPES = 16;
+
+// Per-frame GPU queries. Results of a frame are read once its fence has signaled, so collecting never stalls.
+class GpuProfiler {
+private:
+    struct TimestampScope {
+        std::string name;
+        double lastMs = 0.0;
+        double totalMs = 0.0;
+        uint64_t samples = 0;
+    };
+
+    Device* _device;
+    uint32_t _framesInFlight;
+    std::vector<VkQueryPool> _statisticsPools;
+    std::vector<bool> _statisticsRecorded;
+    uint64_t _fragmentInvocations = 0;
+    uint64_t _fragmentInvocationsTotal = 0;
+    uint64_t _statisticsFrames = 0;
+    std::vector<VkQueryPool> _timestampPools;
+    std::vector<std::vector<bool>> _timestampsRecorded;
+    std::vector<TimestampScope> _scopes;
+    float _timestampPeriod = 0.0f;
+
+    void createStatisticsPools();
+    void createTimestampPools();
+    int findScope(const std::string& name) const;
+    uint32_t scopeIndex(const std::string& name);
+
+public:
+    GpuProfiler(Device* device, uint32_t framesInFlight);
+    ~GpuProfiler();
+    bool statisticsSupported()                  const { return !_statisticsPools.empty(); }
+    bool timestampsSupported()                  const { return !_timestampPools.empty(); }
+    uint64_t fragmentInvocations()              const { return _fragmentInvocations; }
+    double averageFragmentInvocations()         const { return _statisticsFrames == 0 ? 0.0 : _fragmentInvocationsTotal / (double) _statisticsFrames; }
+    double timestampMs(const std::string& scope) const;
+    double averageTimestampMs(const std::string& scope) const;
+
+    // has to be recorded outside of a render pass, before any other query of the frame
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+    // statistics scope has to begin and end within the same subpass
+    void beginStatistics(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+    void endStatistics(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+    // GPU time between the two points, scopes are created on first use
+    void beginTimestamp(VkCommandBuffer commandBuffer, uint32_t currentFrame, const std::string& scope);
+    void endTimestamp(VkCommandBuffer commandBuffer, uint32_t currentFrame, const std::string& scope);
+    // returns whether results of an earlier submission of this frame slot were read
+    bool collect(uint32_t currentFrame);
+};
+}
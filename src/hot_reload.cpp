@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+#include "hot_reload.h"
+
+namespace vmr {
+
+const std::vector<std::string> RESOURCES = {"shaders", "model", "texture", "normal map", "thickness map"};
+
+HotReload::HotReload(Device* device, AppConfig* appConfig, ThreadPool* threadPool, SwapChain* swapChain, ModelPipeline* modelPipeline,
+                     ShadowMap* shadowMap, CullingPass* cullingPass)
+            : _device(device), _configPath(appConfig->configPath()), _assets(*appConfig), _threadPool(threadPool), _swapChain(swapChain),
+              _modelPipeline(modelPipeline), _shadowMap(shadowMap), _cullingPass(cullingPass) {
+    _watcher.watch(_configPath);
+    watchResources(_assets, _assets);
+}
+
+HotReload::~HotReload() {
+    for (auto& [resource, reload] : _reloads) {
+        if (!reload.built) {
+            try {
+                reload.job.get();
+            } catch (const std::exception&) {
+                continue;
+            }
+        }
+        reload.discard();
+    }
+}
+
+std::vector<std::string> HotReload::resourcePaths(const AppConfig& config, const std::string& resource) {
+    if (resource == "shaders") {
+        return {config.modelVertexShaderPath(), config.modelFragmentShaderPath()};
+    } else if (resource == "model") {
+        return {config.displayModelPath()};
+    } else if (resource == "texture") {
+        return {config.modelTexturePath()};
+    } else if (resource == "normal map") {
+        return {config.modelNormalMapPath()};
+    }
+    return {config.thicknessMapPath()};
+}
+
+void HotReload::watchResources(const AppConfig& previous, const AppConfig& current) {
+    std::vector<std::string> paths;
+    for (const auto& resource : RESOURCES) {
+        for (const auto& path : resourcePaths(current, resource)) {
+            paths.push_back(path);
+        }
+    }
+    for (const auto& resource : RESOURCES) {
+        for (const auto& path : resourcePaths(previous, resource)) {
+            if (std::find(paths.begin(), paths.end(), path) == paths.end() && path != _configPath) {
+                _watcher.unwatch(path);
+            }
+        }
+    }
+    for (const auto& path : paths) {
+        _watcher.watch(path);
+    }
+}
+
+void HotReload::reloadConfig(Clock::time_point detected) {
+    //only the asset paths are picked up, every other setting still needs a restart
+    AppConfig previous = _assets;
+    //a config saved halfway through an edit keeps the previous paths until it parses again
+    try {
+        _assets = AppConfig(_configPath);
+    } catch (const std::exception& e) {
+        std::cerr<<"\nfailed to reload "<<_configPath<<": "<<e.what()<<std::endl;
+        _failures++;
+        return;
+    }
+    watchResources(previous, _assets);
+    for (const auto& resource : RESOURCES) {
+        if (resourcePaths(previous, resource) != resourcePaths(_assets, resource)) {
+            start(resource, detected);
+        }
+    }
+}
+
+void HotReload::start(const std::string& resource, Clock::time_point detected) {
+    if (_reloads.count(resource) != 0) {
+        //rebuilt once more after the current reload is swapped in, timed from the first change
+        _queued.emplace(resource, detected);
+        return;
+    }
+    std::vector<std::string> paths = resourcePaths(_assets, resource);
+    Reload reload;
+    reload.detected = detected;
+    if (resource == "shaders") {
+        ModelPipeline* modelPipeline = _modelPipeline;
+        reload.job = _threadPool->submit([modelPipeline, paths]() { modelPipeline->buildReloadedShaders(paths[0], paths[1]); });
+        reload.swapIn = [modelPipeline](VkCommandBuffer) { return modelPipeline->applyReloadedShaders(); };
+        reload.discard = [modelPipeline]() { modelPipeline->discardReloadedShaders(); };
+    } else if (resource == "model") {
+        ModelPipeline* modelPipeline = _modelPipeline;
+        ShadowMap* shadowMap = _shadowMap;
+        CullingPass* cullingPass = _cullingPass;
+        reload.job = _threadPool->submit([modelPipeline, paths]() { modelPipeline->loadReloadedModel(paths[0]); });
+        reload.swapIn = [modelPipeline, shadowMap, cullingPass](VkCommandBuffer commandBuffer) {
+            modelPipeline->applyReloadedModel(commandBuffer);
+            shadowMap->invalidate();
+            if (cullingPass) {
+                cullingPass->modelReloaded();
+            }
+            return true;
+        };
+        reload.discard = []() {};
+    } else {
+        TextureSlot slot = resource == "texture" ? TextureSlot::Albedo : resource == "normal map" ? TextureSlot::NormalMap : TextureSlot::Thickness;
+        SwapChain* swapChain = _swapChain;
+        ModelPipeline* modelPipeline = _modelPipeline;
+        VkDevice device = _device->logical();
+        auto staged = std::make_shared<StagedTexture>();
+        reload.job = _threadPool->submit([swapChain, staged, slot, paths]() { *staged = swapChain->stageTexture(slot, paths[0]); });
+        reload.swapIn = [swapChain, modelPipeline, staged](VkCommandBuffer commandBuffer) {
+            swapChain->replaceTexture(*staged, commandBuffer);
+            modelPipeline->refreshTextureDescriptors();
+            return true;
+        };
+        reload.discard = [device, staged]() {
+            vkDestroyBuffer(device, staged->buffer, nullptr);
+            vkFreeMemory(device, staged->memory, nullptr);
+        };
+    }
+    _reloads.emplace(resource, std::move(reload));
+}
+
+void HotReload::update(VkCommandBuffer commandBuffer) {
+    for (const auto& change : _watcher.takeChanges()) {
+        if (change.path == _configPath) {
+            reloadConfig(change.detected);
+            continue;
+        }
+        for (const auto& resource : RESOURCES) {
+            auto paths = resourcePaths(_assets, resource);
+            if (std::find(paths.begin(), paths.end(), change.path) != paths.end()) {
+                start(resource, change.detected);
+            }
+        }
+    }
+
+    std::vector<std::string> swapped;
+    for (auto& [resource, reload] : _reloads) {
+        if (!reload.built) {
+            if (reload.job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                continue;
+            }
+            try {
+                reload.job.get();
+                reload.built = true;
+            } catch (const std::exception& e) {
+                //the previous resource stays in use
+                std::cerr<<"\nfailed to reload the "<<resource<<": "<<e.what()<<std::endl;
+                _failures++;
+                swapped.push_back(resource);
+                continue;
+            }
+        }
+        if (!reload.swapIn(commandBuffer)) {
+            continue;
+        }
+        double latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - reload.detected).count();
+        Latency& latency = _latencies[resource];
+        latency.count++;
+        latency.totalMs += latencyMs;
+        latency.maxMs = std::max(latency.maxMs, latencyMs);
+        std::cout<<"\nReloaded the "<<resource<<" "<<latencyMs<<" ms after the change"<<std::endl;
+        swapped.push_back(resource);
+    }
+    for (const auto& resource : swapped) {
+        _reloads.erase(resource);
+        auto queued = _queued.find(resource);
+        if (queued != _queued.end()) {
+            Clock::time_point detected = queued->second;
+            _queued.erase(queued);
+            start(resource, detected);
+        }
+    }
+}
+
+void HotReload::printStats() {
+    if (_latencies.empty() && _failures == 0) {
+        return;
+    }
+    std::cout<<"Hot reloads (change to swap-in):";
+    for (const auto& [resource, latency] : _latencies) {
+        std::cout<<" "<<resource<<" "<<latency.count<<"x, avg "<<latency.totalMs / latency.count<<" ms, max "<<latency.maxMs<<" ms;";
+    }
+    std::cout<<" failed "<<_failures<<std::endl;
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "app_config.h"
+#include "culling_pass.h"
+#include "device.h"
+#include "file_watcher.h"
+#include "model_pipeline.h"
+#include "shadow_map.h"
+#include "swap_chain.h"
+#include "thread_pool.h"
+
+namespace vmr {
+// Rebuilds the model shaders, mesh and textures when their files (or their paths in the config) change. Only the
+// resource that changed is rebuilt, on a worker thread, and swapped in when the next frame starts recording, while
+// the frames still in flight keep using the previous one until the deletion queue releases it.
+class HotReload {
+private:
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct Reload {
+        Clock::time_point detected;
+        std::future<void> job;
+        bool built = false;
+        std::function<bool(VkCommandBuffer)> swapIn;    // false when the swap has to wait for a later frame
+        std::function<void()> discard;                  // frees what was built if it is never swapped in
+    };
+    struct Latency {
+        uint32_t count = 0;
+        double totalMs = 0.0;
+        double maxMs = 0.0;
+    };
+
+    Device* _device;
+    std::string _configPath;
+    AppConfig _assets;          // latest valid config read from disk, only its asset paths are used
+    ThreadPool* _threadPool;
+    SwapChain* _swapChain;
+    ModelPipeline* _modelPipeline;
+    ShadowMap* _shadowMap;
+    CullingPass* _cullingPass;
+    FileWatcher _watcher;
+    std::map<std::string, Reload> _reloads;             // in progress, by resource
+    std::map<std::string, Clock::time_point> _queued;   // changed again while being reloaded
+    std::map<std::string, Latency> _latencies;
+    uint32_t _failures = 0;
+
+    static std::vector<std::string> resourcePaths(const AppConfig& config, const std::string& resource);
+    void watchResources(const AppConfig& previous, const AppConfig& current);
+    void reloadConfig(Clock::time_point detected);
+    void start(const std::string& resource, Clock::time_point detected);
+
+public:
+    // cullingPass is null without culling
+    HotReload(Device* device, AppConfig* appConfig, ThreadPool* threadPool, SwapChain* swapChain, ModelPipeline* modelPipeline,
+              ShadowMap* shadowMap, CullingPass* cullingPass);
+    ~HotReload();
+
+    // at the start of recording a frame, uploads go into its command buffer ahead of the passes using them
+    void update(VkCommandBuffer commandBuffer);
+    void printStats();
+};
+}
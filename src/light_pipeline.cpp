@@ -3,8 +3,8 @@
 namespace vmr
 {
 
-LightPipeline::LightPipeline(Device *device, SwapChain *swapChain, AppConfig *appConfig, std::string vertPath, std::string fragPath, std::string modelPath)
-    : Pipeline(device, swapChain, appConfig, vertPath, fragPath, modelPath) {
+LightPipeline::LightPipeline(Device *device, SwapChain *swapChain, AppConfig *appConfig, GeometryArena *geometryArena, std::string vertPath, std::string fragPath, std::string modelPath)
+    : Pipeline(device, swapChain, appConfig, geometryArena, vertPath, fragPath, modelPath) {
     createDescriptorSetLayout();
     createGraphicsPipeline(vertPath, fragPath);
 };
@@ -109,23 +109,7 @@ void LightPipeline::createVertexBuffer() {
         }
     }
 
-    VkDeviceSize bufferSize = sizeof(podVertices[0]) * podVertices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    _device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(_device->logical(), stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, podVertices.data(), (size_t) bufferSize);
-    vkUnmapMemory(_device->logical(), stagingBufferMemory);
-
-    _device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vertexBuffer, _vertexBufferMemory);
-
-    _device->copyBuffer(stagingBuffer, _vertexBuffer, bufferSize);
-
-    vkDestroyBuffer(_device->logical(), stagingBuffer, nullptr);
-    vkFreeMemory(_device->logical(), stagingBufferMemory, nullptr);
+    _vertexRange = _geometryArena->addVertices(podVertices.data(), sizeof(podVertices[0]) * podVertices.size(), sizeof(podVertices[0]));
 }
 
 void LightPipeline::updateUniformBuffer(uint32_t currentImage) {
@@ -179,10 +163,8 @@ void LightPipeline::loadModel() {
 }
 
 void LightPipeline::createGraphicsPipeline(std::string vertPath, std::string fragPath) {
-    auto vertShaderCode = readFile(vertPath);
-    auto fragShaderCode = readFile(fragPath);
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    VkShaderModule vertShaderModule = _device->loadShaderModule(vertPath);
+    VkShaderModule fragShaderModule = _device->loadShaderModule(fragPath);
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -245,7 +227,7 @@ void LightPipeline::createGraphicsPipeline(std::string vertPath, std::string fra
     VkPipelineMultisampleStateCreateInfo multisampling{};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.rasterizationSamples = _swapChain->sampleCount();
     multisampling.minSampleShading = 1.0f; // Optional
     multisampling.pSampleMask = nullptr; // Optional
     multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
@@ -262,12 +244,17 @@ void LightPipeline::createGraphicsPipeline(std::string vertPath, std::string fra
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
     colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
 
+    //the light source does not scatter, its irradiance output stays cleared
+    VkPipelineColorBlendAttachmentState irradianceBlendAttachment = colorBlendAttachment;
+    irradianceBlendAttachment.colorWriteMask = 0;
+    std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments = {colorBlendAttachment, irradianceBlendAttachment};
+
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.attachmentCount = _appConfig->colorAttachmentCount();
+    colorBlending.pAttachments = colorBlendAttachments.data();
     colorBlending.blendConstants[0] = 0.0f; // Optional
     colorBlending.blendConstants[1] = 0.0f; // Optional
     colorBlending.blendConstants[2] = 0.0f; // Optional
@@ -307,7 +294,7 @@ void LightPipeline::createGraphicsPipeline(std::string vertPath, std::string fra
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = _pipelineLayout;
     pipelineInfo.renderPass = _swapChain->renderPass();
-    pipelineInfo.subpass = 0;
+    pipelineInfo.subpass = _appConfig->shadingSubpass();
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex = -1; // Optional
 
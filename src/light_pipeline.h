@@ -14,7 +14,7 @@ private:
     void createGraphicsPipeline(std::string vertPath, std::string fragPath);
 
 public:
-    LightPipeline(Device* device, SwapChain* swapChain, AppConfig* appConfig, std::string vertPath, std::string fragPath, std::string modelPath);
+    LightPipeline(Device* device, SwapChain* swapChain, AppConfig* appConfig, GeometryArena* geometryArena, std::string vertPath, std::string fragPath, std::string modelPath);
     void updateUniformBuffer(uint32_t currentImage) override;
     void prepareModel() override;
 
@@ -5,9 +5,10 @@
 #include "app.h"
 #include "app_config.h"
 
-int main() {
+int main(int argc, char** argv) {
     try {
-        vmr::AppConfig config = vmr::AppConfig("./config.json");
+        //another configuration may be passed, the render tests generate one per scene
+        vmr::AppConfig config = vmr::AppConfig(argc > 1 ? argv[1] : "./config.json");
         vmr::App app(&config);
         app.run();
     } catch (const std::exception& e) {
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "meshlet.h"
+
+namespace vmr {
+
+static void computeMeshletBounds(Meshlet& meshlet, const std::vector<uint32_t>& meshletVertices, const std::vector<glm::vec3>& positions,
+                                 const std::vector<glm::vec3>& normals, const std::vector<uint32_t>& indices) {
+    glm::vec3 minimum(std::numeric_limits<float>::max());
+    glm::vec3 maximum(std::numeric_limits<float>::lowest());
+    for (uint32_t vertex : meshletVertices) {
+        minimum = glm::min(minimum, positions[vertex]);
+        maximum = glm::max(maximum, positions[vertex]);
+    }
+    meshlet.bounds.center = (minimum + maximum) * 0.5f;
+    meshlet.bounds.radius = 0.0f;
+    for (uint32_t vertex : meshletVertices) {
+        meshlet.bounds.radius = std::max(meshlet.bounds.radius, glm::length(positions[vertex] - meshlet.bounds.center));
+    }
+
+    //face normals are oriented by the vertex normals, so the cone does not depend on the winding of the scan
+    std::vector<glm::vec3> faceNormals;
+    glm::vec3 normalSum(0.0f);
+    for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+        const glm::vec3& p0 = positions[indices[i]];
+        glm::vec3 faceNormal = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+        float area = glm::length(faceNormal);
+        if (area == 0.0f) {
+            continue;
+        }
+        faceNormal /= area;
+        if (glm::dot(faceNormal, normals[indices[i]] + normals[indices[i + 1]] + normals[indices[i + 2]]) < 0.0f) {
+            faceNormal = -faceNormal;
+        }
+        faceNormals.push_back(faceNormal);
+        normalSum += faceNormal;
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    float axisLength = glm::length(normalSum);
+    if (faceNormals.empty() || axisLength < 1e-6f) {
+        return;
+    }
+    meshlet.coneAxis = normalSum / axisLength;
+    float minimumDot = 1.0f;
+    for (const auto& faceNormal : faceNormals) {
+        minimumDot = std::min(minimumDot, glm::dot(faceNormal, meshlet.coneAxis));
+    }
+    //cones wider than a hemisphere can never be entirely back-facing
+    if (minimumDot > 0.0f) {
+        meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+}
+
+std::vector<Meshlet> buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, std::vector<uint32_t>& indices) {
+    const uint32_t noMeshlet = std::numeric_limits<uint32_t>::max();
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    //triangles adjacent to every vertex, stored as one array with per-vertex offsets
+    std::vector<uint32_t> adjacencyOffsets(positions.size() + 1, 0);
+    for (uint32_t index : indices) {
+        adjacencyOffsets[index + 1]++;
+    }
+    for (size_t i = 1; i < adjacencyOffsets.size(); i++) {
+        adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++) {
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            adjacency[adjacencyFill[indices[triangle * 3 + corner]]++] = triangle;
+        }
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> vertexMeshlet(positions.size(), noMeshlet);
+    std::vector<uint32_t> reordered;
+    reordered.reserve(indices.size());
+    std::vector<Meshlet> meshlets;
+
+    auto newVertexCount = [&](uint32_t triangle, uint32_t meshletIndex) {
+        uint32_t count = 0;
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            count += vertexMeshlet[indices[triangle * 3 + corner]] != meshletIndex;
+        }
+        return count;
+    };
+
+    uint32_t seed = 0;
+    while (true) {
+        while (seed < triangleCount && emitted[seed]) {
+            seed++;
+        }
+        if (seed == triangleCount) {
+            break;
+        }
+        uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+        Meshlet meshlet{};
+        meshlet.firstIndex = static_cast<uint32_t>(reordered.size());
+        std::vector<uint32_t> meshletVertices;
+        glm::vec3 positionSum(0.0f);
+
+        uint32_t triangle = seed;
+        while (true) {
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                uint32_t vertex = indices[triangle * 3 + corner];
+                if (vertexMeshlet[vertex] != meshletIndex) {
+                    vertexMeshlet[vertex] = meshletIndex;
+                    meshletVertices.push_back(vertex);
+                    positionSum += positions[vertex];
+                }
+                reordered.push_back(vertex);
+            }
+            emitted[triangle] = true;
+            meshlet.indexCount += 3;
+            if (meshlet.indexCount / 3 == MAX_MESHLET_TRIANGLES) {
+                break;
+            }
+
+            //next triangle shares a vertex with the meshlet, prefers the fewest new vertices and then the closest one
+            glm::vec3 centroid = positionSum / static_cast<float>(meshletVertices.size());
+            uint32_t best = noMeshlet;
+            uint32_t bestNewVertices = 4;
+            float bestDistance = std::numeric_limits<float>::max();
+            for (uint32_t vertex : meshletVertices) {
+                for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+                    uint32_t candidate = adjacency[a];
+                    if (emitted[candidate]) {
+                        continue;
+                    }
+                    uint32_t newVertices = newVertexCount(candidate, meshletIndex);
+                    if (meshletVertices.size() + newVertices > MAX_MESHLET_VERTICES) {
+                        continue;
+                    }
+                    glm::vec3 candidateCenter = (positions[indices[candidate * 3]] + positions[indices[candidate * 3 + 1]] + positions[indices[candidate * 3 + 2]]) / 3.0f;
+                    glm::vec3 offset = candidateCenter - centroid;
+                    float distance = glm::dot(offset, offset);
+                    if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance)) {
+                        best = candidate;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+            }
+            if (best == noMeshlet) {
+                break;
+            }
+            triangle = best;
+        }
+
+        meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+        computeMeshletBounds(meshlet, meshletVertices, positions, normals, reordered);
+        meshlets.push_back(meshlet);
+    }
+
+    indices = std::move(reordered);
+    return meshlets;
+}
+
+}
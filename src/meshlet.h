@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+
+namespace vmr {
+const uint32_t MAX_MESHLET_VERTICES = 64;
+const uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+// Cluster of neighbouring triangles occupying a contiguous range of the index buffer
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    BoundingSphere bounds;
+    // all triangle normals lie within the cone around coneAxis, coneCutoff = sin of its half-angle (1 if the cone is not usable)
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Layout of one entry of the MeshletBuffer read by the meshlet culling shader
+struct MeshletData {
+    alignas(16) glm::vec4 boundingSphere;
+    alignas(16) glm::vec4 cone;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t padding[2];
+};
+
+// Groups triangles into meshlets of at most MAX_MESHLET_VERTICES unique vertices and MAX_MESHLET_TRIANGLES triangles,
+// growing each one across shared vertices. Indices are reordered so that every meshlet is a contiguous range.
+std::vector<Meshlet> buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, std::vector<uint32_t>& indices);
+}
@@ -1,50 +1,109 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
 #include "model_pipeline.h"
 
 namespace vmr{
 
-ModelPipeline::ModelPipeline(Device* device, SwapChain* swapChain, AppConfig* appConfig, std::string vertPath, std::string fragPath, std::string modelPath) 
-            : Pipeline(device, swapChain, appConfig, vertPath, fragPath, modelPath){
+ModelPipeline::ModelPipeline(Device* device, SwapChain* swapChain, AppConfig* appConfig, ThreadPool* threadPool, Scene* scene, ClusteredLighting* clusteredLighting, ShadowMap* shadowMap, BindlessHeap* bindlessHeap, GeometryArena* geometryArena, std::string vertPath, std::string fragPath, std::string modelPath) 
+            : Pipeline(device, swapChain, appConfig, geometryArena, vertPath, fragPath, modelPath), _threadPool(threadPool), _scene(scene), _clusteredLighting(clusteredLighting), _shadowMap(shadowMap), _bindlessHeap(bindlessHeap){
     createDescriptorSetLayout();
     createGraphicsPipeline(vertPath, fragPath);
 };
 
+ModelPipeline::~ModelPipeline() {
+    for (auto& build : _variantBuilds) {
+        build.wait();
+    }
+    for (auto& [variant, pipeline] : _variants) {
+        if (pipeline != _graphicsPipeline) { // fallback pipeline is destroyed by the base class
+            vkDestroyPipeline(_device->logical(), pipeline, nullptr);
+        }
+    }
+    for (size_t i = 0; i < _instanceBuffers.size(); i++) {
+        vkDestroyBuffer(_device->logical(), _instanceBuffers[i], nullptr);
+        vkFreeMemory(_device->logical(), _instanceBuffersMemory[i], nullptr);
+    }
+    vkDestroyPipeline(_device->logical(), _depthPipeline, nullptr);
+    vkDestroyPipeline(_device->logical(), _shadowPipeline, nullptr);
+    vkDestroyBuffer(_device->logical(), _meshletBuffer, nullptr);
+    vkFreeMemory(_device->logical(), _meshletBufferMemory, nullptr);
+    delete _skinLut;
+    delete _environmentLighting;
+    vkDestroyPipelineCache(_device->logical(), _pipelineCache, nullptr);
+    vkDestroyShaderModule(_device->logical(), _fragShaderModule, nullptr);
+    vkDestroyShaderModule(_device->logical(), _vertShaderModule, nullptr);
+}
+
 void ModelPipeline::prepareModel() {
     loadModel();
-    prepareTangentSpace();
+    prepareTangentSpace(_vertices, _indices);
+    _meshlets = clusterMeshlets(_vertices, _indices);
     createVertexBuffer();
     createIndexBuffer();
+    createMeshletBuffer();
     createUniformBuffers();
+    createInstanceBuffers();
+    _skinLut = new SkinLut(_device, _appConfig);
+    _environmentLighting = new EnvironmentLighting(_device, _appConfig);
     createDescriptorPool();
     createDescriptorSets();
+    registerMaterials();
 }
 
-void ModelPipeline::createVertexBuffer() {
-    std::vector<Vertex> podVertices;
-    for (const auto& variant : _vertices) {
-        if (const Vertex* pval = std::get_if<Vertex>(&variant)) {
-            podVertices.push_back(*pval);
-        }
+void ModelPipeline::registerMaterials() {
+    _textureViews = {_swapChain->textureImageView(), _swapChain->normalMapImageView(), _swapChain->thicknessMapImageView()};
+    for (size_t i = 0; i < _textureViews.size(); i++) {
+        _textureSlots[i] = _bindlessHeap->addTexture(_textureViews[i], _swapChain->textureSampler());
     }
+    //every config material shares the model's textures and differs in its surface parameters
+    for (const auto& definition : _appConfig->materials()) {
+        _materialIndices.push_back(_bindlessHeap->addMaterial(materialData(definition)));
+    }
+}
 
-    VkDeviceSize bufferSize = sizeof(podVertices[0]) * podVertices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    _device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(_device->logical(), stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, podVertices.data(), (size_t) bufferSize);
-    vkUnmapMemory(_device->logical(), stagingBufferMemory);
-
-    _device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vertexBuffer, _vertexBufferMemory);
-
-    _device->copyBuffer(stagingBuffer, _vertexBuffer, bufferSize);
+Material ModelPipeline::materialData(const MaterialDefinition& definition) {
+    Material material{};
+    material.albedoTexture = _textureSlots[0];
+    material.normalMapTexture = _textureSlots[1];
+    material.thicknessTexture = _textureSlots[2];
+    material.tint = glm::vec4(definition.tint, 1.0f);
+    material.roughness = definition.roughness;
+    material.ior = definition.ior;
+    material.ambient = definition.ambient;
+    return material;
+}
 
-    vkDestroyBuffer(_device->logical(), stagingBuffer, nullptr);
-    vkFreeMemory(_device->logical(), stagingBufferMemory, nullptr);
+void ModelPipeline::createVertexBuffer() {
+    std::vector<char> streams = vertexStreams(_vertices, _positionStreamOffset);
+    _vertexRange = _geometryArena->addVertices(streams.data(), streams.size(), sizeof(Vertex));
 }
 
+std::vector<char> ModelPipeline::vertexStreams(const std::vector<std::variant<Vertex, BasicVertex>>& vertices, VkDeviceSize& positionStreamOffset) {
+    std::vector<Vertex> podVertices;
+    for (const auto& variant : vertices) {
+        podVertices.push_back(std::get<Vertex>(variant));
+    }
+    VkDeviceSize size = sizeof(podVertices[0]) * podVertices.size();
+    positionStreamOffset = 0;
+    std::vector<char> streams;
+    if (_appConfig->depthPrePass()) {
+        //the pre-pass only needs positions, which keeps its vertex fetch at a fraction of the full vertex size;
+        //they start at a multiple of their own stride so the range's vertexOffset also indexes them
+        positionStreamOffset = (size + sizeof(glm::vec3) - 1) / sizeof(glm::vec3) * sizeof(glm::vec3);
+        streams.resize(positionStreamOffset + sizeof(glm::vec3) * podVertices.size());
+        auto positions = reinterpret_cast<glm::vec3*>(streams.data() + positionStreamOffset);
+        for (size_t i = 0; i < podVertices.size(); i++) {
+            positions[i] = podVertices[i].pos;
+        }
+    } else {
+        streams.resize(size);
+    }
+    memcpy(streams.data(), podVertices.data(), (size_t) size);
+    return streams;
+}
 
 void ModelPipeline::createUniformBuffers() {
     VkDeviceSize bufferSize =  sizeof( ModelUniformBufferObject);
@@ -60,14 +119,44 @@ void ModelPipeline::createUniformBuffers() {
     }
 }
 
+void ModelPipeline::createInstanceBuffers() {
+    //sized for the largest instance count the scene may reach (including benchmark steps)
+    VkDeviceSize bufferSize = sizeof(InstanceData) * _scene->capacity();
+
+    _instanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    _instanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    _instanceBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    _instanceBufferVersions.resize(MAX_FRAMES_IN_FLIGHT, 0);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        _device->createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, _instanceBuffers[i], _instanceBuffersMemory[i]);
+
+        vkMapMemory(_device->logical(), _instanceBuffersMemory[i], 0, bufferSize, 0, &_instanceBuffersMapped[i]);
+    }
+}
+
 void ModelPipeline::createDescriptorPool() {
-    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    std::array<VkDescriptorPoolSize, 10> poolSizes{};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
     poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[3].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[4].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[4].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[5].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[5].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[6].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[6].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[7].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[7].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[8].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[8].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[9].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[9].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -99,17 +188,42 @@ void ModelPipeline::createDescriptorSets() {
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof( ModelUniformBufferObject);
 
-        VkDescriptorImageInfo textureImageInfo{};
-        textureImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        textureImageInfo.imageView = _swapChain->textureImageView();
-        textureImageInfo.sampler = _swapChain->textureSampler();
+        VkDescriptorImageInfo skinLutImageInfo{};
+        skinLutImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        skinLutImageInfo.imageView = _skinLut->imageView();
+        skinLutImageInfo.sampler = _skinLut->sampler();
+
+        VkDescriptorImageInfo specularMapImageInfo{};
+        specularMapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        specularMapImageInfo.imageView = _environmentLighting->specularView();
+        specularMapImageInfo.sampler = _environmentLighting->sampler();
 
-        VkDescriptorImageInfo normalMapImageInfo{};
-        normalMapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        normalMapImageInfo.imageView = _swapChain->normalMapImageView();
-        normalMapImageInfo.sampler = _swapChain->textureSampler();
+        VkDescriptorImageInfo irradianceMapImageInfo{};
+        irradianceMapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        irradianceMapImageInfo.imageView = _environmentLighting->irradianceView();
+        irradianceMapImageInfo.sampler = _environmentLighting->sampler();
 
-        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+        VkDescriptorImageInfo brdfLutImageInfo{};
+        brdfLutImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        brdfLutImageInfo.imageView = _environmentLighting->brdfLutView();
+        brdfLutImageInfo.sampler = _environmentLighting->sampler();
+
+        VkDescriptorImageInfo shadowMapImageInfo{};
+        shadowMapImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        shadowMapImageInfo.imageView = _shadowMap->imageView();
+        shadowMapImageInfo.sampler = _shadowMap->sampler();
+
+        VkDescriptorBufferInfo instanceBufferInfo{};
+        instanceBufferInfo.buffer = _instanceBuffers[i];
+        instanceBufferInfo.offset = 0;
+        instanceBufferInfo.range = VK_WHOLE_SIZE;
+
+        std::array<VkDescriptorBufferInfo, 3> lightBufferInfos{};
+        lightBufferInfos[0] = {_clusteredLighting->lightBuffer(i), 0, VK_WHOLE_SIZE};
+        lightBufferInfos[1] = {_clusteredLighting->lightGridBuffer(i), 0, VK_WHOLE_SIZE};
+        lightBufferInfos[2] = {_clusteredLighting->lightIndexBuffer(i), 0, VK_WHOLE_SIZE};
+
+        std::array<VkWriteDescriptorSet, 10> descriptorWrites{};
 
         descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[0].dstSet = _descriptorSets[i];
@@ -119,23 +233,64 @@ void ModelPipeline::createDescriptorSets() {
         descriptorWrites[0].descriptorCount = 1;
         descriptorWrites[0].pBufferInfo = &bufferInfo;
 
-
         descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[1].dstSet = _descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstBinding = 3;
         descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &textureImageInfo;
+        descriptorWrites[1].pBufferInfo = &instanceBufferInfo;
 
         descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[2].dstSet = _descriptorSets[i];
-        descriptorWrites[2].dstBinding = 2;
+        descriptorWrites[2].dstBinding = 5;
         descriptorWrites[2].dstArrayElement = 0;
         descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         descriptorWrites[2].descriptorCount = 1;
-        descriptorWrites[2].pImageInfo = &normalMapImageInfo;
-        
+        descriptorWrites[2].pImageInfo = &skinLutImageInfo;
+
+        descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[3].dstSet = _descriptorSets[i];
+        descriptorWrites[3].dstBinding = 6;
+        descriptorWrites[3].dstArrayElement = 0;
+        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[3].descriptorCount = 1;
+        descriptorWrites[3].pImageInfo = &specularMapImageInfo;
+
+        descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[4].dstSet = _descriptorSets[i];
+        descriptorWrites[4].dstBinding = 7;
+        descriptorWrites[4].dstArrayElement = 0;
+        descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[4].descriptorCount = 1;
+        descriptorWrites[4].pImageInfo = &irradianceMapImageInfo;
+
+        descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[5].dstSet = _descriptorSets[i];
+        descriptorWrites[5].dstBinding = 8;
+        descriptorWrites[5].dstArrayElement = 0;
+        descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[5].descriptorCount = 1;
+        descriptorWrites[5].pImageInfo = &brdfLutImageInfo;
+
+        //point lights, the cluster grid and the light index list at bindings 9 to 11
+        for (uint32_t light = 0; light < lightBufferInfos.size(); light++) {
+            descriptorWrites[6 + light].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[6 + light].dstSet = _descriptorSets[i];
+            descriptorWrites[6 + light].dstBinding = 9 + light;
+            descriptorWrites[6 + light].dstArrayElement = 0;
+            descriptorWrites[6 + light].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[6 + light].descriptorCount = 1;
+            descriptorWrites[6 + light].pBufferInfo = &lightBufferInfos[light];
+        }
+
+        descriptorWrites[9].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[9].dstSet = _descriptorSets[i];
+        descriptorWrites[9].dstBinding = 12;
+        descriptorWrites[9].dstArrayElement = 0;
+        descriptorWrites[9].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[9].descriptorCount = 1;
+        descriptorWrites[9].pImageInfo = &shadowMapImageInfo;
 
         vkUpdateDescriptorSets(_device->logical(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
@@ -149,21 +304,60 @@ void ModelPipeline::createDescriptorSetLayout() {
     uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-    samplerLayoutBinding.binding = 1;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    VkDescriptorSetLayoutBinding normalMapLayoutBinding{};
-    normalMapLayoutBinding.binding = 2;
-    normalMapLayoutBinding.descriptorCount = 1;
-    normalMapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    normalMapLayoutBinding.pImmutableSamplers = nullptr;
-    normalMapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    std::array<VkDescriptorSetLayoutBinding, 3> bindings = {uboLayoutBinding, samplerLayoutBinding, normalMapLayoutBinding};
+    VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+    instanceLayoutBinding.binding = 3;
+    instanceLayoutBinding.descriptorCount = 1;
+    instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    instanceLayoutBinding.pImmutableSamplers = nullptr;
+    instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding skinLutLayoutBinding{};
+    skinLutLayoutBinding.binding = 5;
+    skinLutLayoutBinding.descriptorCount = 1;
+    skinLutLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    skinLutLayoutBinding.pImmutableSamplers = nullptr;
+    skinLutLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding specularMapLayoutBinding{};
+    specularMapLayoutBinding.binding = 6;
+    specularMapLayoutBinding.descriptorCount = 1;
+    specularMapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    specularMapLayoutBinding.pImmutableSamplers = nullptr;
+    specularMapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding irradianceMapLayoutBinding{};
+    irradianceMapLayoutBinding.binding = 7;
+    irradianceMapLayoutBinding.descriptorCount = 1;
+    irradianceMapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    irradianceMapLayoutBinding.pImmutableSamplers = nullptr;
+    irradianceMapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding brdfLutLayoutBinding{};
+    brdfLutLayoutBinding.binding = 8;
+    brdfLutLayoutBinding.descriptorCount = 1;
+    brdfLutLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    brdfLutLayoutBinding.pImmutableSamplers = nullptr;
+    brdfLutLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 3> lightLayoutBindings{};
+    for (uint32_t light = 0; light < lightLayoutBindings.size(); light++) {
+        lightLayoutBindings[light].binding = 9 + light;
+        lightLayoutBindings[light].descriptorCount = 1;
+        lightLayoutBindings[light].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightLayoutBindings[light].pImmutableSamplers = nullptr;
+        lightLayoutBindings[light].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutBinding shadowMapLayoutBinding{};
+    shadowMapLayoutBinding.binding = 12;
+    shadowMapLayoutBinding.descriptorCount = 1;
+    shadowMapLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    shadowMapLayoutBinding.pImmutableSamplers = nullptr;
+    shadowMapLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    //the model's textures are sampled through the bindless heap at set 1
+    std::array<VkDescriptorSetLayoutBinding, 10> bindings = {uboLayoutBinding, instanceLayoutBinding, skinLutLayoutBinding, specularMapLayoutBinding, irradianceMapLayoutBinding, brdfLutLayoutBinding,
+                                                             lightLayoutBindings[0], lightLayoutBindings[1], lightLayoutBindings[2], shadowMapLayoutBinding};
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -178,27 +372,132 @@ void ModelPipeline::updateUniformBuffer(uint32_t currentImage) {
     glm::vec3 cameraPos = _appConfig->observerPosition();
     auto cameraFront = glm::normalize(_appConfig->cameraFront());
     auto view = glm::lookAt(cameraPos, cameraPos + cameraFront, _appConfig->cameraUp());
-    auto proj = glm::perspective(glm::radians(70.0f), _swapChain->extent().width / (float) _swapChain->extent().height, 0.05f, 100.0f);
+    auto proj = glm::perspective(glm::radians(70.0f), _swapChain->extent().width / (float) _swapChain->extent().height, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
     proj[1][1] *= -1; // coordinate flip due to opposite Y in Vulkan vs OpenGL
 
+    _view = view;
+    _projection = proj;
+    _viewProjection = proj * view;
+
     ModelUniformBufferObject ubo{};
-    auto rotate = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    rotate = glm::rotate(rotate, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    auto scale = glm::scale(rotate, glm::vec3(0.5f, 0.5f, 0.5f));
-    ubo.model = scale;
     ubo.view = view;
     ubo.proj = proj;
     ubo.position = cameraPos;
     ubo.lightPosition = _appConfig->lightPosition();
+    //depth slices are spaced exponentially between the near and far plane, as in the light clustering pass
+    glm::uvec3 grid = _clusteredLighting->grid();
+    float sliceScale = grid.z / std::log(CAMERA_FAR_PLANE / CAMERA_NEAR_PLANE);
+    ubo.clusterScale = glm::vec4(grid.x / (float) _swapChain->renderExtent().width, grid.y / (float) _swapChain->renderExtent().height,
+                                 sliceScale, -sliceScale * std::log(CAMERA_NEAR_PLANE));
+    ubo.clusterGrid = glm::uvec4(grid, _clusteredLighting->lightCount());
+    for (uint32_t face = 0; face < SHADOW_MAP_FACES; face++) {
+        ubo.shadowFaces[face] = _shadowMap->faceViewProjection(face);
+    }
+    ubo.shadowParams = _shadowMap->parameters();
     memcpy(_uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+
+    //instances are static most of the time, so each frame's copy is only refreshed after the scene changes
+    if (_instanceBufferVersions[currentImage] != _scene->version()) {
+        memcpy(_instanceBuffersMapped[currentImage], _scene->instances().data(), sizeof(InstanceData) * _scene->instanceCount());
+        _instanceBufferVersions[currentImage] = _scene->version();
+    }
+}
+
+void ModelPipeline::draw(VkCommandBuffer& commandBuffer, int currentFrame) {
+    //one instanced draw for every instance of the mesh
+    bind(commandBuffer, currentFrame, _scene->instanceCount());
+}
+
+void ModelPipeline::bindDepthResources(VkCommandBuffer& commandBuffer, int currentFrame) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthPipeline);
+
+    //bound so that the model's vertexOffset, in whole vertices, lands on the start of its positions; the
+    //index buffer is the arena's, bound once for the command buffer
+    VkBuffer vertexBuffers[] = {_geometryArena->vertexBuffer()};
+    VkDeviceSize offsets[] = {_geometryArena->byteOffset(_vertexRange) + _positionStreamOffset - vertexOffset() * sizeof(glm::vec3)};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSets[currentFrame], 0, nullptr);
+}
+
+void ModelPipeline::bindShadowResources(VkCommandBuffer& commandBuffer, int currentFrame) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSets[currentFrame], 0, nullptr);
+}
+
+void ModelPipeline::pushShadowFace(VkCommandBuffer& commandBuffer, const glm::mat4& viewProjection) {
+    vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProjection);
+}
+
+void ModelPipeline::bindMaterials(VkCommandBuffer& commandBuffer, int currentFrame) {
+    _bindlessHeap->bind(commandBuffer, _pipelineLayout, 1, currentFrame);
+    pushMaterial(commandBuffer, _materialIndices[0]);
+}
+
+void ModelPipeline::pushMaterial(VkCommandBuffer& commandBuffer, uint32_t materialIndex) {
+    vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, MATERIAL_PUSH_CONSTANT_OFFSET, sizeof(uint32_t), &materialIndex);
+}
+
+uint32_t ModelPipeline::materialPipeline(uint32_t material) const {
+    return static_cast<uint32_t>(_appConfig->materials()[material].shaderVariant + 1);
+}
+
+void ModelPipeline::writeInstances(int currentFrame, const std::vector<uint32_t>& order) {
+    //rewritten every frame, the order follows the camera even when the scene does not change
+    const auto& instances = _scene->instances();
+    auto mapped = static_cast<InstanceData*>(_instanceBuffersMapped[currentFrame]);
+    for (size_t i = 0; i < order.size(); i++) {
+        mapped[i] = instances[order[i]];
+    }
+}
+
+uint64_t ModelPipeline::drawBatches(VkCommandBuffer& commandBuffer, int currentFrame, const RenderQueue& queue, bool depthOnly, StateChanges& changes) {
+    if (depthOnly) {
+        //the depth pipeline ignores materials, the batches only keep the draws in the shading pass's order
+        for (const auto& batch : queue.batches()) {
+            vkCmdDrawIndexed(commandBuffer, indexCount(), batch.instanceCount, firstIndex(), vertexOffset(), batch.firstInstance);
+        }
+        return 0;
+    }
+
+    //the per-frame set and the heap stay bound across pipelines sharing the layout
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSets[currentFrame], 0, nullptr);
+    _bindlessHeap->bind(commandBuffer, _pipelineLayout, 1, currentFrame);
+    changes.descriptorSetBinds += 2;
+
+    uint32_t boundPipeline = HIDDEN_PIPELINE, pushedMaterial = UINT32_MAX;
+    uint64_t drawnInstances = 0;
+    for (const auto& batch : queue.batches()) {
+        if (batch.pipeline != boundPipeline) {
+            VkPipeline pipeline = batch.pipeline == 0 ? requestVariant(_appConfig->shaderVariant())
+                                                      : requestVariant(_appConfig->shaderVariants()[batch.pipeline - 1]);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            boundPipeline = batch.pipeline;
+            changes.pipelineBinds++;
+        }
+        if (batch.material != pushedMaterial) {
+            pushMaterial(commandBuffer, _materialIndices[batch.material]);
+            pushedMaterial = batch.material;
+            changes.materialPushes++;
+        }
+        vkCmdDrawIndexed(commandBuffer, indexCount(), batch.instanceCount, firstIndex(), vertexOffset(), batch.firstInstance);
+        changes.draws++;
+        drawnInstances += batch.instanceCount;
+    }
+
+    //an unsorted submission draws every instance on its own, binding its pipeline and pushing its material before each
+    //draw, with the same two sets bound once; the geometry arena is bound for the frame either way
+    uint64_t naiveBinds = 2 + 2 * drawnInstances;
+    uint64_t issuedBinds = changes.pipelineBinds + changes.descriptorSetBinds + changes.materialPushes;
+    return naiveBinds > issuedBinds ? naiveBinds - issuedBinds : 0;
 }
 
-void ModelPipeline::prepareTangentSpace(){
+void ModelPipeline::prepareTangentSpace(std::vector<std::variant<Vertex, BasicVertex>>& vertices, const std::vector<uint32_t>& indices){
     auto getVertexAtIndex = [&](int index) -> Vertex&{
-        return std::get<Vertex>(_vertices.at(_indices.at(index)));
+        return std::get<Vertex>(vertices.at(indices.at(index)));
     };
 
-    for (int i = 0; i < _indices.size(); i += 3) {
+    for (int i = 0; i < indices.size(); i += 3) {
         glm::vec3 v1 = getVertexAtIndex(i).pos;
         glm::vec3 v2 = getVertexAtIndex(i+1).pos;
         glm::vec3 v3 = getVertexAtIndex(i+2).pos;
@@ -225,12 +524,18 @@ void ModelPipeline::prepareTangentSpace(){
 }
 
 void ModelPipeline::loadModel() {
+    loadMesh(_modelPath, _vertices, _indices);
+    _boundingSphere = computeBoundingSphere(_vertices);
+    printModelInfo();
+}
+
+void ModelPipeline::loadMesh(const std::string& path, std::vector<std::variant<Vertex, BasicVertex>>& vertices, std::vector<uint32_t>& indices) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string warn, err;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, _modelPath.c_str())) {
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
         throw std::runtime_error(warn + err);
     }
 
@@ -258,20 +563,405 @@ void ModelPipeline::loadModel() {
             };
 
             if (uniqueVertices.count(vertex) == 0) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(_vertices.size());
-                _vertices.push_back(vertex);
+                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(vertex);
             }
-            _indices.push_back(uniqueVertices[vertex]);
+            indices.push_back(uniqueVertices[vertex]);
         }
     }
-    printModelInfo();
+}
+
+BoundingSphere ModelPipeline::computeBoundingSphere(const std::vector<std::variant<Vertex, BasicVertex>>& vertices) {
+    glm::vec3 minimum(std::numeric_limits<float>::max());
+    glm::vec3 maximum(std::numeric_limits<float>::lowest());
+    for (const auto& variant : vertices) {
+        const Vertex& vertex = std::get<Vertex>(variant);
+        minimum = glm::min(minimum, vertex.pos);
+        maximum = glm::max(maximum, vertex.pos);
+    }
+    BoundingSphere boundingSphere;
+    boundingSphere.center = (minimum + maximum) * 0.5f;
+    boundingSphere.radius = 0.0f;
+    for (const auto& variant : vertices) {
+        boundingSphere.radius = std::max(boundingSphere.radius, glm::length(std::get<Vertex>(variant).pos - boundingSphere.center));
+    }
+    return boundingSphere;
+}
+
+std::vector<Meshlet> ModelPipeline::clusterMeshlets(const std::vector<std::variant<Vertex, BasicVertex>>& vertices, std::vector<uint32_t>& indices) {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    positions.reserve(vertices.size());
+    normals.reserve(vertices.size());
+    for (const auto& variant : vertices) {
+        positions.push_back(std::get<Vertex>(variant).pos);
+        normals.push_back(std::get<Vertex>(variant).normal);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<Meshlet> meshlets = buildMeshlets(positions, normals, indices);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    uint32_t vertexCount = 0;
+    for (const auto& meshlet : meshlets) {
+        vertexCount += meshlet.vertexCount;
+    }
+    std::cout<<"Built "<<meshlets.size()<<" meshlets (avg "<<vertexCount / (float) meshlets.size()<<" vertices, "
+             <<indices.size() / 3.0f / meshlets.size()<<" triangles) in "
+             <<std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count()<<" ms\n";
+    return meshlets;
+}
+
+std::vector<MeshletData> ModelPipeline::meshletData(const std::vector<Meshlet>& meshlets) {
+    std::vector<MeshletData> meshletData;
+    for (const auto& meshlet : meshlets) {
+        MeshletData data{};
+        data.boundingSphere = glm::vec4(meshlet.bounds.center, meshlet.bounds.radius);
+        data.cone = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+        data.firstIndex = meshlet.firstIndex;
+        data.indexCount = meshlet.indexCount;
+        meshletData.push_back(data);
+    }
+    return meshletData;
+}
+
+void ModelPipeline::createMeshletBuffer() {
+    std::vector<MeshletData> meshletData = this->meshletData(_meshlets);
+
+    VkDeviceSize bufferSize = sizeof(meshletData[0]) * meshletData.size();
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    _device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(_device->logical(), stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, meshletData.data(), (size_t) bufferSize);
+    vkUnmapMemory(_device->logical(), stagingBufferMemory);
+
+    _device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _meshletBuffer, _meshletBufferMemory);
+
+    _device->copyBuffer(stagingBuffer, _meshletBuffer, bufferSize);
+
+    vkDestroyBuffer(_device->logical(), stagingBuffer, nullptr);
+    vkFreeMemory(_device->logical(), stagingBufferMemory, nullptr);
 }
 
 void ModelPipeline::createGraphicsPipeline(std::string vertPath, std::string fragPath) {
-    auto vertShaderCode = readFile(vertPath);
-    auto fragShaderCode = readFile(fragPath);
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    _vertShaderModule = _device->loadShaderModule(vertPath);
+    _fragShaderModule = _device->loadShaderModule(fragPath);
+
+    VkPipelineCacheCreateInfo pipelineCacheInfo{};
+    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    if (vkCreatePipelineCache(_device->logical(), &pipelineCacheInfo, nullptr, &_pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+
+    //set 1 is the bindless heap holding the model's textures and materials
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {_descriptorSetLayout, _bindlessHeap->layout()};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    //the shadow pass pushes the view-projection of the atlas face it draws, the shading pass the material index
+    std::array<VkPushConstantRange, 2> pushConstantRanges{};
+    pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRanges[0].offset = 0;
+    pushConstantRanges[0].size = sizeof(glm::mat4);
+    pushConstantRanges[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRanges[1].offset = MATERIAL_PUSH_CONSTANT_OFFSET;
+    pushConstantRanges[1].size = sizeof(uint32_t);
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+    
+    if (vkCreatePipelineLayout(_device->logical(), &pipelineLayoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    if (_appConfig->depthPrePass()) {
+        createDepthPipeline();
+    }
+    createShadowPipeline();
+
+    //every variant listed in the config is compiled up front on the worker threads
+    _startupVariant = _appConfig->shaderVariant();
+    buildVariantAsync(_startupVariant);
+    for (const auto& variant : _appConfig->shaderVariants()) {
+        buildVariantAsync(variant);
+    }
+    auto startupBuilds = std::move(_variantBuilds);
+    _variantBuilds.clear();
+    for (auto& build : startupBuilds) {
+        build.get();
+    }
+    std::cout<<"Built "<<_variants.size()<<" shader variant(s) on "<<_threadPool->workerCount()<<" worker thread(s)\n";
+
+    //the variant active at startup doubles as the fallback used while requested variants are still compiling
+    _graphicsPipeline = _variants.at(_startupVariant);
+}
+
+void ModelPipeline::buildVariantAsync(const ShaderVariant& variant) {
+    VkShaderModule vertShaderModule;
+    VkShaderModule fragShaderModule;
+    {
+        std::lock_guard<std::mutex> lock(_variantsMutex);
+        if (_variants.count(variant) != 0 || _pendingVariants.count(variant) != 0) {
+            return;
+        }
+        _pendingVariants.insert(variant);
+        //a shader reload only swaps the modules once no build is using them
+        vertShaderModule = _vertShaderModule;
+        fragShaderModule = _fragShaderModule;
+    }
+    _variantBuilds.push_back(_threadPool->submit([this, variant, vertShaderModule, fragShaderModule]() {
+        VkPipeline pipeline;
+        try {
+            pipeline = createVariantPipeline(variant, vertShaderModule, fragShaderModule);
+        } catch (const std::exception& e) {
+            //the variant stays pending, so the fallback keeps being used instead of retrying every frame
+            std::cerr<<"\nfailed to build shader variant ("<<variant.name()<<"): "<<e.what()<<std::endl;
+            throw;
+        }
+        std::lock_guard<std::mutex> lock(_variantsMutex);
+        _pendingVariants.erase(variant);
+        _variants[variant] = pipeline;
+    }));
+}
+
+VkPipeline ModelPipeline::requestVariant(const ShaderVariant& variant) {
+    {
+        std::lock_guard<std::mutex> lock(_variantsMutex);
+        auto found = _variants.find(variant);
+        if (found != _variants.end()) {
+            return found->second;
+        }
+    }
+    buildVariantAsync(variant);
+    return _graphicsPipeline;
+}
+
+bool ModelPipeline::isVariantReady(const ShaderVariant& variant) {
+    std::lock_guard<std::mutex> lock(_variantsMutex);
+    return _variants.count(variant) != 0;
+}
+
+void ModelPipeline::buildReloadedShaders(const std::string& vertPath, const std::string& fragPath) {
+    ReloadedShaders reloaded;
+    reloaded.vertShaderModule = _device->loadShaderModule(vertPath);
+    try {
+        reloaded.fragShaderModule = _device->loadShaderModule(fragPath);
+    } catch (...) {
+        //a reload failing to compile keeps the running shaders, nothing of it may outlive the attempt
+        vkDestroyShaderModule(_device->logical(), reloaded.vertShaderModule, nullptr);
+        throw;
+    }
+
+    //every variant built so far is rebuilt, variants requested meanwhile are dropped on the swap and built again on use;
+    //the fallback always is, whatever variant is active
+    std::vector<ShaderVariant> variants = {_startupVariant};
+    {
+        std::lock_guard<std::mutex> lock(_variantsMutex);
+        for (const auto& [variant, pipeline] : _variants) {
+            if (!(variant == _startupVariant)) {
+                variants.push_back(variant);
+            }
+        }
+    }
+    try {
+        for (const auto& variant : variants) {
+            reloaded.variants[variant] = createVariantPipeline(variant, reloaded.vertShaderModule, reloaded.fragShaderModule);
+        }
+    } catch (...) {
+        for (auto& [variant, pipeline] : reloaded.variants) {
+            vkDestroyPipeline(_device->logical(), pipeline, nullptr);
+        }
+        vkDestroyShaderModule(_device->logical(), reloaded.vertShaderModule, nullptr);
+        vkDestroyShaderModule(_device->logical(), reloaded.fragShaderModule, nullptr);
+        throw;
+    }
+    _reloadedShaders = std::move(reloaded);
+}
+
+bool ModelPipeline::applyReloadedShaders() {
+    for (auto& build : _variantBuilds) {
+        if (build.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+    }
+    _variantBuilds.clear();
+
+    std::lock_guard<std::mutex> lock(_variantsMutex);
+    VkDevice device = _device->logical();
+    std::vector<VkPipeline> oldPipelines;
+    for (auto& [variant, pipeline] : _variants) {
+        oldPipelines.push_back(pipeline);
+    }
+    VkShaderModule oldVertShaderModule = _vertShaderModule;
+    VkShaderModule oldFragShaderModule = _fragShaderModule;
+    //frames already submitted may still execute the old pipelines
+    _device->deletionQueue().push([device, oldPipelines, oldVertShaderModule, oldFragShaderModule]() {
+        for (VkPipeline pipeline : oldPipelines) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+        vkDestroyShaderModule(device, oldVertShaderModule, nullptr);
+        vkDestroyShaderModule(device, oldFragShaderModule, nullptr);
+    });
+
+    _variants = std::move(_reloadedShaders.variants);
+    _vertShaderModule = _reloadedShaders.vertShaderModule;
+    _fragShaderModule = _reloadedShaders.fragShaderModule;
+    _reloadedShaders = ReloadedShaders{};
+    //variants that failed to build get another chance with the new code
+    _pendingVariants.clear();
+    //the active variant may have been dropped, requestVariant rebuilds it and falls back meanwhile
+    auto fallback = _variants.find(_startupVariant);
+    if (fallback != _variants.end()) {
+        _graphicsPipeline = fallback->second;
+    }
+    return true;
+}
+
+void ModelPipeline::discardReloadedShaders() {
+    for (auto& [variant, pipeline] : _reloadedShaders.variants) {
+        vkDestroyPipeline(_device->logical(), pipeline, nullptr);
+    }
+    vkDestroyShaderModule(_device->logical(), _reloadedShaders.vertShaderModule, nullptr);
+    vkDestroyShaderModule(_device->logical(), _reloadedShaders.fragShaderModule, nullptr);
+    _reloadedShaders = ReloadedShaders{};
+}
+
+void ModelPipeline::loadReloadedModel(const std::string& path) {
+    ReloadedModel reloaded;
+    reloaded.path = path;
+    loadMesh(path, reloaded.vertices, reloaded.indices);
+    reloaded.boundingSphere = computeBoundingSphere(reloaded.vertices);
+    prepareTangentSpace(reloaded.vertices, reloaded.indices);
+    reloaded.meshlets = clusterMeshlets(reloaded.vertices, reloaded.indices);
+    _reloadedModel = std::move(reloaded);
+}
+
+void ModelPipeline::applyReloadedModel(VkCommandBuffer commandBuffer) {
+    std::vector<char> streams = vertexStreams(_reloadedModel.vertices, _positionStreamOffset);
+    std::vector<MeshletData> meshletData = this->meshletData(_reloadedModel.meshlets);
+
+    //the ranges of the previous model are reused once the frames already submitted have finished
+    _geometryArena->remove(_vertexRange);
+    _geometryArena->remove(_indexRange);
+    _vertexRange = _geometryArena->addVertices(streams.data(), streams.size(), sizeof(Vertex), commandBuffer);
+    _indexRange = _geometryArena->addIndices(_reloadedModel.indices, commandBuffer);
+    VkBuffer meshletBuffer;
+    VkDeviceMemory meshletBufferMemory;
+    uploadBuffer(commandBuffer, meshletData.data(), sizeof(meshletData[0]) * meshletData.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletBuffer, meshletBufferMemory);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkDevice device = _device->logical();
+    VkBuffer oldMeshletBuffer = _meshletBuffer;
+    VkDeviceMemory oldMeshletBufferMemory = _meshletBufferMemory;
+    _device->deletionQueue().push([=]() {
+        vkDestroyBuffer(device, oldMeshletBuffer, nullptr);
+        vkFreeMemory(device, oldMeshletBufferMemory, nullptr);
+    });
+    _meshletBuffer = meshletBuffer;
+    _meshletBufferMemory = meshletBufferMemory;
+
+    _modelPath = _reloadedModel.path;
+    _vertices = std::move(_reloadedModel.vertices);
+    _indices = std::move(_reloadedModel.indices);
+    _meshlets = std::move(_reloadedModel.meshlets);
+    _boundingSphere = _reloadedModel.boundingSphere;
+    _reloadedModel = ReloadedModel{};
+    printModelInfo();
+}
+
+void ModelPipeline::uploadBuffer(VkCommandBuffer commandBuffer, const void* contents, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory) {
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    _device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(_device->logical(), stagingBufferMemory, 0, size, 0, &data);
+        memcpy(data, contents, (size_t) size);
+    vkUnmapMemory(_device->logical(), stagingBufferMemory);
+
+    _device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = size;
+    vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+
+    VkDevice device = _device->logical();
+    _device->deletionQueue().pushAfterRecording([device, stagingBuffer, stagingBufferMemory]() {
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+    });
+}
+
+void ModelPipeline::refreshTextureDescriptors() {
+    //changed views get a new slot, frames in flight keep sampling the old one until they finish
+    std::array<VkImageView, 3> views = {_swapChain->textureImageView(), _swapChain->normalMapImageView(), _swapChain->thicknessMapImageView()};
+    for (size_t i = 0; i < views.size(); i++) {
+        if (views[i] == _textureViews[i]) {
+            continue;
+        }
+        _bindlessHeap->removeTexture(_textureSlots[i]);
+        _textureSlots[i] = _bindlessHeap->addTexture(views[i], _swapChain->textureSampler());
+        _textureViews[i] = views[i];
+    }
+    const auto& definitions = _appConfig->materials();
+    for (size_t i = 0; i < definitions.size(); i++) {
+        _bindlessHeap->updateMaterial(_materialIndices[i], materialData(definitions[i]));
+    }
+}
+
+VkPipeline ModelPipeline::createVariantPipeline(const ShaderVariant& variant, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule) {
+    struct SpecializationData {
+        VkBool32 sss;
+        VkBool32 normalMapping;
+        int32_t thicknessSamples;
+        VkBool32 bakedThickness;
+        VkBool32 preintegratedSkin;
+        float curvatureScale;
+        VkBool32 ibl;
+        float iblIntensity;
+        VkBool32 screenSpaceSss;
+        uint32_t textureSlots;
+    } specializationData{};
+    specializationData.sss = variant.sss ? VK_TRUE : VK_FALSE;
+    specializationData.normalMapping = variant.normalMapping ? VK_TRUE : VK_FALSE;
+    specializationData.thicknessSamples = static_cast<int32_t>(variant.thicknessSamples);
+    specializationData.bakedThickness = variant.bakedThickness ? VK_TRUE : VK_FALSE;
+    specializationData.preintegratedSkin = variant.preintegratedSkin ? VK_TRUE : VK_FALSE;
+    //world-space curvature to the rows of the skin LUT
+    specializationData.curvatureScale = _appConfig->unitsPerMillimeter() / _appConfig->skinLutMaxCurvature();
+    specializationData.ibl = variant.ibl ? VK_TRUE : VK_FALSE;
+    specializationData.iblIntensity = _appConfig->iblIntensity();
+    specializationData.screenSpaceSss = _appConfig->screenSpaceSss() ? VK_TRUE : VK_FALSE;
+    specializationData.textureSlots = _bindlessHeap->textureCapacity();
+
+    //constant ids match the layout(constant_id = N) declarations of the fragment shader
+    std::array<VkSpecializationMapEntry, 10> specializationEntries{};
+    specializationEntries[0] = {0, offsetof(SpecializationData, sss), sizeof(VkBool32)};
+    specializationEntries[1] = {1, offsetof(SpecializationData, normalMapping), sizeof(VkBool32)};
+    specializationEntries[2] = {2, offsetof(SpecializationData, thicknessSamples), sizeof(int32_t)};
+    specializationEntries[3] = {5, offsetof(SpecializationData, bakedThickness), sizeof(VkBool32)};
+    specializationEntries[4] = {6, offsetof(SpecializationData, preintegratedSkin), sizeof(VkBool32)};
+    specializationEntries[5] = {7, offsetof(SpecializationData, curvatureScale), sizeof(float)};
+    specializationEntries[6] = {8, offsetof(SpecializationData, ibl), sizeof(VkBool32)};
+    specializationEntries[7] = {9, offsetof(SpecializationData, iblIntensity), sizeof(float)};
+    specializationEntries[8] = {10, offsetof(SpecializationData, screenSpaceSss), sizeof(VkBool32)};
+    specializationEntries[9] = {11, offsetof(SpecializationData, textureSlots), sizeof(uint32_t)};
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = sizeof(SpecializationData);
+    specializationInfo.pData = &specializationData;
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -284,6 +974,7 @@ void ModelPipeline::createGraphicsPipeline(std::string vertPath, std::string fra
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
@@ -334,7 +1025,7 @@ void ModelPipeline::createGraphicsPipeline(std::string vertPath, std::string fra
     VkPipelineMultisampleStateCreateInfo multisampling{};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.rasterizationSamples = _swapChain->sampleCount();
     multisampling.minSampleShading = 1.0f; // Optional
     multisampling.pSampleMask = nullptr; // Optional
     multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
@@ -351,27 +1042,121 @@ void ModelPipeline::createGraphicsPipeline(std::string vertPath, std::string fra
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
     colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
 
+    std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments = {colorBlendAttachment, colorBlendAttachment};
+
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.attachmentCount = _appConfig->colorAttachmentCount();
+    colorBlending.pAttachments = colorBlendAttachments.data();
     colorBlending.blendConstants[0] = 0.0f; // Optional
     colorBlending.blendConstants[1] = 0.0f; // Optional
     colorBlending.blendConstants[2] = 0.0f; // Optional
     colorBlending.blendConstants[3] = 0.0f; // Optional
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &_descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-    
-    if (vkCreatePipelineLayout(_device->logical(), &pipelineLayoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
+    //after a depth pre-pass only the front-most fragment of every pixel passes, so the skin shader runs once per pixel
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = _appConfig->depthPrePass() ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = _appConfig->depthPrePass() ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.minDepthBounds = 0.0f; // Optional
+    depthStencil.maxDepthBounds = 1.0f; // Optional
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = _pipelineLayout;
+    pipelineInfo.renderPass = _swapChain->renderPass();
+    pipelineInfo.subpass = _appConfig->shadingSubpass();
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+    pipelineInfo.basePipelineIndex = -1; // Optional
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(_device->logical(), _pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
     }
+    return pipeline;
+}
+
+void ModelPipeline::createDepthPipeline() {
+    VkShaderModule vertShaderModule = _device->loadShaderModule(_appConfig->depthPrePassVertexShaderPath());
+
+    //depth-only, no fragment stage is needed
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(glm::vec3);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription attributeDescription{};
+    attributeDescription.binding = 0;
+    attributeDescription.location = 0;
+    attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescription.offset = 0;
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexAttributeDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexAttributeDescriptions = &attributeDescription;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = _swapChain->sampleCount();
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 0;
 
     VkPipelineDepthStencilStateCreateInfo depthStencil{};
     depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
@@ -384,8 +1169,8 @@ void ModelPipeline::createGraphicsPipeline(std::string vertPath, std::string fra
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &vertShaderStageInfo;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
@@ -400,12 +1185,116 @@ void ModelPipeline::createGraphicsPipeline(std::string vertPath, std::string fra
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
     pipelineInfo.basePipelineIndex = -1; // Optional
 
-    if (vkCreateGraphicsPipelines(_device->logical(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+    if (vkCreateGraphicsPipelines(_device->logical(), _pipelineCache, 1, &pipelineInfo, nullptr, &_depthPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pre-pass pipeline!");
+    }
+
+    vkDestroyShaderModule(_device->logical(), vertShaderModule, nullptr);
+}
+
+void ModelPipeline::createShadowPipeline() {
+    VkShaderModule vertShaderModule = _device->loadShaderModule(_appConfig->shadowMapVertexShaderPath());
+
+    //depth-only, no fragment stage is needed
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+
+    //positions are read from the full vertex buffer, the position stream only exists with the depth pre-pass
+    VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
+
+    VkVertexInputAttributeDescription attributeDescription{};
+    attributeDescription.binding = 0;
+    attributeDescription.location = 0;
+    attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescription.offset = offsetof(Vertex, pos);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexAttributeDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexAttributeDescriptions = &attributeDescription;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    std::vector<VkDynamicState> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    //no culling, the model is not closed everywhere and the light may see its back faces;
+    //depth bias pushes the stored depth away from the light to keep lit surfaces from shadowing themselves
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_TRUE;
+    rasterizer.depthBiasConstantFactor = _appConfig->shadowDepthBias();
+    rasterizer.depthBiasSlopeFactor = _appConfig->shadowSlopeBias();
+    rasterizer.depthBiasClamp = 0.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 0;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.minDepthBounds = 0.0f; // Optional
+    depthStencil.maxDepthBounds = 1.0f; // Optional
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &vertShaderStageInfo;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = _pipelineLayout;
+    pipelineInfo.renderPass = _shadowMap->renderPass();
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+    pipelineInfo.basePipelineIndex = -1; // Optional
+
+    if (vkCreateGraphicsPipelines(_device->logical(), _pipelineCache, 1, &pipelineInfo, nullptr, &_shadowPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map pipeline!");
     }
 
-    vkDestroyShaderModule(_device->logical(), fragShaderModule, nullptr);
     vkDestroyShaderModule(_device->logical(), vertShaderModule, nullptr);
 }
 
-}
\ No newline at end of file
+}
@@ -1,23 +1,145 @@
 #pragma once
 
+#include <array>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "bindless_heap.h"
+#include "clustered_lighting.h"
+#include "environment_lighting.h"
+#include "frustum.h"
+#include "meshlet.h"
 #include "pipeline.h"
+#include "render_queue.h"
+#include "scene.h"
+#include "shader_variant.h"
+#include "shadow_map.h"
+#include "skin_lut.h"
+#include "thread_pool.h"
 
 namespace vmr
 {
+const float CAMERA_NEAR_PLANE = 0.05f;
+const float CAMERA_FAR_PLANE = 100.0f;
+// the material index follows the shadow pass's view-projection in the push constants
+const uint32_t MATERIAL_PUSH_CONSTANT_OFFSET = sizeof(glm::mat4);
+
 class ModelPipeline : public Pipeline {
 private:
+    // built on a worker thread by a hot reload, swapped in at a frame boundary
+    struct ReloadedShaders {
+        VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+        VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+        std::unordered_map<ShaderVariant, VkPipeline, ShaderVariantHash> variants;
+    };
+    struct ReloadedModel {
+        std::string path;
+        std::vector<std::variant<Vertex, BasicVertex>> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<Meshlet> meshlets;
+        BoundingSphere boundingSphere;
+    };
+
+    ThreadPool* _threadPool;
+    Scene* _scene;
+    ClusteredLighting* _clusteredLighting;
+    ShadowMap* _shadowMap;
+    BindlessHeap* _bindlessHeap;
+    std::array<VkImageView, 3> _textureViews;      // albedo, normal map and thickness, as registered in the heap
+    std::array<uint32_t, 3> _textureSlots;
+    std::vector<uint32_t> _materialIndices;         // heap material of every config material
+    std::vector<VkBuffer> _instanceBuffers;
+    std::vector<VkDeviceMemory> _instanceBuffersMemory;
+    std::vector<void *> _instanceBuffersMapped;
+    std::vector<uint64_t> _instanceBufferVersions;
+    BoundingSphere _boundingSphere;
+    SkinLut* _skinLut = nullptr;
+    EnvironmentLighting* _environmentLighting = nullptr;
+    std::vector<Meshlet> _meshlets;
+    VkBuffer _meshletBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory _meshletBufferMemory = VK_NULL_HANDLE;
+    glm::mat4 _view;
+    glm::mat4 _projection;
+    glm::mat4 _viewProjection;
+    VkPipeline _depthPipeline = VK_NULL_HANDLE;
+    VkPipeline _shadowPipeline = VK_NULL_HANDLE;
+    VkDeviceSize _positionStreamOffset = 0;        // of the depth pre-pass's positions within the model's vertex range
+    VkShaderModule _vertShaderModule;
+    VkShaderModule _fragShaderModule;
+    VkPipelineCache _pipelineCache;
+    std::mutex _variantsMutex;
+    std::unordered_map<ShaderVariant, VkPipeline, ShaderVariantHash> _variants;
+    std::unordered_set<ShaderVariant, ShaderVariantHash> _pendingVariants;
+    ShaderVariant _startupVariant;                  // its pipeline is the fallback while requested variants compile
+    std::vector<std::future<void>> _variantBuilds;
+    ReloadedShaders _reloadedShaders;
+    ReloadedModel _reloadedModel;
+
     void createDescriptorPool() override;
     void createDescriptorSets() override;
     void createDescriptorSetLayout() override;
     void createVertexBuffer() override;
     void createUniformBuffers() override;
-    void prepareTangentSpace();
+    void createInstanceBuffers();
+    void registerMaterials();
+    Material materialData(const MaterialDefinition& definition);
+    // the vertices, followed by their positions alone when the depth pre-pass draws them
+    std::vector<char> vertexStreams(const std::vector<std::variant<Vertex, BasicVertex>>& vertices, VkDeviceSize& positionStreamOffset);
+    void prepareTangentSpace(std::vector<std::variant<Vertex, BasicVertex>>& vertices, const std::vector<uint32_t>& indices);
     void loadModel() override;
+    void loadMesh(const std::string& path, std::vector<std::variant<Vertex, BasicVertex>>& vertices, std::vector<uint32_t>& indices);
+    BoundingSphere computeBoundingSphere(const std::vector<std::variant<Vertex, BasicVertex>>& vertices);
+    std::vector<Meshlet> clusterMeshlets(const std::vector<std::variant<Vertex, BasicVertex>>& vertices, std::vector<uint32_t>& indices);
+    std::vector<MeshletData> meshletData(const std::vector<Meshlet>& meshlets);
+    // device-local buffer filled by a copy recorded into the frame being recorded
+    void uploadBuffer(VkCommandBuffer commandBuffer, const void* contents, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory);
+    void createMeshletBuffer();
     void createGraphicsPipeline(std::string vertPath, std::string fragPath);
+    void createDepthPipeline();
+    void createShadowPipeline();
+    VkPipeline createVariantPipeline(const ShaderVariant& variant, VkShaderModule vertShaderModule, VkShaderModule fragShaderModule);
+    void buildVariantAsync(const ShaderVariant& variant);
 
 public:
-    ModelPipeline(Device *device, SwapChain *swapChain, AppConfig *appConfig, std::string vertPath, std::string fragPath, std::string modelPath);
+    ModelPipeline(Device *device, SwapChain *swapChain, AppConfig *appConfig, ThreadPool *threadPool, Scene *scene, ClusteredLighting *clusteredLighting, ShadowMap *shadowMap, BindlessHeap *bindlessHeap, GeometryArena *geometryArena, std::string vertPath, std::string fragPath, std::string modelPath);
+    ~ModelPipeline();
     void updateUniformBuffer(uint32_t currentImage) override;
     void prepareModel() override;
+    void draw(VkCommandBuffer &commandBuffer, int currentFrame);
+    // binds the depth-only pipeline with the position stream, followed by the same draws as the shading pass
+    void bindDepthResources(VkCommandBuffer &commandBuffer, int currentFrame);
+    // binds the shadow atlas pipeline, every face is drawn after pushing its view-projection
+    void bindShadowResources(VkCommandBuffer &commandBuffer, int currentFrame);
+    void pushShadowFace(VkCommandBuffer &commandBuffer, const glm::mat4& viewProjection);
+    // binds the bindless heap for the shading pass and selects the first material, after bindResources
+    void bindMaterials(VkCommandBuffer &commandBuffer, int currentFrame);
+    void pushMaterial(VkCommandBuffer &commandBuffer, uint32_t materialIndex);
+    // sort key pipeline of a config material: 0 for the active shader variant, else its variant index + 1
+    uint32_t materialPipeline(uint32_t material) const;
+    // instance data of the frame in the render queue's order instead of the scene order
+    void writeInstances(int currentFrame, const std::vector<uint32_t>& order);
+    // draws the queue's batches binding only what changes between them, the depth pass only draws;
+    // returns the binds a submission binding everything for every batch would have added
+    uint64_t drawBatches(VkCommandBuffer &commandBuffer, int currentFrame, const RenderQueue& queue, bool depthOnly, StateChanges& changes);
+    VkBuffer instanceBuffer(size_t frame) { return _instanceBuffers[frame]; }
+    const BoundingSphere& boundingSphere() const { return _boundingSphere; }
+    VkBuffer meshletBuffer() { return _meshletBuffer; }
+    uint32_t meshletCount() const { return static_cast<uint32_t>(_meshlets.size()); }
+    const glm::mat4& view() const { return _view; }
+    const glm::mat4& projection() const { return _projection; }
+    const glm::mat4& viewProjection() const { return _viewProjection; }
+    VkPipeline requestVariant(const ShaderVariant& variant);
+    bool isVariantReady(const ShaderVariant& variant);
+
+    // hot reload: the build functions run on a worker thread, the apply functions at a frame boundary on the main thread
+    void buildReloadedShaders(const std::string& vertPath, const std::string& fragPath);
+    // false while variants are still compiling with the old modules, the swap is then retried on a later frame
+    bool applyReloadedShaders();
+    void discardReloadedShaders();
+    void loadReloadedModel(const std::string& path);
+    void applyReloadedModel(VkCommandBuffer commandBuffer);
+    // the texture views changed, the new ones are added to the heap and the material points at them from the next upload
+    void refreshTextureDescriptors();
 };
-}
\ No newline at end of file
+}
@@ -10,6 +10,7 @@
 
 #include "app_config.h"
 #include "device.h"
+#include "geometry_arena.h"
 #include "swap_chain.h"
 #include "vertex.h"
 #include "basic_vertex.h"
@@ -32,11 +33,14 @@ namespace std {
 };
 
 struct ModelUniformBufferObject {
-    alignas(16) glm::mat4 model;
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
     alignas(16) glm::vec3 position;
     alignas(16) glm::vec3 lightPosition;
+    alignas(16) glm::vec4 clusterScale;     // clusters per pixel along x and y, scale and bias from log(view depth) to the depth slice
+    alignas(16) glm::uvec4 clusterGrid;     // clusters along x, y and z, point light count
+    alignas(16) glm::mat4 shadowFaces[6];   // light view-projection of every face of the shadow atlas
+    alignas(16) glm::vec4 shadowParams;     // shadows enabled, size of a shadow map texel
 };
 
 struct LightUniformBufferObject {
@@ -49,9 +53,6 @@ struct LightUniformBufferObject {
 namespace vmr {
 class Pipeline {
 private:
-    VkBuffer _indexBuffer;
-    VkDeviceMemory _indexBufferMemory;
-
     virtual void createDescriptorPool() = 0;
     virtual void createDescriptorSets() = 0;
     virtual void createUniformBuffers() = 0;
@@ -67,8 +68,9 @@ protected:
     std::vector<uint32_t> _indices;
     std::vector<VkDescriptorSet> _descriptorSets;
     VkDescriptorSetLayout _descriptorSetLayout;
-    VkBuffer _vertexBuffer;
-    VkDeviceMemory _vertexBufferMemory;
+    GeometryArena *_geometryArena;
+    uint32_t _vertexRange;
+    uint32_t _indexRange;
     std::vector<VkBuffer> _uniformBuffers;
     VkDescriptorPool _descriptorPool;
     std::vector<VkDeviceMemory> _uniformBuffersMemory;
@@ -79,18 +81,23 @@ protected:
     virtual void createVertexBuffer() = 0;
     virtual void createGraphicsPipeline(std::string vertPath, std::string fragPath) = 0;
     void createIndexBuffer();
-    std::vector<char> readFile(const std::string &filename);
-    VkShaderModule createShaderModule(const std::vector<char> &code);
     void printModelInfo();
 
 public:
-    Pipeline(Device *device, SwapChain *swapChain, AppConfig *appConfig, std::string vertPath, std::string fragPath, std::string modelPath);
+    Pipeline(Device *device, SwapChain *swapChain, AppConfig *appConfig, GeometryArena *geometryArena, std::string vertPath, std::string fragPath, std::string modelPath);
     ~Pipeline();
     VkPipeline &pipeline() { return _graphicsPipeline; }
     VkPipelineLayout &layout() { return _pipelineLayout; }
     std::vector<VkDescriptorSet> descriptorSets() { return _descriptorSets; }
 
-    void bind(VkCommandBuffer &commandBuffer, int currentFrame);
+    uint32_t indexCount() { return static_cast<uint32_t>(_indices.size()); }
+    // position of the model in the geometry arena, read at every draw since compaction moves it
+    uint32_t firstIndex() { return _geometryArena->firstIndex(_indexRange); }
+    int32_t vertexOffset() { return _geometryArena->vertexOffset(_vertexRange); }
+
+    // the vertex and index buffers are the arena's, bound once per command buffer
+    void bindResources(VkCommandBuffer &commandBuffer, int currentFrame);
+    void bind(VkCommandBuffer &commandBuffer, int currentFrame, uint32_t instanceCount = 1);
     virtual void updateUniformBuffer(uint32_t currentImage) = 0;
     virtual void prepareModel() = 0;
 };
@@ -0,0 +1,566 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "render_graph.h"
+
+namespace vmr {
+
+namespace {
+struct AccessInfo {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkAccessFlags writeAccess;
+    VkImageLayout layout;
+    bool attachment;
+    bool overwrites;            // the previous contents are not read
+};
+
+AccessInfo accessInfo(GraphAccess access) {
+    switch (access) {
+        case GraphAccess::IndirectRead:
+            return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, false, false};
+        case GraphAccess::ComputeRead:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, false, false};
+        case GraphAccess::ComputeWrite:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false};
+        case GraphAccess::ComputeSampled:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false};
+        case GraphAccess::ComputeStorageWrite:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, false, true};
+        case GraphAccess::ComputeStorageReadWrite:
+            return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL, false, false};
+        case GraphAccess::FragmentRead:
+            return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, false, false};
+        case GraphAccess::FragmentSampled:
+            return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false};
+        case GraphAccess::ColorAttachment:
+            return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, false};
+        case GraphAccess::DepthAttachment:
+            return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, false};
+    }
+    throw std::runtime_error("unknown render graph access!");
+}
+
+std::string stageNames(VkPipelineStageFlags stages) {
+    const std::pair<VkPipelineStageFlags, const char*> names[] = {
+        {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, "top"},
+        {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, "indirect"},
+        {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, "compute"},
+        {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "fragment"},
+        {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, "depth"},
+        {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, "color"},
+    };
+    std::string result;
+    for (const auto& name : names) {
+        if (stages & name.first) {
+            result += (result.empty() ? "" : "|") + std::string(name.second);
+        }
+    }
+    return result;
+}
+
+const char* layoutName(VkImageLayout layout) {
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED:                         return "undefined";
+        case VK_IMAGE_LAYOUT_GENERAL:                           return "general";
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:          return "color attachment";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:  return "depth attachment";
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:          return "shader read";
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:                   return "present";
+        default:                                                return "other";
+    }
+}
+
+// state of a resource while planning the barriers of a frame
+struct ResourceState {
+    bool used = false;
+    PassQueue queue = PassQueue::Graphics;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags writeStages = 0;
+    VkAccessFlags writeAccess = 0;
+    bool writtenByRenderPass = false;       // made visible by the render pass's outgoing dependency
+    VkPipelineStageFlags readStages = 0;    // since the last write
+    VkPipelineStageFlags visibleStages = 0; // where the last write is already visible
+    VkAccessFlags visibleAccess = 0;
+    VkPipelineStageFlags lastStages = 0;
+};
+}
+
+RenderGraph::RenderGraph(Device* device) : _device(device) {}
+
+RenderGraph::~RenderGraph() {
+    destroyTransientImages(false);
+}
+
+uint32_t RenderGraph::importImage(const std::string& name, std::function<VkImage(uint32_t)> image, VkImageLayout initialLayout,
+                                  VkImageAspectFlags aspect) {
+    Resource resource{};
+    resource.name = name;
+    resource.image = true;
+    resource.transient = false;
+    resource.aspect = aspect;
+    resource.imported = std::move(image);
+    resource.initialLayout = initialLayout;
+    _resources.push_back(resource);
+    return static_cast<uint32_t>(_resources.size() - 1);
+}
+
+uint32_t RenderGraph::importBuffer(const std::string& name) {
+    Resource resource{};
+    resource.name = name;
+    resource.image = false;
+    resource.transient = false;
+    _resources.push_back(resource);
+    return static_cast<uint32_t>(_resources.size() - 1);
+}
+
+uint32_t RenderGraph::createImage(const std::string& name, const TransientImageInfo& info) {
+    Resource resource{};
+    resource.name = name;
+    resource.image = true;
+    resource.transient = true;
+    resource.info = info;
+    _resources.push_back(resource);
+    return static_cast<uint32_t>(_resources.size() - 1);
+}
+
+void RenderGraph::markOutput(uint32_t resource) {
+    _resources[resource].output = true;
+}
+
+void RenderGraph::addPass(const std::string& name, PassQueue queue, std::vector<ResourceUse> uses,
+                          std::function<void(VkCommandBuffer, uint32_t)> record, bool sideEffects) {
+    Pass pass{};
+    pass.name = name;
+    pass.queue = queue;
+    pass.uses = std::move(uses);
+    pass.record = std::move(record);
+    pass.sideEffects = sideEffects;
+    _passes.push_back(std::move(pass));
+}
+
+uint32_t RenderGraph::passIndex(const std::string& name) const {
+    for (uint32_t i = 0; i < _passes.size(); i++) {
+        if (_passes[i].name == name) {
+            return i;
+        }
+    }
+    throw std::runtime_error("failed to find render graph pass " + name + "!");
+}
+
+void RenderGraph::compile(VkExtent2D extent, uint32_t copies) {
+    //frames in flight still render with the images of the previous compile
+    destroyTransientImages(_copies != 0);
+    _extent = extent;
+    _copies = copies;
+    for (auto& resource : _resources) {
+        resource.firstPass = UINT32_MAX;
+        resource.lastPass = 0;
+        resource.block = UINT32_MAX;
+    }
+    for (auto& pass : _passes) {
+        pass.culled = false;
+        pass.barrier = PassBarrier{};
+    }
+    cullPasses();
+    computeLifetimes();
+    createTransientImages();
+    aliasMemory();
+    planBarriers();
+}
+
+void RenderGraph::cullPasses() {
+    //walking backwards, a pass is needed if it writes something a later needed pass (or the frame's output) reads
+    std::vector<bool> needed(_resources.size());
+    for (size_t i = 0; i < _resources.size(); i++) {
+        needed[i] = _resources[i].output;
+    }
+    for (size_t p = _passes.size(); p-- > 0;) {
+        Pass& pass = _passes[p];
+        bool live = pass.sideEffects;
+        for (const auto& use : pass.uses) {
+            live = live || (accessInfo(use.access).writeAccess != 0 && needed[use.resource]);
+        }
+        pass.culled = !live;
+        if (!live) {
+            continue;
+        }
+        //a pass overwriting a resource makes earlier writers of it unnecessary, attachments may be loaded
+        for (const auto& use : pass.uses) {
+            if (accessInfo(use.access).overwrites) {
+                needed[use.resource] = false;
+            }
+        }
+        for (const auto& use : pass.uses) {
+            if (!accessInfo(use.access).overwrites) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::computeLifetimes() {
+    for (uint32_t p = 0; p < _passes.size(); p++) {
+        if (_passes[p].culled) {
+            continue;
+        }
+        for (const auto& use : _passes[p].uses) {
+            Resource& resource = _resources[use.resource];
+            resource.firstPass = std::min(resource.firstPass, p);
+            resource.lastPass = std::max(resource.lastPass, p);
+        }
+    }
+}
+
+void RenderGraph::createTransientImages() {
+    for (auto& resource : _resources) {
+        if (!resource.transient) {
+            continue;
+        }
+        const TransientImageInfo& info = resource.info;
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = std::max(1u, (_extent.width + info.extentDivisor - 1) / info.extentDivisor);
+        imageInfo.extent.height = std::max(1u, (_extent.height + info.extentDivisor - 1) / info.extentDivisor);
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = info.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = info.usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        if (info.sharedWithCompute && _device->sharedQueueFamilies().size() > 1) {
+            imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(_device->sharedQueueFamilies().size());
+            imageInfo.pQueueFamilyIndices = _device->sharedQueueFamilies().data();
+        } else {
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
+
+        resource.images.resize(_copies);
+        for (uint32_t copy = 0; copy < _copies; copy++) {
+            if (vkCreateImage(_device->logical(), &imageInfo, nullptr, &resource.images[copy]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image " + resource.name + "!");
+            }
+        }
+    }
+}
+
+void RenderGraph::aliasMemory() {
+    std::vector<uint32_t> transients;
+    std::vector<VkMemoryRequirements> requirements(_resources.size());
+    for (uint32_t i = 0; i < _resources.size(); i++) {
+        if (_resources[i].transient) {
+            //every copy is created alike, so the first one stands for all
+            vkGetImageMemoryRequirements(_device->logical(), _resources[i].images[0], &requirements[i]);
+            _resources[i].size = requirements[i].size;
+            transients.push_back(i);
+        }
+    }
+    //largest first, each into the first block none of whose images is alive at the same time
+    std::sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) { return _resources[a].size > _resources[b].size; });
+    auto overlaps = [this](uint32_t a, uint32_t b) {
+        const Resource& first = _resources[a];
+        const Resource& second = _resources[b];
+        if (first.firstPass == UINT32_MAX || second.firstPass == UINT32_MAX) {
+            return false;
+        }
+        return first.firstPass <= second.lastPass && second.firstPass <= first.lastPass;
+    };
+    for (uint32_t index : transients) {
+        uint32_t blockIndex = 0;
+        for (; blockIndex < _blocks.size(); blockIndex++) {
+            MemoryBlock& block = _blocks[blockIndex];
+            bool fits = (block.memoryTypeBits & requirements[index].memoryTypeBits) != 0;
+            for (uint32_t other : block.resources) {
+                fits = fits && !overlaps(index, other);
+            }
+            if (fits) {
+                break;
+            }
+        }
+        if (blockIndex == _blocks.size()) {
+            _blocks.emplace_back();
+        }
+        MemoryBlock& block = _blocks[blockIndex];
+        block.resources.push_back(index);
+        block.size = std::max(block.size, requirements[index].size);
+        block.alignment = std::max(block.alignment, requirements[index].alignment);
+        block.memoryTypeBits &= requirements[index].memoryTypeBits;
+        _resources[index].block = blockIndex;
+    }
+
+    //one allocation per block and copy, every image of the block bound at its start
+    for (auto& block : _blocks) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = block.size;
+        allocInfo.memoryTypeIndex = _device->findMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        block.memory.resize(_copies);
+        for (uint32_t copy = 0; copy < _copies; copy++) {
+            if (vkAllocateMemory(_device->logical(), &allocInfo, nullptr, &block.memory[copy]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate render graph memory!");
+            }
+            for (uint32_t index : block.resources) {
+                vkBindImageMemory(_device->logical(), _resources[index].images[copy], block.memory[copy], 0);
+            }
+        }
+    }
+
+    for (uint32_t index : transients) {
+        Resource& resource = _resources[index];
+        resource.imageViews.resize(_copies);
+        for (uint32_t copy = 0; copy < _copies; copy++) {
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = resource.images[copy];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource.info.format;
+            viewInfo.subresourceRange.aspectMask = resource.aspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(_device->logical(), &viewInfo, nullptr, &resource.imageViews[copy]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph image view " + resource.name + "!");
+            }
+        }
+    }
+}
+
+void RenderGraph::planBarriers() {
+    std::vector<ResourceState> states(_resources.size());
+    for (size_t i = 0; i < _resources.size(); i++) {
+        states[i].layout = _resources[i].transient ? VK_IMAGE_LAYOUT_UNDEFINED : _resources[i].initialLayout;
+    }
+    _barrierCount = 0;
+    _transitionCount = 0;
+
+    for (uint32_t p = 0; p < _passes.size(); p++) {
+        Pass& pass = _passes[p];
+        if (pass.culled) {
+            continue;
+        }
+        PassBarrier& barrier = pass.barrier;
+        for (const auto& use : pass.uses) {
+            const Resource& resource = _resources[use.resource];
+            ResourceState& state = states[use.resource];
+            AccessInfo info = accessInfo(use.access);
+            VkImageLayout layout = use.layout != VK_IMAGE_LAYOUT_UNDEFINED ? use.layout : info.layout;
+            VkPipelineStageFlags srcStages = 0;
+            VkAccessFlags srcAccess = 0;
+            bool transition = resource.image && !info.attachment && state.layout != layout;
+            bool madeVisible = false;
+
+            if (!state.used) {
+                //an aliased image first waits for the last use of the one before it in the same memory, whose writes
+                //also have to be made available before the new image writes over them
+                if (resource.transient) {
+                    uint32_t previous = UINT32_MAX;
+                    for (uint32_t other : _blocks[resource.block].resources) {
+                        const Resource& candidate = _resources[other];
+                        if (other != use.resource && candidate.firstPass != UINT32_MAX && candidate.lastPass < p
+                            && (previous == UINT32_MAX || candidate.lastPass > _resources[previous].lastPass)) {
+                            previous = other;
+                        }
+                    }
+                    if (previous != UINT32_MAX && states[previous].queue == pass.queue) {
+                        srcStages |= states[previous].lastStages | states[previous].writeStages;
+                        srcAccess |= states[previous].writeAccess;
+                    }
+                }
+            } else if (state.queue != pass.queue) {
+                //ordered by the semaphore between the queues, which also makes the writes visible
+                if (transition) {
+                    throw std::runtime_error("failed to compile render graph, " + resource.name + " changes layout across queues!");
+                }
+                madeVisible = true;
+            } else if (info.attachment) {
+                //accesses by other render passes are covered by the subpass dependencies
+                if (!state.writtenByRenderPass) {
+                    srcStages |= state.writeStages | state.readStages;
+                    srcAccess |= state.writeAccess;
+                }
+            } else {
+                if (state.writeStages != 0 && !state.writtenByRenderPass) {
+                    bool visible = (info.stages & ~state.visibleStages) == 0 && (info.access & ~state.visibleAccess) == 0;
+                    if (!visible || info.writeAccess != 0) {
+                        srcStages |= state.writeStages;
+                        srcAccess |= state.writeAccess;
+                    }
+                } else if (state.writtenByRenderPass && transition) {
+                    srcStages |= state.writeStages;
+                    srcAccess |= state.writeAccess;
+                }
+                //write after read only needs the reads to have finished
+                if (info.writeAccess != 0) {
+                    srcStages |= state.readStages;
+                }
+            }
+
+            if (transition || srcStages != 0) {
+                barrier.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                barrier.dstStages |= info.stages;
+                if (transition) {
+                    barrier.transitions.push_back({use.resource, resource.transient && !state.used ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout,
+                                                   layout, srcAccess, info.access});
+                } else if (srcAccess != 0) {
+                    barrier.srcAccess |= srcAccess;
+                    barrier.dstAccess |= info.access;
+                }
+                madeVisible = madeVisible || srcAccess != 0 || transition;
+            }
+
+            state.used = true;
+            state.queue = pass.queue;
+            state.layout = layout;
+            state.lastStages = info.stages;
+            if (info.writeAccess != 0) {
+                state.writeStages = info.stages;
+                state.writeAccess = info.writeAccess;
+                state.writtenByRenderPass = info.attachment;
+                state.readStages = 0;
+                state.visibleStages = 0;
+                state.visibleAccess = 0;
+            } else {
+                state.readStages |= info.stages;
+                if (madeVisible) {
+                    state.visibleStages |= info.stages;
+                    state.visibleAccess |= info.access;
+                }
+            }
+        }
+        if (barrier.needed()) {
+            _barrierCount++;
+            _transitionCount += static_cast<uint32_t>(barrier.transitions.size());
+        }
+    }
+}
+
+void RenderGraph::destroyTransientImages(bool deferred) {
+    std::vector<VkImageView> imageViews;
+    std::vector<VkImage> images;
+    std::vector<VkDeviceMemory> memory;
+    for (auto& resource : _resources) {
+        imageViews.insert(imageViews.end(), resource.imageViews.begin(), resource.imageViews.end());
+        images.insert(images.end(), resource.images.begin(), resource.images.end());
+        if (resource.transient) {
+            resource.imageViews.clear();
+            resource.images.clear();
+        }
+    }
+    for (auto& block : _blocks) {
+        memory.insert(memory.end(), block.memory.begin(), block.memory.end());
+    }
+    _blocks.clear();
+
+    auto destroy = [device = _device->logical(), imageViews, images, memory]() {
+        for (auto imageView : imageViews) {
+            vkDestroyImageView(device, imageView, nullptr);
+        }
+        for (auto image : images) {
+            vkDestroyImage(device, image, nullptr);
+        }
+        for (auto allocation : memory) {
+            vkFreeMemory(device, allocation, nullptr);
+        }
+    };
+    if (deferred) {
+        _device->deletionQueue().push(destroy);
+    } else {
+        destroy();
+    }
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t begin, uint32_t end) {
+    end = std::min(end, static_cast<uint32_t>(_passes.size()));
+    for (uint32_t p = begin; p < end; p++) {
+        const Pass& pass = _passes[p];
+        if (pass.culled) {
+            continue;
+        }
+        const PassBarrier& barrier = pass.barrier;
+        if (barrier.needed()) {
+            VkMemoryBarrier memoryBarrier{};
+            memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            memoryBarrier.srcAccessMask = barrier.srcAccess;
+            memoryBarrier.dstAccessMask = barrier.dstAccess;
+            uint32_t memoryBarrierCount = (barrier.srcAccess | barrier.dstAccess) != 0 ? 1 : 0;
+
+            std::vector<VkImageMemoryBarrier> imageBarriers(barrier.transitions.size());
+            for (size_t i = 0; i < barrier.transitions.size(); i++) {
+                const ImageTransition& transition = barrier.transitions[i];
+                const Resource& resource = _resources[transition.resource];
+                VkImageMemoryBarrier& imageBarrier = imageBarriers[i];
+                imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                imageBarrier.oldLayout = transition.oldLayout;
+                imageBarrier.newLayout = transition.newLayout;
+                imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageBarrier.image = resource.transient ? resource.images[imageIndex] : resource.imported(imageIndex);
+                imageBarrier.subresourceRange.aspectMask = resource.aspect;
+                imageBarrier.subresourceRange.baseMipLevel = 0;
+                imageBarrier.subresourceRange.levelCount = 1;
+                imageBarrier.subresourceRange.baseArrayLayer = 0;
+                imageBarrier.subresourceRange.layerCount = 1;
+                imageBarrier.srcAccessMask = transition.srcAccess;
+                imageBarrier.dstAccessMask = transition.dstAccess;
+            }
+            vkCmdPipelineBarrier(commandBuffer, barrier.srcStages, barrier.dstStages, 0, memoryBarrierCount, &memoryBarrier,
+                                 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        }
+        pass.record(commandBuffer, imageIndex);
+    }
+}
+
+void RenderGraph::printSchedule() {
+    const double mb = 1024.0 * 1024.0;
+    uint32_t culledCount = 0;
+    for (const auto& pass : _passes) {
+        culledCount += pass.culled ? 1 : 0;
+    }
+    std::cout<<"Render graph: "<<_passes.size() - culledCount<<" pass(es), "<<culledCount<<" culled, "
+             <<_barrierCount<<" barrier(s) with "<<_transitionCount<<" layout transition(s)"<<std::endl;
+    for (uint32_t p = 0; p < _passes.size(); p++) {
+        const Pass& pass = _passes[p];
+        std::cout<<"  "<<pass.name<<(pass.queue == PassQueue::AsyncCompute ? " (async compute)" : "");
+        if (pass.culled) {
+            std::cout<<": culled"<<std::endl;
+            continue;
+        }
+        if (pass.barrier.needed()) {
+            std::cout<<" after barrier "<<stageNames(pass.barrier.srcStages)<<" -> "<<stageNames(pass.barrier.dstStages);
+            for (const auto& transition : pass.barrier.transitions) {
+                std::cout<<", "<<_resources[transition.resource].name<<" "<<layoutName(transition.oldLayout)<<" -> "<<layoutName(transition.newLayout);
+            }
+        }
+        std::cout<<std::endl;
+    }
+
+    VkDeviceSize separate = 0, aliased = 0;
+    for (const auto& resource : _resources) {
+        if (resource.transient) {
+            separate += resource.size;
+            std::cout<<"  "<<resource.name<<": "<<resource.size / mb<<" MB in block "<<resource.block;
+            if (resource.firstPass != UINT32_MAX) {
+                std::cout<<", alive from "<<_passes[resource.firstPass].name<<" to "<<_passes[resource.lastPass].name;
+            }
+            std::cout<<std::endl;
+        }
+    }
+    for (const auto& block : _blocks) {
+        aliased += block.size;
+    }
+    std::cout<<"Transient images: "<<aliased * _copies / mb<<" MB in "<<_blocks.size() * _copies<<" allocation(s) instead of "
+             <<separate * _copies / mb<<" MB ("<<_copies<<" cop"<<(_copies == 1 ? "y" : "ies")<<"), "
+             <<(separate - aliased) * _copies / mb<<" MB saved by aliasing"<<std::endl;
+}
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "device.h"
+
+namespace vmr {
+// how a pass uses a resource, each mapping to the pipeline stages, access and image layout involved
+enum class GraphAccess {
+    IndirectRead,               // buffer of indirect draws and their count
+    ComputeRead,                // storage buffer
+    ComputeWrite,
+    ComputeSampled,             // sampled image
+    ComputeStorageWrite,        // storage image, fully overwritten
+    ComputeStorageReadWrite,
+    FragmentRead,               // storage buffer
+    FragmentSampled,
+    ColorAttachment,            // written by the pass's render pass
+    DepthAttachment,
+};
+
+enum class PassQueue { Graphics, AsyncCompute };
+
+// an image allocated by the graph, one copy per swap chain image, sized relative to the swap chain
+struct TransientImageInfo {
+    VkFormat format;
+    VkImageUsageFlags usage;
+    uint32_t extentDivisor = 1;     // rounded up
+    bool sharedWithCompute = false; // used from the graphics and the async compute queue
+};
+
+struct ResourceUse {
+    uint32_t resource;
+    GraphAccess access;
+    // overrides the layout of the access; for attachments, the layout the render pass leaves the image in
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+// Frame schedule of passes declaring the resources they read and write. Compiling it culls the passes nothing
+// presented depends on, plans the fewest barriers between the remaining ones and places transient images whose
+// lifetimes within the frame do not overlap into the same memory. Render passes transition and synchronize their
+// own attachments through their subpass dependencies, the graph only tracks the layouts they leave; everything
+// else (buffers written by compute, storage images) is synchronized by barriers the graph records before a pass.
+// Passes on the async compute queue are ordered against the graphics queue by semaphores instead.
+class RenderGraph {
+private:
+    struct Resource {
+        std::string name;
+        bool image;
+        bool transient;
+        bool output = false;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        TransientImageInfo info{};
+        std::function<VkImage(uint32_t)> imported;      // image of a swap chain image index
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        uint32_t firstPass = UINT32_MAX;                // lifetime within the schedule
+        uint32_t lastPass = 0;
+        uint32_t block = UINT32_MAX;                    // memory block of a transient image
+        VkDeviceSize size = 0;
+        std::vector<VkImage> images;                    // per copy
+        std::vector<VkImageView> imageViews;
+    };
+    struct ImageTransition {
+        uint32_t resource;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+        VkAccessFlags srcAccess;
+        VkAccessFlags dstAccess;
+    };
+    // everything recorded before a pass, merged into one vkCmdPipelineBarrier
+    struct PassBarrier {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        VkAccessFlags srcAccess = 0;                    // global memory barrier, for buffers
+        VkAccessFlags dstAccess = 0;
+        std::vector<ImageTransition> transitions;
+        bool needed() const { return srcStages != 0 || !transitions.empty(); }
+    };
+    struct Pass {
+        std::string name;
+        PassQueue queue;
+        std::vector<ResourceUse> uses;
+        std::function<void(VkCommandBuffer, uint32_t)> record;
+        bool sideEffects;
+        bool culled = false;
+        PassBarrier barrier;
+    };
+    struct MemoryBlock {
+        std::vector<uint32_t> resources;
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memoryTypeBits = UINT32_MAX;
+        std::vector<VkDeviceMemory> memory;             // per copy
+    };
+
+    Device* _device;
+    std::vector<Resource> _resources;
+    std::vector<Pass> _passes;
+    std::vector<MemoryBlock> _blocks;
+    VkExtent2D _extent{};
+    uint32_t _copies = 0;
+    uint32_t _barrierCount = 0;
+    uint32_t _transitionCount = 0;
+
+    void cullPasses();
+    void computeLifetimes();
+    void createTransientImages();
+    void aliasMemory();
+    void planBarriers();
+    void destroyTransientImages(bool deferred);
+
+public:
+    RenderGraph(Device* device);
+    ~RenderGraph();
+
+    // an image owned elsewhere, in the given layout whenever a frame starts
+    uint32_t importImage(const std::string& name, std::function<VkImage(uint32_t)> image, VkImageLayout initialLayout,
+                         VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+    uint32_t importBuffer(const std::string& name);
+    uint32_t createImage(const std::string& name, const TransientImageInfo& info);
+    // presented or otherwise consumed after the frame, passes it depends on are never culled
+    void markOutput(uint32_t resource);
+    // passes run in the order they are added, ones with side effects are never culled
+    void addPass(const std::string& name, PassQueue queue, std::vector<ResourceUse> uses,
+                 std::function<void(VkCommandBuffer, uint32_t)> record, bool sideEffects = false);
+
+    // (re)creates the transient images for the swap chain, images of a previous compile are destroyed once the
+    // frames submitted so far finish
+    void compile(VkExtent2D extent, uint32_t copies);
+    VkImage image(uint32_t resource, uint32_t copy)             { return _resources[resource].images[copy]; }
+    VkImageView imageView(uint32_t resource, uint32_t copy)     { return _resources[resource].imageViews[copy]; }
+    std::vector<VkImageView> imageViews(uint32_t resource)      { return _resources[resource].imageViews; }
+    uint32_t passIndex(const std::string& name) const;
+
+    // records the live passes in [begin, end) of the schedule with their barriers, for the given swap chain image
+    void execute(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t begin = 0, uint32_t end = UINT32_MAX);
+    void printSchedule();
+};
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "render_queue.h"
+
+namespace vmr {
+
+RenderQueue::RenderQueue(bool sort) : _sort(sort) {}
+
+uint64_t RenderQueue::sortKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+    //non-negative floats order like their bit patterns, so nearer items get smaller keys
+    depth = std::max(depth, 0.0f);
+    uint32_t depthBits;
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    uint64_t state = (static_cast<uint64_t>(pipeline & HIDDEN_PIPELINE) << (SORT_KEY_MATERIAL_BITS + SORT_KEY_MESH_BITS))
+                   | (static_cast<uint64_t>(material & ((1u << SORT_KEY_MATERIAL_BITS) - 1)) << SORT_KEY_MESH_BITS)
+                   | (mesh & ((1u << SORT_KEY_MESH_BITS) - 1));
+    return (state << 32) | depthBits;
+}
+
+void RenderQueue::clear() {
+    _keys.clear();
+    _items.clear();
+    _batches.clear();
+    _frameChanges = StateChanges{};
+}
+
+void RenderQueue::add(uint64_t key, uint32_t item) {
+    _keys.push_back(key);
+    _items.push_back(item);
+}
+
+void RenderQueue::finish() {
+    auto start = std::chrono::high_resolution_clock::now();
+    if (_sort) {
+        radixSort();
+    }
+    buildBatches();
+    _sortMicrosecondsTotal += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    _itemsTotal += _items.size();
+    _frames++;
+}
+
+void RenderQueue::radixSort() {
+    size_t count = _keys.size();
+    if (count < 2) {
+        return;
+    }
+    _scratchKeys.resize(count);
+    _scratchItems.resize(count);
+
+    //one counting pass per byte from the least significant one, each stable so earlier passes stay ordered
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        std::array<size_t, 256> offsets{};
+        for (uint64_t key : _keys) {
+            offsets[(key >> shift) & 0xFF]++;
+        }
+        //a byte shared by every key leaves the order as it is, which skips the pipeline byte and most of the depth
+        if (offsets[(_keys.front() >> shift) & 0xFF] == count) {
+            continue;
+        }
+        size_t offset = 0;
+        for (size_t& bucket : offsets) {
+            size_t bucketSize = bucket;
+            bucket = offset;
+            offset += bucketSize;
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t target = offsets[(_keys[i] >> shift) & 0xFF]++;
+            _scratchKeys[target] = _keys[i];
+            _scratchItems[target] = _items[i];
+        }
+        _keys.swap(_scratchKeys);
+        _items.swap(_scratchItems);
+    }
+}
+
+void RenderQueue::buildBatches() {
+    //runs of equal state in the draw order, hidden items end a run
+    for (uint32_t i = 0; i < _keys.size(); i++) {
+        uint64_t state = _keys[i] >> 32;
+        uint32_t pipeline = static_cast<uint32_t>(state >> (SORT_KEY_MATERIAL_BITS + SORT_KEY_MESH_BITS));
+        if (pipeline == HIDDEN_PIPELINE) {
+            continue;
+        }
+        if (i > 0 && (_keys[i - 1] >> 32) == state) {
+            _batches.back().instanceCount++;
+            continue;
+        }
+        DrawBatch batch{};
+        batch.pipeline = pipeline;
+        batch.material = static_cast<uint32_t>(state >> SORT_KEY_MESH_BITS) & ((1u << SORT_KEY_MATERIAL_BITS) - 1);
+        batch.mesh = static_cast<uint32_t>(state) & ((1u << SORT_KEY_MESH_BITS) - 1);
+        batch.firstInstance = i;
+        batch.instanceCount = 1;
+        _batches.push_back(batch);
+    }
+}
+
+void RenderQueue::addFrameChanges(const StateChanges& changes, uint64_t skippedBinds) {
+    _frameChanges = changes;
+    _changesTotal.pipelineBinds += changes.pipelineBinds;
+    _changesTotal.descriptorSetBinds += changes.descriptorSetBinds;
+    _changesTotal.materialPushes += changes.materialPushes;
+    _changesTotal.draws += changes.draws;
+    _skippedBindsTotal += skippedBinds;
+}
+
+void RenderQueue::printStats() {
+    if (_frames == 0) {
+        return;
+    }
+    std::cout<<"Render queue ("<<(_sort ? "sorted" : "scene order")<<"): avg "<<_itemsTotal / static_cast<double>(_frames)<<" item(s) in "
+             <<_sortMicrosecondsTotal / static_cast<double>(_frames)<<" us, per frame "
+             <<_changesTotal.draws / static_cast<double>(_frames)<<" draw(s), "
+             <<_changesTotal.pipelineBinds / static_cast<double>(_frames)<<" pipeline, "
+             <<_changesTotal.descriptorSetBinds / static_cast<double>(_frames)<<" descriptor set bind(s) and "
+             <<_changesTotal.materialPushes / static_cast<double>(_frames)<<" material push(es), "
+             <<_skippedBindsTotal / static_cast<double>(_frames)<<" redundant bind(s) skipped"<<std::endl;
+}
+}
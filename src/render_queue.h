@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace vmr {
+// key fields from the most to the least significant bits, depth being the float bits of a non-negative view depth
+const uint32_t SORT_KEY_PIPELINE_BITS = 8;
+const uint32_t SORT_KEY_MATERIAL_BITS = 16;
+const uint32_t SORT_KEY_MESH_BITS = 8;
+// pipeline of items kept in the instance order but not drawn, sorting them behind every drawn one
+const uint32_t HIDDEN_PIPELINE = (1u << SORT_KEY_PIPELINE_BITS) - 1;
+
+// consecutive items with the same pipeline, material and mesh, drawn with one instanced draw
+struct DrawBatch {
+    uint32_t pipeline;
+    uint32_t material;
+    uint32_t mesh;
+    uint32_t firstInstance;     // position of the first item in the draw order
+    uint32_t instanceCount;
+};
+
+// binds and draws of one pass, redundant binds are skipped and not counted
+struct StateChanges {
+    uint64_t pipelineBinds = 0;
+    uint64_t descriptorSetBinds = 0;
+    uint64_t materialPushes = 0;
+    uint64_t draws = 0;
+};
+
+// Orders the draws of a frame by 64-bit sort keys of pipeline, material, mesh and depth, so state changes only happen
+// between groups of draws sharing them and each group is drawn front to back. Items are sorted with an LSD radix sort
+// over bytes, skipping the bytes every key has in common. The resulting order is the order the instance data is
+// written in, so each batch is a contiguous range of instances.
+class RenderQueue {
+private:
+    bool _sort;
+    std::vector<uint64_t> _keys;
+    std::vector<uint32_t> _items;
+    std::vector<uint64_t> _scratchKeys;
+    std::vector<uint32_t> _scratchItems;
+    std::vector<DrawBatch> _batches;
+    StateChanges _frameChanges;
+    uint64_t _frames = 0;
+    uint64_t _itemsTotal = 0;
+    uint64_t _sortMicrosecondsTotal = 0;
+    StateChanges _changesTotal;
+    uint64_t _skippedBindsTotal = 0;
+
+    void radixSort();
+    void buildBatches();
+
+public:
+    // unsorted, the items keep the order they were added in and are only batched
+    RenderQueue(bool sort);
+
+    static uint64_t sortKey(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+    void clear();
+    void add(uint64_t key, uint32_t item);
+    // sorts the items and groups them into batches
+    void finish();
+
+    // items in draw order, hidden items included
+    const std::vector<uint32_t>& order() const      { return _items; }
+    const std::vector<DrawBatch>& batches() const   { return _batches; }
+
+    // the state changes of the shading pass of the frame, with the binds a draw-by-draw submission would have issued
+    void addFrameChanges(const StateChanges& changes, uint64_t skippedBinds);
+    const StateChanges& frameChanges() const        { return _frameChanges; }
+    void printStats();
+};
+}
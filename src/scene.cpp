@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene.h"
+
+namespace vmr {
+
+Scene::Scene(AppConfig* appConfig) : _appConfig(appConfig) {
+    if (_appConfig->sceneInstances().empty()) {
+        throw std::runtime_error("scene has to contain at least one instance!");
+    }
+    if (_appConfig->crowdSize() > 0) {
+        populateCrowd(_appConfig->crowdSize());
+    } else {
+        loadInstances();
+    }
+    generateLights();
+    _capacity = instanceCount();
+    for (uint32_t count : _appConfig->benchmarkInstanceCounts()) {
+        _capacity = std::max(_capacity, count);
+    }
+}
+
+void Scene::loadInstances() {
+    _instances.clear();
+    _instanceMaterials.clear();
+    for (const auto& transform : _appConfig->sceneInstances()) {
+        _instances.push_back({transform.matrix()});
+        _instanceMaterials.push_back(transform.material);
+    }
+    _version++;
+}
+
+void Scene::populateCrowd(uint32_t instanceCount) {
+    //copies of the first instance laid out on a square grid, growing away from the camera and cycling through the materials
+    const InstanceTransform& base = _appConfig->sceneInstances().front();
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+    float spacing = _appConfig->crowdSpacing();
+
+    uint32_t materialCount = static_cast<uint32_t>(_appConfig->materials().size());
+
+    _instances.clear();
+    _instanceMaterials.clear();
+    _instances.reserve(instanceCount);
+    _instanceMaterials.reserve(instanceCount);
+    for (uint32_t i = 0; i < instanceCount; i++) {
+        InstanceTransform transform = base;
+        transform.position.x += (i / side) * spacing;
+        transform.position.y += ((i % side) - (side - 1) / 2.0f) * spacing;
+        _instances.push_back({transform.matrix()});
+        _instanceMaterials.push_back((base.material + i) % materialCount);
+    }
+    _version++;
+}
+
+void Scene::generateLights() {
+    //scattered in a cube around the first instance with random saturated colors, the same seed gives the same lights
+    const InstanceTransform& base = _appConfig->sceneInstances().front();
+    std::mt19937 generator(_appConfig->pointLightSeed());
+    std::uniform_real_distribution<float> offset(-_appConfig->pointLightSpread(), _appConfig->pointLightSpread());
+    std::uniform_real_distribution<float> hue(0.0f, 6.0f);
+
+    _lights.clear();
+    _lights.reserve(_appConfig->pointLightCount());
+    for (uint32_t i = 0; i < _appConfig->pointLightCount(); i++) {
+        glm::vec3 position = base.position + glm::vec3(offset(generator), offset(generator), offset(generator));
+        float h = hue(generator);
+        glm::vec3 color = glm::clamp(glm::vec3(std::fabs(h - 3.0f) - 1.0f, 2.0f - std::fabs(h - 2.0f), 2.0f - std::fabs(h - 4.0f)), 0.0f, 1.0f);
+        _lights.push_back({glm::vec4(position, _appConfig->pointLightRadius()), glm::vec4(color, _appConfig->pointLightIntensity())});
+    }
+}
+
+}
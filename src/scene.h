@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+
+namespace vmr {
+// Per-instance data of the display model, laid out as the std430 InstanceBuffer of the model shaders
+struct InstanceData {
+    alignas(16) glm::mat4 model;
+};
+
+// Point light affecting everything within its radius, laid out as the std430 LightBuffer of the clustered lighting shaders
+struct PointLight {
+    alignas(16) glm::vec4 positionRadius;   // world space position, radius of influence
+    alignas(16) glm::vec4 colorIntensity;
+};
+
+class Scene {
+private:
+    AppConfig* _appConfig;
+    std::vector<InstanceData> _instances;
+    std::vector<uint32_t> _instanceMaterials;   // material of every instance, an index into the config materials
+    std::vector<PointLight> _lights;
+    uint32_t _capacity;
+    uint64_t _version = 0;
+
+public:
+    Scene(AppConfig* appConfig);
+
+    const std::vector<InstanceData>& instances()    const { return _instances; }
+    uint32_t instanceCount()                        const { return static_cast<uint32_t>(_instances.size()); }
+    const std::vector<uint32_t>& instanceMaterials() const { return _instanceMaterials; }
+    uint32_t capacity()                             const { return _capacity; }
+    uint64_t version()                              const { return _version; }
+    const std::vector<PointLight>& lights()         const { return _lights; }
+    uint32_t lightCount()                           const { return static_cast<uint32_t>(_lights.size()); }
+
+    void loadInstances();
+    void populateCrowd(uint32_t instanceCount);
+    void generateLights();
+};
+}
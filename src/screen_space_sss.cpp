@@ -0,0 +1,537 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "fullscreen_pipeline.h"
+#include "screen_space_sss.h"
+
+namespace vmr {
+
+const uint32_t DOWNSAMPLE_GROUP_SIZE = 8;
+const uint32_t BLUR_GROUP_SIZE = 64;
+
+// matches the push constant block of sss_blur.comp
+struct BlurPushConstants {
+    glm::vec4 width;
+    glm::ivec2 size;
+    int32_t vertical;
+    float pixelsPerUnit;
+    float depthThreshold;
+};
+
+ScreenSpaceSss::ScreenSpaceSss(Device* device, AppConfig* appConfig, SwapChain* swapChain, RenderGraph* renderGraph, uint32_t firstTarget,
+                               uint32_t secondTarget, uint32_t framesInFlight)
+            : _device(device), _appConfig(appConfig), _swapChain(swapChain), _renderGraph(renderGraph), _firstTarget(firstTarget),
+              _secondTarget(secondTarget) {
+    _asyncCompute = _appConfig->sssAsyncCompute() && _device->asyncComputeSupported();
+    //descriptor sets come from the pool of the current swap chain targets, the pipelines' own pools stay unused
+    _downsamplePipeline = new ComputePipeline(_device, _appConfig->sssDownsampleComputeShaderPath(),
+                                              {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE}, 2 * sizeof(glm::ivec2), 1);
+    _blurPipeline = new ComputePipeline(_device, _appConfig->sssBlurComputeShaderPath(),
+                                        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE}, sizeof(BlurPushConstants), 1);
+    createSampler();
+    createCompositeRenderPass();
+    createCompositeDescriptorSetLayout();
+    createCompositePipeline();
+    if (_swapChain->multisampled()) {
+        createResolvePipeline();
+    }
+    if (_asyncCompute) {
+        createComputeCommandBuffers(framesInFlight);
+    }
+    _halfExtent = {std::max(1u, (_swapChain->extent().width + 1) / 2), std::max(1u, (_swapChain->extent().height + 1) / 2)};
+    createFramebuffers();
+    createDescriptorSets();
+}
+
+ScreenSpaceSss::~ScreenSpaceSss() {
+    destroyTargets();
+    for (size_t i = 0; i < _irradianceReadySemaphores.size(); i++) {
+        vkDestroySemaphore(_device->logical(), _irradianceReadySemaphores[i], nullptr);
+        vkDestroySemaphore(_device->logical(), _scatteringDoneSemaphores[i], nullptr);
+    }
+    if (_computeCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(_device->logical(), _computeCommandPool, nullptr);
+    }
+    vkDestroyPipeline(_device->logical(), _resolvePipeline, nullptr);
+    vkDestroyPipelineLayout(_device->logical(), _resolvePipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device->logical(), _resolveDescriptorSetLayout, nullptr);
+    vkDestroyPipeline(_device->logical(), _compositePipeline, nullptr);
+    vkDestroyPipelineLayout(_device->logical(), _compositePipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device->logical(), _compositeDescriptorSetLayout, nullptr);
+    vkDestroyRenderPass(_device->logical(), _compositeRenderPass, nullptr);
+    vkDestroySampler(_device->logical(), _sampler, nullptr);
+    delete _blurPipeline;
+    delete _downsamplePipeline;
+}
+
+void ScreenSpaceSss::createSampler() {
+    //every pass fetches exact texels, the upsampling weights are computed in the shader
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(_device->logical(), &samplerInfo, nullptr, &_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create screen-space scattering sampler!");
+    }
+}
+
+void ScreenSpaceSss::createCompositeRenderPass() {
+    //the shading pass left the HDR target in the attachment layout, the composite adds to it
+    bool tonemapSubpass = _appConfig->tonemapSubpass();
+    VkAttachmentDescription hdrAttachment{};
+    hdrAttachment.format = _swapChain->hdrFormat();
+    hdrAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    hdrAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    //only read within the render pass once tonemapped by its subpass, unless an EXR capture copies it after the frame
+    bool hdrCapture = _appConfig->captureEnabled() && _appConfig->captureFormat() == "exr";
+    hdrAttachment.storeOp = tonemapSubpass && !hdrCapture ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+    hdrAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    hdrAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    hdrAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    hdrAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    //written by the tonemapping subpass, then presented (or sampled by the upscale)
+    VkAttachmentDescription sceneColorAttachment{};
+    sceneColorAttachment.format = _swapChain->sceneColorFormat();
+    sceneColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    sceneColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    sceneColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    sceneColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    sceneColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    sceneColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    sceneColorAttachment.finalLayout = _appConfig->dynamicResolution() ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference hdrAttachmentRef{};
+    hdrAttachmentRef.attachment = 0;
+    hdrAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &hdrAttachmentRef;
+
+    VkAttachmentReference hdrInputRef{};
+    hdrInputRef.attachment = 0;
+    hdrInputRef.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference sceneColorRef{};
+    sceneColorRef.attachment = 1;
+    sceneColorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription tonemapSubpassDescription{};
+    tonemapSubpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    tonemapSubpassDescription.inputAttachmentCount = 1;
+    tonemapSubpassDescription.pInputAttachments = &hdrInputRef;
+    tonemapSubpassDescription.colorAttachmentCount = 1;
+    tonemapSubpassDescription.pColorAttachments = &sceneColorRef;
+
+    //waits for the blur and for the shading pass writing the image
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    std::vector<VkSubpassDependency> dependencies = {dependency};
+    std::vector<VkSubpassDescription> subpasses = {subpass};
+    std::vector<VkAttachmentDescription> attachments = {hdrAttachment};
+
+    if (tonemapSubpass) {
+        VkSubpassDependency tonemapDependency{};
+        tonemapDependency.srcSubpass = 0;
+        tonemapDependency.dstSubpass = 1;
+        tonemapDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        tonemapDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        tonemapDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        tonemapDependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        tonemapDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        //the scene color target is first written here, after the swap chain image was acquired
+        VkSubpassDependency sceneColorDependency{};
+        sceneColorDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        sceneColorDependency.dstSubpass = 1;
+        sceneColorDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        sceneColorDependency.srcAccessMask = 0;
+        sceneColorDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        sceneColorDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        dependencies.push_back(tonemapDependency);
+        dependencies.push_back(sceneColorDependency);
+        subpasses.push_back(tonemapSubpassDescription);
+        attachments.push_back(sceneColorAttachment);
+    }
+
+    //the upscale samples the scene color, the separate tonemap pass the HDR target
+    if (_appConfig->dynamicResolution() || !tonemapSubpass) {
+        VkSubpassDependency outputDependency{};
+        outputDependency.srcSubpass = static_cast<uint32_t>(subpasses.size()) - 1;
+        outputDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        outputDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        outputDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        outputDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        outputDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dependencies.push_back(outputDependency);
+    }
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(_device->logical(), &renderPassInfo, nullptr, &_compositeRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create screen-space scattering render pass!");
+    }
+}
+
+void ScreenSpaceSss::createCompositeDescriptorSetLayout() {
+    //blurred half resolution irradiance, full resolution irradiance for the depths
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[i].pImmutableSamplers = nullptr;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(_device->logical(), &layoutInfo, nullptr, &_compositeDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create screen-space scattering descriptor set layout!");
+    }
+}
+
+void ScreenSpaceSss::createCompositePipeline() {
+    //additive, the shading pass already wrote everything except the scattered diffuse
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT;
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    _compositePipelineLayout = createFullscreenPipelineLayout(_device, _compositeDescriptorSetLayout, sizeof(glm::ivec2));
+    _compositePipeline = createFullscreenPipeline(_device, _appConfig->fullscreenVertexShaderPath(), _appConfig->sssCompositeFragmentShaderPath(),
+                                                  _compositePipelineLayout, _compositeRenderPass, 0, &colorBlendAttachment);
+}
+
+void ScreenSpaceSss::createResolvePipeline() {
+    VkDescriptorSetLayoutBinding samplesLayoutBinding{};
+    samplesLayoutBinding.binding = 0;
+    samplesLayoutBinding.descriptorCount = 1;
+    samplesLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    samplesLayoutBinding.pImmutableSamplers = nullptr;
+    samplesLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &samplesLayoutBinding;
+
+    if (vkCreateDescriptorSetLayout(_device->logical(), &layoutInfo, nullptr, &_resolveDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create irradiance resolve descriptor set layout!");
+    }
+
+    _resolvePipelineLayout = createFullscreenPipelineLayout(_device, _resolveDescriptorSetLayout, sizeof(int32_t));
+    _resolvePipeline = createFullscreenPipeline(_device, _appConfig->fullscreenVertexShaderPath(), _appConfig->sssResolveFragmentShaderPath(),
+                                                _resolvePipelineLayout, _swapChain->renderPass(), _appConfig->shadingSubpass() + 1);
+}
+
+void ScreenSpaceSss::createComputeCommandBuffers(uint32_t framesInFlight) {
+    QueueFamilyIndices queueFamilyIndices = _device->findQueueFamilies(_device->physical());
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+
+    if (vkCreateCommandPool(_device->logical(), &poolInfo, nullptr, &_computeCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute command pool!");
+    }
+
+    _computeCommandBuffers.resize(framesInFlight);
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = _computeCommandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = framesInFlight;
+
+    if (vkAllocateCommandBuffers(_device->logical(), &allocInfo, _computeCommandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate compute command buffers!");
+    }
+
+    //shading pass -> blur on the compute queue -> composite on the graphics queue
+    _irradianceReadySemaphores.resize(framesInFlight);
+    _scatteringDoneSemaphores.resize(framesInFlight);
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        if (vkCreateSemaphore(_device->logical(), &semaphoreInfo, nullptr, &_irradianceReadySemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(_device->logical(), &semaphoreInfo, nullptr, &_scatteringDoneSemaphores[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create screen-space scattering semaphores!");
+        }
+    }
+}
+
+void ScreenSpaceSss::createFramebuffers() {
+    _framebuffers.resize(_swapChain->imageViews().size());
+    for (size_t i = 0; i < _framebuffers.size(); i++) {
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        std::vector<VkImageView> attachments = {_swapChain->hdrImageView(i)};
+        if (_appConfig->tonemapSubpass()) {
+            attachments.push_back(_swapChain->sceneColorImageViews()[i]);
+        }
+        framebufferInfo.renderPass = _compositeRenderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
+        framebufferInfo.width = _swapChain->extent().width;
+        framebufferInfo.height = _swapChain->extent().height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(_device->logical(), &framebufferInfo, nullptr, &_framebuffers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create screen-space scattering framebuffer!");
+        }
+    }
+}
+
+void ScreenSpaceSss::createDescriptorSets() {
+    uint32_t imageCount = static_cast<uint32_t>(_swapChain->imageViews().size());
+    //per swap chain image: downsample, horizontal and vertical blur, composite; one resolve set for the shared samples
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = imageCount * 3;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = imageCount * 5;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    poolSizes[2].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = imageCount * 4 + 1;
+
+    if (vkCreateDescriptorPool(_device->logical(), &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create screen-space scattering descriptor pool!");
+    }
+
+    auto allocate = [this](VkDescriptorSetLayout layout) {
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = _descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        VkDescriptorSet descriptorSet;
+        if (vkAllocateDescriptorSets(_device->logical(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate screen-space scattering descriptor set!");
+        }
+        return descriptorSet;
+    };
+
+    _downsampleSets.resize(imageCount);
+    _horizontalSets.resize(imageCount);
+    _verticalSets.resize(imageCount);
+    _compositeSets.resize(imageCount);
+    for (uint32_t i = 0; i < imageCount; i++) {
+        _downsampleSets[i] = allocate(_downsamplePipeline->descriptorSetLayout());
+        _horizontalSets[i] = allocate(_blurPipeline->descriptorSetLayout());
+        _verticalSets[i] = allocate(_blurPipeline->descriptorSetLayout());
+        _compositeSets[i] = allocate(_compositeDescriptorSetLayout);
+
+        //the blur goes from the first target into the second one and back
+        VkDescriptorImageInfo irradianceInfo{_sampler, _swapChain->irradianceImageViews()[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo firstStorageInfo{VK_NULL_HANDLE, _renderGraph->imageView(_firstTarget, i), VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo secondStorageInfo{VK_NULL_HANDLE, _renderGraph->imageView(_secondTarget, i), VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo scatteredInfo{_sampler, _renderGraph->imageView(_firstTarget, i), VK_IMAGE_LAYOUT_GENERAL};
+
+        std::array<VkWriteDescriptorSet, 8> descriptorWrites{};
+        auto write = [&descriptorWrites](uint32_t index, VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo* info) {
+            descriptorWrites[index].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[index].dstSet = set;
+            descriptorWrites[index].dstBinding = binding;
+            descriptorWrites[index].dstArrayElement = 0;
+            descriptorWrites[index].descriptorType = type;
+            descriptorWrites[index].descriptorCount = 1;
+            descriptorWrites[index].pImageInfo = info;
+        };
+        write(0, _downsampleSets[i], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &irradianceInfo);
+        write(1, _downsampleSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &firstStorageInfo);
+        write(2, _horizontalSets[i], 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &firstStorageInfo);
+        write(3, _horizontalSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &secondStorageInfo);
+        write(4, _verticalSets[i], 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &secondStorageInfo);
+        write(5, _verticalSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &firstStorageInfo);
+        write(6, _compositeSets[i], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &scatteredInfo);
+        write(7, _compositeSets[i], 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &irradianceInfo);
+
+        vkUpdateDescriptorSets(_device->logical(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    if (_resolvePipeline != VK_NULL_HANDLE) {
+        _resolveSet = allocate(_resolveDescriptorSetLayout);
+        VkDescriptorImageInfo samplesInfo{VK_NULL_HANDLE, _swapChain->irradianceMsImageView(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = _resolveSet;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &samplesInfo;
+        vkUpdateDescriptorSets(_device->logical(), 1, &descriptorWrite, 0, nullptr);
+    }
+}
+
+void ScreenSpaceSss::destroyTargets() {
+    //freeing the pool frees its descriptor sets
+    vkDestroyDescriptorPool(_device->logical(), _descriptorPool, nullptr);
+    for (auto framebuffer : _framebuffers) {
+        vkDestroyFramebuffer(_device->logical(), framebuffer, nullptr);
+    }
+}
+
+void ScreenSpaceSss::recreate() {
+    //frames in flight keep using the old framebuffers and sets, the targets themselves belong to the render graph
+    _device->deletionQueue().push([device = _device->logical(), descriptorPool = _descriptorPool, framebuffers = _framebuffers]() {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        for (auto framebuffer : framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+    });
+    _halfExtent = {std::max(1u, (_swapChain->extent().width + 1) / 2), std::max(1u, (_swapChain->extent().height + 1) / 2)};
+    createFramebuffers();
+    createDescriptorSets();
+}
+
+VkExtent2D ScreenSpaceSss::halfRenderExtent() {
+    VkExtent2D renderExtent = _swapChain->renderExtent();
+    return {std::min(_halfExtent.width, (renderExtent.width + 1) / 2), std::min(_halfExtent.height, (renderExtent.height + 1) / 2)};
+}
+
+void ScreenSpaceSss::barrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                             VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.oldLayout = oldLayout;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = image;
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = 1;
+    imageBarrier.srcAccessMask = srcAccess;
+    imageBarrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
+void ScreenSpaceSss::recordResolve(VkCommandBuffer commandBuffer) {
+    //viewport and scissor are still the ones of the shading subpass
+    int32_t sampleCount = static_cast<int32_t>(_swapChain->sampleCount());
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _resolvePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _resolvePipelineLayout, 0, 1, &_resolveSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, _resolvePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(sampleCount), &sampleCount);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void ScreenSpaceSss::recordDownsample(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    VkExtent2D halfExtent = halfRenderExtent();
+    VkExtent2D renderExtent = _swapChain->renderExtent();
+    //half resolution size, rendered part of the irradiance target
+    std::array<glm::ivec2, 2> sizes = {glm::ivec2(halfExtent.width, halfExtent.height), glm::ivec2(renderExtent.width, renderExtent.height)};
+    _downsamplePipeline->bind(commandBuffer, _downsampleSets[imageIndex]);
+    _downsamplePipeline->pushConstants(commandBuffer, sizes.data(), sizeof(sizes));
+    vkCmdDispatch(commandBuffer, (halfExtent.width + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE,
+                  (halfExtent.height + DOWNSAMPLE_GROUP_SIZE - 1) / DOWNSAMPLE_GROUP_SIZE, 1);
+}
+
+void ScreenSpaceSss::recordBlur(VkCommandBuffer commandBuffer, uint32_t imageIndex, const glm::mat4& projection) {
+    //the render graph orders the blur after the downsample and the composite after the blur
+    VkImage second = _renderGraph->image(_secondTarget, imageIndex);
+    VkExtent2D halfExtent = halfRenderExtent();
+
+    //red scatters furthest in skin, blue the least
+    float width = _appConfig->sssWidth() * _appConfig->unitsPerMillimeter();
+    BlurPushConstants pushConstants{};
+    pushConstants.width = glm::vec4(width, width * 0.45f, width * 0.25f, 0.0f);
+    pushConstants.size = glm::ivec2(halfExtent.width, halfExtent.height);
+    pushConstants.pixelsPerUnit = std::abs(projection[1][1]) * halfExtent.height * 0.5f;
+    pushConstants.depthThreshold = _appConfig->sssDepthThreshold();
+
+    pushConstants.vertical = 0;
+    _blurPipeline->bind(commandBuffer, _horizontalSets[imageIndex]);
+    _blurPipeline->pushConstants(commandBuffer, &pushConstants, sizeof(pushConstants));
+    vkCmdDispatch(commandBuffer, (halfExtent.width + BLUR_GROUP_SIZE - 1) / BLUR_GROUP_SIZE, halfExtent.height, 1);
+
+    //also orders the vertical pass writing the first target after the horizontal one read it
+    barrier(commandBuffer, second, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    pushConstants.vertical = 1;
+    _blurPipeline->bind(commandBuffer, _verticalSets[imageIndex]);
+    _blurPipeline->pushConstants(commandBuffer, &pushConstants, sizeof(pushConstants));
+    vkCmdDispatch(commandBuffer, (halfExtent.height + BLUR_GROUP_SIZE - 1) / BLUR_GROUP_SIZE, halfExtent.width, 1);
+}
+
+void ScreenSpaceSss::recordComposite(VkCommandBuffer commandBuffer, uint32_t imageIndex, Tonemapping* tonemapping) {
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _compositeRenderPass;
+    renderPassInfo.framebuffer = _framebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = _swapChain->renderExtent();
+    renderPassInfo.clearValueCount = 0;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(_swapChain->renderExtent().width);
+    viewport.height = static_cast<float>(_swapChain->renderExtent().height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = _swapChain->renderExtent();
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _compositePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _compositePipelineLayout, 0, 1, &_compositeSets[imageIndex], 0, nullptr);
+    VkExtent2D halfExtent = halfRenderExtent();
+    glm::ivec2 halfSize(halfExtent.width, halfExtent.height);
+    vkCmdPushConstants(commandBuffer, _compositePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(halfSize), &halfSize);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    if (tonemapping->subpass()) {
+        vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+        tonemapping->recordSubpass(commandBuffer, imageIndex);
+    }
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+}
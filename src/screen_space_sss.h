@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+#include "compute_pipeline.h"
+#include "device.h"
+#include "render_graph.h"
+#include "swap_chain.h"
+#include "tonemapping.h"
+
+namespace vmr {
+// Screen-space subsurface scattering. The shading pass writes the key light diffuse of the skin with its view depth
+// into an irradiance target (resolved by a last subpass of the shading pass with multisampling), which is halved, blurred by a separable depth-aware diffusion kernel in compute and added
+// back onto the HDR target by a fullscreen composite pass, which then tonemaps it in a second subpass. With async compute the blur runs on a compute-only
+// queue, the graphics queue only waits for it right before the composite.
+class ScreenSpaceSss {
+private:
+    Device* _device;
+    AppConfig* _appConfig;
+    SwapChain* _swapChain;
+    RenderGraph* _renderGraph;
+    uint32_t _firstTarget;                  // render graph images, two half resolution targets blurred back and forth
+    uint32_t _secondTarget;
+    bool _asyncCompute;
+    ComputePipeline* _downsamplePipeline;
+    ComputePipeline* _blurPipeline;
+    VkSampler _sampler;
+    VkRenderPass _compositeRenderPass;
+    VkDescriptorSetLayout _compositeDescriptorSetLayout;
+    VkPipelineLayout _compositePipelineLayout;
+    VkPipeline _compositePipeline;
+    VkDescriptorSetLayout _resolveDescriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout _resolvePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline _resolvePipeline = VK_NULL_HANDLE;
+    VkCommandPool _computeCommandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> _computeCommandBuffers;
+    std::vector<VkSemaphore> _irradianceReadySemaphores;
+    std::vector<VkSemaphore> _scatteringDoneSemaphores;
+
+    // recreated together with the swap chain
+    VkExtent2D _halfExtent;                 // allocated size, the passes only cover the half of the render extent
+    std::vector<VkFramebuffer> _framebuffers;
+    VkDescriptorPool _descriptorPool;
+    std::vector<VkDescriptorSet> _downsampleSets;
+    std::vector<VkDescriptorSet> _horizontalSets;
+    std::vector<VkDescriptorSet> _verticalSets;
+    std::vector<VkDescriptorSet> _compositeSets;
+    VkDescriptorSet _resolveSet = VK_NULL_HANDLE;    // the multisampled irradiance is shared by all swap chain images
+
+    void createSampler();
+    void createCompositeRenderPass();
+    void createCompositeDescriptorSetLayout();
+    void createCompositePipeline();
+    void createResolvePipeline();
+    void createComputeCommandBuffers(uint32_t framesInFlight);
+    void createFramebuffers();
+    void createDescriptorSets();
+    void destroyTargets();
+    VkExtent2D halfRenderExtent();
+    void barrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                 VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage);
+
+public:
+    ScreenSpaceSss(Device* device, AppConfig* appConfig, SwapChain* swapChain, RenderGraph* renderGraph, uint32_t firstTarget, uint32_t secondTarget,
+                   uint32_t framesInFlight);
+    ~ScreenSpaceSss();
+    // configured and the device has a compute-only queue family
+    bool asyncCompute()                                 const { return _asyncCompute; }
+    VkCommandBuffer computeCommandBuffer(uint32_t frame)      { return _computeCommandBuffers[frame]; }
+    VkSemaphore irradianceReadySemaphore(uint32_t frame)      { return _irradianceReadySemaphores[frame]; }
+    VkSemaphore scatteringDoneSemaphore(uint32_t frame)       { return _scatteringDoneSemaphores[frame]; }
+    VkRenderPass compositeRenderPass()                        { return _compositeRenderPass; }
+
+    // rebuilds what refers to the per swap chain image targets after the render graph recreated them, the old
+    // framebuffers and descriptor sets are destroyed once the frames using them finished
+    void recreate();
+    // resolve subpass following the shading subpass of the main render pass, only with multisampling
+    void recordResolve(VkCommandBuffer commandBuffer);
+    // compute work, recorded outside of a render pass after the shading pass ended; the render graph transitions the
+    // targets and orders the passes against each other
+    void recordDownsample(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordBlur(VkCommandBuffer commandBuffer, uint32_t imageIndex, const glm::mat4& projection);
+    // render pass on the HDR target, tonemapped into the scene color target by its second subpass unless the
+    // tonemapping runs as a separate pass
+    void recordComposite(VkCommandBuffer commandBuffer, uint32_t imageIndex, Tonemapping* tonemapping);
+};
+}
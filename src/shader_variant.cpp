@@ -0,0 +1,36 @@
+#include <functional>
+#include <sstream>
+
+#include "shader_variant.h"
+
+namespace vmr {
+
+bool ShaderVariant::operator==(const ShaderVariant& other) const {
+    return sss == other.sss
+            && normalMapping == other.normalMapping
+            && bakedThickness == other.bakedThickness
+            && preintegratedSkin == other.preintegratedSkin
+            && ibl == other.ibl
+            && thicknessSamples == other.thicknessSamples;
+}
+
+std::string ShaderVariant::name() const {
+    std::ostringstream stream;
+    stream<<"sss="<<(sss ? "on" : "off")
+          <<" normalMap="<<(normalMapping ? "on" : "off")
+          <<" thickness="<<(bakedThickness ? "baked" : "loop")
+          <<" skinLUT="<<(preintegratedSkin ? "on" : "off")
+          <<" ibl="<<(ibl ? "on" : "off")
+          <<" samples="<<thicknessSamples;
+    return stream.str();
+}
+
+size_t ShaderVariantHash::operator()(const ShaderVariant& variant) const {
+    size_t seed = std::hash<uint32_t>()(variant.thicknessSamples);
+    seed ^= (static_cast<size_t>(variant.sss) << 3) | (static_cast<size_t>(variant.normalMapping) << 4)
+          | (static_cast<size_t>(variant.bakedThickness) << 5) | (static_cast<size_t>(variant.preintegratedSkin) << 6)
+          | (static_cast<size_t>(variant.ibl) << 7);
+    return seed;
+}
+
+}
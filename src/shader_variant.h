@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace vmr {
+// Values baked into the model fragment shader through specialization constants.
+// Every distinct combination results in a separate VkPipeline, surface parameters come from the material instead.
+struct ShaderVariant {
+    bool sss = true;
+    bool normalMapping = true;
+    bool bakedThickness = true;
+    bool preintegratedSkin = false;
+    bool ibl = false;
+    uint32_t thicknessSamples = 7;
+
+    bool operator==(const ShaderVariant& other) const;
+    std::string name() const;
+};
+
+struct ShaderVariantHash {
+    size_t operator()(const ShaderVariant& variant) const;
+};
+}
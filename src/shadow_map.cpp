@@ -0,0 +1,254 @@
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shadow_map.h"
+
+namespace vmr {
+
+const float SHADOW_NEAR_PLANE = 0.01f;
+
+ShadowMap::ShadowMap(Device* device, AppConfig* appConfig, Scene* scene) : _device(device), _appConfig(appConfig), _scene(scene) {
+    _resolution = _appConfig->shadowMapResolution();
+    chooseFormat();
+    createImage();
+    createImageView();
+    createSampler();
+    createRenderPass();
+    createFramebuffer();
+}
+
+ShadowMap::~ShadowMap() {
+    vkDestroyFramebuffer(_device->logical(), _framebuffer, nullptr);
+    vkDestroyRenderPass(_device->logical(), _renderPass, nullptr);
+    vkDestroySampler(_device->logical(), _sampler, nullptr);
+    vkDestroyImageView(_device->logical(), _imageView, nullptr);
+    vkDestroyImage(_device->logical(), _image, nullptr);
+    vkFreeMemory(_device->logical(), _imageMemory, nullptr);
+}
+
+void ShadowMap::chooseFormat() {
+    //32-bit depth keeps the precision over the whole light range, 16-bit is the only one every device can sample
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(_device->physical(), VK_FORMAT_D32_SFLOAT, &properties);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    _format = (properties.optimalTilingFeatures & required) == required ? VK_FORMAT_D32_SFLOAT : VK_FORMAT_D16_UNORM;
+    if (_format == VK_FORMAT_D16_UNORM) {
+        vkGetPhysicalDeviceFormatProperties(_device->physical(), _format, &properties);
+    }
+    //linear filtering of a comparison sampler averages four depth tests (hardware PCF)
+    _filter = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+}
+
+void ShadowMap::createImage() {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = _resolution * 3;
+    imageInfo.extent.height = _resolution * 2;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = _format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(_device->logical(), &imageInfo, nullptr, &_image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(_device->logical(), _image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = _device->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(_device->logical(), &allocInfo, nullptr, &_imageMemory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate shadow map memory!");
+    }
+    vkBindImageMemory(_device->logical(), _image, _imageMemory, 0);
+}
+
+void ShadowMap::createImageView() {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = _image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = _format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(_device->logical(), &viewInfo, nullptr, &_imageView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map image view!");
+    }
+}
+
+void ShadowMap::createSampler() {
+    //comparison sampler, the shader passes the fragment depth and gets back the lit fraction
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = _filter;
+    samplerInfo.minFilter = _filter;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(_device->logical(), &samplerInfo, nullptr, &_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map sampler!");
+    }
+}
+
+void ShadowMap::createRenderPass() {
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = _format;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 0;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 0;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    //frames still in flight may be sampling the previous atlas, their reads finish before it is cleared
+    std::array<VkSubpassDependency, 2> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    //the model shading samples the new atlas later in the same command buffer
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &depthAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(_device->logical(), &renderPassInfo, nullptr, &_renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map render pass!");
+    }
+}
+
+void ShadowMap::createFramebuffer() {
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = _renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &_imageView;
+    framebufferInfo.width = _resolution * 3;
+    framebufferInfo.height = _resolution * 2;
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(_device->logical(), &framebufferInfo, nullptr, &_framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow map framebuffer!");
+    }
+}
+
+void ShadowMap::updateFaces(const glm::vec3& lightPosition) {
+    const std::array<glm::vec3, SHADOW_MAP_FACES> directions = {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+        glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+    };
+    //depth range is spelled out, the shader compares against [0, 1] depths
+    auto projection = glm::perspectiveRH_ZO(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, _appConfig->shadowFarPlane());
+    for (uint32_t face = 0; face < SHADOW_MAP_FACES; face++) {
+        glm::vec3 up = face < 4 ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        _faceViewProjections[face] = projection * glm::lookAt(lightPosition, lightPosition + directions[face], up);
+    }
+}
+
+void ShadowMap::update(const glm::vec3& lightPosition) {
+    bool unchanged = lightPosition == _renderedLightPosition && _scene->version() == _renderedSceneVersion;
+    if (_valid && (unchanged || !enabled())) {
+        _reuseCount++;
+        return;
+    }
+    //the first frame renders even with shadows disabled, clearing the atlas moves it into a readable layout
+    updateFaces(lightPosition);
+    _renderedLightPosition = lightPosition;
+    _renderedSceneVersion = _scene->version();
+    _valid = true;
+    _dirty = true;
+    _renderCount++;
+}
+
+void ShadowMap::beginRenderPass(VkCommandBuffer commandBuffer) {
+    VkClearValue clearValue{};
+    clearValue.depthStencil = {1.0f, 0};
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _renderPass;
+    renderPassInfo.framebuffer = _framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {_resolution * 3, _resolution * 2};
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearValue;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void ShadowMap::setFace(VkCommandBuffer commandBuffer, uint32_t face) {
+    VkViewport viewport{};
+    viewport.x = static_cast<float>((face % 3) * _resolution);
+    viewport.y = static_cast<float>((face / 3) * _resolution);
+    viewport.width = static_cast<float>(_resolution);
+    viewport.height = static_cast<float>(_resolution);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {static_cast<int32_t>((face % 3) * _resolution), static_cast<int32_t>((face / 3) * _resolution)};
+    scissor.extent = {_resolution, _resolution};
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void ShadowMap::endRenderPass(VkCommandBuffer commandBuffer) {
+    vkCmdEndRenderPass(commandBuffer);
+    _dirty = false;
+}
+
+void ShadowMap::printStats() {
+    uint64_t frames = _renderCount + _reuseCount;
+    if (frames == 0) {
+        return;
+    }
+    std::cout<<"Shadow map rendered in "<<_renderCount<<" of "<<frames<<" frames ("
+             <<100.0 * _renderCount / frames<<"%), reused in the remaining "<<_reuseCount<<std::endl;
+}
+}
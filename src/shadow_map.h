@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+
+#include "app_config.h"
+#include "device.h"
+#include "scene.h"
+
+namespace vmr {
+const uint32_t SHADOW_MAP_FACES = 6;
+
+// Omnidirectional shadow map of the movable light. The six 90 degree faces (+x, -x, +y, -y, +z, -z) are rendered
+// into one depth atlas of 3 by 2 tiles. The atlas is cached: it is only re-rendered after the light position or the
+// scene transforms changed, every other frame samples the previous result.
+class ShadowMap {
+private:
+    Device* _device;
+    AppConfig* _appConfig;
+    Scene* _scene;
+    uint32_t _resolution;
+    VkFormat _format;
+    VkFilter _filter;
+    VkImage _image;
+    VkDeviceMemory _imageMemory;
+    VkImageView _imageView;
+    VkSampler _sampler;
+    VkRenderPass _renderPass;
+    VkFramebuffer _framebuffer;
+    std::array<glm::mat4, SHADOW_MAP_FACES> _faceViewProjections;
+    glm::vec3 _renderedLightPosition;
+    uint64_t _renderedSceneVersion = 0;
+    bool _valid = false;
+    bool _dirty = false;
+    uint64_t _renderCount = 0;
+    uint64_t _reuseCount = 0;
+
+    void chooseFormat();
+    void createImage();
+    void createImageView();
+    void createSampler();
+    void createRenderPass();
+    void createFramebuffer();
+    void updateFaces(const glm::vec3& lightPosition);
+
+public:
+    ShadowMap(Device* device, AppConfig* appConfig, Scene* scene);
+    ~ShadowMap();
+    bool enabled()                              const { return _appConfig->shadowsEnabled(); }
+    VkRenderPass renderPass()                   { return _renderPass; }
+    VkImage image()                             { return _image; }
+    VkImageView imageView()                     { return _imageView; }
+    VkSampler sampler()                         { return _sampler; }
+    const glm::mat4& faceViewProjection(uint32_t face) const { return _faceViewProjections[face]; }
+    // enabled flag, size of a texel within a face
+    glm::vec4 parameters()                      const { return glm::vec4(enabled() ? 1.0f : 0.0f, 1.0f / _resolution, 0.0f, 0.0f); }
+    bool needsRender()                          const { return _dirty; }
+    // the geometry changed without a scene update, the atlas is redrawn for the current faces
+    void invalidate()                           { _dirty = true; }
+    uint64_t renderCount()                      const { return _renderCount; }
+    uint64_t reuseCount()                       const { return _reuseCount; }
+
+    // compares the light position and scene version with the ones the atlas was last rendered for,
+    // has to be called before the uniform buffers of the frame are written
+    void update(const glm::vec3& lightPosition);
+    // render pass clearing the atlas, faces are drawn between begin and end
+    void beginRenderPass(VkCommandBuffer commandBuffer);
+    void setFace(VkCommandBuffer commandBuffer, uint32_t face);
+    void endRenderPass(VkCommandBuffer commandBuffer);
+    void printStats();
+};
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+
+#include "simulation.h"
+#include "window.h"
+
+namespace vmr {
+
+//a tick running this late resynchronizes instead of catching up with a burst of ticks
+const auto MAX_TICK_LAG = std::chrono::milliseconds(250);
+const float MOUSE_SENSITIVITY = 0.1f;      // degrees per pixel
+
+Simulation::Simulation(AppConfig* appConfig) : _appConfig(appConfig), _state(initialState(appConfig)), _snapshots(_state) {
+    _firstMouse = _appConfig->firstMouse();
+    _lastX = _appConfig->lastX();
+    _lastY = _appConfig->lastY();
+    _yaw = _appConfig->yaw();
+    _pitch = _appConfig->pitch();
+    _thread = std::thread(&Simulation::run, this);
+}
+
+SimulationState Simulation::initialState(AppConfig* appConfig) {
+    SimulationState state;
+    state.observerPosition = appConfig->observerPosition();
+    state.cameraFront = appConfig->cameraFront();
+    state.lightPosition = appConfig->lightPosition();
+    state.movementMode = appConfig->movementMode();
+    state.shaderVariant = appConfig->shaderVariant();
+    return state;
+}
+
+Simulation::~Simulation() {
+    _stopping = true;
+    _thread.join();
+}
+
+void Simulation::keyEvent(int key, bool pressed) {
+    std::lock_guard<std::mutex> lock(_inputMutex);
+    _input.push_back({false, key, pressed, 0.0, 0.0, Clock::now()});
+}
+
+void Simulation::cursorEvent(double x, double y) {
+    std::lock_guard<std::mutex> lock(_inputMutex);
+    _input.push_back({true, 0, false, x, y, Clock::now()});
+}
+
+const SimulationState& Simulation::latest() {
+    _snapshots.fetch();
+    return _snapshots.front();
+}
+
+void Simulation::run() {
+    auto step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / _appConfig->simulationTickRate()));
+    float seconds = 1.0f / _appConfig->simulationTickRate();
+    auto next = Clock::now();
+    while (!_stopping) {
+        next += step;
+        std::this_thread::sleep_until(next);
+        if (Clock::now() - next > MAX_TICK_LAG) {
+            next = Clock::now();
+            _lateTicks++;
+        }
+
+        std::vector<InputEvent> input;
+        {
+            std::lock_guard<std::mutex> lock(_inputMutex);
+            input.swap(_input);
+        }
+        for (const auto& event : input) {
+            applyInput(event);
+            _state.lastInput = event.time;
+        }
+        tick(seconds);
+        _state.tick++;
+
+        _snapshots.back() = _state;
+        _snapshots.publish();
+    }
+}
+
+void Simulation::applyInput(const InputEvent& event) {
+    if (event.cursor) {
+        if (_firstMouse) {
+            _lastX = event.x;
+            _lastY = event.y;
+            _firstMouse = false;
+        }
+        float xoffset = (event.x - _lastX) * MOUSE_SENSITIVITY;
+        float yoffset = (event.y - _lastY) * MOUSE_SENSITIVITY;
+        _lastX = event.x;
+        _lastY = event.y;
+
+        _yaw -= xoffset;
+        _pitch = std::clamp(_pitch - yoffset, -89.0f, 89.0f);
+
+        _state.cameraFront.x = cos(glm::radians(_yaw)) * cos(glm::radians(_pitch));
+        _state.cameraFront.y = sin(glm::radians(_yaw)) * cos(glm::radians(_pitch));
+        _state.cameraFront.z = sin(glm::radians(_pitch));
+        return;
+    }
+
+    bool wasHeld = _heldKeys[event.key];
+    _heldKeys[event.key] = event.pressed;
+    if (!event.pressed || wasHeld) {
+        return;
+    }
+    ShaderVariant& variant = _state.shaderVariant;
+    switch (event.key) {
+        case GLFW_KEY_1: _state.movementMode = MOVEMENT_CAMERA; break;
+        case GLFW_KEY_2: _state.movementMode = MOVEMENT_LIGHT; break;
+        case GLFW_KEY_3: variant.sss = !variant.sss; break;
+        case GLFW_KEY_4: variant.normalMapping = !variant.normalMapping; break;
+        case GLFW_KEY_5: variant.bakedThickness = !variant.bakedThickness; break;
+        case GLFW_KEY_6: variant.preintegratedSkin = !variant.preintegratedSkin; break;
+        case GLFW_KEY_7: variant.ibl = !variant.ibl; break;
+    }
+}
+
+void Simulation::tick(float seconds) {
+    //speeds are in units per second, each tick moves by the same fixed step
+    if (_state.movementMode == MOVEMENT_LIGHT) {
+        float distance = _appConfig->lightSpeed() * seconds;
+        if (held(GLFW_KEY_W)) _state.lightPosition.x += distance;
+        if (held(GLFW_KEY_S)) _state.lightPosition.x -= distance;
+        if (held(GLFW_KEY_A)) _state.lightPosition.y += distance;
+        if (held(GLFW_KEY_D)) _state.lightPosition.y -= distance;
+        if (held(GLFW_KEY_Q)) _state.lightPosition.z += distance;
+        if (held(GLFW_KEY_E)) _state.lightPosition.z -= distance;
+    } else if (_state.movementMode == MOVEMENT_CAMERA) {
+        float distance = _appConfig->cameraSpeed() * seconds;
+        glm::vec3 right = glm::normalize(glm::cross(_state.cameraFront, _appConfig->cameraUp()));
+        if (held(GLFW_KEY_W)) _state.observerPosition += distance * _state.cameraFront;
+        if (held(GLFW_KEY_S)) _state.observerPosition -= distance * _state.cameraFront;
+        if (held(GLFW_KEY_A)) _state.observerPosition -= distance * right;
+        if (held(GLFW_KEY_D)) _state.observerPosition += distance * right;
+        if (held(GLFW_KEY_Q)) _state.observerPosition.z += distance;
+        if (held(GLFW_KEY_E)) _state.observerPosition.z -= distance;
+    }
+}
+
+}
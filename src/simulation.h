@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "app_config.h"
+#include "triple_buffer.h"
+
+namespace vmr {
+// Camera, light and shader toggles as of one simulation tick, read by the render thread.
+struct SimulationState {
+    glm::vec3 observerPosition;
+    glm::vec3 cameraFront;
+    glm::vec3 lightPosition;
+    int movementMode;
+    ShaderVariant shaderVariant;
+    uint64_t tick = 0;
+    std::chrono::high_resolution_clock::time_point lastInput{};   // newest input event applied, epoch if none yet
+};
+
+// Integrates the input on its own thread at a fixed tick rate, so movement speed no longer depends on the frame
+// rate. Input events arrive from the window callbacks on the main thread, every tick publishes a snapshot of the
+// resulting state through a triple buffer.
+class Simulation {
+private:
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct InputEvent {
+        bool cursor;            // cursor movement, a key otherwise
+        int key;
+        bool pressed;
+        double x;
+        double y;
+        Clock::time_point time;
+    };
+
+    AppConfig* _appConfig;
+    std::mutex _inputMutex;         // only held to append an event or to take all of them
+    std::vector<InputEvent> _input;
+
+    // owned by the simulation thread
+    SimulationState _state;
+    std::unordered_map<int, bool> _heldKeys;
+    bool _firstMouse;
+    double _lastX;
+    double _lastY;
+    float _yaw;
+    float _pitch;
+
+    TripleBuffer<SimulationState> _snapshots;
+    std::atomic<bool> _stopping{false};
+    std::atomic<uint64_t> _lateTicks{0};
+    std::thread _thread;
+
+    static SimulationState initialState(AppConfig* appConfig);
+    void run();
+    void applyInput(const InputEvent& event);
+    void tick(float seconds);
+    bool held(int key) { return _heldKeys[key]; }
+
+public:
+    Simulation(AppConfig* appConfig);
+    ~Simulation();
+
+    // called from the window callbacks on the main thread
+    void keyEvent(int key, bool pressed);
+    void cursorEvent(double x, double y);
+    // newest published state, stays valid until the next call on the render thread
+    const SimulationState& latest();
+    uint64_t lateTicks() const { return _lateTicks; }
+};
+}
@@ -0,0 +1,216 @@
+#include <chrono>
+#include <cstring>
+
+#include "compute_pipeline.h"
+#include "disk_cache.h"
+#include "skin_lut.h"
+
+namespace vmr {
+
+// bumped whenever shaders/skin_lut.comp changes its output, so stale cache entries are not reused
+const uint32_t SKIN_LUT_VERSION = 1;
+const VkFormat SKIN_LUT_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+static void transitionLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                             VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+SkinLut::SkinLut(Device* device, AppConfig* appConfig) : _device(device), _appConfig(appConfig) {
+    auto start = std::chrono::high_resolution_clock::now();
+    createImage();
+    createImageView();
+    createSampler();
+
+    SkinLutConstants constants{_appConfig->skinLutResolution(), _appConfig->skinLutSamples(), _appConfig->skinLutMaxCurvature()};
+    uint64_t key = hashBytes(&constants, sizeof(constants), hashBytes(&SKIN_LUT_VERSION, sizeof(SKIN_LUT_VERSION)));
+    VkDeviceSize imageSize = static_cast<VkDeviceSize>(constants.resolution) * constants.resolution * 4;
+    DiskCache cache(_appConfig->cacheDirectory());
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    _device->createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    void* data;
+    vkMapMemory(_device->logical(), stagingBufferMemory, 0, imageSize, 0, &data);
+
+    std::vector<char> cached;
+    bool cacheHit = cache.load("skin_lut", key, cached) && cached.size() == imageSize;
+    if (cacheHit) {
+        memcpy(data, cached.data(), static_cast<size_t>(imageSize));
+        upload(stagingBuffer);
+    } else {
+        generate(stagingBuffer);
+        cache.store("skin_lut", key, data, static_cast<size_t>(imageSize));
+    }
+
+    vkUnmapMemory(_device->logical(), stagingBufferMemory);
+    vkDestroyBuffer(_device->logical(), stagingBuffer, nullptr);
+    vkFreeMemory(_device->logical(), stagingBufferMemory, nullptr);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout<<(cacheHit ? "Loaded" : "Generated")<<" "<<constants.resolution<<"x"<<constants.resolution<<" skin scattering LUT"
+             <<(cacheHit ? " from cache" : "")<<" in "<<std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count()<<" ms\n";
+}
+
+SkinLut::~SkinLut() {
+    vkDestroySampler(_device->logical(), _sampler, nullptr);
+    vkDestroyImageView(_device->logical(), _imageView, nullptr);
+    vkDestroyImage(_device->logical(), _image, nullptr);
+    vkFreeMemory(_device->logical(), _imageMemory, nullptr);
+}
+
+void SkinLut::createImage() {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = _appConfig->skinLutResolution();
+    imageInfo.extent.height = _appConfig->skinLutResolution();
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = SKIN_LUT_FORMAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(_device->logical(), &imageInfo, nullptr, &_image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create skin LUT image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(_device->logical(), _image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = _device->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(_device->logical(), &allocInfo, nullptr, &_imageMemory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate skin LUT memory!");
+    }
+    vkBindImageMemory(_device->logical(), _image, _imageMemory, 0);
+}
+
+void SkinLut::createImageView() {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = _image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = SKIN_LUT_FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(_device->logical(), &viewInfo, nullptr, &_imageView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create skin LUT image view!");
+    }
+}
+
+void SkinLut::createSampler() {
+    //clamped, the edges of the table are N.L = -1 / 1 and the largest curvature
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(_device->logical(), &samplerInfo, nullptr, &_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create skin LUT sampler!");
+    }
+}
+
+void SkinLut::generate(VkBuffer readbackBuffer) {
+    ComputePipeline pipeline(_device, _appConfig->skinLutComputeShaderPath(), {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE}, sizeof(SkinLutConstants), 1);
+    VkDescriptorSet descriptorSet = pipeline.allocateDescriptorSet();
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageInfo.imageView = _imageView;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(_device->logical(), 1, &descriptorWrite, 0, nullptr);
+
+    SkinLutConstants constants{_appConfig->skinLutResolution(), _appConfig->skinLutSamples(), _appConfig->skinLutMaxCurvature()};
+    uint32_t groupCount = (constants.resolution + 7) / 8;
+
+    VkCommandBuffer commandBuffer = _device->beginSingleTimeCommands();
+    transitionLayout(commandBuffer, _image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+        0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    pipeline.bind(commandBuffer, descriptorSet);
+    pipeline.pushConstants(commandBuffer, &constants, sizeof(constants));
+    vkCmdDispatch(commandBuffer, groupCount, groupCount, 1);
+
+    //the table is read back once so the next start can skip the dispatch
+    transitionLayout(commandBuffer, _image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {constants.resolution, constants.resolution, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, _image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+    transitionLayout(commandBuffer, _image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    VkBufferMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = readbackBuffer;
+    hostBarrier.offset = 0;
+    hostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+    _device->endSingleTimeCommands(commandBuffer);
+}
+
+void SkinLut::upload(VkBuffer stagingBuffer) {
+    uint32_t resolution = _appConfig->skinLutResolution();
+    VkCommandBuffer commandBuffer = _device->beginSingleTimeCommands();
+    transitionLayout(commandBuffer, _image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {resolution, resolution, 1};
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, _image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    transitionLayout(commandBuffer, _image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    _device->endSingleTimeCommands(commandBuffer);
+}
+
+}
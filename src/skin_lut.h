@@ -0,0 +1,36 @@
+#pragma once
+
+#include "app_config.h"
+#include "device.h"
+
+namespace vmr {
+// Pre-integrated diffuse scattering of skin, indexed by N.L (columns) and surface curvature (rows).
+// Generated by a compute shader on the first start and loaded from the disk cache afterwards.
+class SkinLut {
+private:
+    struct SkinLutConstants {
+        uint32_t resolution;
+        uint32_t sampleCount;
+        float maxCurvature;
+    };
+
+    Device* _device;
+    AppConfig* _appConfig;
+    VkImage _image;
+    VkDeviceMemory _imageMemory;
+    VkImageView _imageView;
+    VkSampler _sampler;
+
+    void createImage();
+    void createImageView();
+    void createSampler();
+    void generate(VkBuffer readbackBuffer);
+    void upload(VkBuffer stagingBuffer);
+
+public:
+    SkinLut(Device* device, AppConfig* appConfig);
+    ~SkinLut();
+    VkImageView imageView()  { return _imageView; }
+    VkSampler sampler()      { return _sampler; }
+};
+}
@@ -0,0 +1,154 @@
+#include <cmath>
+
+#include "sphere_culling.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define VMR_X86_CULLING
+#endif
+
+namespace vmr {
+
+void BoundingSphereArray::resize(size_t count) {
+    size_t padded = (count + batchSize - 1) / batchSize * batchSize;
+    _count = count;
+    //padding spheres have an infinitely negative radius, so no plane distance is ever above -radius
+    _centerX.assign(padded, 0.0f);
+    _centerY.assign(padded, 0.0f);
+    _centerZ.assign(padded, 0.0f);
+    _radius.assign(padded, -INFINITY);
+}
+
+void BoundingSphereArray::set(size_t index, const BoundingSphere& sphere) {
+    _centerX[index] = sphere.center.x;
+    _centerY[index] = sphere.center.y;
+    _centerZ[index] = sphere.center.z;
+    _radius[index] = sphere.radius;
+}
+
+static uint32_t cullSpheresScalar(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t* visibleIndices) {
+    uint32_t visibleCount = 0;
+    for (size_t i = 0; i < spheres.size(); i++) {
+        bool visible = true;
+        for (const auto& plane : frustum.planes) {
+            float distance = plane.x * spheres.centerX()[i] + plane.y * spheres.centerY()[i] + plane.z * spheres.centerZ()[i] + plane.w;
+            visible = visible && distance >= -spheres.radius()[i];
+        }
+        visibleIndices[visibleCount] = static_cast<uint32_t>(i);
+        visibleCount += visible;
+    }
+    return visibleCount;
+}
+
+#ifdef VMR_X86_CULLING
+//set bits of the lane mask are turned into indices, which keeps the output compacted without branching per plane
+static inline uint32_t appendVisible(int mask, uint32_t base, uint32_t* visibleIndices, uint32_t visibleCount) {
+    while (mask) {
+        visibleIndices[visibleCount++] = base + __builtin_ctz(mask);
+        mask &= mask - 1;
+    }
+    return visibleCount;
+}
+
+static uint32_t cullSpheresSse(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t* visibleIndices) {
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (size_t p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32_t visibleCount = 0;
+    //two 4-wide halves per iteration to match the batch size of the AVX kernel
+    for (size_t i = 0; i < spheres.paddedSize(); i += BoundingSphereArray::batchSize) {
+        int mask = 0;
+        for (size_t half = 0; half < 2; half++) {
+            size_t offset = i + half * 4;
+            __m128 x = _mm_loadu_ps(spheres.centerX() + offset);
+            __m128 y = _mm_loadu_ps(spheres.centerY() + offset);
+            __m128 z = _mm_loadu_ps(spheres.centerZ() + offset);
+            __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(spheres.radius() + offset));
+
+            __m128 visible = _mm_cmpeq_ps(zero, zero);
+            for (size_t p = 0; p < 6; p++) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                                             _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negativeRadius));
+            }
+            mask |= _mm_movemask_ps(visible) << (half * 4);
+        }
+        visibleCount = appendVisible(mask, static_cast<uint32_t>(i), visibleIndices, visibleCount);
+    }
+    return visibleCount;
+}
+
+//compiled for AVX regardless of the global flags, only called after a runtime check
+__attribute__((target("avx")))
+static uint32_t cullSpheresAvx(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t* visibleIndices) {
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (size_t p = 0; p < 6; p++) {
+        planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    uint32_t visibleCount = 0;
+    for (size_t i = 0; i < spheres.paddedSize(); i += BoundingSphereArray::batchSize) {
+        __m256 x = _mm256_loadu_ps(spheres.centerX() + i);
+        __m256 y = _mm256_loadu_ps(spheres.centerY() + i);
+        __m256 z = _mm256_loadu_ps(spheres.centerZ() + i);
+        __m256 negativeRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(spheres.radius() + i));
+
+        __m256 visible = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (size_t p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+                                            _mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+        visibleCount = appendVisible(_mm256_movemask_ps(visible), static_cast<uint32_t>(i), visibleIndices, visibleCount);
+    }
+    return visibleCount;
+}
+#endif
+
+CullingKernel bestCullingKernel() {
+#ifdef VMR_X86_CULLING
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) {
+        return CullingKernel::Avx;
+    }
+    if (__builtin_cpu_supports("sse")) {
+        return CullingKernel::Sse;
+    }
+#endif
+    return CullingKernel::Scalar;
+}
+
+const char* cullingKernelName(CullingKernel kernel) {
+    switch (kernel) {
+        case CullingKernel::Avx:
+            return "AVX";
+        case CullingKernel::Sse:
+            return "SSE";
+        default:
+            return "scalar";
+    }
+}
+
+uint32_t cullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t* visibleIndices, CullingKernel kernel) {
+#ifdef VMR_X86_CULLING
+    if (kernel == CullingKernel::Avx) {
+        return cullSpheresAvx(frustum, spheres, visibleIndices);
+    }
+    if (kernel == CullingKernel::Sse) {
+        return cullSpheresSse(frustum, spheres, visibleIndices);
+    }
+#endif
+    return cullSpheresScalar(frustum, spheres, visibleIndices);
+}
+
+}
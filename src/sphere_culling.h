@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+
+namespace vmr {
+// World space bounding spheres kept as separate coordinate arrays, so that eight of them
+// fill one AVX register. Storage is padded to a multiple of eight with spheres that never pass the test.
+class BoundingSphereArray {
+private:
+    std::vector<float> _centerX;
+    std::vector<float> _centerY;
+    std::vector<float> _centerZ;
+    std::vector<float> _radius;
+    size_t _count = 0;
+
+public:
+    static const size_t batchSize = 8;
+
+    void resize(size_t count);
+    void set(size_t index, const BoundingSphere& sphere);
+
+    size_t size()               const { return _count; }
+    size_t paddedSize()         const { return _radius.size(); }
+    const float* centerX()      const { return _centerX.data(); }
+    const float* centerY()      const { return _centerY.data(); }
+    const float* centerZ()      const { return _centerZ.data(); }
+    const float* radius()       const { return _radius.data(); }
+};
+
+enum class CullingKernel {
+    Scalar,
+    Sse,
+    Avx
+};
+
+// Fastest kernel the running CPU supports
+CullingKernel bestCullingKernel();
+const char* cullingKernelName(CullingKernel kernel);
+
+// Writes indices of the spheres intersecting the frustum to visibleIndices (at least spheres.size() entries)
+// in ascending order and returns how many were written
+uint32_t cullSpheres(const Frustum& frustum, const BoundingSphereArray& spheres, uint32_t* visibleIndices, CullingKernel kernel);
+}
@@ -6,6 +6,9 @@
 #include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
 
 #include "swap_chain.h"
 
@@ -14,22 +17,31 @@ namespace vmr{
 SwapChain::SwapChain(Device* device, GLFWwindow* window, AppConfig* appConfig) : _device(device), _window(window), _appConfig(appConfig) {
     createSwapChain();
     createImageViews();
+    _sampleCount = chooseSampleCount();
+    _hdrFormat = chooseHdrFormat();
 };
 
 SwapChain::~SwapChain(){
+    for (const auto& retired : _retiredSwapChains) {
+        vkDestroySwapchainKHR(_device->logical(), retired.swapChain, nullptr);
+    }
     cleanupSwapChain();
+    vkDestroyRenderPass(_device->logical(), _renderPass, nullptr);
 
     vkDestroySampler(_device->logical(), _textureSampler, nullptr);
     vkDestroyImageView(_device->logical(), _textureImageView, nullptr);
     vkDestroyImageView(_device->logical(), _normalMapImageView, nullptr);
+    vkDestroyImageView(_device->logical(), _thicknessMapImageView, nullptr);
     vkDestroyImage(_device->logical(), _textureImage, nullptr);
     vkDestroyImage(_device->logical(), _normalMapImage, nullptr);
+    vkDestroyImage(_device->logical(), _thicknessMapImage, nullptr);
     vkFreeMemory(_device->logical(), _textureImageMemory, nullptr);
     vkFreeMemory(_device->logical(), _normalMapMemory, nullptr);
+    vkFreeMemory(_device->logical(), _thicknessMapMemory, nullptr);
 }
 
 
-void SwapChain::createSwapChain() {
+void SwapChain::createSwapChain(VkSwapchainKHR oldSwapChain) {
     SwapChainSupportDetails swapChainSupport = _device->querySwapChainSupport(_device->physical());
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -48,6 +60,11 @@ void SwapChain::createSwapChain() {
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    _transferSource = _appConfig->captureEnabled() && (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    if (_transferSource) {
+        //copied into the readback buffers of the frame capture
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
     QueueFamilyIndices indices = _device->findQueueFamilies(_device->physical());
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
@@ -64,7 +81,7 @@ void SwapChain::createSwapChain() {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = oldSwapChain; // lets the presentation engine reuse resources of the retired swap chain
     if (vkCreateSwapchainKHR(_device->logical(), &createInfo, nullptr, &_swapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
     }
@@ -121,20 +138,116 @@ void SwapChain::recreateSwapChain() {
         glfwGetFramebufferSize(_window, &width, &height);
         glfwWaitEvents();
     }
-    vkDeviceWaitIdle(_device->logical()); //we shouldn't touch resources that may still be in use
-
-    cleanupSwapChain();
+    auto start = std::chrono::high_resolution_clock::now();
 
-    createSwapChain(); //need to be recreated because they are based directly on the swap chain images
+    if (_appConfig->resizeWaitIdle()) {
+        vkDeviceWaitIdle(_device->logical()); //we shouldn't touch resources that may still be in use
+        cleanupSwapChain();
+        createSwapChain();
+    } else {
+        //frames in flight keep rendering to the old resources, which are destroyed once their fences signal
+        retireSwapChain();
+    }
     createImageViews(); // need to be recreated because they are based directly on the swap chain images
     createDepthResources();
-    createFramebuffers(); // they depend on the swap chain images
+    createMultisampleResources();
+    createHdrResources();
+    //the framebuffers follow once the render graph recreated its targets for the new extent
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double elapsedMs = std::chrono::duration<double, std::milli>(end - start).count();
+    _recreateCount++;
+    _recreateTotalMs += elapsedMs;
+    _recreateMaxMs = std::max(_recreateMaxMs, elapsedMs);
+}
+
+void SwapChain::retireSwapChain() {
+    VkSwapchainKHR oldSwapChain = _swapChain;
+    createSwapChain(oldSwapChain);
+
+    _device->deletionQueue().push([device = _device->logical(), oldSwapChain,
+                                    imageViews = _swapChainImageViews, framebuffers = _swapChainFramebuffers,
+                                    depthImage = _depthImage, depthImageMemory = _depthImageMemory, depthImageView = _depthImageView,
+                                    colorMsImage = _colorMsImage, colorMsImageMemory = _colorMsImageMemory, colorMsImageView = _colorMsImageView,
+                                    irradianceMsImage = _irradianceMsImage, irradianceMsImageMemory = _irradianceMsImageMemory, irradianceMsImageView = _irradianceMsImageView,
+                                    hdrImages = _hdrImages, hdrImagesMemory = _hdrImagesMemory, hdrImageViews = _hdrImageViews]() {
+        vkDestroyImageView(device, depthImageView, nullptr);
+        vkDestroyImage(device, depthImage, nullptr);
+        vkFreeMemory(device, depthImageMemory, nullptr);
+        vkDestroyImageView(device, colorMsImageView, nullptr);
+        vkDestroyImage(device, colorMsImage, nullptr);
+        vkFreeMemory(device, colorMsImageMemory, nullptr);
+        vkDestroyImageView(device, irradianceMsImageView, nullptr);
+        vkDestroyImage(device, irradianceMsImage, nullptr);
+        vkFreeMemory(device, irradianceMsImageMemory, nullptr);
+        for (size_t i = 0; i < hdrImages.size(); i++) {
+            vkDestroyImageView(device, hdrImageViews[i], nullptr);
+            vkDestroyImage(device, hdrImages[i], nullptr);
+            vkFreeMemory(device, hdrImagesMemory[i], nullptr);
+        }
+        for (auto framebuffer : framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        for (auto imageView : imageViews) {
+            vkDestroyImageView(device, imageView, nullptr);
+        }
+    });
+    //the image a retired swap chain waits for never comes back once its presenter is retired too, it then waits for
+    //a present of the new one instead, which comes after that presenter's
+    for (auto& retired : _retiredSwapChains) {
+        if (retired.presentedBy == oldSwapChain) {
+            retired.presentedBy = VK_NULL_HANDLE;
+            retired.presentedImage = UINT32_MAX;
+        }
+    }
+    _retiredSwapChains.push_back({oldSwapChain});
+}
+
+void SwapChain::imagePresented(uint32_t imageIndex) {
+    for (auto& retired : _retiredSwapChains) {
+        if (retired.presentedBy == VK_NULL_HANDLE) {
+            retired.presentedBy = _swapChain;
+            retired.presentedImage = imageIndex;
+        }
+    }
+}
+
+void SwapChain::imageAcquired(uint32_t imageIndex) {
+    auto completed = std::remove_if(_retiredSwapChains.begin(), _retiredSwapChains.end(), [this, imageIndex](const RetiredSwapChain& retired) {
+        if (retired.presentedBy != _swapChain || retired.presentedImage != imageIndex) {
+            return false;
+        }
+        vkDestroySwapchainKHR(_device->logical(), retired.swapChain, nullptr);
+        return true;
+    });
+    _retiredSwapChains.erase(completed, _retiredSwapChains.end());
+}
+
+void SwapChain::printRecreateStats() {
+    if (_recreateCount == 0) {
+        return;
+    }
+    std::cout<<"Swap chain recreated "<<_recreateCount<<" time(s) ("
+             <<(_appConfig->resizeWaitIdle() ? "wait idle" : "deferred destruction")<<"): avg "
+             <<_recreateTotalMs / _recreateCount<<" ms, max "
+             <<_recreateMaxMs<<" ms"<<std::endl;
 }
 
 void SwapChain::cleanupSwapChain() {
     vkDestroyImageView(_device->logical(), _depthImageView, nullptr);
     vkDestroyImage(_device->logical(), _depthImage, nullptr);
     vkFreeMemory(_device->logical(), _depthImageMemory, nullptr);
+    vkDestroyImageView(_device->logical(), _colorMsImageView, nullptr);
+    vkDestroyImage(_device->logical(), _colorMsImage, nullptr);
+    vkFreeMemory(_device->logical(), _colorMsImageMemory, nullptr);
+    vkDestroyImageView(_device->logical(), _irradianceMsImageView, nullptr);
+    vkDestroyImage(_device->logical(), _irradianceMsImage, nullptr);
+    vkFreeMemory(_device->logical(), _irradianceMsImageMemory, nullptr);
+    for (size_t i = 0; i < _hdrImages.size(); i++) {
+        vkDestroyImageView(_device->logical(), _hdrImageViews[i], nullptr);
+        vkDestroyImage(_device->logical(), _hdrImages[i], nullptr);
+        vkFreeMemory(_device->logical(), _hdrImagesMemory[i], nullptr);
+    }
     
     for (auto framebuffer : _swapChainFramebuffers) {
         vkDestroyFramebuffer(_device->logical(), framebuffer, nullptr);
@@ -145,7 +258,6 @@ void SwapChain::cleanupSwapChain() {
     }
 
     vkDestroySwapchainKHR(_device->logical(), _swapChain, nullptr);
-    vkDestroyRenderPass(_device->logical(), _renderPass, nullptr);
 }
 
 void SwapChain::createImageViews() {
@@ -158,19 +270,188 @@ void SwapChain::createImageViews() {
 
 void SwapChain::createDepthResources() {
     VkFormat depthFormat = _device->findDepthFormat();
+    //depth is cleared at the start of the render pass and never stored, so it can stay in tile memory
     createImage(_swapChainExtent.width, _swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _depthImage, _depthImageMemory);
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        _depthImage, _depthImageMemory, false, _sampleCount);
     _depthImageView = createImageView(_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-    transitionImageLayout(_depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    //no explicit layout transition (and the queue wait that comes with it), the render pass starts from VK_IMAGE_LAYOUT_UNDEFINED
+}
+
+void SwapChain::createMultisampleResources() {
+    if (!multisampled()) {
+        return;
+    }
+    //only the resolved results are stored, one set of samples is enough for all swap chain images
+    createImage(_swapChainExtent.width, _swapChainExtent.height, _hdrFormat, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        _colorMsImage, _colorMsImageMemory, false, _sampleCount);
+    _colorMsImageView = createImageView(_colorMsImage, _hdrFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+    if (_appConfig->screenSpaceSss()) {
+        //read sample by sample by the resolve subpass, the depth in alpha cannot be averaged
+        createImage(_swapChainExtent.width, _swapChainExtent.height, IRRADIANCE_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _irradianceMsImage, _irradianceMsImageMemory, false, _sampleCount);
+        _irradianceMsImageView = createImageView(_irradianceMsImage, IRRADIANCE_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+}
+
+VkSampleCountFlags SwapChain::supportedSampleCounts() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(_device->physical(), &properties);
+    return properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+}
+
+VkSampleCountFlagBits SwapChain::chooseSampleCount() {
+    VkSampleCountFlags supported = supportedSampleCounts();
+    uint32_t sampleCount = 1;
+    for (uint32_t samples = 2; samples <= _appConfig->msaaSamples() && samples <= VK_SAMPLE_COUNT_64_BIT; samples *= 2) {
+        if (supported & samples) {
+            sampleCount = samples;
+        }
+    }
+    if (sampleCount != _appConfig->msaaSamples()) {
+        std::cout<<"MSAA: "<<_appConfig->msaaSamples()<<" samples not supported, using "<<sampleCount<<std::endl;
+    }
+    return static_cast<VkSampleCountFlagBits>(sampleCount);
+}
+
+VkFormat SwapChain::chooseHdrFormat() {
+    //the packed format halves the bandwidth, but blending into it is optional
+    VkFormat format = _appConfig->hdrFormat() == "B10G11R11_UFLOAT" ? VK_FORMAT_B10G11R11_UFLOAT_PACK32 : VK_FORMAT_R16G16B16A16_SFLOAT;
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(_device->physical(), format, &properties);
+    if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT)) {
+        std::cout<<"HDR: "<<_appConfig->hdrFormat()<<" not supported as a blended attachment, using R16G16B16A16_SFLOAT"<<std::endl;
+        format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    }
+    return format;
+}
+
+VkDeviceSize SwapChain::attachmentMemorySize(VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples) {
+    //the requirements are known without binding any memory
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {_swapChainExtent.width, _swapChainExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = samples;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImage image;
+    if (vkCreateImage(_device->logical(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(_device->logical(), image, &memRequirements);
+    vkDestroyImage(_device->logical(), image, nullptr);
+    return memRequirements.size;
+}
+
+void SwapChain::printAttachmentMemory() {
+    const double mb = 1024.0 * 1024.0;
+    VkSampleCountFlags supported = supportedSampleCounts();
+    VkImageUsageFlags colorUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    VkImageUsageFlags depthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    std::cout<<"Transient attachment memory at "<<_swapChainExtent.width<<"x"<<_swapChainExtent.height
+             <<(_lazilyAllocated ? " (lazily allocated):" : " (device local):")<<std::endl;
+    for (uint32_t samples = 1; samples <= VK_SAMPLE_COUNT_64_BIT; samples *= 2) {
+        if (!(supported & samples)) {
+            continue;
+        }
+        VkSampleCountFlagBits sampleCount = static_cast<VkSampleCountFlagBits>(samples);
+        VkDeviceSize size = attachmentMemorySize(_device->findDepthFormat(), depthUsage, sampleCount);
+        if (_appConfig->tonemapInMainPass()) {
+            size += attachmentMemorySize(_hdrFormat, colorUsage | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_SAMPLE_COUNT_1_BIT);
+        }
+        //without multisampling color and irradiance are rendered straight into the stored targets
+        if (samples > 1) {
+            size += attachmentMemorySize(_hdrFormat, colorUsage, sampleCount);
+            if (_appConfig->screenSpaceSss()) {
+                size += attachmentMemorySize(IRRADIANCE_FORMAT, colorUsage | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, sampleCount);
+            }
+        }
+        std::cout<<"  "<<samples<<"x: "<<size / mb<<" MB"<<(sampleCount == _sampleCount ? " (active)" : "")<<std::endl;
+    }
+
+    if (_lazilyAllocated) {
+        VkDeviceSize committed = 0;
+        VkDeviceMemory hdrImageMemory = _appConfig->tonemapInMainPass() ? _hdrImagesMemory[0] : VK_NULL_HANDLE;
+        for (VkDeviceMemory memory : {_depthImageMemory, _colorMsImageMemory, _irradianceMsImageMemory, hdrImageMemory}) {
+            if (memory != VK_NULL_HANDLE) {
+                VkDeviceSize memoryCommitted = 0;
+                vkGetDeviceMemoryCommitment(_device->logical(), memory, &memoryCommitted);
+                committed += memoryCommitted;
+            }
+        }
+        std::cout<<"Committed transient attachment memory: "<<committed / mb<<" MB"<<std::endl;
+    }
+}
+
+void SwapChain::createHdrResources() {
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    size_t count = _swapChainImages.size();
+    if (_appConfig->tonemapInMainPass()) {
+        //read back by the tonemapping subpass only, the values never have to reach memory
+        usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        count = 1;
+    } else {
+        usage |= _appConfig->tonemapSubpass() ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (_appConfig->captureEnabled() && _appConfig->captureFormat() == "exr") {
+            usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+    }
+    _hdrImages.resize(count);
+    _hdrImagesMemory.resize(count);
+    _hdrImageViews.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        createImage(_swapChainExtent.width, _swapChainExtent.height, _hdrFormat, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            _hdrImages[i], _hdrImagesMemory[i]);
+        _hdrImageViews[i] = createImageView(_hdrImages[i], _hdrFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+}
+
+void SwapChain::setTransientTargets(const std::vector<VkImageView>& irradianceImageViews, const std::vector<VkImageView>& sceneColorImageViews) {
+    _irradianceImageViews = irradianceImageViews;
+    _sceneColorImageViews = sceneColorImageViews;
+}
+
+VkExtent2D SwapChain::renderExtent() const {
+    return {
+        std::max(1u, static_cast<uint32_t>(std::lround(_swapChainExtent.width * _renderScale))),
+        std::max(1u, static_cast<uint32_t>(std::lround(_swapChainExtent.height * _renderScale)))
+    };
 }
 
 void SwapChain::createFramebuffers() {
     _swapChainFramebuffers.resize(_swapChainImageViews.size());
     for (size_t i = 0; i < _swapChainImageViews.size(); i++) {
-        std::array<VkImageView, 2> attachments = {
-            _swapChainImageViews[i],
+        std::vector<VkImageView> attachments = {
+            hdrImageView(i),
             _depthImageView
         };
+        if (_appConfig->screenSpaceSss()) {
+            attachments.push_back(_irradianceImageViews[i]);
+        }
+        if (multisampled()) {
+            //samples are rendered into the shared images and resolved into the per-image targets, same order as the render pass
+            attachments[0] = _colorMsImageView;
+            if (_appConfig->screenSpaceSss()) {
+                attachments[2] = _irradianceMsImageView;
+            }
+            attachments.push_back(hdrImageView(i));
+            if (_appConfig->screenSpaceSss()) {
+                attachments.push_back(_irradianceImageViews[i]);
+            }
+        }
+        if (_appConfig->tonemapInMainPass()) {
+            attachments.push_back(sceneColorImageViews()[i]);
+        }
 
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -210,6 +491,7 @@ VkImageView SwapChain::createImageView(VkImage image, VkFormat format, VkImageAs
 void SwapChain::createTextureImageViews() {
     _textureImageView = createImageView(_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
     _normalMapImageView = createImageView(_normalMapImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    _thicknessMapImageView = createImageView(_thicknessMapImage, VK_FORMAT_R8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
 }
 
 void SwapChain::createTextureSampler() {
@@ -307,7 +589,8 @@ bool SwapChain::hasStencilComponent(VkFormat format) {
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-void SwapChain::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+void SwapChain::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory,
+                            bool sharedWithCompute, VkSampleCountFlagBits samples) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -320,8 +603,14 @@ void SwapChain::createImage(uint32_t width, uint32_t height, VkFormat format, Vk
     imageInfo.tiling = tiling;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = usage;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.samples = samples;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (sharedWithCompute) {
+        //concurrent sharing spares the queue family ownership transfers
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(_device->sharedQueueFamilies().size());
+        imageInfo.pQueueFamilyIndices = _device->sharedQueueFamilies().data();
+    }
 
     if (vkCreateImage(_device->logical(), &imageInfo, nullptr, &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
@@ -329,6 +618,12 @@ void SwapChain::createImage(uint32_t width, uint32_t height, VkFormat format, Vk
 
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(_device->logical(), image, &memRequirements);
+    //transient attachments are only backed by memory if the tiles ever spill, on tilers that is never
+    if ((usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+        _device->hasMemoryType(memRequirements.memoryTypeBits, properties | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+        properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        _lazilyAllocated = true;
+    }
 
     VkMemoryAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
@@ -345,17 +640,37 @@ void SwapChain::createImage(uint32_t width, uint32_t height, VkFormat format, Vk
 void SwapChain::createTextureImages() {
     createTextureImage(_textureImage, _textureImageMemory, _appConfig->modelTexturePath());
     createTextureImage(_normalMapImage, _normalMapMemory, _appConfig->modelNormalMapPath());
+    createThicknessMapImage();
 }
 
-void SwapChain::createTextureImage(VkImage& image, VkDeviceMemory& memory, std::string path) {
+void SwapChain::createTextureImage(VkImage& image, VkDeviceMemory& memory, std::string path, VkFormat format) {
+    bool singleChannel = format == VK_FORMAT_R8_UNORM;
     int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, singleChannel ? STBI_grey : STBI_rgb_alpha);
 
     if (!pixels) {
         throw std::runtime_error("failed to load texture image!");
     }
 
+    uploadTextureImage(pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), format, image, memory);
+    stbi_image_free(pixels);
+}
+
+void SwapChain::createThicknessMapImage() {
+    std::string path = _appConfig->thicknessMapPath();
+    if (std::ifstream(path).good()) {
+        createTextureImage(_thicknessMapImage, _thicknessMapMemory, path, VK_FORMAT_R8_UNORM);
+        return;
+    }
+    //a single white texel gives the same result as the procedural thickness, so the app still runs without a bake
+    std::cout<<"Thickness map "<<path<<" not found, bake it with make thickness_baker\n";
+    unsigned char thin = 255;
+    uploadTextureImage(&thin, 1, 1, VK_FORMAT_R8_UNORM, _thicknessMapImage, _thicknessMapMemory);
+}
+
+void SwapChain::uploadTextureImage(const void* pixels, uint32_t width, uint32_t height, VkFormat format, VkImage& image, VkDeviceMemory& memory) {
+    VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * (format == VK_FORMAT_R8_UNORM ? 1 : 4);
+
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
     _device->createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
@@ -365,18 +680,107 @@ void SwapChain::createTextureImage(VkImage& image, VkDeviceMemory& memory, std::
     memcpy(data, pixels, static_cast<size_t>(imageSize));
     vkUnmapMemory(_device->logical(), stagingBufferMemory);
 
-    stbi_image_free(pixels);
-
-    createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+    createImage(width, height, format, VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
-    transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(stagingBuffer, image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-    transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    transitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    copyBufferToImage(stagingBuffer, image, width, height);
+    transitionImageLayout(image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     vkDestroyBuffer(_device->logical(), stagingBuffer, nullptr);
     vkFreeMemory(_device->logical(), stagingBufferMemory, nullptr);
 }
 
+StagedTexture SwapChain::stageTexture(TextureSlot slot, const std::string& path) {
+    StagedTexture staged{};
+    staged.slot = slot;
+    staged.format = slot == TextureSlot::Thickness ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+    bool singleChannel = staged.format == VK_FORMAT_R8_UNORM;
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, singleChannel ? STBI_grey : STBI_rgb_alpha);
+
+    if (!pixels) {
+        throw std::runtime_error("failed to load texture image!");
+    }
+    staged.width = static_cast<uint32_t>(texWidth);
+    staged.height = static_cast<uint32_t>(texHeight);
+    VkDeviceSize imageSize = static_cast<VkDeviceSize>(staged.width) * staged.height * (singleChannel ? 1 : 4);
+
+    _device->createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staged.buffer, staged.memory);
+
+    void* data;
+    vkMapMemory(_device->logical(), staged.memory, 0, imageSize, 0, &data);
+    memcpy(data, pixels, static_cast<size_t>(imageSize));
+    vkUnmapMemory(_device->logical(), staged.memory);
+    stbi_image_free(pixels);
+    return staged;
+}
+
+void SwapChain::replaceTexture(const StagedTexture& staged, VkCommandBuffer commandBuffer) {
+    VkImage image;
+    VkDeviceMemory memory;
+    createImage(staged.width, staged.height, staged.format, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+    //recorded ahead of the frame's passes instead of a single-time submission, which would stall on the queue
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {staged.width, staged.height, 1};
+    vkCmdCopyBufferToImage(commandBuffer, staged.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkImageView view = createImageView(image, staged.format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    VkImage* currentImage = &_textureImage;
+    VkDeviceMemory* currentMemory = &_textureImageMemory;
+    VkImageView* currentView = &_textureImageView;
+    if (staged.slot == TextureSlot::NormalMap) {
+        currentImage = &_normalMapImage;
+        currentMemory = &_normalMapMemory;
+        currentView = &_normalMapImageView;
+    } else if (staged.slot == TextureSlot::Thickness) {
+        currentImage = &_thicknessMapImage;
+        currentMemory = &_thicknessMapMemory;
+        currentView = &_thicknessMapImageView;
+    }
+
+    //frames already submitted still sample the old texture, the staging buffer is read by the one being recorded
+    VkDevice device = _device->logical();
+    VkImage oldImage = *currentImage;
+    VkDeviceMemory oldMemory = *currentMemory;
+    VkImageView oldView = *currentView;
+    _device->deletionQueue().push([device, oldImage, oldMemory, oldView]() {
+        vkDestroyImageView(device, oldView, nullptr);
+        vkDestroyImage(device, oldImage, nullptr);
+        vkFreeMemory(device, oldMemory, nullptr);
+    });
+    VkBuffer stagingBuffer = staged.buffer;
+    VkDeviceMemory stagingMemory = staged.memory;
+    _device->deletionQueue().pushAfterRecording([device, stagingBuffer, stagingMemory]() {
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingMemory, nullptr);
+    });
+    *currentImage = image;
+    *currentMemory = memory;
+    *currentView = view;
+}
+
 void SwapChain::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
     VkCommandBuffer commandBuffer = _device->beginSingleTimeCommands();
 
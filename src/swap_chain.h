@@ -8,6 +8,21 @@
 
 
 namespace vmr{
+// diffuse irradiance of the shaded surfaces, with their view depth in alpha
+const VkFormat IRRADIANCE_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+enum class TextureSlot { Albedo, NormalMap, Thickness };
+
+// decoded texels of a texture waiting in a staging buffer to replace one of the model textures
+struct StagedTexture {
+    TextureSlot slot;
+    VkFormat format;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+};
+
 class SwapChain {
 
 private:
@@ -16,6 +31,7 @@ private:
     GLFWwindow* _window;
     VkSwapchainKHR _swapChain;
     std::vector<VkImage> _swapChainImages;
+    bool _transferSource = false;      // the swap chain images can be copied from
     VkFormat _swapChainImageFormat;
     VkExtent2D _swapChainExtent;
     std::vector<VkImageView> _swapChainImageViews;
@@ -24,26 +40,64 @@ private:
     VkImage _depthImage;
     VkDeviceMemory _depthImageMemory;
     VkImageView _depthImageView;
+    VkSampleCountFlagBits _sampleCount = VK_SAMPLE_COUNT_1_BIT;
+    bool _lazilyAllocated = false;      // whether the transient attachments got lazily allocated memory
+    VkImage _colorMsImage = VK_NULL_HANDLE;
+    VkDeviceMemory _colorMsImageMemory = VK_NULL_HANDLE;
+    VkImageView _colorMsImageView = VK_NULL_HANDLE;
+    VkImage _irradianceMsImage = VK_NULL_HANDLE;
+    VkDeviceMemory _irradianceMsImageMemory = VK_NULL_HANDLE;
+    VkImageView _irradianceMsImageView = VK_NULL_HANDLE;
+    std::vector<VkImageView> _irradianceImageViews;     // owned by the render graph, like the scene color targets
+    VkFormat _hdrFormat;
+    std::vector<VkImage> _hdrImages;
+    std::vector<VkDeviceMemory> _hdrImagesMemory;
+    std::vector<VkImageView> _hdrImageViews;
+    std::vector<VkImageView> _sceneColorImageViews;
+    float _renderScale = 1.0f;
     VkImage _textureImage;
     VkImage _normalMapImage;
+    VkImage _thicknessMapImage;
     VkDeviceMemory _textureImageMemory;
     VkDeviceMemory _normalMapMemory;
+    VkDeviceMemory _thicknessMapMemory;
     VkImageView _textureImageView;
     VkImageView _normalMapImageView;
+    VkImageView _thicknessMapImageView;
     VkSampler _textureSampler;
+    uint32_t _recreateCount = 0;
+    double _recreateTotalMs = 0.0;
+    double _recreateMaxMs = 0.0;
+    // frame fences do not cover presentation, a retired swap chain may still have presents pending
+    struct RetiredSwapChain {
+        VkSwapchainKHR swapChain;
+        // first image presented after the retirement and the swap chain it belongs to, reacquiring it from that same
+        // swap chain means every earlier present finished
+        VkSwapchainKHR presentedBy = VK_NULL_HANDLE;
+        uint32_t presentedImage = UINT32_MAX;
+    };
+    std::vector<RetiredSwapChain> _retiredSwapChains;
     
-    void createSwapChain();
+    void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
     void createImageViews();
     VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
     VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+    VkSampleCountFlags supportedSampleCounts();
+    VkSampleCountFlagBits chooseSampleCount();
+    VkFormat chooseHdrFormat();
+    VkDeviceSize attachmentMemorySize(VkFormat format, VkImageUsageFlags usage, VkSampleCountFlagBits samples);
     void cleanupSwapChain();
+    void retireSwapChain();
     VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-    void createTextureImage(VkImage& image, VkDeviceMemory& memory, std::string path);
+    void createTextureImage(VkImage& image, VkDeviceMemory& memory, std::string path, VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+    void createThicknessMapImage();
+    void uploadTextureImage(const void* pixels, uint32_t width, uint32_t height, VkFormat format, VkImage& image, VkDeviceMemory& memory);
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
     bool hasStencilComponent(VkFormat format);
     void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory,
+                     bool sharedWithCompute = false, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
 
 public:
     SwapChain(Device* device, GLFWwindow* window, AppConfig* appConfig);
@@ -54,16 +108,55 @@ public:
     VkRenderPass&               renderPass()            {return _renderPass; }
     VkFormat&                   imageFormat()           {return _swapChainImageFormat; }
     std::vector<VkFramebuffer>& framebuffers()          {return _swapChainFramebuffers; }
+    std::vector<VkImageView>&   imageViews()            {return _swapChainImageViews; }
+    std::vector<VkImageView>&   irradianceImageViews()  {return _irradianceImageViews; }
+    // what the scene is rendered into: offscreen targets with dynamic resolution, the swap chain images otherwise
+    std::vector<VkImageView>&   sceneColorImageViews()  {return _appConfig->dynamicResolution() ? _sceneColorImageViews : _swapChainImageViews; }
+    VkFormat                    sceneColorFormat()      {return _swapChainImageFormat; }
+    // what the shading writes, tonemapped into the scene color targets
+    VkFormat                    hdrFormat()             const {return _hdrFormat; }
+    VkImageView                 hdrImageView(size_t imageIndex) {return _hdrImageViews[_hdrImageViews.size() == 1 ? 0 : imageIndex]; }
+    VkImage                     hdrImage(size_t imageIndex) {return _hdrImages[_hdrImages.size() == 1 ? 0 : imageIndex]; }
+    VkImage                     image(size_t imageIndex) {return _swapChainImages[imageIndex]; }
+    bool                        transferSource()        const {return _transferSource; }
+    float                       renderScale()           const {return _renderScale; }
+    void                        setRenderScale(float scale) {_renderScale = scale; }
+    // part of the scene color targets rendered to, the top-left corner scaled by the render scale
+    VkExtent2D                  renderExtent()          const;
     VkImageView&                textureImageView()      {return _textureImageView; }
     VkImageView&                normalMapImageView()    {return _normalMapImageView; }
+    VkImageView&                thicknessMapImageView() {return _thicknessMapImageView; }
     VkSampler                   textureSampler()        {return _textureSampler; }
+    VkSampleCountFlagBits       sampleCount()           const {return _sampleCount; }
+    bool                        multisampled()          const {return _sampleCount != VK_SAMPLE_COUNT_1_BIT; }
+    VkImageView                 colorMsImageView()      {return _colorMsImageView; }
+    VkImageView                 irradianceMsImageView() {return _irradianceMsImageView; }
 
     void recreateSwapChain();
+    // retired swap chains are destroyed once an image presented after their retirement is acquired again, which means
+    // that present, and the ones queued before it, have completed
+    void imagePresented(uint32_t imageIndex);
+    void imageAcquired(uint32_t imageIndex);
+    void printRecreateStats();
+    // size of the main pass attachments for every supported sample count, and how much of the transient ones is committed
+    void printAttachmentMemory();
     void createFramebuffers();
     void createDepthResources();
+    // shared multisampled color (and irradiance) attachments, resolved within the main render pass
+    void createMultisampleResources();
+    // one transient target when the main pass tonemaps, otherwise per swap chain image as later passes read it
+    void createHdrResources();
+    // per swap chain image transient images of the render graph: the irradiance written by the shading subpass and read
+    // by the screen-space scattering, and with dynamic resolution the full size scene color targets, so that the render
+    // scale can change without reallocating; set before the framebuffers are created
+    void setTransientTargets(const std::vector<VkImageView>& irradianceImageViews, const std::vector<VkImageView>& sceneColorImageViews);
     void createTextureImages();
     void createTextureImageViews();
     void createTextureSampler();
+    // decodes the image into a staging buffer, safe to call from a worker thread
+    StagedTexture stageTexture(TextureSlot slot, const std::string& path);
+    // records the upload into the frame being recorded and swaps the texture in, the old one is deferred for deletion
+    void replaceTexture(const StagedTexture& staged, VkCommandBuffer commandBuffer);
 
 };
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace vmr {
+class ThreadPool {
+private:
+    std::vector<std::thread> _workers;
+    std::queue<std::function<void()>> _tasks;
+    std::mutex _tasksMutex;
+    std::condition_variable _tasksCondition;
+    bool _stopping = false;
+
+    void workerLoop();
+
+public:
+    ThreadPool(size_t workerCount);
+    ~ThreadPool();
+    size_t workerCount() const { return _workers.size(); }
+
+    template<typename F>
+    std::future<void> submit(F task) {
+        auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+        std::future<void> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(_tasksMutex);
+            _tasks.push([packaged]() { (*packaged)(); });
+        }
+        _tasksCondition.notify_one();
+        return result;
+    }
+};
+}
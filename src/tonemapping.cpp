@@ -0,0 +1,277 @@
+#include <iostream>
+
+#include "fullscreen_pipeline.h"
+#include "tonemapping.h"
+
+namespace vmr {
+
+Tonemapping::Tonemapping(Device* device, AppConfig* appConfig, SwapChain* swapChain, VkRenderPass renderPass, uint32_t subpass)
+            : _device(device), _appConfig(appConfig), _swapChain(swapChain) {
+    _subpass = _appConfig->tonemapSubpass();
+    if (!_subpass) {
+        createSampler();
+        createRenderPass();
+        renderPass = _renderPass;
+        subpass = 0;
+    }
+    createDescriptorSetLayout();
+    createPipeline(renderPass, subpass);
+    createFramebuffers();
+    createDescriptorSets();
+}
+
+Tonemapping::~Tonemapping() {
+    destroyTargets();
+    vkDestroyPipeline(_device->logical(), _pipeline, nullptr);
+    vkDestroyPipelineLayout(_device->logical(), _pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(_device->logical(), _descriptorSetLayout, nullptr);
+    vkDestroyRenderPass(_device->logical(), _renderPass, nullptr);
+    vkDestroySampler(_device->logical(), _sampler, nullptr);
+}
+
+void Tonemapping::createSampler() {
+    //texels are fetched one to one
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    if (vkCreateSampler(_device->logical(), &samplerInfo, nullptr, &_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tonemapping sampler!");
+    }
+}
+
+void Tonemapping::createRenderPass() {
+    //every rendered pixel is written, the previous contents are not needed
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = _swapChain->sceneColorFormat();
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = _appConfig->dynamicResolution() ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    //waits for the HDR target being written and for the swap chain image being acquired
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    std::vector<VkSubpassDependency> dependencies = {dependency};
+
+    //the upscale samples the result
+    if (_appConfig->dynamicResolution()) {
+        VkSubpassDependency upscaleDependency{};
+        upscaleDependency.srcSubpass = 0;
+        upscaleDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        upscaleDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        upscaleDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        upscaleDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        upscaleDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dependencies.push_back(upscaleDependency);
+    }
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(_device->logical(), &renderPassInfo, nullptr, &_renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tonemapping render pass!");
+    }
+}
+
+void Tonemapping::createDescriptorSetLayout() {
+    VkDescriptorSetLayoutBinding hdrLayoutBinding{};
+    hdrLayoutBinding.binding = 0;
+    hdrLayoutBinding.descriptorCount = 1;
+    hdrLayoutBinding.descriptorType = _subpass ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    hdrLayoutBinding.pImmutableSamplers = nullptr;
+    hdrLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &hdrLayoutBinding;
+
+    if (vkCreateDescriptorSetLayout(_device->logical(), &layoutInfo, nullptr, &_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tonemapping descriptor set layout!");
+    }
+}
+
+void Tonemapping::createPipeline(VkRenderPass renderPass, uint32_t subpass) {
+    _pipelineLayout = createFullscreenPipelineLayout(_device, _descriptorSetLayout, sizeof(float));
+    _pipeline = createFullscreenPipeline(_device, _appConfig->fullscreenVertexShaderPath(),
+                                         _subpass ? _appConfig->tonemapFragmentShaderPath() : _appConfig->tonemapPassFragmentShaderPath(),
+                                         _pipelineLayout, renderPass, subpass);
+}
+
+void Tonemapping::createFramebuffers() {
+    if (_subpass) {
+        return;
+    }
+    _framebuffers.resize(_swapChain->imageViews().size());
+    for (size_t i = 0; i < _framebuffers.size(); i++) {
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = _renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &_swapChain->sceneColorImageViews()[i];
+        framebufferInfo.width = _swapChain->extent().width;
+        framebufferInfo.height = _swapChain->extent().height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(_device->logical(), &framebufferInfo, nullptr, &_framebuffers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create tonemapping framebuffer!");
+        }
+    }
+}
+
+void Tonemapping::createDescriptorSets() {
+    uint32_t imageCount = static_cast<uint32_t>(_swapChain->imageViews().size());
+    VkDescriptorType descriptorType = _subpass ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = descriptorType;
+    poolSize.descriptorCount = imageCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = imageCount;
+
+    if (vkCreateDescriptorPool(_device->logical(), &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tonemapping descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(imageCount, _descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _descriptorPool;
+    allocInfo.descriptorSetCount = imageCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    _descriptorSets.resize(imageCount);
+    if (vkAllocateDescriptorSets(_device->logical(), &allocInfo, _descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate tonemapping descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        VkDescriptorImageInfo imageInfo{_sampler, _swapChain->hdrImageView(i), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = _descriptorSets[i];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = descriptorType;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(_device->logical(), 1, &descriptorWrite, 0, nullptr);
+    }
+}
+
+void Tonemapping::destroyTargets() {
+    vkDestroyDescriptorPool(_device->logical(), _descriptorPool, nullptr);
+    for (auto framebuffer : _framebuffers) {
+        vkDestroyFramebuffer(_device->logical(), framebuffer, nullptr);
+    }
+}
+
+void Tonemapping::recreate() {
+    //frames in flight keep using the old sets and framebuffers, which are destroyed once their fences signal
+    _device->deletionQueue().push([device = _device->logical(), descriptorPool = _descriptorPool, framebuffers = _framebuffers]() {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        for (auto framebuffer : framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+    });
+    createFramebuffers();
+    createDescriptorSets();
+}
+
+void Tonemapping::recordSubpass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    float exposure = _appConfig->exposure();
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSets[imageIndex], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(exposure), &exposure);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void Tonemapping::recordPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _renderPass;
+    renderPassInfo.framebuffer = _framebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = _swapChain->renderExtent();
+    renderPassInfo.clearValueCount = 0;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(_swapChain->renderExtent().width);
+    viewport.height = static_cast<float>(_swapChain->renderExtent().height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = _swapChain->renderExtent();
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    recordSubpass(commandBuffer, imageIndex);
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+double Tonemapping::hdrTrafficMb() {
+    double pixelBytes = _swapChain->hdrFormat() == VK_FORMAT_R16G16B16A16_SFLOAT ? 8.0 : 4.0;
+    double targetMb = _swapChain->extent().width * _swapChain->extent().height * pixelBytes / (1024.0 * 1024.0);
+    //the scattering composite always loads what the main pass stored, the separate pass adds one more store and read
+    uint32_t transfers = _appConfig->screenSpaceSss() ? 2 : 0;
+    if (!_subpass) {
+        transfers += 2;
+    }
+    return transfers * targetMb;
+}
+
+void Tonemapping::printStats() {
+    std::cout<<"Tonemapping ";
+    if (!_subpass) {
+        std::cout<<"as a separate pass";
+    } else {
+        std::cout<<"as a subpass of the "<<(_appConfig->screenSpaceSss() ? "scattering composite" : "main pass");
+    }
+    std::cout<<": estimated HDR traffic through memory "<<hdrTrafficMb()<<" MB per frame at full resolution"<<std::endl;
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "app_config.h"
+#include "device.h"
+#include "swap_chain.h"
+
+namespace vmr {
+// Tonemapping of the HDR target into the scene color target. Runs as the last subpass of the render pass that last
+// writes the HDR values (the main pass, or the scattering composite), reading them as an input attachment, or for
+// comparison as a separate render pass sampling the stored target.
+class Tonemapping {
+private:
+    Device* _device;
+    AppConfig* _appConfig;
+    SwapChain* _swapChain;
+    bool _subpass;
+    VkSampler _sampler = VK_NULL_HANDLE;
+    VkRenderPass _renderPass = VK_NULL_HANDLE;      // only for the separate pass
+    VkDescriptorSetLayout _descriptorSetLayout;
+    VkPipelineLayout _pipelineLayout;
+    VkPipeline _pipeline;
+
+    // recreated together with the swap chain
+    std::vector<VkFramebuffer> _framebuffers;
+    VkDescriptorPool _descriptorPool;
+    std::vector<VkDescriptorSet> _descriptorSets;
+
+    void createSampler();
+    void createRenderPass();
+    void createDescriptorSetLayout();
+    void createPipeline(VkRenderPass renderPass, uint32_t subpass);
+    void createFramebuffers();
+    void createDescriptorSets();
+    void destroyTargets();
+
+public:
+    // renderPass and subpass locate the tonemapping subpass, the separate pass uses its own
+    Tonemapping(Device* device, AppConfig* appConfig, SwapChain* swapChain, VkRenderPass renderPass, uint32_t subpass);
+    ~Tonemapping();
+    bool subpass()                              const { return _subpass; }
+
+    void recreate();
+    // draws within the current subpass, the viewport and scissor are left as set by the render pass
+    void recordSubpass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    // render pass on the scene color target, leaves it ready for presentation (or for the upscale)
+    void recordPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    // estimated HDR bytes written to and read back from memory per frame at full resolution
+    double hdrTrafficMb();
+    void printStats();
+};
+}
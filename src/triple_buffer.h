@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace vmr {
+// Hands the newest value from one writer thread to one reader thread without locks. The writer fills the back
+// slot and swaps it with the middle one, the reader swaps the middle slot with its front one whenever the writer
+// published since its last read. Neither side ever waits, intermediate values the reader did not get to are dropped.
+template<typename T>
+class TripleBuffer {
+private:
+    static const uint8_t INDEX_MASK = 0x3;
+    static const uint8_t FRESH_BIT = 0x4;     // set by the writer in the middle index, cleared by the reader
+
+    std::array<T, 3> _slots;
+    std::atomic<uint8_t> _middle{1};
+    uint8_t _back = 0;      // only touched by the writer
+    uint8_t _front = 2;     // only touched by the reader
+
+public:
+    TripleBuffer(const T& initial) : _slots{initial, initial, initial} {}
+
+    // writer side
+    T& back() { return _slots[_back]; }
+    void publish() {
+        uint8_t previous = _middle.exchange(_back | FRESH_BIT, std::memory_order_acq_rel);
+        _back = previous & INDEX_MASK;
+    }
+
+    // reader side, returns whether a newer value was published since the last fetch
+    bool fetch() {
+        if ((_middle.load(std::memory_order_acquire) & FRESH_BIT) == 0) {
+            return false;
+        }
+        uint8_t previous = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = previous & INDEX_MASK;
+        return true;
+    }
+    const T& front() const { return _slots[_front]; }
+};
+}
@@ -8,15 +8,18 @@
 #include "app_config.h"
 
 namespace vmr{
+class Simulation;
 
 class Window{
 private:
     GLFWwindow* _window;
     AppConfig* _appConfig;
+    Simulation* _simulation = nullptr;
     bool _framebufferResized = false;
 
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
     static void mouseMovementCallback(GLFWwindow* window, double xpos, double ypos);
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
     bool isPressed(int key);
     
 public:
@@ -25,6 +28,8 @@ public:
     GLFWwindow* window() {return _window; }
     bool& framebufferResized()       { return _framebufferResized; }
     const bool& framebufferResized() const { return _framebufferResized; }
+    // receives the movement and toggle input, events are only forwarded from then on
+    void setSimulation(Simulation* simulation) { _simulation = simulation; }
 
     void handleKeystrokes();
     void pollEvents();
@@ -0,0 +1,285 @@
+// Renders every scene of tests/render_tests.json through the renderer and checks it against the stored references:
+// the last captured frame against tests/golden/<scene>.png within a perceptual tolerance, and the startup and median
+// frame times against tests/baselines.json. Meant to run on a software Vulkan driver, so the images do not depend on
+// the GPU and the times only on the machine. With --update the references are recorded instead of compared. A scene
+// without a reference fails, unless --allow-missing reports it as skipped instead.
+// Usage: render_test <renderer> [--update] [--allow-missing]
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+using nlohmann::json;
+
+const fs::path TEST_DIR = "tests";
+const fs::path OUTPUT_DIR = "build/test";
+
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;     // RGBA
+};
+
+enum class CheckResult { Passed, Failed, Missing };    // missing: no reference recorded yet
+
+struct ImageDifference {
+    double meanDeltaE = 0.0;
+    double badPixelFraction = 0.0;        // share of pixels differing noticeably
+};
+
+json readJson(const fs::path& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("failed to open " + path.string() + "!");
+    }
+    return json::parse(file);
+}
+
+void writeJson(const fs::path& path, const json& value) {
+    std::ofstream file(path);
+    file<<value.dump(4)<<std::endl;
+}
+
+bool loadImage(const fs::path& path, Image& image) {
+    int channels;
+    unsigned char* data = stbi_load(path.string().c_str(), &image.width, &image.height, &channels, 4);
+    if (!data) {
+        return false;
+    }
+    image.pixels.assign(data, data + static_cast<size_t>(image.width) * image.height * 4);
+    stbi_image_free(data);
+    return true;
+}
+
+//CIELAB of an sRGB pixel under D65, where a euclidean distance of about 2.3 is the smallest noticeable difference
+void toLab(const unsigned char* pixel, double lab[3]) {
+    double linear[3];
+    for (int c = 0; c < 3; c++) {
+        double v = pixel[c] / 255.0;
+        linear[c] = v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+    }
+    double xyz[3] = {
+        (0.4124 * linear[0] + 0.3576 * linear[1] + 0.1805 * linear[2]) / 0.95047,
+        (0.2126 * linear[0] + 0.7152 * linear[1] + 0.0722 * linear[2]),
+        (0.0193 * linear[0] + 0.1192 * linear[1] + 0.9505 * linear[2]) / 1.08883
+    };
+    for (double& v : xyz) {
+        v = v > 0.008856 ? std::cbrt(v) : 7.787 * v + 16.0 / 116.0;
+    }
+    lab[0] = 116.0 * xyz[1] - 16.0;
+    lab[1] = 500.0 * (xyz[0] - xyz[1]);
+    lab[2] = 200.0 * (xyz[1] - xyz[2]);
+}
+
+//also writes a map of the differing pixels, red where the difference is noticeable
+ImageDifference compareImages(const Image& result, const Image& golden, double pixelDeltaE, const fs::path& diffPath) {
+    ImageDifference difference;
+    size_t pixelCount = static_cast<size_t>(result.width) * result.height;
+    std::vector<unsigned char> diff(pixelCount * 3);
+    size_t badPixels = 0;
+    for (size_t i = 0; i < pixelCount; i++) {
+        double a[3], b[3];
+        toLab(&result.pixels[4 * i], a);
+        toLab(&golden.pixels[4 * i], b);
+        double deltaE = std::sqrt((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+        difference.meanDeltaE += deltaE;
+        unsigned char gray = static_cast<unsigned char>(std::min(255.0, deltaE * 255.0 / (4.0 * pixelDeltaE)));
+        if (deltaE > pixelDeltaE) {
+            badPixels++;
+            diff[3 * i] = 255;
+            diff[3 * i + 1] = 0;
+            diff[3 * i + 2] = 0;
+        } else {
+            diff[3 * i] = diff[3 * i + 1] = diff[3 * i + 2] = gray;
+        }
+    }
+    difference.meanDeltaE /= pixelCount;
+    difference.badPixelFraction = static_cast<double>(badPixels) / pixelCount;
+    stbi_write_png(diffPath.string().c_str(), result.width, result.height, 3, diff.data(), result.width * 3);
+    return difference;
+}
+
+//config.json with the scene's and the run's settings merged in, written next to the run's other outputs
+fs::path writeConfig(const json& base, const json& common, const json& scene, const json& run, const fs::path& path) {
+    json config = base;
+    config.merge_patch(common);
+    config.merge_patch(scene);
+    config.merge_patch(run);
+    writeJson(path, config);
+    return path;
+}
+
+bool runRenderer(const std::string& renderer, const fs::path& config, const fs::path& log) {
+    std::string command = renderer + " " + config.string() + " > " + log.string() + " 2>&1";
+    if (std::system(command.c_str()) != 0) {
+        std::cout<<"FAILED (renderer exited with an error, see "<<log.string()<<")\n";
+        return false;
+    }
+    return true;
+}
+
+CheckResult checkImage(const std::string& scene, const fs::path& frame, const json& tolerance, bool update, const fs::path& outputDir) {
+    fs::path golden = TEST_DIR / "golden" / (scene + ".png");
+    if (!fs::exists(frame)) {
+        std::cout<<"FAILED (no frame captured)\n";
+        return CheckResult::Failed;
+    }
+    if (update) {
+        fs::create_directories(golden.parent_path());
+        fs::copy_file(frame, golden, fs::copy_options::overwrite_existing);
+        std::cout<<"image recorded, ";
+        return CheckResult::Passed;
+    }
+    Image result, reference;
+    if (!loadImage(frame, result)) {
+        std::cout<<"FAILED (captured frame "<<frame.string()<<" can't be read)\n";
+        return CheckResult::Failed;
+    }
+    if (!fs::exists(golden)) {
+        std::cout<<"image MISSING (no golden image "<<golden.string()<<", record one with make test_update), ";
+        return CheckResult::Missing;
+    }
+    if (!loadImage(golden, reference)) {
+        std::cout<<"FAILED (golden image "<<golden.string()<<" can't be read)\n";
+        return CheckResult::Failed;
+    }
+    if (result.width != reference.width || result.height != reference.height) {
+        std::cout<<"FAILED (frame is "<<result.width<<"x"<<result.height<<", golden image "<<reference.width<<"x"<<reference.height<<")\n";
+        return CheckResult::Failed;
+    }
+    ImageDifference difference = compareImages(result, reference, tolerance["pixelDeltaE"], outputDir / "diff.png");
+    std::cout<<"mean dE "<<difference.meanDeltaE<<", "<<100.0 * difference.badPixelFraction<<"% pixels differ, ";
+    if (difference.badPixelFraction > tolerance["maxPixelFraction"].get<double>() || difference.meanDeltaE > tolerance["maxMeanDeltaE"].get<double>()) {
+        std::cout<<"FAILED (image differs, see "<<(outputDir / "diff.png").string()<<")\n";
+        return CheckResult::Failed;
+    }
+    return CheckResult::Passed;
+}
+
+CheckResult checkPerformance(const std::string& scene, const json& metrics, const json& tolerance, json& baselines, bool update) {
+    double frameMs = metrics["medianFrameMs"];
+    double startupMs = metrics["startupMs"];
+    std::cout<<"frame "<<frameMs<<" ms, startup "<<startupMs<<" ms";
+    if (update) {
+        baselines[scene] = {{"medianFrameMs", frameMs}, {"startupMs", startupMs}};
+        std::cout<<", baseline recorded\n";
+        return CheckResult::Passed;
+    }
+    if (!baselines.contains(scene)) {
+        std::cout<<"\n    timing MISSING (no baseline in "<<(TEST_DIR / "baselines.json").string()<<", record one with make test_update)\n";
+        return CheckResult::Missing;
+    }
+    //each time is allowed to grow by its tolerance over the baseline, getting faster always passes
+    bool passed = true;
+    double frameLimit = baselines[scene]["medianFrameMs"].get<double>() * (1.0 + tolerance["frameTimeTolerance"].get<double>());
+    double startupLimit = baselines[scene]["startupMs"].get<double>() * (1.0 + tolerance["startupTimeTolerance"].get<double>());
+    if (frameMs > frameLimit) {
+        std::cout<<"\n    FAILED (frame time regressed, limit "<<frameLimit<<" ms)";
+        passed = false;
+    }
+    if (startupMs > startupLimit) {
+        std::cout<<"\n    FAILED (startup time regressed, limit "<<startupLimit<<" ms)";
+        passed = false;
+    }
+    std::cout<<(passed ? ", ok\n" : "\n");
+    return passed ? CheckResult::Passed : CheckResult::Failed;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr<<"Usage: render_test <renderer> [--update] [--allow-missing]"<<std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string renderer = argv[1];
+    bool update = false;
+    bool allowMissing = false;
+    for (int i = 2; i < argc; i++) {
+        update = update || std::string(argv[i]) == "--update";
+        allowMissing = allowMissing || std::string(argv[i]) == "--allow-missing";
+    }
+    std::cout.setf(std::ios::fixed, std::ios::floatfield);
+    std::cout.precision(3);
+
+    try {
+        json base = readJson("config.json");
+        json tests = readJson(TEST_DIR / "render_tests.json");
+        json baselines = readJson(TEST_DIR / "baselines.json");
+        uint32_t captureFrames = tests["captureFrames"];
+        char lastFrame[32];
+        std::snprintf(lastFrame, sizeof(lastFrame), "frame_%06u.png", captureFrames - 1);
+
+        uint32_t failures = 0;
+        uint32_t skipped = 0;
+        for (const std::string scene : tests["scenes"]) {
+            json patch = readJson(TEST_DIR / "scenes" / (scene + ".json"));
+            fs::path outputDir = OUTPUT_DIR / scene;
+            fs::remove_all(outputDir);
+            fs::create_directories(outputDir / "frames");
+            std::cout<<scene<<": "<<std::flush;
+
+            //the image is taken from the last captured frame, by then every startup pass has finished, and with a
+            //readback buffer for every frame none of them is dropped
+            json captureRun = {
+                {"capture", {{"enabled", true}, {"format", "png"}, {"directory", (outputDir / "frames").string()},
+                             {"frames", captureFrames}, {"ringSize", captureFrames}, {"hidden", true}}},
+                {"metrics", {{"path", ""}, {"frames", 0}}}
+            };
+            fs::path config = writeConfig(base, tests["common"], patch, captureRun, outputDir / "capture.json");
+            if (!runRenderer(renderer, config, outputDir / "capture.log")) {
+                failures++;
+                continue;
+            }
+            CheckResult image = checkImage(scene, outputDir / "frames" / lastFrame, tests["image"], update, outputDir);
+            if (image == CheckResult::Failed) {
+                failures++;
+                continue;
+            }
+
+            //timed separately, the readback copies and encoding would otherwise be measured too
+            json perfRun = {
+                {"capture", {{"enabled", false}, {"hidden", true}}},
+                {"metrics", {{"path", (outputDir / "metrics.json").string()}, {"frames", tests["perfFrames"]}}}
+            };
+            config = writeConfig(base, tests["common"], patch, perfRun, outputDir / "perf.json");
+            if (!runRenderer(renderer, config, outputDir / "perf.log")) {
+                failures++;
+                continue;
+            }
+            CheckResult performance = checkPerformance(scene, readJson(outputDir / "metrics.json"), tests["performance"], baselines, update);
+            bool missing = image == CheckResult::Missing || performance == CheckResult::Missing;
+            if (performance == CheckResult::Failed || (missing && !allowMissing)) {
+                failures++;
+            } else if (missing) {
+                skipped++;
+            }
+        }
+
+        size_t sceneCount = tests["scenes"].size();
+        if (update) {
+            writeJson(TEST_DIR / "baselines.json", baselines);
+            std::cout<<"References of "<<sceneCount - failures<<" of "<<sceneCount<<" scene(s) recorded"<<std::endl;
+        } else {
+            std::cout<<sceneCount - failures - skipped<<" of "<<sceneCount<<" scene(s) passed";
+            if (skipped > 0) {
+                std::cout<<", "<<skipped<<" skipped for missing references (--allow-missing)";
+            }
+            std::cout<<std::endl;
+        }
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        std::cerr<<e.what()<<std::endl;
+        return EXIT_FAILURE;
+    }
+}
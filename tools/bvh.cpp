@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "bvh.h"
+
+namespace vmr {
+
+const uint32_t MAX_LEAF_TRIANGLES = 4;
+
+Bvh::Bvh(std::vector<Triangle> triangles) : _triangles(std::move(triangles)) {
+    _centroids.reserve(_triangles.size());
+    for (const auto& triangle : _triangles) {
+        _centroids.push_back((triangle.v0 + triangle.v1 + triangle.v2) / 3.0f);
+    }
+    _nodes.reserve(2 * _triangles.size() / MAX_LEAF_TRIANGLES + 1);
+    if (!_triangles.empty()) {
+        build(0, static_cast<uint32_t>(_triangles.size()));
+    }
+}
+
+uint32_t Bvh::build(uint32_t first, uint32_t count) {
+    uint32_t nodeIndex = static_cast<uint32_t>(_nodes.size());
+    _nodes.push_back({});
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    glm::vec3 centroidMin = boundsMin;
+    glm::vec3 centroidMax = boundsMax;
+    for (uint32_t i = first; i < first + count; i++) {
+        boundsMin = glm::min(boundsMin, glm::min(_triangles[i].v0, glm::min(_triangles[i].v1, _triangles[i].v2)));
+        boundsMax = glm::max(boundsMax, glm::max(_triangles[i].v0, glm::max(_triangles[i].v1, _triangles[i].v2)));
+        centroidMin = glm::min(centroidMin, _centroids[i]);
+        centroidMax = glm::max(centroidMax, _centroids[i]);
+    }
+    _nodes[nodeIndex].boundsMin = boundsMin;
+    _nodes[nodeIndex].boundsMax = boundsMax;
+
+    if (count <= MAX_LEAF_TRIANGLES) {
+        _nodes[nodeIndex].first = first;
+        _nodes[nodeIndex].count = count;
+        return nodeIndex;
+    }
+
+    //median split along the widest axis of the centroids, triangles and centroids are permuted together
+    glm::vec3 extent = centroidMax - centroidMin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    std::vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = first + i;
+    }
+    uint32_t half = count / 2;
+    std::nth_element(order.begin(), order.begin() + half, order.end(), [&](uint32_t a, uint32_t b) {
+        return _centroids[a][axis] < _centroids[b][axis];
+    });
+    std::vector<Triangle> triangles(count);
+    std::vector<glm::vec3> centroids(count);
+    for (uint32_t i = 0; i < count; i++) {
+        triangles[i] = _triangles[order[i]];
+        centroids[i] = _centroids[order[i]];
+    }
+    std::copy(triangles.begin(), triangles.end(), _triangles.begin() + first);
+    std::copy(centroids.begin(), centroids.end(), _centroids.begin() + first);
+
+    build(first, half);
+    uint32_t right = build(first + half, count - half);
+    _nodes[nodeIndex].first = right;
+    _nodes[nodeIndex].count = 0;
+    return nodeIndex;
+}
+
+static bool intersectsBounds(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float maxDistance) {
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+        if (tMin > tMax) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Moller-Trumbore, both faces count since the ray starts inside the mesh
+static float intersectTriangle(const glm::vec3& origin, const glm::vec3& direction, const Triangle& triangle) {
+    glm::vec3 edge1 = triangle.v1 - triangle.v0;
+    glm::vec3 edge2 = triangle.v2 - triangle.v0;
+    glm::vec3 p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::fabs(determinant) < 1e-12f) {
+        return -1.0f;
+    }
+    float inverseDeterminant = 1.0f / determinant;
+    glm::vec3 s = origin - triangle.v0;
+    float u = glm::dot(s, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f) {
+        return -1.0f;
+    }
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f) {
+        return -1.0f;
+    }
+    return glm::dot(edge2, q) * inverseDeterminant;
+}
+
+float Bvh::closestHit(const glm::vec3& origin, const glm::vec3& direction, float minDistance, float maxDistance) const {
+    if (_nodes.empty()) {
+        return maxDistance;
+    }
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float closest = maxDistance;
+
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = _nodes[stack[--stackSize]];
+        if (!intersectsBounds(origin, inverseDirection, node.boundsMin, node.boundsMax, closest)) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                float distance = intersectTriangle(origin, direction, _triangles[i]);
+                if (distance > minDistance && distance < closest) {
+                    closest = distance;
+                }
+            }
+        } else {
+            uint32_t left = static_cast<uint32_t>(&node - _nodes.data()) + 1;
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = left;
+        }
+    }
+    return closest;
+}
+
+}
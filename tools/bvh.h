@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vmr {
+struct Triangle {
+    glm::vec3 v0;
+    glm::vec3 v1;
+    glm::vec3 v2;
+};
+
+// Bounding volume hierarchy over a static triangle soup, answering closest-hit queries from many threads at once
+class Bvh {
+private:
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        uint32_t first;     // first triangle of a leaf, or the right child of an inner node (the left one follows directly)
+        uint32_t count;     // 0 for inner nodes
+    };
+
+    std::vector<Triangle> _triangles;
+    std::vector<glm::vec3> _centroids;
+    std::vector<Node> _nodes;
+
+    uint32_t build(uint32_t first, uint32_t count);
+
+public:
+    Bvh(std::vector<Triangle> triangles);
+
+    size_t nodeCount()      const { return _nodes.size(); }
+    size_t triangleCount()  const { return _triangles.size(); }
+
+    // distance to the closest triangle along the normalized direction within (minDistance, maxDistance), or maxDistance if there is none
+    float closestHit(const glm::vec3& origin, const glm::vec3& direction, float minDistance, float maxDistance) const;
+};
+}
@@ -0,0 +1,93 @@
+// Compares frustum culling of 100k instances by a scalar glm loop over instance matrices
+// with the packed SIMD kernels used by the CPU culling path of the renderer.
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../src/frustum.h"
+#include "../src/sphere_culling.h"
+
+using namespace vmr;
+
+const uint32_t instanceCount = 100000;
+const uint32_t iterations = 200;
+
+template<typename F>
+double measure(F pass) {
+    pass(); // warmup
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        pass();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+int main() {
+    //instances scattered around the camera, about a tenth of them ends up inside the frustum
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    std::uniform_real_distribution<float> scale(0.2f, 2.0f);
+
+    std::vector<glm::mat4> models(instanceCount);
+    for (auto& model : models) {
+        model = glm::translate(glm::mat4(1.0f), glm::vec3(position(generator), position(generator), position(generator)));
+        model = glm::rotate(model, glm::radians(angle(generator)), glm::vec3(0.0f, 0.0f, 1.0f));
+        model = glm::scale(model, glm::vec3(scale(generator)));
+    }
+    BoundingSphere meshBounds{glm::vec3(0.0f, 0.1f, 0.2f), 0.75f};
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, -10.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    proj[1][1] *= -1;
+    Frustum frustum = Frustum::fromViewProjection(proj * view);
+
+    std::vector<uint32_t> visibleIndices(instanceCount);
+    uint32_t scalarVisible = 0;
+    double scalarTime = measure([&]() {
+        scalarVisible = 0;
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            BoundingSphere bounds = meshBounds.transformed(models[i]);
+            if (frustum.intersectsSphere(bounds.center, bounds.radius)) {
+                visibleIndices[scalarVisible++] = i;
+            }
+        }
+    });
+
+    //packing happens only when the scene changes, it is reported separately from the per-frame test
+    BoundingSphereArray spheres;
+    double packTime = measure([&]() {
+        spheres.resize(instanceCount);
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            spheres.set(i, meshBounds.transformed(models[i]));
+        }
+    });
+
+    std::cout.setf(std::ios::fixed,std::ios::floatfield);
+    std::cout.precision(2);
+    std::cout<<instanceCount<<" instances, "<<iterations<<" iterations\n";
+    std::cout<<"packing bounds: "<<packTime<<" us\n\n";
+    std::cout<<"kernel | avg time [us] | visible | speedup\n";
+    std::cout<<"glm loop | "<<scalarTime<<" | "<<scalarVisible<<" | 1.00x\n";
+
+    CullingKernel best = bestCullingKernel();
+    for (CullingKernel kernel : {CullingKernel::Scalar, CullingKernel::Sse, CullingKernel::Avx}) {
+        if (static_cast<int>(kernel) > static_cast<int>(best)) {
+            std::cout<<cullingKernelName(kernel)<<" | not supported\n";
+            continue;
+        }
+        uint32_t visible = 0;
+        double time = measure([&]() {
+            visible = cullSpheres(frustum, spheres, visibleIndices.data(), kernel);
+        });
+        std::cout<<cullingKernelName(kernel)<<" | "<<time<<" | "<<visible<<" | "<<scalarTime / time<<"x"
+                 <<(visible == scalarVisible ? "" : " (MISMATCH)")<<"\n";
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+// Bakes a local thickness map for subsurface scattering. Every texel of the UV layout casts rays into the mesh,
+// against the surface normal, and stores how close the opposite side is (white = thin, black = thick or no surface).
+// Usage: thickness_baker <model.obj> <output.pgm> [resolution] [rays per texel] [max distance]
+#define TINYOBJLOADER_IMPLEMENTATION
+
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "../src/thread_pool.h"
+#include "bvh.h"
+
+using namespace vmr;
+
+struct MeshTriangle {
+    glm::vec3 position[3];
+    glm::vec3 normal[3];
+    glm::vec2 texCoord[3];
+    bool mapped = true;     // false without texture coordinates, the triangle then only occludes
+};
+
+// Surface point covered by a texel, found by rasterizing the triangles in UV space
+struct TexelSample {
+    bool covered = false;
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+const uint32_t ROWS_PER_TASK = 8;
+const uint32_t DILATION_STEPS = 4;
+
+std::vector<MeshTriangle> loadTriangles(const std::string& path) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+        throw std::runtime_error(warn + err);
+    }
+
+    std::vector<MeshTriangle> triangles;
+    for (const auto& shape : shapes) {
+        for (size_t i = 0; i + 2 < shape.mesh.indices.size(); i += 3) {
+            MeshTriangle triangle{};
+            bool hasNormals = true;
+            for (int corner = 0; corner < 3; corner++) {
+                const auto& index = shape.mesh.indices[i + corner];
+                //tinyobj marks attributes a face does not reference with a negative index
+                if (index.vertex_index < 0) {
+                    throw std::runtime_error("face without a vertex position in " + path + "!");
+                }
+                triangle.position[corner] = {
+                    attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2]
+                };
+                if (index.normal_index >= 0) {
+                    triangle.normal[corner] = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2]
+                    };
+                } else {
+                    hasNormals = false;
+                }
+                //flipped the same way as in ModelPipeline::loadModel, so texel rows match the renderer's texture coordinates
+                if (index.texcoord_index >= 0) {
+                    triangle.texCoord[corner] = {
+                        attrib.texcoords[2 * index.texcoord_index + 0],
+                        1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                    };
+                } else {
+                    triangle.mapped = false;
+                }
+            }
+            if (!hasNormals) {
+                glm::vec3 faceNormal = glm::cross(triangle.position[1] - triangle.position[0], triangle.position[2] - triangle.position[0]);
+                if (glm::length(faceNormal) > 0.0f) {
+                    faceNormal = glm::normalize(faceNormal);
+                }
+                triangle.normal[0] = triangle.normal[1] = triangle.normal[2] = faceNormal;
+            }
+            triangles.push_back(triangle);
+        }
+    }
+    return triangles;
+}
+
+std::vector<TexelSample> rasterizeUvLayout(const std::vector<MeshTriangle>& triangles, uint32_t resolution) {
+    std::vector<TexelSample> texels(resolution * resolution);
+    for (const auto& triangle : triangles) {
+        if (!triangle.mapped) {
+            continue;
+        }
+        glm::vec2 p0 = triangle.texCoord[0] * static_cast<float>(resolution);
+        glm::vec2 p1 = triangle.texCoord[1] * static_cast<float>(resolution);
+        glm::vec2 p2 = triangle.texCoord[2] * static_cast<float>(resolution);
+        float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+        if (std::fabs(area) < 1e-12f) {
+            continue;
+        }
+
+        int minX = std::max(0, static_cast<int>(std::floor(std::min({p0.x, p1.x, p2.x}))));
+        int maxX = std::min(static_cast<int>(resolution) - 1, static_cast<int>(std::ceil(std::max({p0.x, p1.x, p2.x}))));
+        int minY = std::max(0, static_cast<int>(std::floor(std::min({p0.y, p1.y, p2.y}))));
+        int maxY = std::min(static_cast<int>(resolution) - 1, static_cast<int>(std::ceil(std::max({p0.y, p1.y, p2.y}))));
+        for (int y = minY; y <= maxY; y++) {
+            for (int x = minX; x <= maxX; x++) {
+                glm::vec2 center(x + 0.5f, y + 0.5f);
+                float w0 = ((p1.x - center.x) * (p2.y - center.y) - (p2.x - center.x) * (p1.y - center.y)) / area;
+                float w1 = ((p2.x - center.x) * (p0.y - center.y) - (p0.x - center.x) * (p2.y - center.y)) / area;
+                float w2 = 1.0f - w0 - w1;
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                    continue;
+                }
+                TexelSample& texel = texels[y * resolution + x];
+                texel.covered = true;
+                texel.position = triangle.position[0] * w0 + triangle.position[1] * w1 + triangle.position[2] * w2;
+                texel.normal = glm::normalize(triangle.normal[0] * w0 + triangle.normal[1] * w1 + triangle.normal[2] * w2);
+            }
+        }
+    }
+    return texels;
+}
+
+float bakeTexel(const Bvh& bvh, const TexelSample& texel, uint32_t rayCount, float maxDistance, std::mt19937& generator) {
+    //cosine-weighted directions around the inverted normal
+    glm::vec3 inward = -texel.normal;
+    glm::vec3 helper = std::fabs(inward.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 tangent = glm::normalize(glm::cross(helper, inward));
+    glm::vec3 bitangent = glm::cross(inward, tangent);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    float epsilon = maxDistance * 1e-4f;
+    glm::vec3 origin = texel.position + inward * epsilon;
+    float distanceSum = 0.0f;
+    for (uint32_t i = 0; i < rayCount; i++) {
+        float radius = std::sqrt(uniform(generator));
+        float angle = 2.0f * 3.14159265f * uniform(generator);
+        glm::vec3 direction = tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle))
+                            + inward * std::sqrt(std::max(0.0f, 1.0f - radius * radius));
+        distanceSum += bvh.closestHit(origin, glm::normalize(direction), epsilon, maxDistance);
+    }
+    return 1.0f - distanceSum / (rayCount * maxDistance);
+}
+
+//empty texels next to baked ones take their average, so bilinear filtering does not bleed black into UV seams
+void dilate(std::vector<float>& values, std::vector<bool>& filled, uint32_t resolution) {
+    for (uint32_t step = 0; step < DILATION_STEPS; step++) {
+        std::vector<float> next = values;
+        std::vector<bool> nextFilled = filled;
+        for (uint32_t y = 0; y < resolution; y++) {
+            for (uint32_t x = 0; x < resolution; x++) {
+                if (filled[y * resolution + x]) {
+                    continue;
+                }
+                float sum = 0.0f;
+                int count = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = static_cast<int>(x) + dx;
+                        int ny = static_cast<int>(y) + dy;
+                        if (nx < 0 || ny < 0 || nx >= static_cast<int>(resolution) || ny >= static_cast<int>(resolution) || !filled[ny * resolution + nx]) {
+                            continue;
+                        }
+                        sum += values[ny * resolution + nx];
+                        count++;
+                    }
+                }
+                if (count > 0) {
+                    next[y * resolution + x] = sum / count;
+                    nextFilled[y * resolution + x] = true;
+                }
+            }
+        }
+        values = std::move(next);
+        filled = std::move(nextFilled);
+    }
+}
+
+//binary PGM, a single 8-bit channel that stb_image loads directly
+void writePgm(const std::string& path, const std::vector<float>& values, uint32_t resolution) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+    file<<"P5\n"<<resolution<<" "<<resolution<<"\n255\n";
+    std::vector<unsigned char> pixels(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        pixels[i] = static_cast<unsigned char>(std::round(std::min(1.0f, std::max(0.0f, values[i])) * 255.0f));
+    }
+    file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr<<"usage: "<<argv[0]<<" <model.obj> <output.pgm> [resolution=1024] [rays=64] [maxDistance=half of the bounding radius]\n";
+        return 1;
+    }
+    std::string modelPath = argv[1];
+    std::string outputPath = argv[2];
+    uint32_t resolution = argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 1024;
+    uint32_t rayCount = argc > 4 ? static_cast<uint32_t>(std::stoul(argv[4])) : 64;
+
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<MeshTriangle> meshTriangles = loadTriangles(modelPath);
+
+        std::vector<Triangle> triangles;
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+        for (const auto& triangle : meshTriangles) {
+            triangles.push_back({triangle.position[0], triangle.position[1], triangle.position[2]});
+            for (const auto& position : triangle.position) {
+                boundsMin = glm::min(boundsMin, position);
+                boundsMax = glm::max(boundsMax, position);
+            }
+        }
+        float maxDistance = argc > 5 ? std::stof(argv[5]) : glm::length(boundsMax - boundsMin) * 0.25f;
+
+        Bvh bvh(std::move(triangles));
+        std::vector<TexelSample> texels = rasterizeUvLayout(meshTriangles, resolution);
+        auto prepared = std::chrono::high_resolution_clock::now();
+        std::cout<<"Loaded "<<bvh.triangleCount()<<" triangles, built "<<bvh.nodeCount()<<" BVH nodes in "
+                 <<std::chrono::duration<float, std::chrono::milliseconds::period>(prepared - start).count()<<" ms\n";
+
+        //texel rows are baked in blocks on all hardware threads, each block with its own deterministic random sequence
+        std::vector<float> values(texels.size(), 0.0f);
+        std::vector<bool> filled(texels.size(), false);
+        uint64_t coveredCount = 0;
+        for (const auto& texel : texels) {
+            coveredCount += texel.covered;
+        }
+        {
+            ThreadPool threadPool(std::thread::hardware_concurrency());
+            std::cout<<"Baking on "<<threadPool.workerCount()<<" thread(s)\n";
+            std::vector<std::future<void>> tasks;
+            for (uint32_t firstRow = 0; firstRow < resolution; firstRow += ROWS_PER_TASK) {
+                tasks.push_back(threadPool.submit([&, firstRow]() {
+                    std::mt19937 generator(firstRow);
+                    uint32_t lastRow = std::min(resolution, firstRow + ROWS_PER_TASK);
+                    for (uint32_t i = firstRow * resolution; i < lastRow * resolution; i++) {
+                        if (texels[i].covered) {
+                            values[i] = bakeTexel(bvh, texels[i], rayCount, maxDistance, generator);
+                        }
+                    }
+                }));
+            }
+            for (auto& task : tasks) {
+                task.get();
+            }
+        }
+        for (size_t i = 0; i < texels.size(); i++) {
+            filled[i] = texels[i].covered;
+        }
+        auto baked = std::chrono::high_resolution_clock::now();
+        float bakeSeconds = std::chrono::duration<float>(baked - prepared).count();
+
+        dilate(values, filled, resolution);
+        writePgm(outputPath, values, resolution);
+
+        std::cout<<"Baked "<<coveredCount<<" texels ("<<resolution<<"x"<<resolution<<", "<<rayCount<<" rays, max distance "<<maxDistance<<") in "
+                 <<bakeSeconds<<" s, "<<coveredCount * rayCount / bakeSeconds / 1e6f<<" Mrays/s\n";
+        std::cout<<"Written to "<<outputPath<<"\n";
+    } catch (const std::exception& e) {
+        std::cerr<<e.what()<<std::endl;
+        return 1;
+    }
+    return 0;
+}